@@ -0,0 +1,138 @@
+//-----------------------------------------------------------------------------
+// File: AssetLoader.h
+//
+// Desc: Background bitmap loading. Loads are queued as requests that a few
+//	worker threads decode (CImageFile::LoadFromFile); the caller keeps the
+//	request as a handle and only blocks when it actually needs the pixels.
+//-----------------------------------------------------------------------------
+
+#ifndef _ASSETLOADER_H_
+#define _ASSETLOADER_H_
+
+//-----------------------------------------------------------------------------
+// AssetLoader Specific Includes
+//-----------------------------------------------------------------------------
+#include "ImageFile.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CAssetLoader;
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CAssetRequest (Class)
+// Desc : Handle of one queued load, owned by its loader.
+//-----------------------------------------------------------------------------
+class CAssetRequest
+{
+public:
+	const char*			Name() const { return m_strName.c_str(); }
+
+	// Finished, successfully or not. Never blocks.
+	bool				IsReady() const;
+
+	// The decoded image, NULL when the file could not be loaded. Blocks
+	// until the load is done; a load no worker has started yet is done on
+	// the calling thread instead of waiting for its turn.
+	const CImageFile*	Get();
+
+private:
+	friend class CAssetLoader;
+
+	enum STATE
+	{
+		QUEUED,
+		LOADING,
+		LOADED,
+		FAILED
+	};
+
+	CAssetRequest( CAssetLoader *pLoader, const char *szName, CImageFile *pTarget );
+	CAssetRequest( const CAssetRequest& rhs );
+	CAssetRequest& operator=( const CAssetRequest& rhs );
+
+	CAssetLoader		*m_pLoader;
+	std::string			m_strName;
+	CImageFile			m_Image;
+	CImageFile			*m_pTarget;			// Image decoded into, m_Image unless the caller gave one
+	STATE				m_State;			// Guarded by the loader's lock
+};
+
+//-----------------------------------------------------------------------------
+// Name : CAssetLoader (Class)
+// Desc : Owns the workers and every request made through it. Requests stay
+//		valid until the loader is destroyed, which drops the loads that have
+//		not started and waits for the others.
+//-----------------------------------------------------------------------------
+class CAssetLoader
+{
+public:
+	enum PRIORITY
+	{
+		LOAD_FOREGROUND,		// Needed soon, ahead of every background load
+		LOAD_BACKGROUND			// Needed later, loaded once the queue is idle
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	// 0 threads leaves one hardware thread to the caller, at least one
+	explicit CAssetLoader( unsigned uThreads = 0 );
+	~CAssetLoader();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	// Queues szFileName unless it was requested before, in which case that
+	// request is returned (raised to the foreground if asked). pTarget, when
+	// given, receives the pixels instead of an image owned by the request.
+	CAssetRequest*		Load( const char *szFileName, PRIORITY priority = LOAD_FOREGROUND, CImageFile *pTarget = NULL );
+
+	// The request made for szFileName, NULL if there was none
+	CAssetRequest*		Find( const char *szFileName ) const;
+
+	// Requests not finished yet
+	size_t				GetPendingCount() const;
+	void				WaitAll();
+
+	unsigned			GetThreadCount() const { return (unsigned)m_Workers.size(); }
+
+private:
+	friend class CAssetRequest;
+
+	CAssetLoader( const CAssetLoader& rhs );
+	CAssetLoader& operator=( const CAssetLoader& rhs );
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	void				WorkerMain();
+	void				Decode( CAssetRequest *pRequest, std::unique_lock<std::mutex> &lock );
+	bool				Unqueue( CAssetRequest *pRequest );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	typedef std::map<std::string, std::unique_ptr<CAssetRequest> > RequestMap;
+
+	std::vector<std::thread>		m_Workers;
+	mutable std::mutex				m_Lock;
+	std::condition_variable			m_WakeWorkers;
+	std::condition_variable			m_LoadDone;
+	std::deque<CAssetRequest*>		m_Foreground;
+	std::deque<CAssetRequest*>		m_Background;
+	RequestMap						m_Requests;
+	size_t							m_Pending;
+	bool							m_bQuit;
+};
+
+#endif // _ASSETLOADER_H_
@@ -0,0 +1,196 @@
+//-----------------------------------------------------------------------------
+// File: AssetPack.h
+//
+// Desc: Single file holding every sprite bitmap already decoded. PackBuilder
+//	writes it from a manifest (Data/assets.txt), the game maps it once and
+//	draws straight from the mapping, there is no decoding at run time.
+//
+//	Layout (little endian, every offset from the start of the file):
+//		SPackHeader
+//		SPackEntry[dwEntryCount]
+//		DWORD buckets[dwBucketCount]	entry index or PACK_EMPTY_BUCKET,
+//										open addressing on the name hash
+//		names							zero terminated
+//		pixels, palettes and masks		PACK_ALIGNMENT aligned
+//
+//	Pixels are bottom-up like a GDI DIB, unpadded rows in the smallest
+//	CCompactImage format holding the bitmap exactly (32 bit, RGB565 or 8 bit
+//	indices with a palette of COMPACT_PALETTE_SIZE colors); the writer picks
+//	it per entry and sprites widen the rows they draw. The mask is 1 bit per
+//	pixel, also bottom-up with rows padded to 4 bytes, set where the sprite
+//	is transparent; those pixels are black in the image so it can be drawn
+//	with SRCAND (mask) then SRCPAINT (image).
+//-----------------------------------------------------------------------------
+
+#ifndef _ASSETPACK_H_
+#define _ASSETPACK_H_
+
+//-----------------------------------------------------------------------------
+// AssetPack Specific Includes
+//-----------------------------------------------------------------------------
+#include "MappedFile.h"
+#include "CompactImage.h"
+
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const DWORD PACK_MAGIC			= 0x4b504953;	// "SIPK"
+const DWORD PACK_VERSION		= 2;
+const DWORD PACK_ALIGNMENT		= 64;			// Pixel, palette and mask data, a cache line
+const DWORD PACK_EMPTY_BUCKET	= 0xffffffff;
+const DWORD PACK_NO_COLOR_KEY	= 0xffffffff;
+
+// SPackEntry::dwFlags
+const DWORD PACK_HAS_MASK		= 0x1;
+
+//-----------------------------------------------------------------------------
+// Main Structure Declarations
+//-----------------------------------------------------------------------------
+struct SPackHeader
+{
+	DWORD	dwMagic;
+	DWORD	dwVersion;
+	DWORD	dwFileSize;
+	DWORD	dwEntryCount;
+	DWORD	dwBucketCount;			// Power of two
+	DWORD	dwEntriesOffset;
+	DWORD	dwBucketsOffset;
+	DWORD	dwNamesOffset;
+};
+
+struct SPackEntry
+{
+	DWORD	dwNameHash;
+	DWORD	dwNameOffset;
+	LONG	lWidth;
+	LONG	lHeight;
+	DWORD	dwColorKey;				// COLORREF the mask was made from, or PACK_NO_COLOR_KEY
+	DWORD	dwFlags;
+	DWORD	dwPixelsOffset;
+	DWORD	dwMaskOffset;			// 0 without PACK_HAS_MASK
+	DWORD	dwFrameCount;			// Animations, frames stacked downwards
+	RECT	rcFrame;				// First frame, top-down coordinates
+	DWORD	dwFormat;				// ECompactFormat of the pixels
+	DWORD	dwPaletteOffset;		// COMPACT_INDEXED8 only, 0 otherwise
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CAssetPack (Class)
+// Desc : Read only view of a pack. Open checks every entry against the file
+//		size, so the pointers handed out afterwards are always in range.
+//		They stay valid until Close.
+//-----------------------------------------------------------------------------
+class CAssetPack
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	CAssetPack();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	bool				Open( const char *szFileName );
+
+	// A pack already in memory, the bytes must outlive it
+	bool				Open( const BYTE *pData, size_t size );
+	void				Close();
+	bool				IsOpen() const { return m_pHeader != NULL; }
+
+	DWORD				GetEntryCount() const;
+	const SPackEntry*	GetEntry( DWORD dwIndex ) const;
+
+	// Names are matched ignoring case and the kind of slash, NULL when the
+	// pack does not hold it
+	const SPackEntry*	Find( const char *szName ) const;
+
+	const char*			GetName( const SPackEntry &entry ) const;
+	// Rows in the entry's format, the palette is NULL unless it is indexed
+	const BYTE*			GetPixels( const SPackEntry &entry ) const;
+	const RGBQUAD*		GetPalette( const SPackEntry &entry ) const;
+	const BYTE*			GetMask( const SPackEntry &entry ) const;
+
+	// rc (inclusive, rows in memory order) of the entry as 32 bit pixels
+	void				Expand( const SPackEntry &entry, const RECT &rc, RGBQUAD *pDst, size_t dstStride ) const;
+
+	static DWORD		HashName( const char *szName );
+	static DWORD		GetMaskStride( LONG lWidth ) { return ((DWORD)lWidth + 31) / 32 * 4; }
+
+private:
+	CAssetPack( const CAssetPack& rhs );
+	CAssetPack& operator=( const CAssetPack& rhs );
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	bool				Validate();
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	CMappedFile			m_File;
+	const BYTE			*m_pData;
+	size_t				m_Size;
+	const SPackHeader	*m_pHeader;			// NULL while closed
+	const SPackEntry	*m_pEntries;
+	const DWORD			*m_pBuckets;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CAssetPackWriter (Class)
+// Desc : Collects decoded bitmaps and lays them out as a pack, each in the
+//		smallest format that keeps every pixel. Used by the PackBuilder tool
+//		and the benchmarks.
+//-----------------------------------------------------------------------------
+class CAssetPackWriter
+{
+public:
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	// Keyed sprites get their mask from dwColorKey (a COLORREF), masked ones
+	// from pMask where it is dark (white is transparent). Neither gives an
+	// opaque sprite without a mask.
+	bool				Add( const char *szName, const CImageFile &image, DWORD dwColorKey,
+							const CImageFile *pMask = NULL, DWORD dwFrameCount = 1, const RECT *pFrame = NULL );
+
+	// Adds every bitmap listed in a manifest, one "<file> [key=RRGGBB]
+	// [mask=<file>] [frames=N] [frame=l,t,r,b]" per line, '#' starts a
+	// comment. Files are relative to the manifest and named szPrefix + file.
+	bool				AddManifest( const char *szManifest, const char *szPrefix );
+
+	void				Write( std::vector<BYTE> &data ) const;
+
+	size_t				GetEntryCount() const { return m_Entries.size(); }
+
+	// Pixel and palette bytes of the entries, and what they would take at
+	// 32 bits a pixel
+	size_t				GetPixelBytes() const;
+	size_t				GetRgb32Bytes() const;
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Structures for This Class
+	//-------------------------------------------------------------------------
+	struct SPending
+	{
+		std::string				strName;
+		SPackEntry				entry;
+		CCompactImage			pixels;
+		std::vector<BYTE>		mask;
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	std::vector<SPending>	m_Entries;
+};
+
+#endif // _ASSETPACK_H_
@@ -14,6 +14,10 @@ public:
 	void present();
 	void reset();
 
+	// Copies the back buffer into pDst, width() * height() 32 bit pixels,
+	// top row first.
+	bool copyPixels(RGBQUAD* pDst);
+
 	HDC getDC() const { return mhDC; }
 	HWND getHWND() const { return mhWnd; }
 
@@ -37,5 +41,11 @@ private:
 	HBITMAP mhOldObject;
 	int mWidth;
 	int mHeight;
+
+	// 32 bit DIB section copyPixels blits into, made on its first call.
+	HDC mhCaptureDC;
+	HBITMAP mhCaptureSurface;
+	HBITMAP mhCaptureOldObject;
+	RGBQUAD* mpCapturePixels;
 };
 #endif // BACKBUFFER_H
\ No newline at end of file
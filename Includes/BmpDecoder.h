@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+// File: BmpDecoder.h
+//
+// Desc: Portable BMP decoder. The file is memory mapped, the headers are
+//	parsed here (no GDI) and pixels are decoded straight from the mapping
+//	into the caller's 32 bit buffer in whichever row order it wants.
+//
+//	Supported: uncompressed 8 (palettized), 24 and 32 bit files, 8 bit RLE
+//	and 32 bit BI_BITFIELDS with the usual masks, bottom-up and top-down.
+//-----------------------------------------------------------------------------
+
+#ifndef _BMPDECODER_H_
+#define _BMPDECODER_H_
+
+//-----------------------------------------------------------------------------
+// BmpDecoder Specific Includes
+//-----------------------------------------------------------------------------
+#include "MappedFile.h"
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CBmpDecoder (Class)
+// Desc : Open reads and checks the headers only, Decode does the pixels.
+//-----------------------------------------------------------------------------
+class CBmpDecoder
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	CBmpDecoder();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	// Maps the file, false when it is missing or not a supported BMP
+	bool			Open( const char *szFileName );
+
+	// A BMP already in memory, the bytes must outlive the decoder
+	bool			Open( const BYTE *pData, size_t size );
+	void			Close();
+
+	LONG			Width() const { return m_lWidth; }
+	LONG			Height() const { return m_lHeight; }
+	WORD			BitCount() const { return m_wBitCount; }
+	bool			IsTopDown() const { return m_bTopDown; }
+
+	// Decodes every pixel into pDst (Width() * Height() of them). Row 0 of
+	// pDst is the bottom row when bBottomUp (the GDI DIB order CImageFile
+	// keeps) and the top row otherwise. Reserved bytes are 0 except in 32
+	// bit files, which are copied as they are.
+	bool			Decode( RGBQUAD *pDst, bool bBottomUp ) const;
+
+private:
+	CBmpDecoder( const CBmpDecoder& rhs );
+	CBmpDecoder& operator=( const CBmpDecoder& rhs );
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	bool			ParseHeaders();
+	bool			DecodeRle8( RGBQUAD *pDst, bool bBottomUp ) const;
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	CMappedFile		m_File;
+	const BYTE		*m_pData;			// Whole file
+	size_t			m_Size;
+	LONG			m_lWidth;
+	LONG			m_lHeight;
+	bool			m_bTopDown;
+	WORD			m_wBitCount;
+	DWORD			m_dwCompression;
+	DWORD			m_dwPixelsOffset;	// Start of the pixel array in the file
+	DWORD			m_dwStride;			// Bytes per uncompressed row, padded to 4
+	RGBQUAD			m_Palette[256];		// 8 bit files, unused entries black
+};
+
+#endif // _BMPDECODER_H_
@@ -9,32 +9,33 @@
 #define _BULLET_H_
 
 //-----------------------------------------------------------------------------
-// ScoreSprite Specific Includes
+// Bullet Specific Includes
 //-----------------------------------------------------------------------------
-#include "Sprite.h"
+#include "Vec2.h"
 
 //-----------------------------------------------------------------------------
 // Main Class Definitions
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // Name : Bullet (Class)
-// Desc : Bullet class that stores which team shot the bullet and
-// updates the sprite.
+// Desc : Bullet class that stores which team shot the bullet and its motion.
+// The application draws every bullet with a single shared sprite.
 //-----------------------------------------------------------------------------
-class Bullet: public Sprite
+class Bullet
 {
 public:
 	//-------------------------------------------------------------------------
 	// Public Variables for This Class.
 	//-------------------------------------------------------------------------
-	ULONG team;
+	Vec2 mPosition;
+	Vec2 mVelocity;
+	unsigned long team;
 
 	//-------------------------------------------------------------------------
-	// Constructor for This Class.
+	// Public Functions for This Class.
 	//-------------------------------------------------------------------------
-	Bullet(const char *szImageFile, COLORREF crTransparentColor) :
-		Sprite(szImageFile, crTransparentColor) {};
+	void update(float dt) { mPosition += mVelocity * dt; }
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -17,12 +17,22 @@
 #include "CPlayer.h"
 #include "BackBuffer.h"
 #include "ImageFile.h"
+#include "CompactImage.h"
+#include "AssetPack.h"
+#include "AssetLoader.h"
+#include "FrameCapture.h"
 #include "ScoreSprite.h"
-#include "Bullet.h"
 #include "MenuSprite.h"
+#include "GameWorld.h"
 
 #include <list>
 
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const ULONG IDLE_FRAME_RATE		= 30;	// Frame cap used while paused or on a menu screen
+const int	MENU_REPEAT_TICKS	= 5;	// Idle ticks between two menu selection moves
+
 //-----------------------------------------------------------------------------
 // Forward Declarations
 //-----------------------------------------------------------------------------
@@ -52,14 +62,11 @@ public:
 	int			BeginGame();
 	bool		ShutDown();
 
-	enum GameState {
-		START,
-		ONGOING,
-		LOST,
-		WON,
-		PAUSE
-	};
-	
+	ULONG		GetFramesRendered() const { return m_nFramesRendered; }
+	ULONG		GetFramesSkipped() const { return m_nFramesSkipped; }
+
+	typedef CGameWorld::GameState GameState;
+
 private:
 	//-------------------------------------------------------------------------
 	// Private Functions for This Class
@@ -67,24 +74,25 @@ private:
 	bool		BuildObjects();
 	void		ReleaseObjects();
 	void		FrameAdvance();
+	bool		IsIdleState() const;
+	void		WaitForIdleTick();
+	void		skipFrame();
+	void		updateCounters();
+	void		drawCounterOverlay();
+	void		captureFrame();
 	bool		CreateDisplay();
 	void		SetupGameState();
+	void		requestAssets();
+	void		buildDeferredSprites(bool bWait);
+	void		recordStartup();
 	void		AnimateObjects();
 	void		DrawObjects();
 	void		ProcessInput();
-	void		SpawnBullet(const Vec2 position, const Vec2 velocity, const CPlayer::TEAM team);
-	bool		detectCollision(const Bullet* bullet);
-	bool		bulletUnitCollision(const Bullet& bullet, CPlayer& unit);
+	void		drawUnit(CPlayer& unit, Sprite* sprite);
 	void		addStars(int noStars);
 	void		scrollBackground(float dt);
-	void		addEnemies(int noEnemies);
-	void		enemyFire();
-	void		holdInside(CPlayer& unit);
-	void		removeDead();
-	void		trackPlayer(Sprite& bullet);
-	void		updateGameState();
 	void		setPLives(int livesP1, int livesP2);
-	void		moveEnemies();
+	void		syncScores();
 	void		saveGame();
 	void		loadGame();
 	
@@ -104,6 +112,13 @@ private:
 	HMENU						m_hMenu;			// Window Menu
 	
 	bool						m_bActive;			// Is the application active ?
+	bool						m_bDirty;			// Does the idle screen need to be redrawn ?
+	bool						m_bShowCounters;	// Is the counter overlay visible ?
+	bool						m_bScreenshot;		// Is the next presented frame saved ?
+	DWORD						m_dwLastIdleTick;	// Time (ms) of the last idle frame
+	DWORD						m_dwMinimizedTime;	// Time (ms) the window was minimized, 0 when it is not
+	ULONG						m_nFramesRendered;	// Frames drawn and presented
+	ULONG						m_nFramesSkipped;	// Idle ticks with nothing drawn
 
 	ULONG						m_nViewX;			// X Position of render viewport
 	ULONG						m_nViewY;			// Y Position of render viewport
@@ -113,21 +128,31 @@ private:
 	POINT						m_OldCursorPos;		// Old cursor position for tracking
 	HINSTANCE					m_hInstance;
 
-	CImageFile					m_imgBackground;	// Background image
+	CImageFile					m_imgBackground;	// Background image as decoded, released once compacted
+	CCompactImage				m_cmpBackground;	// Background image drawn every frame
+	CAssetPack					m_AssetPack;		// Pre-decoded sprites, mapped while the objects exist
+	CAssetLoader				m_AssetLoader;		// Decodes the bitmaps the pack does not hold
+	CFrameCapture				m_Recorder;			// "-capture" recording of every presented frame
+	CFrameCapture				m_Screenshots;		// F12 stills, started on the first one
+
+	long long					m_llStartupBegin;	// InitInstance entry, 0 once the first frame was presented
+	long long					m_llStartupBuilt;	// Objects built, the first frame follows
 
 	BackBuffer*					_Buffer;			// Back buffer
-	CPlayer*					_Player1;			// Player one
-	CPlayer*					_Player2;			// Player two
+	CGameWorld					m_World;			// Units, bullets and game rules
+
+	Sprite*						_shipSprites[2][3];	// Player ships, indexed by [team - 1][tilt]
+	Sprite*						_enemySprite;		// Shared by every enemy
+	Sprite*						_bulletSprite;		// Shared by every bullet
+	AnimatedSprite*				_explosionSprite;	// Shared by every exploding unit
 
-	std::list<CPlayer*>			_enemies;			// List containing all enemies alive
-	std::list<Bullet*>			_bullets;			// List containing all bullets on the screen
 	std::list<Sprite*>			_stars;				// List containing stars scrolling in the background
 	std::list<Sprite*>			_livesBlue;			// Lives for blue player
 	std::list<Sprite*>			_livesRed;			// Lives for red player
 
 	Vec2						_screenSize;		// Provides easy access to the screen size
 
-	GameState					_gameState;			// Game state (ongoing, won, lost)
+	GameState					_drawnState;		// Game state shown by the last presented frame
 	Sprite*						_wonSprite;			// Information to be displayed when game is won
 	Sprite*						_lostSprite;		// Information to be displayed when game is lost
 
@@ -136,8 +161,6 @@ private:
 	ScoreSprite*				_scoreP1;			// Score for the player 1
 	ScoreSprite*				_scoreP2;			// Score for the player 2
 
-	int							frameCounter;
-
 	MenuSprite*					gameMenu;
 };
 
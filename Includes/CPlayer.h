@@ -2,7 +2,9 @@
 // File: CPlayer.cpp
 //
 // Desc: This file stores the player object class. This class performs tasks
-//	   such as player movement, some minor physics as well as rendering.
+//	   such as player movement, some minor physics and the explosion state.
+//	   Rendering is left to the application, so this class has no platform
+//	   dependencies and is shared with the headless runner.
 //
 // Original design by Adam Hoult & Gary Simmons. Modified by Mihai Popescu.
 //-----------------------------------------------------------------------------
@@ -13,10 +15,12 @@
 //-----------------------------------------------------------------------------
 // CPlayer Specific Includes
 //-----------------------------------------------------------------------------
-#include "Main.h"
-#include "Sprite.h"
+#include "Vec2.h"
 
-#include <vector>
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int EXPLOSION_FRAME_COUNT = 16;	// Frames in data/explosion.bmp
 
 //-----------------------------------------------------------------------------
 // Main Class Definitions
@@ -31,8 +35,8 @@ public:
 	//-------------------------------------------------------------------------
 	// Enumerators
 	//-------------------------------------------------------------------------
-	enum DIRECTION 
-	{ 
+	enum DIRECTION
+	{
 		DIR_FORWARD		= 1,
 		DIR_BACKWARD	= 2,
 		DIR_LEFT		= 4,
@@ -51,18 +55,23 @@ public:
 		ENEMY		= 3
 	};
 
+	enum TILT {
+		TILT_NONE,		// flying straight
+		TILT_CW,		// banking right
+		TILT_CCW		// banking left
+	};
+
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors for This Class.
 	//-------------------------------------------------------------------------
-			 CPlayer(const BackBuffer *pBackBuffer, const char* texturePath);
+			 CPlayer(TEAM team, const Vec2& size);
 	virtual ~CPlayer();
 
 	//-------------------------------------------------------------------------
 	// Public Functions for This Class.
 	//-------------------------------------------------------------------------
 	void					Update( float dt );
-	void					Draw();
-	void					Move(ULONG ulDirection);
+	void					Move(unsigned long ulDirection);
 	Vec2&					Position();
 	Vec2&					Velocity();
 	void					Explode();
@@ -75,22 +84,30 @@ public:
 	void					setLives(int noLives);
 	bool					hasExploded();
 	void					setTeam(TEAM team);
+	TEAM					getTeam();
+	TILT					getTilt();
+	int						getExplosionFrame();
+	const Vec2&				getExplosionPosition();
 
 private:
 	//-------------------------------------------------------------------------
 	// Private Variables for This Class.
 	//-------------------------------------------------------------------------
 
-	Sprite*					_sprite;
+	Vec2					_position;
+	Vec2					_velocity;
+	Vec2					_size;
+	int						_frameCounter;
+	TILT					_tilt;
 	ESpeedStates			_speedState;
 	float					_timer;
 	bool					_explosion;
-	AnimatedSprite*			_explosionSprite;
 	int						_explosionFrame;
+	int						_explosionShown;
+	Vec2					_explosionPosition;
 	bool					_isDead;
 	int						_lives;
 	TEAM					_team;
-	const BackBuffer*		_BF;
 };
 
-#endif // _CPLAYER_H_
\ No newline at end of file
+#endif // _CPLAYER_H_
@@ -0,0 +1,81 @@
+#pragma once
+// CompactImage.h
+// Resident copies of images in less than 32 bits a pixel: RGB565, or 8 bit
+// indices into a palette of their own. Rows are bottom-up like
+// CImageFile's; the pixels are widened back to RGBQUADs (reserved 0) a band
+// at a time by the expand kernels of PixelKernels.h when they are drawn,
+// so only a few rows ever exist at full size.
+#include "ImageFile.h"
+
+#include <vector>
+
+enum ECompactFormat
+{
+	COMPACT_RGB32,			// RGBQUADs, for images no smaller format holds exactly
+	COMPACT_RGB565,			// WORDs, every channel its top bits repeated when widened
+	COMPACT_INDEXED8		// BYTEs into COMPACT_PALETTE_SIZE colors
+};
+
+// Entries of an indexed image's palette, the unused ones black
+const unsigned int COMPACT_PALETTE_SIZE = 256;
+
+// Rows Paint widens per blit
+const LONG COMPACT_PAINT_ROWS = 64;
+
+class CCompactImage
+{
+	ECompactFormat m_Format;
+	LONG m_lWidth, m_lHeight;
+	std::vector<BYTE> m_Pixels;				// Rows of m_lWidth pixels in m_Format, unpadded
+	std::vector<RGBQUAD> m_Palette;			// COMPACT_INDEXED8 only
+	std::vector<RGBQUAD> m_Band;			// Paint's widened rows
+
+public:
+	CCompactImage();
+
+	// Smallest format holding count pixels exactly, reserved bytes aside.
+	// The palette an indexed image needs counts towards its size.
+	static ECompactFormat ChooseFormat(const RGBQUAD *pPixels, size_t count);
+
+	// Bytes of the rows of a lWidth x lHeight image in format, the palette
+	// aside
+	static size_t GetPixelBytes(ECompactFormat format, LONG lWidth, LONG lHeight);
+
+	// Replaces the pixels with the image's in the smallest exact format, or
+	// in format, false when it would change any pixel
+	bool Compress(const CImageFile &image);
+	bool Compress(const CImageFile &image, ECompactFormat format);
+	bool Compress(const RGBQUAD *pPixels, LONG lWidth, LONG lHeight, ECompactFormat format);
+
+	void Clear();
+	bool IsEmpty() const { return m_Pixels.empty(); }
+
+	ECompactFormat Format() const { return m_Format; }
+	LONG Width() const { return m_lWidth; }
+	LONG Height() const { return m_lHeight; }
+
+	// Pixel rows in Format() and the palette, NULL unless indexed
+	const BYTE* Data() const { return m_Pixels.empty() ? NULL : &m_Pixels[0]; }
+	const RGBQUAD* Palette() const { return m_Palette.empty() ? NULL : &m_Palette[0]; }
+
+	// Pixels and palette held, Paint's band excluded
+	size_t GetBytes() const { return m_Pixels.size() + m_Palette.size() * sizeof(RGBQUAD); }
+
+	// Widens the image, or rc (inclusive, rows in memory order), into rows
+	// dstStride pixels apart
+	void Expand(RGBQUAD *pDst, size_t dstStride, const RECT *rc = NULL) const;
+
+	// Same for any rows of lWidth pixels in format, pPalette holding
+	// COMPACT_PALETTE_SIZE colors when indexed
+	static void Expand(ECompactFormat format, const BYTE *pPixels, LONG lWidth, const RGBQUAD *pPalette,
+		const RECT &rc, RGBQUAD *pDst, size_t dstStride);
+
+	// image becomes a 32 bit copy
+	bool ExpandTo(CImageFile &image) const;
+
+#ifdef _WIN32
+	// Draws the image with its top left corner at x, y, widened
+	// COMPACT_PAINT_ROWS rows at a time
+	void Paint(HDC hdc, int x, int y);
+#endif
+};
@@ -0,0 +1,134 @@
+#pragma once
+// Convolution.h
+// Filters that keep the image size: blurs, sharpening and any other small
+// convolution, on CImageFile pixels or on byte planes (CopyMonoImage,
+// CPlanarImage). The image is cut in tiles run on the CResizableImage
+// thread pool, the inner loops are the fixed point TAPS kernels of
+// PixelKernels.h, so every SIMD level and thread count gives the same
+// pixels.
+#include "ImageFile.h"
+
+#include <vector>
+
+// Output tile of one pool band. The kernel radius around a tile is read
+// (and for separable kernels filtered horizontally) again by its neighbours.
+const unsigned int CONVOLVE_TILE_WIDTH = 256;
+const unsigned int CONVOLVE_TILE_HEIGHT = 64;
+
+// Largest separable kernel radius and non-separable kernel side
+const int CONVOLVE_MAX_RADIUS = 32;
+const int CONVOLVE_MAX_MATRIX = 15;
+
+// Source pixels used for taps outside the image
+enum EBorderMode
+{
+	BORDER_CLAMP,		// the edge pixel repeated (default)
+	BORDER_MIRROR,		// reflected about the edge pixel, -1 reads 1
+	BORDER_WRAP,		// the opposite edge, for tiling textures
+	BORDER_ZERO			// black
+};
+
+// Weights of a convolution, quantized once when set. Kernels are written
+// as the image is seen: left to right and top to bottom, whatever the row
+// order in memory.
+class CConvolutionKernel
+{
+	friend class CConvolver;
+
+	// Fixed point weights, iBits fraction bits chosen so the largest weight
+	// still fits a short (WEIGHT_BITS unless some weight is 2 or more)
+	struct STaps
+	{
+		std::vector<short> weights;
+		int iBits;
+	};
+
+	bool m_bSeparable;
+	int m_iWidth;
+	int m_iHeight;
+	STaps m_Horizontal;		// Separable kernels
+	STaps m_Vertical;
+	STaps m_Matrix;			// The others, row major from the top
+
+	static bool Quantize(const double *pWeights, int iCount, STaps &taps);
+
+public:
+	// Identity
+	CConvolutionKernel();
+
+	// Applied as a horizontal then a vertical pass, odd tap counts
+	bool SetSeparable(const double *pHorizontal, int iHTaps, const double *pVertical, int iVTaps);
+
+	// Any odd iWidth x iHeight kernel, row major from the top row
+	bool SetMatrix(const double *pWeights, int iWidth, int iHeight);
+
+	// Normalized Gaussian of radius ceil(3 sigma), the usual blur and denoise
+	void SetGaussian(double dSigma);
+	void SetBox(int iRadius);
+
+	// 3x3 Laplacian sharpen, center 1 + 4 * amount and -amount next to it
+	void SetSharpen(double dAmount);
+
+	bool IsSeparable() const { return m_bSeparable; }
+	int Width() const { return m_iWidth; }
+	int Height() const { return m_iHeight; }
+};
+
+class CConvolver
+{
+	EBorderMode m_Border;
+
+	// Source of in place filtering and the tile buffers of every thread,
+	// kept between calls so filtering each frame does not allocate
+	CImageFile m_Copy;
+	std::vector<BYTE> m_Scratch;
+
+	// Filters one image or plane of any pixel type, strides in pixels
+	template <class T>
+	void Run(const CConvolutionKernel &kernel, const T *pSrc, size_t srcStride, T *pDst, size_t dstStride,
+		int iWidth, int iHeight);
+
+	// Copies the weights of kernel into the arguments of a Run or block
+	template <class TConvolve>
+	static void SetKernel(const CConvolutionKernel &kernel, TConvolve &c);
+
+	template <class T>
+	static void Block(const CConvolutionKernel &kernel, EBorderMode border, const T *pSrc, size_t srcStride,
+		const RECT &source, T *pDst, size_t dstStride, const RECT &block, LONG lWidth, LONG lHeight, T *pScratch);
+
+public:
+	CConvolver() : m_Border(BORDER_CLAMP) {}
+
+	void SetBorderMode(EBorderMode mode) { m_Border = mode; }
+	EBorderMode GetBorderMode() const { return m_Border; }
+
+	// dst becomes src filtered, created at the size of src when it differs
+	bool Apply(const CConvolutionKernel &kernel, const CImageFile &src, CImageFile &dst);
+
+	// Filters image in place, through a copy
+	bool Apply(const CConvolutionKernel &kernel, CImageFile &image);
+
+	// lWidth x lHeight byte planes, rows strides bytes apart and in the
+	// same (bottom-up) order as the image they came from. pSrc and pDst
+	// must not overlap.
+	bool ApplyPlane(const CConvolutionKernel &kernel, const BYTE *pSrc, size_t srcStride,
+		BYTE *pDst, size_t dstStride, LONG lWidth, LONG lHeight);
+
+	// Blocks of an lWidth x lHeight image filtered on the calling thread,
+	// for callers producing the source piece by piece (CImagePipeline).
+	// Rects are inclusive with rows in memory order, like CopyMonoImage's.
+	// GetBlockSource gives the source pixels the block reads, the whole
+	// width or height at the edges for BORDER_WRAP. ApplyBlock filters the
+	// block from those pixels (pSrc is the first) into pDst (the block's
+	// first pixel) through GetBlockScratch(kernel) pixels of pScratch, on
+	// image pixels or on byte planes.
+	static RECT GetBlockSource(const CConvolutionKernel &kernel, EBorderMode border, const RECT &block,
+		LONG lWidth, LONG lHeight);
+	static size_t GetBlockScratch(const CConvolutionKernel &kernel);
+	static void ApplyBlock(const CConvolutionKernel &kernel, EBorderMode border, const RGBQUAD *pSrc,
+		size_t srcStride, const RECT &source, RGBQUAD *pDst, size_t dstStride, const RECT &block,
+		LONG lWidth, LONG lHeight, RGBQUAD *pScratch);
+	static void ApplyBlock(const CConvolutionKernel &kernel, EBorderMode border, const BYTE *pSrc,
+		size_t srcStride, const RECT &source, BYTE *pDst, size_t dstStride, const RECT &block,
+		LONG lWidth, LONG lHeight, BYTE *pScratch);
+};
@@ -0,0 +1,86 @@
+//-----------------------------------------------------------------------------
+// File: Counters.h
+//
+// Desc: Registry of named runtime counters and gauges. Counters accumulate
+//	events during a frame and are reset when the frame ends, gauges hold the
+//	last value set. Every frame end takes a snapshot of all values, which can
+//	be kept as a time series and exported as CSV or JSON.
+//-----------------------------------------------------------------------------
+
+#ifndef _COUNTERS_H_
+#define _COUNTERS_H_
+
+//-----------------------------------------------------------------------------
+// Counters Specific Includes
+//-----------------------------------------------------------------------------
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+// The counter is looked up once per call site, then it is a single atomic add.
+#define COUNTER_ADD(name, n)	do { static CCounter *_pCounter = CCounters::Register(name, CCounter::PER_FRAME); _pCounter->Add(n); } while (0)
+#define COUNTER_INC(name)		COUNTER_ADD(name, 1)
+#define GAUGE_SET(name, v)		do { static CCounter *_pGauge = CCounters::Register(name, CCounter::GAUGE); _pGauge->Set(v); } while (0)
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CCounter (Class)
+// Desc : A single named value. Safe to update from any thread.
+//-----------------------------------------------------------------------------
+class CCounter
+{
+public:
+	enum KIND
+	{
+		PER_FRAME,		// reset to zero at every frame end
+		GAUGE			// keeps its value until set again
+	};
+
+	CCounter( const char *szName, KIND kind ) : m_szName(szName), m_Kind(kind), m_llValue(0) {}
+
+	void		Add( long long n )	{ m_llValue.fetch_add(n, std::memory_order_relaxed); }
+	void		Set( long long v )	{ m_llValue.store(v, std::memory_order_relaxed); }
+	long long	Get() const			{ return m_llValue.load(std::memory_order_relaxed); }
+	long long	Reset()				{ return m_llValue.exchange(0, std::memory_order_relaxed); }	// Value before the reset
+
+	const char*	Name() const		{ return m_szName; }
+	KIND		Kind() const		{ return m_Kind; }
+
+private:
+	CCounter( const CCounter& rhs );
+
+	const char				*m_szName;
+	KIND					m_Kind;
+	std::atomic<long long>	m_llValue;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CCounters (Class)
+// Desc : Owns every registered counter and the per-frame snapshots.
+// Note : Names must be string literals (or otherwise outlive the registry).
+//-----------------------------------------------------------------------------
+class CCounters
+{
+public:
+	//-------------------------------------------------------------------------
+	// Public Static Functions For This Class
+	//-------------------------------------------------------------------------
+	static CCounter*	Register( const char *szName, CCounter::KIND kind );
+	static CCounter*	Find( const char *szName );
+
+	static void			EnableHistory( bool bEnable );
+	static void			EndFrame( const char *szLabel = 0 );
+
+	static unsigned		GetCount();
+	static const char*	GetName( unsigned i );
+	static long long	GetLastValue( unsigned i );
+	static long long	GetHeapAllocations();
+
+	static bool			ExportCSV( const char *szFileName );
+	static bool			ExportJSON( const char *szFileName );
+};
+
+#endif // _COUNTERS_H_
@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+// File: EmbeddedAssets.h
+//
+// Desc: Asset pack compiled into the executable, for builds that must not
+//	touch the file system at start up. Configuring with EMBED_ASSETS=ON makes
+//	PackBuilder generate the pack as C++ (EmbeddedAssetTable.h with the
+//	descriptors, EmbeddedAssetData.cpp with the bytes) and defines
+//	EMBED_ASSETS for everything linking the EmbeddedAssets library.
+//
+//	The descriptor table is constexpr, so FindEmbeddedAsset resolves names
+//	at compile time; at run time the bytes open as an ordinary CAssetPack
+//	and sprites use them exactly like a mapped assets.pak.
+//-----------------------------------------------------------------------------
+
+#ifndef _EMBEDDEDASSETS_H_
+#define _EMBEDDEDASSETS_H_
+
+//-----------------------------------------------------------------------------
+// EmbeddedAssets Specific Includes
+//-----------------------------------------------------------------------------
+#include "AssetPack.h"
+
+//-----------------------------------------------------------------------------
+// Main Structure Declarations
+//-----------------------------------------------------------------------------
+// Compile time copy of a pack entry, offsets are into the embedded pack
+struct SEmbeddedAsset
+{
+	const char	*szName;
+	LONG		lWidth;
+	LONG		lHeight;
+	DWORD		dwColorKey;
+	DWORD		dwFrameCount;
+	RECT		rcFrame;
+	DWORD		dwPixelsOffset;
+	DWORD		dwMaskOffset;
+	DWORD		dwFormat;			// ECompactFormat
+	DWORD		dwPaletteOffset;
+};
+
+#ifdef EMBED_ASSETS
+
+// Generated, defines g_EmbeddedAssets[] and EMBEDDED_ASSET_COUNT
+#include "EmbeddedAssetTable.h"
+
+//-----------------------------------------------------------------------------
+// Name : EmbeddedNameEquals ()
+// Desc : CAssetPack::Find's name rules, usable in constant expressions.
+//-----------------------------------------------------------------------------
+constexpr char EmbeddedNameChar( char c )
+{
+	return c == '\\' ? '/' : (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+constexpr bool EmbeddedNameEquals( const char *a, const char *b )
+{
+	while (*a && *b)
+	{
+		if (EmbeddedNameChar(*a++) != EmbeddedNameChar(*b++))
+			return false;
+	}
+	return *a == *b;
+}
+
+//-----------------------------------------------------------------------------
+// Name : FindEmbeddedAsset ()
+// Desc : Index into g_EmbeddedAssets, -1 when the pack does not hold it.
+//		"static_assert(FindEmbeddedAsset(name) >= 0)" turns a missing asset
+//		into a build error.
+//-----------------------------------------------------------------------------
+constexpr int FindEmbeddedAsset( const char *szName )
+{
+	for (int i = 0; i < (int)EMBEDDED_ASSET_COUNT; i++)
+	{
+		if (EmbeddedNameEquals(g_EmbeddedAssets[i].szName, szName))
+			return i;
+	}
+	return -1;
+}
+
+// The generated pack bytes (EmbeddedAssetData.cpp)
+const BYTE*		GetEmbeddedPackData();
+size_t			GetEmbeddedPackSize();
+
+//-----------------------------------------------------------------------------
+// Name : OpenEmbeddedAssets ()
+// Desc : Opens the compiled in pack, nothing is read from disk.
+//-----------------------------------------------------------------------------
+inline bool OpenEmbeddedAssets( CAssetPack &pack )
+{
+	return pack.Open(GetEmbeddedPackData(), GetEmbeddedPackSize());
+}
+
+#endif // EMBED_ASSETS
+
+#endif // _EMBEDDEDASSETS_H_
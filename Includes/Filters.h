@@ -5,7 +5,16 @@
 #define FILTER_2PI double (2.0 * FILTER_PI)
 #define FILTER_4PI double (4.0 * FILTER_PI)
 
+// Samples per unit of distance kept by CFilterCurve. Linear interpolation
+// between them stays within 1e-6 of the exact curves, far below one step of
+// the 14 bit fixed point weights.
+const int FILTER_CURVE_RESOLUTION = 1024;
 
+
+// Every filter below also has a non virtual, inline Eval() and a constexpr
+// DefaultWidth(), so code instantiated per filter type (see CWeightsTable)
+// does not pay a virtual call per tap. Tabulated() tells whether the curve
+// is worth sampling into a CFilterCurve instead of being evaluated directly.
 class CGenericFilter
 {
 protected:
@@ -19,40 +28,54 @@ public:
 	double GetWidth()					{ return m_dWidth; }
 	void   SetWidth (double dWidth)		{ m_dWidth = dWidth; }
 
+	// Shape parameters besides the width, filters of the same type with the
+	// same width and parameters produce the same weights
+	virtual void GetParams (double &dParam1, double &dParam2) { dParam1 = dParam2 = 0; }
+
 	virtual double Filter (double dVal) = 0;
 };
 
 class CBoxFilter : public CGenericFilter
 {
 public:
-	CBoxFilter() : CGenericFilter(0.5) {}
+	static constexpr double DefaultWidth() { return 0.5; }
+	static constexpr bool Tabulated() { return false; }
+
+	CBoxFilter() : CGenericFilter(DefaultWidth()) {}
 	virtual ~CBoxFilter() {}
 
-	double Filter (double dVal) { return (fabs(dVal) <= m_dWidth ? 1.0 : 0.0); }
+	double Eval (double dVal) const { return (fabs(dVal) <= m_dWidth ? 1.0 : 0.0); }
+	double Filter (double dVal) { return Eval(dVal); }
 };
 
 class CBilinearFilter : public CGenericFilter
 {
 public:
+	static constexpr double DefaultWidth() { return 1; }
+	static constexpr bool Tabulated() { return false; }
 
-	CBilinearFilter () : CGenericFilter(1) {}
+	CBilinearFilter () : CGenericFilter(DefaultWidth()) {}
 	virtual ~CBilinearFilter() {}
 
-	double Filter (double dVal) {
+	double Eval (double dVal) const {
 		dVal = fabs(dVal);
 		return (dVal < m_dWidth ? m_dWidth - dVal : 0.0);
 	}
+	double Filter (double dVal) { return Eval(dVal); }
 };
 
 class CBicubicFilter : public CGenericFilter
 {
 protected:
+	double m_b, m_c;
 	double p0, p2, p3;
 	double q0, q1, q2, q3;
 
 public:
+	static constexpr double DefaultWidth() { return 2; }
+	static constexpr bool Tabulated() { return true; }
 
-	CBicubicFilter (double b = (1/(double)3), double c = (1/(double)3)) : CGenericFilter(2) {
+	CBicubicFilter (double b = (1/(double)3), double c = (1/(double)3)) : CGenericFilter(DefaultWidth()), m_b(b), m_c(c) {
 		p0 = (6 - 2*b) / 6;
 		p2 = (-18 + 12*b + 6*c) / 6;
 		p3 = (12 - 9*b - 6*c) / 6;
@@ -63,7 +86,9 @@ public:
 	}
 	virtual ~CBicubicFilter() {}
 
-	double Filter(double dVal) {
+	void GetParams (double &dParam1, double &dParam2) { dParam1 = m_b; dParam2 = m_c; }
+
+	double Eval(double dVal) const {
 		dVal = fabs(dVal);
 		if(dVal < 1)
 			return (p0 + dVal*dVal*(p2 + dVal*p3));
@@ -71,24 +96,29 @@ public:
 			return (q0 + dVal*(q1 + dVal*(q2 + dVal*q3)));
 		return 0;
 	}
+	double Filter (double dVal) { return Eval(dVal); }
 };
 
 class CLanczos3Filter : public CGenericFilter
 {
 public:
-	CLanczos3Filter() : CGenericFilter(3) {}
+	static constexpr double DefaultWidth() { return 3; }
+	static constexpr bool Tabulated() { return true; }
+
+	CLanczos3Filter() : CGenericFilter(DefaultWidth()) {}
 	virtual ~CLanczos3Filter() {}
 
-	double Filter(double dVal) {
+	double Eval(double dVal) const {
 		dVal = fabs(dVal);
 		if(dVal < m_dWidth)     {
 			return (sinc(dVal) * sinc(dVal / m_dWidth));
 		}
 		return 0;
 	}
+	double Filter (double dVal) { return Eval(dVal); }
 
 private:
-	double sinc(double value) {
+	static double sinc(double value) {
 		if(value != 0) {
 			value *= FILTER_PI;
 			return (sin(value) / value);
@@ -100,10 +130,13 @@ private:
 class CBSplineFilter : public CGenericFilter
 {
 public:
-	CBSplineFilter() : CGenericFilter(2) {}
+	static constexpr double DefaultWidth() { return 2; }
+	static constexpr bool Tabulated() { return true; }
+
+	CBSplineFilter() : CGenericFilter(DefaultWidth()) {}
 	virtual ~CBSplineFilter() {}
 
-	double Filter(double dVal) {
+	double Eval(double dVal) const {
 
 		dVal = fabs(dVal);
 		if(dVal < 1) return (4 + dVal*dVal*(-6 + 3*dVal)) / 6;
@@ -113,4 +146,32 @@ public:
 		}
 		return 0;
 	}
-};
\ No newline at end of file
+	double Filter (double dVal) { return Eval(dVal); }
+};
+
+
+// Curve of a filter sampled FILTER_CURVE_RESOLUTION times per unit over its
+// default width and linearly interpolated. Only valid while the filter keeps
+// its default width.
+template <class TFilter>
+class CFilterCurve
+{
+public:
+	static constexpr int SAMPLES = int(TFilter::DefaultWidth() * FILTER_CURVE_RESOLUTION) + 2;
+
+	explicit CFilterCurve (const TFilter &filter) {
+		for (int i = 0; i < SAMPLES; i++)
+			m_Samples[i] = filter.Eval(double(i) / FILTER_CURVE_RESOLUTION);
+	}
+
+	double Eval (double dVal) const {
+		dVal = fabs(dVal) * FILTER_CURVE_RESOLUTION;
+		int i = (int)dVal;
+		if (i >= SAMPLES - 1)
+			return 0;
+		return m_Samples[i] + (dVal - i) * (m_Samples[i + 1] - m_Samples[i]);
+	}
+
+private:
+	double m_Samples[SAMPLES];
+};
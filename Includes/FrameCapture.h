@@ -0,0 +1,163 @@
+//-----------------------------------------------------------------------------
+// File: FrameCapture.h
+//
+// Desc: Screenshots and frame recording off the render thread. The frame is
+//	copied into one of a few buffers allocated at Start and handed through a
+//	lock-free queue to a writer thread, which encodes and writes it while
+//	the game goes on. When every buffer is still queued the frame is either
+//	dropped or waited for (CAPTURE_DROP / CAPTURE_BLOCK), both are counted.
+//
+//	Output is a 32 bit BMP per frame ("<path>_000001.bmp" ...) or a single
+//	YUV4MPEG2 stream (4:4:4, full range BT.601) most video tools read as
+//	uncompressed video.
+//-----------------------------------------------------------------------------
+
+#ifndef _FRAMECAPTURE_H_
+#define _FRAMECAPTURE_H_
+
+//-----------------------------------------------------------------------------
+// FrameCapture Specific Includes
+//-----------------------------------------------------------------------------
+#include "ImageTypes.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const unsigned CAPTURE_DEFAULT_BUFFERS	= 4;
+const unsigned CAPTURE_DEFAULT_RATE		= 60;		// Frames per second written in the Y4M header
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CFrameCapture (Class)
+// Desc : One producer thread (BeginFrame / EndFrame / Submit) and the
+//		capture's own writer thread. Frames are top-down 32 bit pixels, the
+//		order the window shows them in.
+//-----------------------------------------------------------------------------
+class CFrameCapture
+{
+public:
+	enum FORMAT
+	{
+		CAPTURE_BMP,			// One file per frame
+		CAPTURE_Y4M				// One YUV4MPEG2 stream
+	};
+
+	enum POLICY
+	{
+		CAPTURE_DROP,			// Skip the frame, the game never waits
+		CAPTURE_BLOCK			// Wait for the writer, every frame is kept
+	};
+
+	struct SOptions
+	{
+		FORMAT			format;
+		POLICY			policy;
+		unsigned		uBuffers;			// Frames in flight, at least 1
+		unsigned		uFrameRate;
+		std::string		strPath;			// BMP file name prefix, or the Y4M file
+
+		SOptions() : format(CAPTURE_BMP), policy(CAPTURE_DROP), uBuffers(CAPTURE_DEFAULT_BUFFERS),
+			uFrameRate(CAPTURE_DEFAULT_RATE), strPath("capture") {}
+	};
+
+	// Totals since Start, also reported through the "capture ..." counters
+	struct SStats
+	{
+		unsigned long long	ullCaptured;		// Frames queued to the writer
+		unsigned long long	ullWritten;
+		unsigned long long	ullDropped;			// CAPTURE_DROP, no free buffer
+		unsigned long long	ullStalls;			// CAPTURE_BLOCK, had to wait for one
+		long long			llStallTime;		// Nanoseconds spent waiting
+		long long			llWriteTime;		// Nanoseconds the writer spent on frames
+		bool				bWriteFailed;
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	CFrameCapture();
+	~CFrameCapture();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	// Allocates the buffers, opens the stream and starts the writer for
+	// lWidth x lHeight frames. False when it cannot open the output.
+	bool			Start( const SOptions &options, LONG lWidth, LONG lHeight );
+
+	// Writes every frame still queued and stops the writer, false when any
+	// write failed
+	bool			Stop();
+
+	bool			IsRunning() const { return m_Writer.joinable(); }
+	LONG			Width() const { return m_lWidth; }
+	LONG			Height() const { return m_lHeight; }
+
+	// Buffer for the next frame, Width() * Height() pixels, or NULL when it
+	// is dropped (or the capture is not running). EndFrame queues it.
+	RGBQUAD*		BeginFrame();
+	void			EndFrame();
+
+	// BeginFrame, a copy of pPixels (rows lStride pixels apart) and EndFrame
+	bool			Submit( const RGBQUAD *pPixels, LONG lStride );
+
+	void			GetStats( SStats &stats ) const;
+
+private:
+	CFrameCapture( const CFrameCapture& rhs );
+	CFrameCapture& operator=( const CFrameCapture& rhs );
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	void			WriterMain();
+	bool			WriteFrame( unsigned uBuffer );
+	bool			WriteBmp( const RGBQUAD *pPixels, unsigned long long ullFrame );
+	bool			WriteY4m( const RGBQUAD *pPixels );
+	void			Wake( std::atomic<bool> &bAsleep, std::condition_variable &wake );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	SOptions							m_Options;
+	LONG								m_lWidth;
+	LONG								m_lHeight;
+	std::vector<std::vector<RGBQUAD> >	m_Buffers;
+	std::vector<unsigned long long>		m_FrameNumbers;		// Per buffer, set before it is queued
+	std::vector<BYTE>					m_Encoded;			// Writer's output frame
+	FILE								*m_pStream;			// CAPTURE_Y4M
+
+	CSpscQueue<unsigned>				m_Free;				// Buffers the producer may fill, writer -> producer
+	CSpscQueue<unsigned>				m_Queued;			// Filled buffers, producer -> writer
+	int									m_iCurrent;			// Buffer between BeginFrame and EndFrame, or -1
+
+	// Only taken to sleep when a queue is empty and to wake the sleeper
+	std::mutex							m_WakeLock;
+	std::condition_variable				m_WakeWriter;
+	std::condition_variable				m_WakeProducer;
+	std::atomic<bool>					m_bWriterAsleep;
+	std::atomic<bool>					m_bProducerAsleep;
+	std::atomic<bool>					m_bQuit;
+	std::thread							m_Writer;
+
+	std::atomic<unsigned long long>		m_ullCaptured;
+	std::atomic<unsigned long long>		m_ullWritten;
+	std::atomic<unsigned long long>		m_ullDropped;
+	std::atomic<unsigned long long>		m_ullStalls;
+	std::atomic<long long>				m_llStallTime;
+	std::atomic<long long>				m_llWriteTime;
+	std::atomic<bool>					m_bWriteFailed;
+};
+
+#endif // _FRAMECAPTURE_H_
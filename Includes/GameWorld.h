@@ -0,0 +1,132 @@
+//-----------------------------------------------------------------------------
+// File: GameWorld.h
+//
+// Desc: Game simulation, holds every unit and bullet and applies the game
+//	rules (movement, firing, collisions, scoring, win / lose). It has no
+//	window or GDI dependencies so the same rules run in the game and in the
+//	headless runner.
+//-----------------------------------------------------------------------------
+
+#ifndef _GAMEWORLD_H_
+#define _GAMEWORLD_H_
+
+//-----------------------------------------------------------------------------
+// GameWorld Specific Includes
+//-----------------------------------------------------------------------------
+#include "Vec2.h"
+#include "CPlayer.h"
+#include "Bullet.h"
+
+#include <list>
+#include <random>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int FIRE_COOLDOWN_FRAMES	= 50;	// Frames between two player shots
+const int ENEMY_FIRE_FRAME		= 2000;	// Enemy frame counter value that triggers a shot
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CGameWorld (Class)
+// Desc : Owns the game state and advances it one frame at a time.
+//-----------------------------------------------------------------------------
+class CGameWorld
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators & Structures
+	//-------------------------------------------------------------------------
+	enum GameState {
+		START,
+		ONGOING,
+		LOST,
+		WON,
+		PAUSE
+	};
+
+	// Input for one frame, directions are CPlayer::DIRECTION flags
+	struct SInput
+	{
+		unsigned long	ulP1Direction;
+		bool			bP1Fire;
+		unsigned long	ulP2Direction;
+		bool			bP2Fire;
+
+		SInput() : ulP1Direction(0), bP1Fire(false), ulP2Direction(0), bP2Fire(false) {}
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+				CGameWorld();
+	virtual		~CGameWorld();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	void		Init(const Vec2& screenSize, const Vec2& shipSize, const Vec2& enemySize, unsigned int seed);
+	void		Release();
+
+	void		Step(float dt, const SInput& input);
+	void		ApplyInput(const SInput& input);
+	void		Animate(float dt);
+	void		RemoveDead();
+
+	void		AddEnemies(int noEnemies);
+	void		SetLives(int livesP1, int livesP2);
+	void		SpawnBullet(const Vec2 position, const Vec2 velocity, const CPlayer::TEAM team);
+	void		PublishCounters() const;
+
+	bool		Save(const char *szFileName) const;
+	bool		Load(const char *szFileName);
+
+	GameState	GetState() const				{ return _gameState; }
+	void		SetState(GameState state)		{ _gameState = state; }
+	CPlayer*	Player1()						{ return _Player1; }
+	CPlayer*	Player2()						{ return _Player2; }
+	int			GetScore(CPlayer::TEAM team) const;
+	void		SetScore(CPlayer::TEAM team, int score);
+	const Vec2&	ScreenSize() const				{ return _screenSize; }
+	int			Random()						{ return int(_random() & 0x7fffffff); }
+
+	std::list<CPlayer*>&		Enemies()		{ return _enemies; }
+	std::list<Bullet*>&			Bullets()		{ return _bullets; }
+
+	static const char*	StateName(GameState state);
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	bool		detectCollision(const Bullet* bullet);
+	bool		bulletUnitCollision(const Bullet& bullet, CPlayer& unit);
+	void		enemyFire();
+	void		holdInside(CPlayer& unit);
+	void		trackPlayer(Bullet& bullet);
+	void		updateGameState();
+	void		moveEnemies();
+
+	//-------------------------------------------------------------------------
+	// Private Variables For This Class
+	//-------------------------------------------------------------------------
+	Vec2						_screenSize;		// Size of the playable area
+	Vec2						_enemySize;			// Collision size of an enemy ship
+
+	CPlayer*					_Player1;			// Player one
+	CPlayer*					_Player2;			// Player two
+
+	std::list<CPlayer*>			_enemies;			// List containing all enemies alive
+	std::list<Bullet*>			_bullets;			// List containing all bullets on the screen
+
+	GameState					_gameState;			// Game state (ongoing, won, lost)
+	int							_scoreP1;			// Score for the player 1
+	int							_scoreP2;			// Score for the player 2
+
+	int							frameCounter;		// Enemy formation movement timer
+	std::mt19937				_random;			// Seeded once, drives every random decision
+};
+
+#endif // _GAMEWORLD_H_
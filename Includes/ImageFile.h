@@ -2,7 +2,8 @@
 // ImageFile.h
 // by Mihai Popescu
 // March 2009
-#include "main.h"
+#include "ImageTypes.h"
+#include "MathDefs.h"
 
 
 typedef BYTE (*RGBQUAD_TO_BYTE)(const RGBQUAD &q);
@@ -20,31 +21,95 @@ enum EColorChannel
 	ECC_EXCLUSIVEBLUE
 };
 
+// Reduction used between mip levels
+enum EMipFilter
+{
+	MIP_BOX,		// 2x2 averages, the cheap default
+	MIP_LANCZOS		// sharper, several times slower to build
+};
+
 
 class CImageFile
 {
 protected:
 	BITMAPINFOHEADER m_biInfo;
 	RGBQUAD *m_pRGB;
+#ifdef _WIN32
 	HBITMAP m_hBMP;
+#endif
 
 	LONG &height;
 	LONG &width;
 	char m_szFileName[MAX_PATH];
 
+	// Next smaller mip level (owned), NULL until it is asked for
+	CImageFile *m_pMip;
+	EMipFilter m_MipFilter;
+
+	// Fills m_biInfo for a w x h 32 bit image, the pixels are left alone
+	void SetHeader(LONG w, LONG h);
+
 public:
 	CImageFile(void);
 	virtual ~CImageFile(void);
 
+	// Allocates a blank (black) 32 bit image
+	bool Create(LONG w, LONG h);
+
+	// Replaces the pixels with a copy of another image's
+	bool CopyFrom(const CImageFile &source);
+
+	// Frees the pixels and mips, the image is 0 x 0 until the next Create
+	// or load
+	void Release();
+
+	// Loads an 8, 24 or 32 bit BMP file (see CBmpDecoder), on any platform
+	bool LoadFromFile(const char* szFileName);
+
+#ifdef _WIN32
 	bool LoadBitmapFromFile(const char* szFileName, HDC hdc);
 	virtual void Paint(HDC hdc, int x, int y);
+	void Reload(HDC hdc);
+#endif
 
 	LONG Height() const { return height; }
 	LONG Width() const { return width; }
 
+	RGBQUAD* Pixels() { return m_pRGB; }
+	const RGBQUAD* Pixels() const { return m_pRGB; }
+
 	void Clear() { ZeroMemory(m_pRGB, sizeof(RGBQUAD) * width * height); }
-	void Reload(HDC hdc);
 
-	BYTE* CopyMonoImage(EColorChannel chn, const RECT* rc = NULL);
+	// One channel of the image, or of rc (inclusive, rows in memory order),
+	// as width x height bytes. The first form allocates the buffer with
+	// new[], the second writes rows dstStride bytes apart into the caller's.
+	// Hue, saturation and luminosity are scaled to 0 .. 255 (see
+	// RGB_TO_HSL_KERNEL); CPlanarImage splits several channels in one pass.
+	BYTE* CopyMonoImage(EColorChannel chn, const RECT* rc = NULL) const;
+	void CopyMonoImage(EColorChannel chn, BYTE *pDst, size_t dstStride, const RECT* rc = NULL) const;
+
+	// Writes a red, green or blue channel back, the exclusive ones clear the
+	// other two first
 	void PasteMonoImage(const BYTE *img, EColorChannel chn, const RECT* rc = NULL);
+	void PasteMonoImage(const BYTE *img, size_t srcStride, EColorChannel chn, const RECT* rc = NULL);
+
+	// Mip chain: level 0 is the image itself and every further level is the
+	// previous one halved (sizes round down, 1x1 is the last level). Levels
+	// are built from each other on first use and take about a third of the
+	// base image's memory. Create, CopyFrom, loading, PasteMonoImage and
+	// CResizableImage::Resample drop them; code writing through Pixels()
+	// calls ReleaseMips itself.
+	void SetMipFilter(EMipFilter filter);
+	EMipFilter GetMipFilter() const { return m_MipFilter; }
+
+	int GetMipLevelCount() const;
+	const CImageFile* GetMipLevel(int iLevel);
+
+	// Smallest level still covering lWidth x lHeight, the level to resample
+	// a sprite of that size from. Level 0 when the target is not smaller.
+	const CImageFile* GetNearestMipLevel(LONG lWidth, LONG lHeight, int *pLevel = NULL);
+
+	// Bytes held by the levels built so far, level 0 excluded
+	size_t GetMipBytes() const;
+	void ReleaseMips();
 };
\ No newline at end of file
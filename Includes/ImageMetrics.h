@@ -0,0 +1,43 @@
+//-----------------------------------------------------------------------------
+// File: ImageMetrics.h
+//
+// Desc: Full reference image quality metrics, used to compare the output of
+//	the resampling modes against each other or against a reference.
+//-----------------------------------------------------------------------------
+
+#ifndef _IMAGEMETRICS_H_
+#define _IMAGEMETRICS_H_
+
+//-----------------------------------------------------------------------------
+// ImageMetrics Specific Includes
+//-----------------------------------------------------------------------------
+#include "ImageFile.h"
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int SSIM_WINDOW = 8;		// SSIM is averaged over windows of this size
+const int SSIM_STEP = 4;		// spaced this far apart
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CImageMetrics (Class)
+// Desc : Both images must have the same size, otherwise the result is -1.
+//-----------------------------------------------------------------------------
+class CImageMetrics
+{
+public:
+	//-------------------------------------------------------------------------
+	// Public Static Functions For This Class
+	//-------------------------------------------------------------------------
+	// Peak signal to noise ratio in dB over the red, green and blue
+	// channels, infinite for identical images
+	static double	PSNR( const CImageFile &a, const CImageFile &b );
+
+	// Mean structural similarity of the luma (1 for identical images)
+	static double	SSIM( const CImageFile &a, const CImageFile &b );
+};
+
+#endif // _IMAGEMETRICS_H_
@@ -0,0 +1,122 @@
+#pragma once
+// ImagePipeline.h
+// Chains of image operations evaluated as one pass. Channel extraction,
+// lookup tables, convolutions and resamples are recorded first; Run then
+// computes the output tile by tile on the CResizableImage thread pool, each
+// tile pulling from the stages before it only the pixels it needs (kernel
+// borders, resample windows). Neighbouring point operations are fused into
+// one lookup per pixel and nothing but the output is written to memory, so
+// CopyMonoImage -> filter -> PasteMonoImage -> Resample reads the source
+// and writes the result about once instead of once per step.
+#include "Convolution.h"
+#include "ResizeEngine.h"
+
+#include <vector>
+
+// Rows of an output tile, times the whole upscale factor. Tiles span the
+// output's width, rows are read whole rather than in short pieces of
+// every row, and a pool band walks its tiles top-down. The pixels the
+// stages before a tile produce for it stay in the thread's cache.
+const unsigned int PIPELINE_TILE_ROWS = 64;
+
+class CImagePipeline
+{
+	enum EStage
+	{
+		STAGE_CHANNEL,
+		STAGE_LUT,
+		STAGE_PASTE,
+		STAGE_CONVOLVE,
+		STAGE_RESAMPLE
+	};
+
+	struct SStage
+	{
+		EStage type;
+		EColorChannel chn;
+		BYTE tables[3][256];			// LUT, blue, green and red as in an RGBQUAD
+		CConvolutionKernel kernel;
+		EBorderMode border;
+		CGenericFilter *pFilter;
+		unsigned int uWidth, uHeight;
+
+		SStage() : type(STAGE_LUT), chn(ECC_RED), border(BORDER_CLAMP), pFilter(NULL), uWidth(0), uHeight(0) {}
+	};
+
+	// Rows a step produced for a tile, rc the pixels they hold. The next
+	// tile down keeps the ones it reads again instead of producing them.
+	template <class T>
+	struct SRows
+	{
+		std::vector<T> pixels;
+		RECT rc;
+
+		SRows() { Forget(); }
+		void Forget() { rc.left = rc.top = 0; rc.right = rc.bottom = -1; }
+	};
+
+	// Buffers of one thread's tiles, grown as needed and kept between runs
+	struct SThreadBuffers
+	{
+		// Indexed by step, the rows are kept from tile to tile
+		std::vector<SRows<RGBQUAD> > steps;			// Output of every step but the last
+		std::vector<SRows<RGBQUAD> > resample;		// Source rows filtered horizontally
+		std::vector<SRows<BYTE> > grayIn;			// Input plane of a gray convolution
+
+		std::vector<RGBQUAD> convolve;				// CConvolver::ApplyBlock scratch
+		std::vector<RGBQUAD> row;					// Point operations before a gray plane
+		std::vector<BYTE> grayOut;
+		std::vector<BYTE> grayScratch;
+		std::vector<BYTE> plane;					// One row of a HSL channel
+	};
+
+	std::vector<SStage> m_Stages;
+	std::vector<SThreadBuffers> m_Threads;
+
+	// Source of runs writing over their own source when tiles read other
+	// pixels of it than the ones they write (convolutions, resamples) or
+	// read it again after writing (Paste)
+	CImageFile m_Copy;
+
+	// Tile evaluation, ImagePipeline.cpp
+	friend struct SPipelineRun;
+
+	CImagePipeline(const CImagePipeline&);
+	CImagePipeline& operator=(const CImagePipeline&);
+
+public:
+	CImagePipeline() {}
+
+	// Removes every stage
+	void Clear() { m_Stages.clear(); }
+	bool IsEmpty() const { return m_Stages.empty(); }
+
+	// Every pixel becomes the gray of one channel, the value CopyMonoImage
+	// gives for chn (the exclusive channels read like the plain ones)
+	void Channel(EColorChannel chn);
+
+	// Maps red, green and blue through 256 byte tables, copied here
+	void Lut(const BYTE *pTable);
+	void Lut(const BYTE *pRed, const BYTE *pGreen, const BYTE *pBlue);
+
+	// Pixels become the source's with one red, green or blue channel
+	// replaced by the same channel of the pixels so far, like
+	// PasteMonoImage of a CopyMonoImage; an exclusive channel leaves the
+	// other two 0. Not after a Resample.
+	bool Paste(EColorChannel chn);
+
+	// Convolution with a border rule of its own, the kernel is copied. Gray
+	// pixels (after Channel) are filtered as a single byte plane.
+	void Convolve(const CConvolutionKernel &kernel, EBorderMode border = BORDER_CLAMP);
+
+	// Scales to uWidth x uHeight, the pixels Resample gives with linear
+	// light off. pFilter must outlive the runs.
+	bool Resample(CGenericFilter *pFilter, unsigned int uWidth, unsigned int uHeight);
+
+	// Size of the output for a lWidth x lHeight source
+	void GetOutputSize(LONG lWidth, LONG lHeight, LONG &lOutWidth, LONG &lOutHeight) const;
+
+	// dst becomes src through every stage, created at the output size when
+	// it differs. src and dst may be the same image.
+	bool Run(const CImageFile &src, CImageFile &dst);
+};
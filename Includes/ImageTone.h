@@ -0,0 +1,47 @@
+#pragma once
+// ImageTone.h
+// Histograms and tone curves of CImageFile pixels: 256 bin counts of any
+// channel from ECC_RED to ECC_LUMINOSITY (the exclusive ones act like the
+// plain ones), 256 entry lookup tables applied to the pixels, and the
+// equalization and auto levels curves built from the counts. Rects are
+// inclusive with rows in memory order, like CopyMonoImage's.
+#include "ImageFile.h"
+
+// Share of the pixels AutoLevels clips at each end by default
+const double TONE_LEVELS_CLIP = 0.005;
+
+class CImageTone
+{
+public:
+	// Counts of every byte value of chn over the image or rc into pBins
+	static bool Histogram(const CImageFile &image, EColorChannel chn, DWORD *pBins, const RECT *rc = NULL);
+
+	// Red, green and blue in one pass, a NULL histogram is skipped
+	static bool Histogram(const CImageFile &image, DWORD *pRed, DWORD *pGreen, DWORD *pBlue,
+		const RECT *rc = NULL);
+
+	// Red, green and blue through their tables, reserved bytes are kept
+	static bool ApplyLut(CImageFile &image, const BYTE *pRed, const BYTE *pGreen, const BYTE *pBlue,
+		const RECT *rc = NULL);
+
+	// One channel through pTable. Hue, saturation and luminosity go to HSL
+	// and back like CPlanarImage::Merge, which rounds the other two and
+	// clears the reserved bytes.
+	static bool ApplyLut(CImageFile &image, EColorChannel chn, const BYTE *pTable, const RECT *rc = NULL);
+
+	// Curve spreading the counts of pBins evenly over 0 .. 255
+	static void EqualizeCurve(const DWORD *pBins, BYTE *pTable);
+
+	// Curve stretching the values between the dClip share of the darkest and
+	// of the brightest pixels to 0 .. 255, identity for a single value
+	static void LevelsCurve(const DWORD *pBins, double dClip, BYTE *pTable);
+
+	// Histogram, curve and LUT of one channel
+	static bool Equalize(CImageFile &image, EColorChannel chn, const RECT *rc = NULL);
+	static bool AutoLevels(CImageFile &image, EColorChannel chn, double dClip = TONE_LEVELS_CLIP,
+		const RECT *rc = NULL);
+
+	// Red, green and blue levels each stretched on its own, one histogram
+	// pass and one LUT pass
+	static bool AutoLevels(CImageFile &image, double dClip = TONE_LEVELS_CLIP, const RECT *rc = NULL);
+};
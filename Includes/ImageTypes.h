@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// File: ImageTypes.h
+//
+// Desc: Pixel and bitmap header types used by the image modules. On Windows
+//	they come from windows.h, elsewhere the same layouts are declared here
+//	so the image processing code also builds for the headless tools.
+//-----------------------------------------------------------------------------
+
+#ifndef _IMAGETYPES_H_
+#define _IMAGETYPES_H_
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <string.h>
+#include <stdint.h>
+
+typedef uint8_t		BYTE;
+typedef uint16_t	WORD;
+typedef uint32_t	DWORD;
+typedef int32_t		LONG;
+typedef unsigned int UINT;
+
+typedef struct tagRGBQUAD
+{
+	BYTE	rgbBlue;
+	BYTE	rgbGreen;
+	BYTE	rgbRed;
+	BYTE	rgbReserved;
+} RGBQUAD;
+
+typedef struct tagBITMAPINFOHEADER
+{
+	DWORD	biSize;
+	LONG	biWidth;
+	LONG	biHeight;
+	WORD	biPlanes;
+	WORD	biBitCount;
+	DWORD	biCompression;
+	DWORD	biSizeImage;
+	LONG	biXPelsPerMeter;
+	LONG	biYPelsPerMeter;
+	DWORD	biClrUsed;
+	DWORD	biClrImportant;
+} BITMAPINFOHEADER;
+
+typedef struct tagRECT
+{
+	LONG	left;
+	LONG	top;
+	LONG	right;
+	LONG	bottom;
+} RECT;
+
+#define BI_RGB				0L
+#define BI_RLE8				1L
+#define BI_BITFIELDS		3L
+#define MAX_PATH			260
+#define ZeroMemory(p, n)	memset((p), 0, (n))
+
+#endif // _WIN32
+
+#endif // _IMAGETYPES_H_
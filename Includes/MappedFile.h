@@ -0,0 +1,61 @@
+//-----------------------------------------------------------------------------
+// File: MappedFile.h
+//
+// Desc: Read only view of a whole file mapped into memory, through
+//	CreateFileMapping on Windows and mmap elsewhere.
+//-----------------------------------------------------------------------------
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+//-----------------------------------------------------------------------------
+// MappedFile Specific Includes
+//-----------------------------------------------------------------------------
+#include "ImageTypes.h"
+
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CMappedFile (Class)
+// Desc : The view stays valid until Close or destruction. Empty files open
+//		fine with a NULL Data().
+//-----------------------------------------------------------------------------
+class CMappedFile
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	CMappedFile();
+	~CMappedFile();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	bool			Open( const char *szFileName );
+	void			Close();
+
+	bool			IsOpen() const { return m_bOpen; }
+	const BYTE*		Data() const { return m_pData; }
+	size_t			Size() const { return m_Size; }
+
+private:
+	CMappedFile( const CMappedFile& rhs );
+	CMappedFile& operator=( const CMappedFile& rhs );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	const BYTE		*m_pData;
+	size_t			m_Size;
+	bool			m_bOpen;
+#ifdef _WIN32
+	HANDLE			m_hFile;
+	HANDLE			m_hMapping;
+#endif
+};
+
+#endif // _MAPPEDFILE_H_
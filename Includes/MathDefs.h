@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// File: MathDefs.h
+//
+// Desc: Math constants and helpers shared by the game and the platform
+//	independent modules (no windows.h in here).
+//-----------------------------------------------------------------------------
+
+#ifndef _MATHDEFS_H_
+#define _MATHDEFS_H_
+
+#include <math.h>
+
+//-----------------------------------------------------------------------------
+// Common defines
+//-----------------------------------------------------------------------------
+#define EPS 1e-3 // epsilon (the smallest float value used)
+#define PI 3.14159265358979323846
+#define DEG2RAD(deg) (PI * (deg) / 180.0)
+#define RAD2DEG(rad) ((rad) * 180.0 / PI)
+
+#endif // _MATHDEFS_H_
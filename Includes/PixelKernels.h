@@ -0,0 +1,95 @@
+#pragma once
+// PixelKernels.h
+// Per pixel inner loops of CBmpDecoder, CConvolver, CImageTone, CCompactImage,
+// CImagePipeline and of the channel conversions of CImageFile and
+// CPlanarImage. Like the resampling kernels every one exists as plain C++
+// and, on x86, as SSE4.1 and AVX2 versions of the level picked in
+// SimdLevel.h, all producing bit-identical results.
+#include "ImageTypes.h"
+#include "SimdLevel.h"
+
+// Taps a TAPS kernel takes at most
+const int TAPS_MAX = 256;
+
+// Copies of the 256 bins a histogram kernel counts into, pixel x going to
+// copy x % HISTOGRAM_SETS: runs of equal bytes then add to different
+// counters instead of each waiting on the store of the one before
+const int HISTOGRAM_SETS = 4;
+
+// Byte tables of a LUT_KERNEL, every entry already shifted to its
+// channel's place in a pixel so a lookup is three loads and ORs
+struct SLutTables
+{
+	DWORD	blue[256];
+	DWORD	green[256];
+	DWORD	red[256];
+
+	void Set(const BYTE *pRed, const BYTE *pGreen, const BYTE *pBlue);
+};
+
+// Widens count packed 3 byte (b, g, r) pixels to RGBQUADs with reserved 0
+typedef void (*EXPAND24_KERNEL)(const BYTE *pSrc, RGBQUAD *pDst, unsigned count);
+
+// Copies the red, green and blue bytes of count pixels to separate planes,
+// a NULL plane is skipped
+typedef void (*SPLIT_RGB_KERNEL)(const RGBQUAD *pSrc, BYTE *pRed, BYTE *pGreen, BYTE *pBlue, unsigned count);
+
+// Writes a plane into one channel (byte 0 blue, 1 green, 2 red) of count
+// pixels, the other bytes are kept
+typedef void (*MERGE_CHANNEL_KERNEL)(const BYTE *pPlane, RGBQUAD *pDst, unsigned uChannel, unsigned count);
+
+// HSL of count pixels, a NULL plane is skipped. Bytes map 0 .. 255 onto
+// 0 .. 1 for saturation and luminosity and onto 0 .. 360 degrees for hue,
+// all three rounded down. Grays have hue and saturation 0.
+typedef void (*RGB_TO_HSL_KERNEL)(const RGBQUAD *pSrc, BYTE *pHue, BYTE *pSat, BYTE *pLum, unsigned count);
+
+// Back to pixels (reserved 0), rounded to nearest
+typedef void (*HSL_TO_RGB_KERNEL)(const BYTE *pHue, const BYTE *pSat, const BYTE *pLum, RGBQUAD *pDst, unsigned count);
+
+// Convolution taps: pDst[c] = sum over i of pWeights[i] * pSrc[c +
+// pOffsets[i]] for count pixels, weights in iBits (1 .. WEIGHT_BITS) fixed
+// point, rounded and clamped once, at most TAPS_MAX taps. Reserved bytes
+// are zeroed.
+typedef void (*TAPS_KERNEL)(const RGBQUAD *pSrc, const int *pOffsets, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits);
+typedef void (*PLANE_TAPS_KERNEL)(const BYTE *pSrc, const int *pOffsets, BYTE *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits);
+
+// Adds count pixels to red, green and blue histograms, pBins holding
+// HISTOGRAM_SETS x 256 counters for each channel in that order. The plane
+// version counts bytes into HISTOGRAM_SETS x 256 counters.
+typedef void (*HISTOGRAM_KERNEL)(const RGBQUAD *pSrc, unsigned count, DWORD *pBins);
+typedef void (*PLANE_HISTOGRAM_KERNEL)(const BYTE *pSrc, unsigned count, DWORD *pBins);
+
+// Red, green and blue of count pixels through the tables, reserved bytes
+// are kept. pSrc may be pDst.
+typedef void (*LUT_KERNEL)(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned count, const SLutTables &tables);
+
+// Widens count RGB565 pixels (red in the top 5 bits) to RGBQUADs with
+// reserved 0, the top bits of each channel repeated below them so 0 and
+// full scale stay exact
+typedef void (*EXPAND565_KERNEL)(const WORD *pSrc, RGBQUAD *pDst, unsigned count);
+
+// Looks count 8 bit indices up in a 256 entry palette, copied as they are
+typedef void (*EXPAND_INDEXED_KERNEL)(const BYTE *pSrc, RGBQUAD *pDst, unsigned count, const RGBQUAD *pPalette);
+
+struct SPixelKernels
+{
+	ESimdLevel				level;
+	const char				*szName;
+	EXPAND24_KERNEL			pfnExpand24;
+	SPLIT_RGB_KERNEL		pfnSplitRgb;
+	MERGE_CHANNEL_KERNEL	pfnMergeChannel;
+	RGB_TO_HSL_KERNEL		pfnRgbToHsl;
+	HSL_TO_RGB_KERNEL		pfnHslToRgb;
+	TAPS_KERNEL				pfnTaps;
+	PLANE_TAPS_KERNEL		pfnPlaneTaps;
+	HISTOGRAM_KERNEL		pfnHistogram;
+	PLANE_HISTOGRAM_KERNEL	pfnPlaneHistogram;
+	LUT_KERNEL				pfnLut;
+	EXPAND565_KERNEL		pfnExpand565;
+	EXPAND_INDEXED_KERNEL	pfnExpandIndexed;
+};
+
+// Kernels of the level picked with SetSimdLevel
+const SPixelKernels& GetPixelKernels();
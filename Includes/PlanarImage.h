@@ -0,0 +1,70 @@
+#pragma once
+// PlanarImage.h
+// Channels of an image stored apart, one byte plane each, for the filters
+// working on a single channel. Planes are filled and written back by the
+// SIMD kernels of PixelKernels.h: one pass over the pixels splits any of
+// red, green and blue, another any of hue, saturation and luminosity.
+#include "ImageFile.h"
+
+// Planes are indexed by EColorChannel, ECC_RED .. ECC_LUMINOSITY
+const int PLANE_COUNT = ECC_LUMINOSITY + 1;
+
+// Bits selecting planes in Split and Merge
+const unsigned int PLANE_RED = 1 << ECC_RED;
+const unsigned int PLANE_GREEN = 1 << ECC_GREEN;
+const unsigned int PLANE_BLUE = 1 << ECC_BLUE;
+const unsigned int PLANE_HUE = 1 << ECC_HUE;
+const unsigned int PLANE_SATURATION = 1 << ECC_SATURATION;
+const unsigned int PLANE_LUMINOSITY = 1 << ECC_LUMINOSITY;
+const unsigned int PLANES_RGB = PLANE_RED | PLANE_GREEN | PLANE_BLUE;
+const unsigned int PLANES_HSL = PLANE_HUE | PLANE_SATURATION | PLANE_LUMINOSITY;
+
+// Plane rows start on this boundary, one AVX2 register
+const unsigned int PLANE_ALIGNMENT = 32;
+
+class CPlanarImage
+{
+private:
+	LONG m_lWidth;
+	LONG m_lHeight;
+	size_t m_Stride;
+
+	// Allocations as returned by new[] and the aligned planes inside them,
+	// NULL until a plane is first used
+	BYTE *m_pBlocks[PLANE_COUNT];
+	BYTE *m_pPlanes[PLANE_COUNT];
+
+	CPlanarImage(const CPlanarImage&);
+	CPlanarImage& operator=(const CPlanarImage&);
+
+public:
+	CPlanarImage();
+	~CPlanarImage();
+
+	// Sets the size, planes of another size are freed. Planes of the same
+	// size are kept with their contents.
+	bool Create(LONG w, LONG h);
+	void Release();
+
+	LONG Width() const { return m_lWidth; }
+	LONG Height() const { return m_lHeight; }
+
+	// Bytes from a plane row to the next, a multiple of PLANE_ALIGNMENT
+	size_t Stride() const { return m_Stride; }
+
+	// Plane of chn, allocated on first use (contents undefined until
+	// written). Rows are in the image's memory order, bottom-up like the
+	// pixels of a CImageFile.
+	BYTE* Plane(EColorChannel chn);
+	// NULL while not allocated
+	const BYTE* Plane(EColorChannel chn) const;
+
+	// Sizes the image to image (or to rc of it) and fills the planes in
+	// uPlanes. rc follows CopyMonoImage: inclusive, rows in memory order.
+	bool Split(const CImageFile &image, unsigned int uPlanes, const RECT *rc = NULL);
+
+	// Writes planes into image with the first one at (x, y). PLANES_HSL
+	// (all three needed) replaces the pixels, the RGB planes then replace
+	// their channel. False when a plane is missing or image is too small.
+	bool Merge(CImageFile &image, unsigned int uPlanes, LONG x = 0, LONG y = 0) const;
+};
@@ -0,0 +1,95 @@
+//-----------------------------------------------------------------------------
+// File: Profiler.h
+//
+// Desc: Lightweight hierarchical scope profiler. Scopes are recorded into
+//	per-thread rings keeping the newest events and can be written out as a
+//	Chrome trace (chrome://tracing or ui.perfetto.dev) on demand or after a
+//	number of frames.
+//
+//	Scopes are recorded in debug builds, and in release builds defining
+//	ENABLE_PROFILER. Other release builds compile them out, PROFILE_SCOPE
+//	expands to nothing.
+//-----------------------------------------------------------------------------
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+#if !defined(NDEBUG) || defined(ENABLE_PROFILER)
+#define PROFILER_ENABLED
+#endif
+
+const unsigned int PROFILER_EVENTS_PER_THREAD = 1 << 16;	// Newest events kept by each thread, a power of two
+
+#define PROFILER_CONCAT_(a, b)	a##b
+#define PROFILER_CONCAT(a, b)	PROFILER_CONCAT_(a, b)
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_SCOPE(name)		CProfileScope PROFILER_CONCAT(_profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION()		PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_FRAME_MARK()	CProfiler::FrameMark()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_FRAME_MARK()
+#endif
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CProfiler (Class)
+// Desc : Collects timed scopes from every thread. Recording only touches the
+//		calling thread's buffer, the buffers are merged when dumped.
+// Note : Scope names must be string literals (or otherwise outlive the dump),
+//		only the pointer is stored.
+//-----------------------------------------------------------------------------
+class CProfiler
+{
+public:
+	//-------------------------------------------------------------------------
+	// Public Static Functions For This Class
+	//-------------------------------------------------------------------------
+	static long long	Now();
+	static void			Record( const char *szName, long long llStart, long long llEnd, int iDepth );
+	static int&			Depth();
+
+	static void			SetThreadName( const char *szName );
+	static void			SetAutoDump( unsigned long ulFrames, const char *szFileName );
+	static void			FrameMark();
+	static unsigned long GetFrameCount();
+
+	static bool			Dump( const char *szFileName );
+};
+
+//-----------------------------------------------------------------------------
+// Name : CProfileScope (Class)
+// Desc : RAII marker, records the time spent between construction and
+//		destruction under the given name. Use through PROFILE_SCOPE.
+//-----------------------------------------------------------------------------
+class CProfileScope
+{
+public:
+	CProfileScope( const char *szName ) : m_szName(szName)
+	{
+		m_iDepth = CProfiler::Depth()++;
+		m_llStart = CProfiler::Now();
+	}
+
+	~CProfileScope()
+	{
+		CProfiler::Record( m_szName, m_llStart, CProfiler::Now(), m_iDepth );
+		CProfiler::Depth()--;
+	}
+
+private:
+	CProfileScope( const CProfileScope& rhs );
+
+	const char	*m_szName;
+	long long	m_llStart;
+	int			m_iDepth;
+};
+
+#endif // _PROFILER_H_
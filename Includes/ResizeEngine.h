@@ -1,63 +1,208 @@
 #pragma once
 #include "Filters.h"
 #include "ImageFile.h"
+#include "ResizeKernels.h"
+#include "ThreadPool.h"
+
+#include <memory>
+#include <type_traits>
+
+// The vertical pass computes strips of VERTICAL_STRIP output rows, each row
+// as a weighted sum of whole source rows. Rows are walked VERTICAL_CHUNK
+// pixels at a time so the source rows under a strip stay in cache.
+const unsigned int VERTICAL_STRIP = 16;
+const unsigned int VERTICAL_CHUNK = 512;
+
+// Columns filtered together by VERTICAL_COLUMNS, 16 pixels are one 64 byte
+// cache line
+const unsigned int VERTICAL_BLOCK = 16;
+
+// Ways of running the vertical pass, all of them produce the same pixels
+enum EVerticalMode
+{
+	VERTICAL_STRIPS,		// strips of output rows (default)
+	VERTICAL_COLUMNS,		// blocks of columns walked top to bottom
+	VERTICAL_TRANSPOSE		// transpose, filter rows, transpose back
+};
+
+// Rows filtered by a thread in one go by the horizontal pass
+const unsigned int HORIZONTAL_BAND = 8;
+
+// Fixed point weights use this many fraction bits, 1.0 == 1 << WEIGHT_BITS.
+// 14 bits leave room for the negative lobes and >1 peaks of bicubic and
+// Lanczos in a short, and keep 255 * weight sums well inside an int.
+const int WEIGHT_BITS = 14;
+const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+// Weights of every destination pixel start on a multiple of this many
+// shorts (one 16 byte SIMD register), the padding holds zero weights
+const unsigned int WEIGHTS_PAD = 8;
+
+// Weights tables kept by CWeightsCache unless changed with SetCapacity
+const unsigned int WEIGHTS_CACHE_SIZE = 8;
 
 class CWeightsTable
 {
 	typedef struct 
 	{
-		double *Weights;			// Normalized weights of neighboring pixels
 		int Left, Right;			// Bounds of source pixels window
 	} sContribution;
 
 private:
-	// Row (or column) of contribution weights
-	sContribution *m_WeightTable;
+	// Single allocation holding the double weights, the fixed point weights
+	// and the bounds, in that order
+	BYTE *m_pBlock;
+	// Normalized weights of neighboring pixels, m_WindowStride per pixel
+	double *m_pWeights;
+	// Same weights in fixed point, they sum to exactly WEIGHT_ONE
+	short *m_pFixedWeights;
+	// Row (or column) of source windows
+	sContribution *m_pBounds;
 	// Filter window size (of affecting source pixels)
 	DWORD m_WindowSize;
+	// Window size rounded up to WEIGHTS_PAD
+	DWORD m_WindowStride;
 	// Length of line (no. of rows / cols)
 	DWORD m_LineLength;
 
+	CWeightsTable(const CWeightsTable&);
+	CWeightsTable& operator=(const CWeightsTable&);
+
+	// Computes the weights of every destination pixel, curve is the filter
+	// itself, its CFilterCurve or a wrapper around the virtual Filter()
+	template <class TCurve>
+	void FillWeights(const TCurve &curve, double dScale, double dFScale, double dWidth, DWORD uSrcSize);
+
+	template <class TFilter>
+	void FillWeightsFor(TFilter &filter, double dScale, double dFScale, double dWidth, DWORD uSrcSize);
+	template <class TFilter>
+	void FillWeightsFor(TFilter &filter, double dScale, double dFScale, double dWidth, DWORD uSrcSize, std::true_type);
+	template <class TFilter>
+	void FillWeightsFor(TFilter &filter, double dScale, double dFScale, double dWidth, DWORD uSrcSize, std::false_type);
+
 public:
 	
 	CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrcSize);
 	~CWeightsTable();
 
 	// Retrieve a filter weight, given source and destination positions
-	double getWeight(int dst_pos, int src_pos) {
-			return m_WeightTable[dst_pos].Weights[src_pos];
+	double getWeight(int dst_pos, int src_pos) const {
+			return m_pWeights[dst_pos * m_WindowStride + src_pos];
+	}
+
+	// Retrieve the fixed point weights of a destination position, index 0 is
+	// the weight of the left boundary
+	const short* getFixedWeights(int dst_pos) const {
+			return &m_pFixedWeights[dst_pos * m_WindowStride];
 	}
 
 	// Retrieve left boundary of source line buffer
-	int getLeftBoundary(int dst_pos) {
-			return m_WeightTable[dst_pos].Left;
+	int getLeftBoundary(int dst_pos) const {
+			return m_pBounds[dst_pos].Left;
 	}
 
 	// Retrieve right boundary of source line buffer
-	int getRightBoundary(int dst_pos) {
-			return m_WeightTable[dst_pos].Right;
+	int getRightBoundary(int dst_pos) const {
+			return m_pBounds[dst_pos].Right;
+	}
+
+	// Distance in shorts between the fixed point weights of two neighboring
+	// destination positions
+	DWORD getWindowStride() const {
+			return m_WindowStride;
 	}
 };
 
+// Least recently used set of weights tables shared by every CResizableImage,
+// resampling many images between the same sizes builds each table once
+class CWeightsCache
+{
+public:
+	typedef std::shared_ptr<const CWeightsTable> TablePtr;
+
+	// Table for the filter (type, width and parameters) and sizes, built on a miss
+	static TablePtr Get(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrcSize);
+
+	// 0 disables caching, tables still in use stay alive until released
+	static void SetCapacity(unsigned int uTables);
+	static void Clear();
+};
+
 
 class CResizableImage : public CImageFile
 {
 	CGenericFilter *m_pFilter;
 	RGBQUAD *m_pResImg;
-	CWeightsTable *m_pWeights;
+	CWeightsCache::TablePtr m_pWeights;
+	bool m_bLinearLight;
 
 public:
-	CResizableImage() { m_pFilter = NULL; }
+	CResizableImage() { m_pFilter = NULL; m_bLinearLight = false; }
 	virtual ~CResizableImage() {}
 
 	void SetFilter(CGenericFilter *pFilter) { m_pFilter = pFilter; }
 
+	// Filter in linear light instead of on the sRGB bytes. Slower, but
+	// downscaled edges keep their brightness and colors do not shift.
+	void SetLinearLight(bool bLinear) { m_bLinearLight = bLinear; }
+	bool GetLinearLight() const { return m_bLinearLight; }
+
 	// Scale an image to the desired dimensions
 	void Resample(unsigned dst_width, unsigned dst_height);
 
+	// Becomes source scaled to the desired dimensions, source is not changed
+	bool ResampleFrom(const CImageFile &source, unsigned dst_width, unsigned dst_height);
+
+	// Threads shared by every Resample, 0 (the default) uses every hardware
+	// thread and 1 keeps the work on the calling thread. The output does not
+	// depend on the thread count.
+	static void SetThreadCount(unsigned uThreads);
+	static unsigned GetThreadCount();
+
+	// The pool itself, shared with the other whole image passes (CConvolver)
+	static CThreadPool& GetThreadPool();
+
+	// Vertical pass implementation used by every Resample, for comparisons
+	static void SetVerticalMode(EVerticalMode mode);
+	static EVerticalMode GetVerticalMode();
+
+	// Box filter resamples by whole factors (2x / 4x down, any factor up)
+	// replicate pixels or average blocks instead of going through the
+	// weights tables, on by default. The pixels are the same either way,
+	// off is for comparisons.
+	static void SetIntegerFastPaths(bool bEnable);
+	static bool GetIntegerFastPaths();
+
 private:
+	// Arguments of one filtering pass, handed to every band
+	struct SPass
+	{
+		CResizableImage *pImage;
+		unsigned int dst_width;
+		unsigned int dst_height;
+	};
+
 	void ScaleRow(unsigned int dst_width, unsigned int /*dst_height*/, unsigned int row);
-	void ScaleCol(unsigned int dst_width, unsigned int dst_height, unsigned int col);
+	void ScaleStrip(unsigned int dst_width, unsigned int row_begin, unsigned int row_end);
+	void ScaleCols(unsigned int dst_width, unsigned int dst_height, unsigned int col, unsigned int count);
+
+	// Thread pool bands, rows [uBegin, uEnd) or column blocks [uBegin, uEnd)
+	static void RowBand(void *pContext, unsigned uBegin, unsigned uEnd);
+	static void StripBand(void *pContext, unsigned uBegin, unsigned uEnd);
+	static void ColBand(void *pContext, unsigned uBegin, unsigned uEnd);
+
+	// Resample body, m_pRGB is not freed when it is pBorrowed
+	void ResamplePixels(unsigned dst_width, unsigned dst_height, const RGBQUAD *pBorrowed);
+
+	// Box filter integer ratio paths, false when the ratio does not qualify
+	bool ResampleIntegerRatio(unsigned dst_width, unsigned dst_height);
+
+	// Resample through per thread rings of 15 bit linear light rows into
+	// m_pResImg
+	void ResampleLinear(unsigned dst_width, unsigned dst_height);
+
+	// VERTICAL_TRANSPOSE flavour of VerticalFilter
+	void TransposedVerticalFilter(unsigned int dst_width, unsigned int dst_height);
 
 	// Performs horizontal image filtering
 	void HorizontalFilter(unsigned int dst_width, unsigned int dst_height);
@@ -0,0 +1,68 @@
+#pragma once
+// ResizeKernels.h
+// Inner loops of the resampling in CResizableImage and CStreamResizer. Every
+// kernel exists as plain C++ and, on x86, as SSE4.1 and AVX2 versions picked
+// at run time from what the CPU supports (see SimdLevel.h). All versions
+// produce bit-identical results.
+#include "ImageTypes.h"
+#include "SimdLevel.h"
+
+class CWeightsTable;
+
+// Linear light channels are 15 bit (0 .. LINEAR_ONE) so they fit signed
+// 16 bit SIMD multiplies like the byte channels do
+const int LINEAR_BITS = 15;
+const int LINEAR_ONE = (1 << LINEAR_BITS) - 1;
+
+// Entries of the linear to sRGB table, indexed by the top 12 bits
+const int LINEAR_TO_SRGB_SIZE = 4096;
+
+// Pixel of the linear light mode, channels in the RGBQUAD order
+struct SLinearPixel
+{
+	short	b, g, r, a;
+};
+
+// Filters pixels [dst_begin, dst_end) of one row: pDst[x - dst_begin] = sum
+// of weights(x) * source pixels from left(x) on, pSrc holding the source
+// row from pixel src_begin. Whole rows pass 0, 0 and the destination width.
+typedef void (*RESIZE_ROW_KERNEL)(const RGBQUAD *pSrc, unsigned src_begin, RGBQUAD *pDst, unsigned dst_begin,
+	unsigned dst_end, const CWeightsTable &weights);
+
+// Filters count adjacent pixels along a column window: pDst[c] = sum over k
+// of pWeights[k] * pSrc[k * src_stride + c], pSrc is the first row of the window
+typedef void (*RESIZE_COL_KERNEL)(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps);
+
+// Same filters on linear light pixels
+typedef void (*LINEAR_ROW_KERNEL)(const SLinearPixel *pSrc, SLinearPixel *pDst, unsigned dst_width, const CWeightsTable &weights);
+typedef void (*LINEAR_COL_KERNEL)(const SLinearPixel *pSrc, unsigned src_stride, SLinearPixel *pDst, unsigned count,
+	const short *pWeights, int taps);
+
+// Integer ratio paths of the box filter. BOX_REDUCE averages factor x factor
+// blocks (factor 2 or 4) of the factor rows at pSrc into one row of
+// dst_width pixels, REPLICATE repeats every pixel of a row factor times.
+typedef void (*BOX_REDUCE_KERNEL)(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned dst_width,
+	unsigned factor);
+typedef void (*REPLICATE_KERNEL)(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned src_width, unsigned factor);
+
+struct SResizeKernels
+{
+	ESimdLevel			level;
+	const char			*szName;
+	RESIZE_ROW_KERNEL	pfnRow;
+	RESIZE_COL_KERNEL	pfnCol;
+	LINEAR_ROW_KERNEL	pfnLinearRow;
+	LINEAR_COL_KERNEL	pfnLinearCol;
+	BOX_REDUCE_KERNEL	pfnBoxReduce;
+	REPLICATE_KERNEL	pfnReplicate;
+};
+
+// Kernels of the level picked with SetSimdLevel
+const SResizeKernels& GetResizeKernels();
+
+// Table conversions between sRGB bytes and linear light, 256 entries one
+// way and LINEAR_TO_SRGB_SIZE the other. Converting a byte to linear and
+// back gives the same byte.
+void SrgbToLinear(const RGBQUAD *pSrc, SLinearPixel *pDst, unsigned count);
+void LinearToSrgb(const SLinearPixel *pSrc, RGBQUAD *pDst, unsigned count);
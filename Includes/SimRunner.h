@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+// File: SimRunner.h
+//
+// Desc: Runs the game simulation for a number of frames without a window,
+//	feeding bot or scripted input and timing every phase. Shared by the
+//	headless runner and the benchmark suite.
+//-----------------------------------------------------------------------------
+
+#ifndef _SIMRUNNER_H_
+#define _SIMRUNNER_H_
+
+//-----------------------------------------------------------------------------
+// SimRunner Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameWorld.h"
+
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const float	SIM_DT			= 1.0f / 60.0f;	// Fixed time step, keeps runs reproducible
+const int	SIM_SHIP_SIZE	= 72;			// Size of data/ship1.bmp and data/enemyship.bmp
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CSimRunner (Class)
+// Desc : Drives one CGameWorld through a fixed number of frames.
+//-----------------------------------------------------------------------------
+class CSimRunner
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators & Structures
+	//-------------------------------------------------------------------------
+	enum EInput
+	{
+		INPUT_NONE,			// nobody touches the keyboard
+		INPUT_BOT,			// both players chase the closest enemy and fire
+		INPUT_SCRIPT		// commands read from a script track
+	};
+
+	// One line of an input script, "<frame> <verb> [arg]"
+	struct SCommand
+	{
+		unsigned long	ulFrame;
+		std::string		strVerb;
+		std::string		strArg;
+	};
+
+	struct SOptions
+	{
+		unsigned long			ulFrames;		// Frames to simulate, stops early on WON / LOST
+		unsigned int			uSeed;			// World random seed
+		int						iEnemies;		// Enemies in the first wave
+		int						iBullets;		// Enemy bullets spawned before the first frame
+		Vec2					screenSize;		// Playable area
+		CGameWorld::GameState	startState;		// State of the world on frame 0
+		EInput					input;
+		std::vector<SCommand>	script;			// Used with INPUT_SCRIPT
+
+		SOptions() : ulFrames(3600), uSeed(1), iEnemies(33), iBullets(0), screenSize(1920, 1080),
+			startState(CGameWorld::ONGOING), input(INPUT_NONE) {}
+	};
+
+	// Per frame durations (ns) of one simulation phase
+	struct SPhase
+	{
+		const char				*szName;
+		std::vector<long long>	samples;
+
+		long long	Total() const;
+		long long	Max() const;
+		double		Mean() const;
+		long long	Median() const;
+		long long	Percentile(double p) const;
+	};
+
+	struct SCounterTotal
+	{
+		std::string		strName;
+		long long		llValue;		// summed for per-frame counters, last value for gauges
+	};
+
+	struct SResult
+	{
+		unsigned long				ulFrames;			// Frames actually simulated
+		CGameWorld::GameState		finalState;
+		int							iScoreP1;
+		int							iScoreP2;
+		long long					llSetupAllocations;	// operator new calls while building the world
+		long long					llRunAllocations;	// operator new calls while stepping it
+		std::vector<SPhase>			phases;
+		std::vector<SCounterTotal>	counters;
+	};
+
+	//-------------------------------------------------------------------------
+	// Public Static Functions For This Class
+	//-------------------------------------------------------------------------
+	static bool		LoadScript( const char *szFileName, std::vector<SCommand> &script );
+	static void		Run( const SOptions &opt, SResult &result );
+	static bool		WriteStats( const char *szFileName, const SOptions &opt, const SResult &result );
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Static Functions For This Class
+	//-------------------------------------------------------------------------
+	static void		ParseKeys( const std::string &strKeys, unsigned long &ulDirection, bool &bFire );
+	static void		BotSteer( CGameWorld &world, CPlayer *pPlayer, unsigned long &ulDirection, bool &bFire );
+};
+
+#endif // _SIMRUNNER_H_
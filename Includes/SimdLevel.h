@@ -0,0 +1,36 @@
+#pragma once
+// SimdLevel.h
+// Instruction set level of the SIMD kernel tables, the resampling kernels of
+// ResizeKernels.h and the pixel kernels of PixelKernels.h. Each table has an
+// entry per level and uses the one picked here.
+
+enum ESimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE41,
+	SIMD_AVX2
+};
+
+// For the kernel sources: SIMD_X86 when the x86 intrinsics are available,
+// SIMD_TARGET(isa) on every function using them. GCC and Clang only emit
+// SSE4.1 / AVX2 instructions in functions marked for them, MSVC accepts the
+// intrinsics anywhere.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#endif
+
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// Best level the CPU (and OS) supports
+ESimdLevel GetSupportedSimdLevel();
+
+// Level the kernels run at, the supported one unless lowered with SetSimdLevel
+ESimdLevel GetSimdLevel();
+
+// Caps the level of every kernel table (for comparisons and debugging),
+// levels above the supported one fall back to it
+void SetSimdLevel(ESimdLevel level);
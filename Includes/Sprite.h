@@ -7,6 +7,8 @@
 #include "main.h"
 #include "Vec2.h"
 #include "BackBuffer.h"
+#include "AssetPack.h"
+#include "AssetLoader.h"
 
 class Sprite
 {
@@ -24,6 +26,14 @@ public:
 	void setBackBuffer(const BackBuffer *pBackBuffer);
 	virtual void draw();
 
+	// Sprites created while a pack is set take their bitmaps from it when it
+	// holds the file, the pack must stay open until they are deleted.
+	static void setAssetPack(const CAssetPack *pPack);
+
+	// Files the loader was asked for are taken from it (waiting for them if
+	// needed) instead of being loaded again.
+	static void setAssetLoader(CAssetLoader *pLoader);
+
 public:
 	// Keep these public because they need to be
 	// modified externally frequently.
@@ -51,6 +61,15 @@ protected:
 	COLORREF mcTransparentColor;
 	void drawTransparent();
 	void drawMask();
+
+	// Pack entry the sprite draws from, NULL when it uses the GDI bitmaps
+	const SPackEntry *mpAsset;
+	const BYTE *mpAssetPixels;
+	const BYTE *mpAssetMask;
+
+	bool loadFromPack(const char *szImageFile, DWORD dwColorKey);
+	HBITMAP loadBitmap(const char *szFile);
+	void drawAsset(int xSrc, int ySrc, int w, int h);
 };
 
 // AnimatedSprite
@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+// File: SpscQueue.h
+//
+// Desc: Bounded lock-free queue between exactly one producer thread and one
+//	consumer thread. Neither side ever blocks or allocates: Push fails when
+//	the queue is full and Pop when it is empty, what to do then is up to the
+//	caller.
+//-----------------------------------------------------------------------------
+
+#ifndef _SPSCQUEUE_H_
+#define _SPSCQUEUE_H_
+
+//-----------------------------------------------------------------------------
+// SpscQueue Specific Includes
+//-----------------------------------------------------------------------------
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CSpscQueue (Template Class)
+// Desc : Ring of a power of two slots. The producer owns m_Tail and the
+//		consumer m_Head, each only reads the other's, so a Push and a Pop
+//		never touch the same cache line but for the slot they hand over.
+// Note : Reset is not thread safe, call it while neither side is running.
+//-----------------------------------------------------------------------------
+template <class T>
+class CSpscQueue
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	explicit CSpscQueue( size_t capacity = 0 ) : m_Mask(0), m_Head(0), m_Tail(0) { Reset(capacity); }
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	// Empties the queue and makes room for at least capacity items
+	void Reset( size_t capacity )
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size *= 2;
+
+		m_Items.assign(size, T());
+		m_Mask = size - 1;
+		m_Head.store(0, std::memory_order_relaxed);
+		m_Tail.store(0, std::memory_order_relaxed);
+	}
+
+	size_t Capacity() const { return m_Items.size(); }
+
+	// Producer only, false when the queue is full
+	bool Push( const T &item )
+	{
+		size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) == m_Items.size())
+			return false;
+
+		m_Items[tail & m_Mask] = item;
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only, false when the queue is empty
+	bool Pop( T &item )
+	{
+		size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire))
+			return false;
+
+		item = m_Items[head & m_Mask];
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Either side; only a hint while the other one is running
+	bool IsEmpty() const { return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire); }
+
+private:
+	CSpscQueue( const CSpscQueue& rhs );
+	CSpscQueue& operator=( const CSpscQueue& rhs );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	std::vector<T>			m_Items;
+	size_t					m_Mask;
+	char					m_PadHead[64];
+	std::atomic<size_t>		m_Head;			// Next item to pop, written by the consumer
+	char					m_PadTail[64];
+	std::atomic<size_t>		m_Tail;			// Next free slot, written by the producer
+	char					m_PadEnd[64];
+};
+
+#endif // _SPSCQUEUE_H_
@@ -0,0 +1,169 @@
+//-----------------------------------------------------------------------------
+// File: StreamResizer.h
+//
+// Desc: Resamples images that do not fit in memory. Source rows are pulled
+//	from a row provider as the vertical filter reaches them, filtered
+//	horizontally into a ring of destination-width rows and every finished
+//	destination row is handed to a row sink. Memory use grows with the
+//	image width only.
+//-----------------------------------------------------------------------------
+
+#ifndef _STREAMRESIZER_H_
+#define _STREAMRESIZER_H_
+
+//-----------------------------------------------------------------------------
+// StreamResizer Specific Includes
+//-----------------------------------------------------------------------------
+#include "ResizeEngine.h"
+
+#include <stdio.h>
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : IRowProvider (Interface)
+// Desc : Source of image rows, row 0 is the top one. Rows are requested in
+//		increasing order, each one once.
+//-----------------------------------------------------------------------------
+class IRowProvider
+{
+public:
+	virtual ~IRowProvider() {}
+
+	virtual LONG	Width() const = 0;
+	virtual LONG	Height() const = 0;
+	virtual bool	ReadRow( LONG y, RGBQUAD *pRow ) = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Name : IRowSink (Interface)
+// Desc : Receives destination rows top to bottom.
+//-----------------------------------------------------------------------------
+class IRowSink
+{
+public:
+	virtual ~IRowSink() {}
+
+	virtual bool	WriteRow( LONG y, const RGBQUAD *pRow ) = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CImageRowProvider (Class)
+// Desc : Rows of an image already in memory.
+//-----------------------------------------------------------------------------
+class CImageRowProvider : public IRowProvider
+{
+public:
+	explicit CImageRowProvider( const CImageFile &image ) : m_Image(image) {}
+
+	LONG	Width() const { return m_Image.Width(); }
+	LONG	Height() const { return m_Image.Height(); }
+	bool	ReadRow( LONG y, RGBQUAD *pRow );
+
+private:
+	const CImageFile	&m_Image;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CImageRowSink (Class)
+// Desc : Writes rows into an image created with the destination size.
+//-----------------------------------------------------------------------------
+class CImageRowSink : public IRowSink
+{
+public:
+	explicit CImageRowSink( CImageFile &image ) : m_Image(image) {}
+
+	bool	WriteRow( LONG y, const RGBQUAD *pRow );
+
+private:
+	CImageFile			&m_Image;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CBmpRowProvider (Class)
+// Desc : Reads the rows of an uncompressed 24 or 32 bit BMP file one at a
+//		time, bottom-up and top-down files alike.
+//-----------------------------------------------------------------------------
+class CBmpRowProvider : public IRowProvider
+{
+public:
+	CBmpRowProvider();
+	~CBmpRowProvider();
+
+	bool	Open( const char *szFileName );
+	void	Close();
+
+	LONG	Width() const { return m_lWidth; }
+	LONG	Height() const { return m_lHeight; }
+	bool	ReadRow( LONG y, RGBQUAD *pRow );
+
+private:
+	CBmpRowProvider( const CBmpRowProvider& rhs );
+	CBmpRowProvider& operator=( const CBmpRowProvider& rhs );
+
+	FILE		*m_pFile;
+	LONG		m_lWidth;
+	LONG		m_lHeight;
+	bool		m_bBottomUp;
+	WORD		m_wBitCount;
+	DWORD		m_dwPixelsOffset;	// Start of the pixel array in the file
+	DWORD		m_dwStride;			// Bytes per file row, padded to 4
+	BYTE		*m_pLine;			// One file row
+};
+
+//-----------------------------------------------------------------------------
+// Name : CBmpRowSink (Class)
+// Desc : Writes a top-down 32 bit BMP file row by row.
+//-----------------------------------------------------------------------------
+class CBmpRowSink : public IRowSink
+{
+public:
+	CBmpRowSink();
+	~CBmpRowSink();
+
+	bool	Create( const char *szFileName, LONG lWidth, LONG lHeight );
+	bool	Close();
+
+	bool	WriteRow( LONG y, const RGBQUAD *pRow );
+
+private:
+	CBmpRowSink( const CBmpRowSink& rhs );
+	CBmpRowSink& operator=( const CBmpRowSink& rhs );
+
+	FILE		*m_pFile;
+	LONG		m_lWidth;
+	bool		m_bOk;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CStreamResizer (Class)
+// Desc : Horizontal then vertical resampling through a ring of rows. The
+//		pixels match CResizableImage::Resample without linear light
+//		whenever that one also filters horizontally first (dst_width *
+//		height <= dst_height * width), box filter integer ratios included.
+//		The other order rounds in between passes differently.
+//-----------------------------------------------------------------------------
+class CStreamResizer
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	explicit CStreamResizer( CGenericFilter *pFilter ) : m_pFilter(pFilter), m_WorkingBytes(0) {}
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	// Fails when a row cannot be read or written
+	bool	Resample( IRowProvider &source, unsigned dst_width, unsigned dst_height, IRowSink &sink );
+
+	// Bytes of row buffers used by the last Resample
+	size_t	GetWorkingBytes() const { return m_WorkingBytes; }
+
+private:
+	CGenericFilter	*m_pFilter;
+	size_t			m_WorkingBytes;
+};
+
+#endif // _STREAMRESIZER_H_
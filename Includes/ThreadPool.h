@@ -0,0 +1,95 @@
+//-----------------------------------------------------------------------------
+// File: ThreadPool.h
+//
+// Desc: Small fixed size pool of worker threads that splits a range of work
+//	items into bands. The calling thread works on bands too and returns once
+//	every band is done, so a Run behaves like an ordinary loop.
+//-----------------------------------------------------------------------------
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+//-----------------------------------------------------------------------------
+// ThreadPool Specific Includes
+//-----------------------------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CThreadPool (Class)
+// Desc : Runs a band function over [0, count) on every thread of the pool.
+// Note : Bands are handed out in whatever order threads ask for them, the
+//		band function must only write to data owned by its own items. Runs
+//		from different threads are serialized, a band must not Run the
+//		same pool again.
+//-----------------------------------------------------------------------------
+class CThreadPool
+{
+public:
+	// Processes items [uBegin, uEnd)
+	typedef void (*BAND_FUNC)( void *pContext, unsigned uBegin, unsigned uEnd );
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	explicit CThreadPool( unsigned uThreads = 0 );
+	~CThreadPool();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	// Threads taking part in a Run, the caller included
+	unsigned		GetThreadCount() const { return (unsigned)m_Workers.size() + 1; }
+
+	// Splits [0, uCount) into bands of at least uGrain items and blocks until
+	// all of them were processed
+	void			Run( unsigned uCount, unsigned uGrain, BAND_FUNC pfnBand, void *pContext );
+
+	//-------------------------------------------------------------------------
+	// Public Static Functions For This Class
+	//-------------------------------------------------------------------------
+	// Threads the hardware runs at once, at least 1
+	static unsigned	GetHardwareThreads();
+
+	// Index of the calling thread within the pool whose band it runs, 0 for
+	// the thread that called Run, 1 .. GetThreadCount() - 1 for workers. Lets
+	// bands share one scratch allocation made before Run.
+	static unsigned	GetThreadIndex();
+
+private:
+	CThreadPool( const CThreadPool& rhs );
+	CThreadPool& operator=( const CThreadPool& rhs );
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	void			WorkerMain( unsigned uIndex );
+	void			DoBands();
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	std::vector<std::thread>	m_Workers;
+	std::mutex					m_RunLock;			// Held by the thread that owns the current Run
+	std::mutex					m_Lock;
+	std::condition_variable		m_WakeWorkers;
+	std::condition_variable		m_WakeCaller;
+	unsigned long				m_ulGeneration;		// Bumped for every Run, wakes the workers
+	unsigned					m_uBusyWorkers;		// Workers still inside the current Run
+	bool						m_bQuit;
+
+	// Current job
+	BAND_FUNC					m_pfnBand;
+	void						*m_pContext;
+	unsigned					m_uCount;
+	unsigned					m_uBandSize;
+	std::atomic<unsigned>		m_NextBand;
+};
+
+#endif // _THREADPOOL_H_
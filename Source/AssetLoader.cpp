@@ -0,0 +1,199 @@
+//-----------------------------------------------------------------------------
+// File: AssetLoader.cpp
+//
+// Desc: Bitmaps decoded on worker threads.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// AssetLoader Specific Includes
+//-----------------------------------------------------------------------------
+#include "AssetLoader.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const unsigned ASSET_LOADER_MAX_THREADS = 4;	// Decoding is mostly memory bound
+
+//-----------------------------------------------------------------------------
+// CAssetRequest Member Functions
+//-----------------------------------------------------------------------------
+CAssetRequest::CAssetRequest( CAssetLoader *pLoader, const char *szName, CImageFile *pTarget ) :
+	m_pLoader(pLoader), m_strName(szName), m_pTarget(pTarget ? pTarget : &m_Image), m_State(QUEUED)
+{
+}
+
+bool CAssetRequest::IsReady() const
+{
+	std::lock_guard<std::mutex> guard(m_pLoader->m_Lock);
+	return m_State == LOADED || m_State == FAILED;
+}
+
+const CImageFile* CAssetRequest::Get()
+{
+	std::unique_lock<std::mutex> lock(m_pLoader->m_Lock);
+
+	// Not started, no point waiting for the workers to get to it
+	if (m_State == QUEUED && m_pLoader->Unqueue(this))
+		m_pLoader->Decode(this, lock);
+
+	if (m_State == LOADING)
+	{
+		PROFILE_SCOPE("CAssetRequest::Wait");
+		m_pLoader->m_LoadDone.wait(lock, [this] { return m_State == LOADED || m_State == FAILED; });
+	}
+	return m_State == LOADED ? m_pTarget : NULL;
+}
+
+//-----------------------------------------------------------------------------
+// CAssetLoader Member Functions
+//-----------------------------------------------------------------------------
+CAssetLoader::CAssetLoader( unsigned uThreads ) : m_Pending(0), m_bQuit(false)
+{
+	if (uThreads == 0)
+		uThreads = (std::min)((std::max)(CThreadPool::GetHardwareThreads(), 2u) - 1, ASSET_LOADER_MAX_THREADS);
+
+	m_Workers.reserve(uThreads);
+	for (unsigned i = 0; i < uThreads; i++)
+		m_Workers.push_back(std::thread(&CAssetLoader::WorkerMain, this));
+}
+
+CAssetLoader::~CAssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_Lock);
+		m_bQuit = true;
+	}
+	m_WakeWorkers.notify_all();
+
+	for (size_t i = 0; i < m_Workers.size(); i++)
+		m_Workers[i].join();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Load ()
+//-----------------------------------------------------------------------------
+CAssetRequest* CAssetLoader::Load( const char *szFileName, PRIORITY priority, CImageFile *pTarget )
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+
+	std::unique_ptr<CAssetRequest> &slot = m_Requests[szFileName];
+	if (slot)
+	{
+		// Moved ahead of the background loads it was queued behind
+		if (priority == LOAD_FOREGROUND && std::find(m_Background.begin(), m_Background.end(), slot.get()) != m_Background.end())
+		{
+			Unqueue(slot.get());
+			m_Foreground.push_back(slot.get());
+		}
+		return slot.get();
+	}
+
+	slot.reset(new CAssetRequest(this, szFileName, pTarget));
+	(priority == LOAD_FOREGROUND ? m_Foreground : m_Background).push_back(slot.get());
+	m_Pending++;
+
+	lock.unlock();
+	m_WakeWorkers.notify_one();
+	return slot.get();
+}
+
+CAssetRequest* CAssetLoader::Find( const char *szFileName ) const
+{
+	std::lock_guard<std::mutex> guard(m_Lock);
+
+	RequestMap::const_iterator it = m_Requests.find(szFileName);
+	return it != m_Requests.end() ? it->second.get() : NULL;
+}
+
+size_t CAssetLoader::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> guard(m_Lock);
+	return m_Pending;
+}
+
+//-----------------------------------------------------------------------------
+// Name : WaitAll ()
+// Desc : Helps with the queue instead of only waiting on it.
+//-----------------------------------------------------------------------------
+void CAssetLoader::WaitAll()
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+
+	while (!m_Foreground.empty() || !m_Background.empty())
+	{
+		std::deque<CAssetRequest*> &queue = m_Foreground.empty() ? m_Background : m_Foreground;
+		CAssetRequest *pRequest = queue.front();
+		queue.pop_front();
+		Decode(pRequest, lock);
+	}
+
+	m_LoadDone.wait(lock, [this] { return m_Pending == 0; });
+}
+
+//-----------------------------------------------------------------------------
+// Name : Unqueue () (Private)
+// Desc : Takes a request off its queue, false when it was not queued. The
+//		queues are a few dozen entries at most.
+//-----------------------------------------------------------------------------
+bool CAssetLoader::Unqueue( CAssetRequest *pRequest )
+{
+	std::deque<CAssetRequest*> *pQueues[2] = { &m_Foreground, &m_Background };
+	for (int i = 0; i < 2; i++)
+	{
+		std::deque<CAssetRequest*>::iterator it = std::find(pQueues[i]->begin(), pQueues[i]->end(), pRequest);
+		if (it != pQueues[i]->end())
+		{
+			pQueues[i]->erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Decode () (Private)
+// Desc : Loads a request taken off the queue, with the lock released while
+//		decoding.
+//-----------------------------------------------------------------------------
+void CAssetLoader::Decode( CAssetRequest *pRequest, std::unique_lock<std::mutex> &lock )
+{
+	pRequest->m_State = CAssetRequest::LOADING;
+	lock.unlock();
+
+	bool bLoaded;
+	{
+		PROFILE_SCOPE("CAssetLoader::Decode");
+		bLoaded = pRequest->m_pTarget->LoadFromFile(pRequest->Name());
+	}
+
+	lock.lock();
+	pRequest->m_State = bLoaded ? CAssetRequest::LOADED : CAssetRequest::FAILED;
+	m_Pending--;
+	m_LoadDone.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+// Name : WorkerMain () (Private)
+// Desc : Foreground requests first, background ones when there are none.
+//-----------------------------------------------------------------------------
+void CAssetLoader::WorkerMain()
+{
+	CProfiler::SetThreadName("Asset loader");
+
+	std::unique_lock<std::mutex> lock(m_Lock);
+	for (;;)
+	{
+		m_WakeWorkers.wait(lock, [this] { return m_bQuit || !m_Foreground.empty() || !m_Background.empty(); });
+		if (m_bQuit)
+			break;
+
+		std::deque<CAssetRequest*> &queue = m_Foreground.empty() ? m_Background : m_Foreground;
+		CAssetRequest *pRequest = queue.front();
+		queue.pop_front();
+		Decode(pRequest, lock);
+	}
+}
@@ -0,0 +1,476 @@
+//-----------------------------------------------------------------------------
+// File: AssetPack.cpp
+//
+// Desc: Pre-decoded sprite pack, reading and writing.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// AssetPack Specific Includes
+//-----------------------------------------------------------------------------
+#include "AssetPack.h"
+#include "ImageFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	const LONG PACK_MAX_DIMENSION = 1 << 15;
+
+	// Same rules as Find, names compare as if lowercase with forward slashes
+	char NormalizeChar( char c )
+	{
+		return c == '\\' ? '/' : (char)tolower((unsigned char)c);
+	}
+
+	bool SameName( const char *a, const char *b )
+	{
+		for (; *a && *b; a++, b++)
+		{
+			if (NormalizeChar(*a) != NormalizeChar(*b))
+				return false;
+		}
+		return *a == *b;
+	}
+
+	// True when [dwOffset, dwOffset + size) lies inside the file
+	bool InRange( DWORD dwOffset, unsigned long long size, size_t fileSize )
+	{
+		return dwOffset + size <= fileSize;
+	}
+
+	DWORD AlignUp( DWORD dwValue )
+	{
+		return (dwValue + PACK_ALIGNMENT - 1) & ~(PACK_ALIGNMENT - 1);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// CAssetPack Member Functions
+//-----------------------------------------------------------------------------
+CAssetPack::CAssetPack() :
+	m_pData(NULL), m_Size(0), m_pHeader(NULL), m_pEntries(NULL), m_pBuckets(NULL)
+{
+}
+
+bool CAssetPack::Open( const char *szFileName )
+{
+	Close();
+
+	if (!m_File.Open(szFileName))
+		return false;
+
+	m_pData = m_File.Data();
+	m_Size = m_File.Size();
+	if (!Validate())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool CAssetPack::Open( const BYTE *pData, size_t size )
+{
+	Close();
+
+	m_pData = pData;
+	m_Size = size;
+	if (!Validate())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CAssetPack::Close()
+{
+	m_File.Close();
+	m_pData = NULL;
+	m_Size = 0;
+	m_pHeader = NULL;
+	m_pEntries = NULL;
+	m_pBuckets = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Validate () (Private)
+// Desc : One pass over the index when the pack is opened, a few dozen
+//		entries, so lookups and draws never need to check anything.
+//-----------------------------------------------------------------------------
+bool CAssetPack::Validate()
+{
+	if (!m_pData || m_Size < sizeof(SPackHeader) || m_Size > 0xffffffff)
+		return false;
+
+	const SPackHeader *pHeader = (const SPackHeader*)m_pData;
+	if (pHeader->dwMagic != PACK_MAGIC || pHeader->dwVersion != PACK_VERSION || pHeader->dwFileSize != m_Size)
+		return false;
+
+	DWORD dwBuckets = pHeader->dwBucketCount;
+	if (dwBuckets == 0 || (dwBuckets & (dwBuckets - 1)) != 0 || dwBuckets <= pHeader->dwEntryCount ||
+		(pHeader->dwEntriesOffset | pHeader->dwBucketsOffset) % 4 != 0 ||
+		!InRange(pHeader->dwEntriesOffset, (unsigned long long)pHeader->dwEntryCount * sizeof(SPackEntry), m_Size) ||
+		!InRange(pHeader->dwBucketsOffset, (unsigned long long)dwBuckets * sizeof(DWORD), m_Size))
+		return false;
+
+	m_pEntries = (const SPackEntry*)(m_pData + pHeader->dwEntriesOffset);
+	m_pBuckets = (const DWORD*)(m_pData + pHeader->dwBucketsOffset);
+
+	for (DWORD b = 0; b < dwBuckets; b++)
+	{
+		if (m_pBuckets[b] != PACK_EMPTY_BUCKET && m_pBuckets[b] >= pHeader->dwEntryCount)
+			return false;
+	}
+
+	for (DWORD i = 0; i < pHeader->dwEntryCount; i++)
+	{
+		const SPackEntry &entry = m_pEntries[i];
+
+		if (entry.lWidth <= 0 || entry.lHeight <= 0 || entry.lWidth > PACK_MAX_DIMENSION ||
+			entry.lHeight > PACK_MAX_DIMENSION || entry.dwFormat > COMPACT_INDEXED8 || entry.dwPixelsOffset % 4 != 0)
+			return false;
+
+		size_t pixelBytes = CCompactImage::GetPixelBytes((ECompactFormat)entry.dwFormat, entry.lWidth, entry.lHeight);
+		if (!InRange(entry.dwPixelsOffset, pixelBytes, m_Size))
+			return false;
+
+		// Indices are bytes, every one of them has a palette entry
+		if (entry.dwFormat == COMPACT_INDEXED8 &&
+			(entry.dwPaletteOffset % 4 != 0 || !InRange(entry.dwPaletteOffset, COMPACT_PALETTE_SIZE * sizeof(RGBQUAD), m_Size)))
+			return false;
+
+		if ((entry.dwFlags & PACK_HAS_MASK) &&
+			(entry.dwMaskOffset % 4 != 0 || !InRange(entry.dwMaskOffset, (unsigned long long)GetMaskStride(entry.lWidth) * entry.lHeight, m_Size)))
+			return false;
+
+		if (entry.dwNameOffset < pHeader->dwNamesOffset || entry.dwNameOffset >= m_Size ||
+			!memchr(m_pData + entry.dwNameOffset, 0, m_Size - entry.dwNameOffset))
+			return false;
+	}
+
+	m_pHeader = pHeader;
+	return true;
+}
+
+DWORD CAssetPack::GetEntryCount() const
+{
+	return m_pHeader ? m_pHeader->dwEntryCount : 0;
+}
+
+const SPackEntry* CAssetPack::GetEntry( DWORD dwIndex ) const
+{
+	return dwIndex < GetEntryCount() ? &m_pEntries[dwIndex] : NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Name : HashName () (Static)
+// Desc : FNV-1a of the normalized name.
+//-----------------------------------------------------------------------------
+DWORD CAssetPack::HashName( const char *szName )
+{
+	DWORD dwHash = 2166136261u;
+	for (; *szName; szName++)
+	{
+		dwHash ^= (BYTE)NormalizeChar(*szName);
+		dwHash *= 16777619u;
+	}
+	return dwHash;
+}
+
+const SPackEntry* CAssetPack::Find( const char *szName ) const
+{
+	if (!m_pHeader || !szName)
+		return NULL;
+
+	DWORD dwHash = HashName(szName);
+	DWORD dwMask = m_pHeader->dwBucketCount - 1;
+
+	// There is always an empty bucket, so the probe ends
+	for (DWORD b = dwHash & dwMask; m_pBuckets[b] != PACK_EMPTY_BUCKET; b = (b + 1) & dwMask)
+	{
+		const SPackEntry &entry = m_pEntries[m_pBuckets[b]];
+		if (entry.dwNameHash == dwHash && SameName(GetName(entry), szName))
+			return &entry;
+	}
+	return NULL;
+}
+
+const char* CAssetPack::GetName( const SPackEntry &entry ) const
+{
+	return (const char*)(m_pData + entry.dwNameOffset);
+}
+
+const BYTE* CAssetPack::GetPixels( const SPackEntry &entry ) const
+{
+	return m_pData + entry.dwPixelsOffset;
+}
+
+const RGBQUAD* CAssetPack::GetPalette( const SPackEntry &entry ) const
+{
+	return entry.dwFormat == COMPACT_INDEXED8 ? (const RGBQUAD*)(m_pData + entry.dwPaletteOffset) : NULL;
+}
+
+const BYTE* CAssetPack::GetMask( const SPackEntry &entry ) const
+{
+	return (entry.dwFlags & PACK_HAS_MASK) ? m_pData + entry.dwMaskOffset : NULL;
+}
+
+void CAssetPack::Expand( const SPackEntry &entry, const RECT &rc, RGBQUAD *pDst, size_t dstStride ) const
+{
+	CCompactImage::Expand((ECompactFormat)entry.dwFormat, GetPixels(entry), entry.lWidth, GetPalette(entry),
+		rc, pDst, dstStride);
+}
+
+//-----------------------------------------------------------------------------
+// CAssetPackWriter Member Functions
+//-----------------------------------------------------------------------------
+bool CAssetPackWriter::Add( const char *szName, const CImageFile &image, DWORD dwColorKey,
+	const CImageFile *pMask, DWORD dwFrameCount, const RECT *pFrame )
+{
+	LONG w = image.Width(), h = image.Height();
+	if (!image.Pixels() || w <= 0 || h <= 0 || w > PACK_MAX_DIMENSION || h > PACK_MAX_DIMENSION)
+		return false;
+	if (pMask && (pMask->Width() != w || pMask->Height() != h || !pMask->Pixels()))
+		return false;
+
+	for (size_t i = 0; i < m_Entries.size(); i++)
+	{
+		if (SameName(m_Entries[i].strName.c_str(), szName))
+			return false;
+	}
+
+	SPending pending;
+	pending.strName = szName;
+	memset(&pending.entry, 0, sizeof(pending.entry));
+	pending.entry.dwNameHash = CAssetPack::HashName(szName);
+	pending.entry.lWidth = w;
+	pending.entry.lHeight = h;
+	pending.entry.dwColorKey = pMask ? PACK_NO_COLOR_KEY : dwColorKey;
+	pending.entry.dwFrameCount = dwFrameCount > 0 ? dwFrameCount : 1;
+	if (pFrame)
+		pending.entry.rcFrame = *pFrame;
+	else
+	{
+		pending.entry.rcFrame.right = w;
+		pending.entry.rcFrame.bottom = h;
+	}
+
+	const RGBQUAD *pSrc = image.Pixels();
+	std::vector<RGBQUAD> pixels(pSrc, pSrc + (size_t)w * h);
+
+	if (pMask || dwColorKey != PACK_NO_COLOR_KEY)
+	{
+		BYTE keyRed = BYTE(dwColorKey & 0xff), keyGreen = BYTE((dwColorKey >> 8) & 0xff), keyBlue = BYTE((dwColorKey >> 16) & 0xff);
+		DWORD dwStride = CAssetPack::GetMaskStride(w);
+
+		pending.entry.dwFlags |= PACK_HAS_MASK;
+		pending.mask.assign((size_t)dwStride * h, 0);
+
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			RGBQUAD &pixel = pixels[i];
+			bool bClear;
+			if (pMask)
+			{
+				const RGBQUAD &m = pMask->Pixels()[i];
+				bClear = m.rgbRed * 77 + m.rgbGreen * 150 + m.rgbBlue * 29 >= 128 * 256;
+			}
+			else
+			{
+				bClear = pixel.rgbRed == keyRed && pixel.rgbGreen == keyGreen && pixel.rgbBlue == keyBlue;
+				if (bClear)
+					pixel.rgbRed = pixel.rgbGreen = pixel.rgbBlue = 0;
+			}
+
+			// 1 bit DIBs keep the leftmost pixel in the high bit
+			if (bClear)
+			{
+				size_t x = i % w, y = i / w;
+				pending.mask[y * dwStride + x / 8] |= BYTE(0x80 >> (x % 8));
+			}
+		}
+	}
+
+	// Reserved bytes are dropped, keyed pixels are black by now
+	ECompactFormat format = CCompactImage::ChooseFormat(&pixels[0], pixels.size());
+	if (!pending.pixels.Compress(&pixels[0], w, h, format))
+		return false;
+	pending.entry.dwFormat = format;
+
+	m_Entries.push_back(pending);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : AddManifest ()
+//-----------------------------------------------------------------------------
+bool CAssetPackWriter::AddManifest( const char *szManifest, const char *szPrefix )
+{
+	std::ifstream file(szManifest);
+	if (!file)
+	{
+		fprintf(stderr, "AssetPack: cannot open %s\n", szManifest);
+		return false;
+	}
+
+	std::string strDir = szManifest;
+	size_t slash = strDir.find_last_of("/\\");
+	strDir = slash == std::string::npos ? std::string() : strDir.substr(0, slash + 1);
+
+	std::string strLine;
+	for (int iLine = 1; std::getline(file, strLine); iLine++)
+	{
+		size_t hash = strLine.find('#');
+		if (hash != std::string::npos)
+			strLine.erase(hash);
+
+		std::istringstream tokens(strLine);
+		std::string strFile, strToken, strMask;
+		if (!(tokens >> strFile))
+			continue;
+
+		DWORD dwKey = PACK_NO_COLOR_KEY, dwFrames = 1;
+		RECT rcFrame, *pFrame = NULL;
+		bool bOk = true;
+
+		while (bOk && tokens >> strToken)
+		{
+			size_t eq = strToken.find('=');
+			std::string strKey = strToken.substr(0, eq);
+			std::string strValue = eq == std::string::npos ? std::string() : strToken.substr(eq + 1);
+
+			if (strKey == "key" && strValue.size() == 6)
+			{
+				// Written RRGGBB, kept as a COLORREF
+				DWORD dwRGB = (DWORD)strtoul(strValue.c_str(), NULL, 16);
+				dwKey = ((dwRGB >> 16) & 0xff) | (dwRGB & 0xff00) | ((dwRGB & 0xff) << 16);
+			}
+			else if (strKey == "mask")		strMask = strValue;
+			else if (strKey == "frames")	dwFrames = (DWORD)atoi(strValue.c_str());
+			else if (strKey == "frame")
+			{
+				int l, t, r, b;
+				bOk = sscanf(strValue.c_str(), "%d,%d,%d,%d", &l, &t, &r, &b) == 4;
+				rcFrame.left = l;
+				rcFrame.top = t;
+				rcFrame.right = r;
+				rcFrame.bottom = b;
+				pFrame = &rcFrame;
+			}
+			else
+				bOk = false;
+		}
+
+		CImageFile image, mask;
+		if (!bOk || !image.LoadFromFile((strDir + strFile).c_str()) ||
+			(!strMask.empty() && !mask.LoadFromFile((strDir + strMask).c_str())) ||
+			!Add((std::string(szPrefix) + strFile).c_str(), image, dwKey, strMask.empty() ? NULL : &mask, dwFrames, pFrame))
+		{
+			fprintf(stderr, "AssetPack: %s(%d): cannot add %s\n", szManifest, iLine, strFile.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Write ()
+// Desc : Index first so opening the pack only touches its first pages.
+//-----------------------------------------------------------------------------
+void CAssetPackWriter::Write( std::vector<BYTE> &data ) const
+{
+	DWORD dwCount = (DWORD)m_Entries.size();
+	DWORD dwBuckets = 2;
+	while (dwBuckets < dwCount * 2)
+		dwBuckets *= 2;
+
+	SPackHeader header;
+	header.dwMagic = PACK_MAGIC;
+	header.dwVersion = PACK_VERSION;
+	header.dwEntryCount = dwCount;
+	header.dwBucketCount = dwBuckets;
+	header.dwEntriesOffset = sizeof(SPackHeader);
+	header.dwBucketsOffset = header.dwEntriesOffset + dwCount * sizeof(SPackEntry);
+	header.dwNamesOffset = header.dwBucketsOffset + dwBuckets * sizeof(DWORD);
+
+	std::vector<SPackEntry> entries(dwCount);
+	std::vector<DWORD> buckets(dwBuckets, PACK_EMPTY_BUCKET);
+
+	DWORD dwOffset = header.dwNamesOffset;
+	for (DWORD i = 0; i < dwCount; i++)
+	{
+		entries[i] = m_Entries[i].entry;
+		entries[i].dwNameOffset = dwOffset;
+		dwOffset += (DWORD)m_Entries[i].strName.size() + 1;
+
+		DWORD b = entries[i].dwNameHash & (dwBuckets - 1);
+		while (buckets[b] != PACK_EMPTY_BUCKET)
+			b = (b + 1) & (dwBuckets - 1);
+		buckets[b] = i;
+	}
+
+	for (DWORD i = 0; i < dwCount; i++)
+	{
+		const CCompactImage &pixels = m_Entries[i].pixels;
+		dwOffset = AlignUp(dwOffset);
+		entries[i].dwPixelsOffset = dwOffset;
+		dwOffset += (DWORD)CCompactImage::GetPixelBytes(pixels.Format(), pixels.Width(), pixels.Height());
+
+		if (pixels.Palette())
+		{
+			dwOffset = AlignUp(dwOffset);
+			entries[i].dwPaletteOffset = dwOffset;
+			dwOffset += COMPACT_PALETTE_SIZE * sizeof(RGBQUAD);
+		}
+
+		if (!m_Entries[i].mask.empty())
+		{
+			dwOffset = AlignUp(dwOffset);
+			entries[i].dwMaskOffset = dwOffset;
+			dwOffset += (DWORD)m_Entries[i].mask.size();
+		}
+	}
+	header.dwFileSize = dwOffset;
+
+	data.assign(dwOffset, 0);
+	memcpy(&data[0], &header, sizeof(header));
+	if (dwCount > 0)
+		memcpy(&data[header.dwEntriesOffset], &entries[0], dwCount * sizeof(SPackEntry));
+	memcpy(&data[header.dwBucketsOffset], &buckets[0], dwBuckets * sizeof(DWORD));
+
+	for (DWORD i = 0; i < dwCount; i++)
+	{
+		const SPending &pending = m_Entries[i];
+		memcpy(&data[entries[i].dwNameOffset], pending.strName.c_str(), pending.strName.size() + 1);
+		const CCompactImage &pixels = pending.pixels;
+		memcpy(&data[entries[i].dwPixelsOffset], pixels.Data(),
+			CCompactImage::GetPixelBytes(pixels.Format(), pixels.Width(), pixels.Height()));
+		if (pixels.Palette())
+			memcpy(&data[entries[i].dwPaletteOffset], pixels.Palette(), COMPACT_PALETTE_SIZE * sizeof(RGBQUAD));
+		if (!pending.mask.empty())
+			memcpy(&data[entries[i].dwMaskOffset], &pending.mask[0], pending.mask.size());
+	}
+}
+
+size_t CAssetPackWriter::GetPixelBytes() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < m_Entries.size(); i++)
+		bytes += m_Entries[i].pixels.GetBytes();
+	return bytes;
+}
+
+size_t CAssetPackWriter::GetRgb32Bytes() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < m_Entries.size(); i++)
+		bytes += CCompactImage::GetPixelBytes(COMPACT_RGB32, m_Entries[i].entry.lWidth, m_Entries[i].entry.lHeight);
+	return bytes;
+}
@@ -2,6 +2,8 @@
 // By Frank Luna
 // August 24, 2004.
 #include "BackBuffer.h"
+#include "Profiler.h"
+#include <string.h>
 
 
 BackBuffer::BackBuffer(HWND hWnd, int width, int height)
@@ -17,6 +19,12 @@ BackBuffer::BackBuffer(HWND hWnd, int width, int height)
 	mWidth = width;
 	mHeight = height;
 
+	// No capture surface until a frame is copied.
+	mhCaptureDC = 0;
+	mhCaptureSurface = 0;
+	mhCaptureOldObject = 0;
+	mpCapturePixels = 0;
+
 	// Create system memory device context that is compatible
 	// with the window one.
 	mhDC = CreateCompatibleDC(hWndDC);
@@ -54,6 +62,13 @@ void BackBuffer::reset()
 
 BackBuffer::~BackBuffer()
 {
+	if( mhCaptureDC )
+	{
+		SelectObject(mhCaptureDC, mhCaptureOldObject);
+		DeleteObject(mhCaptureSurface);
+		DeleteDC(mhCaptureDC);
+	}
+
 	SelectObject(mhDC, mhOldObject);
 	DeleteObject(mhSurface);
 	DeleteDC(mhDC);
@@ -61,6 +76,8 @@ BackBuffer::~BackBuffer()
 
 void BackBuffer::present()
 {
+	PROFILE_SCOPE("BackBuffer::present");
+
 	// Get a handle to the device context associated with
 	// the window.
 	HDC hWndDC = GetDC(mhWnd);
@@ -71,4 +88,41 @@ void BackBuffer::present()
 
 	// Always free window DC when done.
 	ReleaseDC(mhWnd, hWndDC);
-}
\ No newline at end of file
+}
+
+bool BackBuffer::copyPixels(RGBQUAD* pDst)
+{
+	PROFILE_SCOPE("BackBuffer::copyPixels");
+
+	// The surface is a device dependent bitmap that stays selected into
+	// mhDC, so GetDIBits cannot read it. It is blitted into a top-down
+	// 32 bit DIB section instead, whose bits are plain memory.
+	if( !mhCaptureDC )
+	{
+		BITMAPINFO info;
+		ZeroMemory(&info, sizeof(info));
+		info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		info.bmiHeader.biWidth = mWidth;
+		info.bmiHeader.biHeight = -mHeight;
+		info.bmiHeader.biPlanes = 1;
+		info.bmiHeader.biBitCount = 32;
+		info.bmiHeader.biCompression = BI_RGB;
+
+		void* pBits = 0;
+		mhCaptureSurface = CreateDIBSection(mhDC, &info, DIB_RGB_COLORS, &pBits, 0, 0);
+		if( !mhCaptureSurface )
+			return false;
+
+		mhCaptureDC = CreateCompatibleDC(mhDC);
+		mhCaptureOldObject = (HBITMAP)SelectObject(mhCaptureDC, mhCaptureSurface);
+		mpCapturePixels = (RGBQUAD*)pBits;
+	}
+
+	if( !BitBlt(mhCaptureDC, 0, 0, mWidth, mHeight, mhDC, 0, 0, SRCCOPY) )
+		return false;
+
+	// GDI may still be writing the bits.
+	GdiFlush();
+	memcpy(pDst, mpCapturePixels, (size_t)mWidth * mHeight * sizeof(RGBQUAD));
+	return true;
+}
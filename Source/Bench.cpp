@@ -0,0 +1,1571 @@
+//-----------------------------------------------------------------------------
+// File: Bench.cpp
+//
+// Desc: Scenario benchmark suite. Runs every scenario of a suite file through
+//	the headless simulation (or the image resampler), reports per phase
+//	timings and allocation counts and compares them with a baseline.
+//
+//	Usage: Bench --suite Bench/suite.txt [--baseline Bench/baseline.json]
+//		[--only name] [--out results.json] [--update-baseline [--replace]]
+//		[--time-threshold 0.25] [--alloc-threshold 0]
+//
+//	Every timed phase reports its mean, median and 95th percentile, only
+//	the median is compared with the baseline. A scenario that regressed
+//	runs again, twice at most, and keeps its fastest timings.
+//	--update-baseline runs every scenario three times and records the middle
+//	timings. It adds the scenarios the baseline does not have yet and keeps
+//	the recorded ones, unless --only names one or --replace is given.
+//
+//	Suite lines are "<name> key=value ...". Simulation keys: seed, frames,
+//	enemies, bullets, screen=WxH, state=START|ONGOING|PAUSE and
+//	input=none|bot|script:<file> (relative to the suite file). A line with
+//	kind=resample times CResizableImage::Resample instead, with keys
+//	src=WxH, dst=WxH, filter=box|bilinear|bicubic|bspline|lanczos3,
+//	simd=scalar|sse41|avx2 (capped to what the CPU supports), threads (0 for
+//	every hardware thread), vertical=strips|columns|transpose, repeat and
+//	seed. linear=1 filters in linear light, fastpath=0 sends box filter
+//	integer ratios through the weights tables, stream=1 runs CStreamResizer
+//	instead and also reports its row buffer size. mip=box|lanczos resamples
+//	from the nearest mip level instead of the source, building the levels
+//	is timed apart (MipBuild). ref=<scenario> prints the speedup over an
+//	earlier scenario.
+//
+//	kind=decode times CBmpDecoder on a BMP built in memory from src=WxH
+//	noise, with bpp=8|24|32, topdown=1, simd, repeat and seed.
+//
+//	kind=channels times CImageFile::CopyMonoImage of a src=WxH noise image
+//	into a buffer allocated once, with channel=red|hue|saturation|luminosity,
+//	simd, repeat and seed. channel=hsl splits all three HSL planes with
+//	CPlanarImage instead.
+//
+//	kind=convolve times CConvolver on a src=WxH noise image with
+//	kernel=gaussian|box|sharpen, sigma (Gaussian, radius for box), plane=1
+//	for the luminosity plane instead of the pixels, simd, threads, repeat
+//	and seed.
+//
+//	kind=pipeline times an effect on a src=WxH noise image: the gray of
+//	channel, a kernel/sigma convolution of it, a contrast LUT, pasted into
+//	the red channel of the image and resampled to dst with filter.
+//	resample=0 leaves the resample out, timing the fusion on its own. fused=1
+//	(the default) runs it as one CImagePipeline, fused=0 step by step
+//	through CopyMonoImage, CConvolver::ApplyPlane, PasteMonoImage and
+//	ResampleFrom. Both give the same pixels, checked before timing. simd,
+//	threads, repeat and seed as above.
+//
+//	kind=tone times CImageTone on a src=WxH noise image with
+//	op=histogram|lut|equalize|levels and channel=red|hue|saturation|
+//	luminosity, or channel=rgb for red, green and blue in one pass. lut
+//	applies an inverting curve. simd, repeat and seed as above.
+//
+//	kind=compact times widening a src=WxH CCompactImage back to 32 bits in
+//	the bands CCompactImage::Paint blits, with format=rgb32|rgb565|indexed.
+//	The noise is made to fit the format exactly (200 colors for indexed), so
+//	ChooseFormat picks it and the round trip is checked before timing. Also
+//	reports resident_bytes. simd, repeat and seed as above.
+//
+//	kind=capture times handing repeat src=WxH noise frames to a Y4M
+//	CFrameCapture writing to the null device, with policy=drop|block,
+//	buffers and interval (microseconds from one frame to the next like a
+//	game's frame time, 0 submits them back to back). Capture is the game thread's side (copy, plus the wait under
+//	block), Writer the encoding and writing each frame costs the writer
+//	thread. Drops depend on the scheduler, they are printed, not compared.
+//
+//	The exit code is 1 when a metric regressed past its threshold.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Bench Specific Includes
+//-----------------------------------------------------------------------------
+#include "SimRunner.h"
+#include "ResizeEngine.h"
+#include "StreamResizer.h"
+#include "BmpDecoder.h"
+#include "PlanarImage.h"
+#include "Convolution.h"
+#include "ImagePipeline.h"
+#include "ImageTone.h"
+#include "CompactImage.h"
+#include "FrameCapture.h"
+#include "Profiler.h"
+#include "Counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const double BENCH_TIME_THRESHOLD	= 0.25;	// Allowed relative slowdown of a timing
+const double BENCH_ALLOC_THRESHOLD	= 0.0;	// Allowed relative growth of an allocation count
+const double BENCH_TIME_FLOOR_US	= 5.0;	// Timing changes below this are noise
+const double BENCH_RESOLUTION		= 1e-3;	// Metrics are written with three decimals
+const int BENCH_RETRIES				= 2;	// Runs again of a scenario that regressed, before it counts
+const int BENCH_RETRY_PAUSE_MS		= 1000;	// Lets whatever slowed the machine down pass first
+
+namespace
+{
+	typedef std::map<std::string, double>	MetricMap;		// "Animate.mean_us" -> value
+	typedef std::map<std::string, MetricMap> ScenarioMap;	// scenario name -> metrics
+
+	//-------------------------------------------------------------------------
+	// Name : SScenario (Struct)
+	// Desc : One line of the suite file.
+	//-------------------------------------------------------------------------
+	enum EScenarioKind
+	{
+		KIND_SIMULATION,
+		KIND_RESAMPLE,
+		KIND_DECODE,
+		KIND_CHANNELS,
+		KIND_CONVOLVE,
+		KIND_PIPELINE,
+		KIND_TONE,
+		KIND_COMPACT,
+		KIND_CAPTURE
+	};
+
+	struct SScenario
+	{
+		std::string				strName;
+		EScenarioKind			kind;
+		CSimRunner::SOptions	sim;
+
+		// Resample scenarios
+		int						srcWidth, srcHeight;
+		int						dstWidth, dstHeight;
+		std::string				strFilter;
+		ESimdLevel				simd;
+		unsigned int			uThreads;
+		EVerticalMode			vertical;
+		bool					bStream;
+		bool					bLinear;
+		bool					bFastPaths;
+		std::string				strMip;			// Mip filter, empty resamples the source
+		int						iBitCount;		// Decode scenarios
+		bool					bTopDown;
+		std::string				strChannel;		// Channel scenarios
+		std::string				strKernel;		// Convolution scenarios
+		double					dSigma;
+		bool					bPlane;
+		bool					bFused;			// Pipeline scenarios
+		bool					bResample;
+		std::string				strOp;			// Tone scenarios
+		ECompactFormat			format;			// Compact scenarios
+		CFrameCapture::POLICY	policy;			// Capture scenarios
+		unsigned int			uBuffers;
+		unsigned int			uInterval;
+		int						iRepeat;
+		std::string				strRef;			// Scenario the speedup is reported against
+
+		SScenario() : kind(KIND_SIMULATION), srcWidth(1280), srcHeight(720), dstWidth(1920), dstHeight(1080),
+			strFilter("bicubic"), simd(SIMD_AVX2), uThreads(0), vertical(VERTICAL_STRIPS), bStream(false), bLinear(false),
+			bFastPaths(true), iBitCount(24), bTopDown(false), strChannel("hue"), strKernel("gaussian"), dSigma(2.0),
+			bPlane(false), bFused(true), bResample(true), strOp("histogram"), format(COMPACT_RGB565),
+			policy(CFrameCapture::CAPTURE_DROP), uBuffers(CAPTURE_DEFAULT_BUFFERS), uInterval(0),
+			iRepeat(5) {}
+	};
+
+	struct SThresholds
+	{
+		double	dTime;
+		double	dAlloc;
+		double	dTimeFloorUs;
+
+		SThresholds() : dTime(BENCH_TIME_THRESHOLD), dAlloc(BENCH_ALLOC_THRESHOLD), dTimeFloorUs(BENCH_TIME_FLOOR_US) {}
+	};
+
+	//-------------------------------------------------------------------------
+	// Name : CJsonReader (Class)
+	// Desc : Just enough JSON to read back the files this tool writes:
+	//		objects, numbers and strings. Arrays and literals are skipped.
+	//-------------------------------------------------------------------------
+	class CJsonReader
+	{
+	public:
+		CJsonReader(const std::string &strText) : m_strText(strText), m_nPos(0) {}
+
+		// Reads {"thresholds":{...}, "scenarios":{"name":{"metric":n}}}
+		bool ReadBaseline(ScenarioMap &scenarios, SThresholds &thr)
+		{
+			if (!Expect('{'))
+				return false;
+
+			while (!Peek('}'))
+			{
+				std::string strKey;
+				if (!ReadString(strKey) || !Expect(':'))
+					return false;
+
+				if (strKey == "scenarios")
+				{
+					if (!Expect('{'))
+						return false;
+					while (!Peek('}'))
+					{
+						std::string strName;
+						if (!ReadString(strName) || !Expect(':') || !ReadNumbers(scenarios[strName]))
+							return false;
+						Peek(',') && Expect(',');
+					}
+					Expect('}');
+				}
+				else if (strKey == "thresholds")
+				{
+					MetricMap values;
+					if (!ReadNumbers(values))
+						return false;
+					if (values.count("time"))			thr.dTime = values["time"];
+					if (values.count("allocations"))	thr.dAlloc = values["allocations"];
+					if (values.count("time_floor_us"))	thr.dTimeFloorUs = values["time_floor_us"];
+				}
+				else if (!SkipValue())
+					return false;
+
+				Peek(',') && Expect(',');
+			}
+
+			return Expect('}');
+		}
+
+	private:
+		void SkipSpace()
+		{
+			while (m_nPos < m_strText.size() && isspace((unsigned char)m_strText[m_nPos]))
+				m_nPos++;
+		}
+
+		bool Peek(char c)
+		{
+			SkipSpace();
+			return m_nPos < m_strText.size() && m_strText[m_nPos] == c;
+		}
+
+		bool Expect(char c)
+		{
+			if (!Peek(c))
+				return false;
+			m_nPos++;
+			return true;
+		}
+
+		bool ReadString(std::string &str)
+		{
+			if (!Expect('"'))
+				return false;
+
+			str.clear();
+			while (m_nPos < m_strText.size() && m_strText[m_nPos] != '"')
+			{
+				if (m_strText[m_nPos] == '\\' && m_nPos + 1 < m_strText.size())
+					m_nPos++;
+				str += m_strText[m_nPos++];
+			}
+			return Expect('"');
+		}
+
+		bool ReadNumber(double &d)
+		{
+			SkipSpace();
+			const char *szStart = m_strText.c_str() + m_nPos;
+			char *szEnd;
+			d = strtod(szStart, &szEnd);
+			if (szEnd == szStart)
+				return false;
+			m_nPos += szEnd - szStart;
+			return true;
+		}
+
+		// Flat object of numbers, other values are ignored
+		bool ReadNumbers(MetricMap &values)
+		{
+			if (!Expect('{'))
+				return false;
+
+			while (!Peek('}'))
+			{
+				std::string strKey;
+				double d;
+				if (!ReadString(strKey) || !Expect(':'))
+					return false;
+				if (Peek('"') || Peek('{') || Peek('['))
+				{
+					if (!SkipValue())
+						return false;
+				}
+				else if (ReadNumber(d))
+					values[strKey] = d;
+				else if (!SkipValue())
+					return false;
+
+				Peek(',') && Expect(',');
+			}
+
+			return Expect('}');
+		}
+
+		bool SkipValue()
+		{
+			std::string str;
+			double d;
+
+			if (Peek('"'))
+				return ReadString(str);
+
+			if (Peek('{') || Peek('['))
+			{
+				int iDepth = 0;
+				do
+				{
+					if (Peek('"')) { ReadString(str); continue; }
+					char c = m_strText[m_nPos++];
+					if (c == '{' || c == '[') iDepth++;
+					if (c == '}' || c == ']') iDepth--;
+				} while (iDepth > 0 && m_nPos < m_strText.size());
+				return iDepth == 0;
+			}
+
+			if (ReadNumber(d))
+				return true;
+
+			// true, false, null
+			SkipSpace();
+			while (m_nPos < m_strText.size() && isalpha((unsigned char)m_strText[m_nPos]))
+				m_nPos++;
+			return true;
+		}
+
+		const std::string	&m_strText;
+		size_t				m_nPos;
+	};
+
+	bool ReadFile(const char *szFileName, std::string &strText)
+	{
+		std::ifstream in(szFileName, std::ios::binary);
+		if (!in)
+			return false;
+
+		std::ostringstream ss;
+		ss << in.rdbuf();
+		strText = ss.str();
+		return true;
+	}
+
+	std::string DirectoryOf(const std::string &strPath)
+	{
+		size_t n = strPath.find_last_of("/\\");
+		return n == std::string::npos ? std::string() : strPath.substr(0, n + 1);
+	}
+
+	bool ParseSize(const std::string &str, int &w, int &h)
+	{
+		return sscanf(str.c_str(), "%dx%d", &w, &h) == 2 && w > 0 && h > 0;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : LoadSuite ()
+	// Desc : Reads the scenarios of a suite file.
+	//-------------------------------------------------------------------------
+	bool LoadSuite(const char *szFileName, std::vector<SScenario> &suite)
+	{
+		std::ifstream in(szFileName);
+		if (!in)
+		{
+			fprintf(stderr, "Bench: cannot read suite %s\n", szFileName);
+			return false;
+		}
+
+		std::string strDir = DirectoryOf(szFileName);
+		std::string strLine;
+		int iLine = 0;
+
+		while (std::getline(in, strLine))
+		{
+			iLine++;
+			std::istringstream line(strLine);
+			SScenario sc;
+
+			if (!(line >> sc.strName) || sc.strName[0] == '#')
+				continue;
+
+			std::string strPair;
+			while (line >> strPair)
+			{
+				size_t eq = strPair.find('=');
+				std::string strKey = strPair.substr(0, eq);
+				std::string strValue = eq == std::string::npos ? std::string() : strPair.substr(eq + 1);
+				bool bOk = true;
+
+				if (strKey == "kind")
+				{
+					if (strValue == "resample")		sc.kind = KIND_RESAMPLE;
+					else if (strValue == "decode")	sc.kind = KIND_DECODE;
+					else if (strValue == "channels")	sc.kind = KIND_CHANNELS;
+					else if (strValue == "convolve")	sc.kind = KIND_CONVOLVE;
+					else if (strValue == "pipeline")	sc.kind = KIND_PIPELINE;
+					else if (strValue == "tone")		sc.kind = KIND_TONE;
+					else if (strValue == "compact")	sc.kind = KIND_COMPACT;
+					else if (strValue == "capture")	sc.kind = KIND_CAPTURE;
+					else bOk = false;
+				}
+				else if (strKey == "seed")		sc.sim.uSeed = (unsigned int)strtoul(strValue.c_str(), NULL, 10);
+				else if (strKey == "frames")	sc.sim.ulFrames = strtoul(strValue.c_str(), NULL, 10);
+				else if (strKey == "enemies")	sc.sim.iEnemies = atoi(strValue.c_str());
+				else if (strKey == "bullets")	sc.sim.iBullets = atoi(strValue.c_str());
+				else if (strKey == "threads")	sc.uThreads = (unsigned int)strtoul(strValue.c_str(), NULL, 10);
+				else if (strKey == "repeat")	sc.iRepeat = atoi(strValue.c_str());
+				else if (strKey == "filter")	sc.strFilter = strValue;
+				else if (strKey == "mip")
+				{
+					sc.strMip = strValue;
+					bOk = strValue == "box" || strValue == "lanczos";
+				}
+				else if (strKey == "simd")
+				{
+					if (strValue == "scalar")		sc.simd = SIMD_SCALAR;
+					else if (strValue == "sse41")	sc.simd = SIMD_SSE41;
+					else if (strValue == "avx2")	sc.simd = SIMD_AVX2;
+					else bOk = false;
+				}
+				else if (strKey == "vertical")
+				{
+					if (strValue == "strips")			sc.vertical = VERTICAL_STRIPS;
+					else if (strValue == "columns")		sc.vertical = VERTICAL_COLUMNS;
+					else if (strValue == "transpose")	sc.vertical = VERTICAL_TRANSPOSE;
+					else bOk = false;
+				}
+				else if (strKey == "ref")		sc.strRef = strValue;
+				else if (strKey == "stream")	sc.bStream = strValue == "1";
+				else if (strKey == "linear")	sc.bLinear = strValue == "1";
+				else if (strKey == "fastpath")	sc.bFastPaths = strValue != "0";
+				else if (strKey == "topdown")	sc.bTopDown = strValue == "1";
+				else if (strKey == "kernel")
+				{
+					sc.strKernel = strValue;
+					bOk = strValue == "gaussian" || strValue == "box" || strValue == "sharpen";
+				}
+				else if (strKey == "sigma")		sc.dSigma = atof(strValue.c_str());
+				else if (strKey == "plane")		sc.bPlane = strValue == "1";
+				else if (strKey == "fused")		sc.bFused = strValue != "0";
+				else if (strKey == "resample")	sc.bResample = strValue != "0";
+				else if (strKey == "op")
+				{
+					sc.strOp = strValue;
+					bOk = strValue == "histogram" || strValue == "lut" || strValue == "equalize" || strValue == "levels";
+				}
+				else if (strKey == "format")
+				{
+					if (strValue == "rgb32")			sc.format = COMPACT_RGB32;
+					else if (strValue == "rgb565")		sc.format = COMPACT_RGB565;
+					else if (strValue == "indexed")		sc.format = COMPACT_INDEXED8;
+					else bOk = false;
+				}
+				else if (strKey == "policy")
+				{
+					if (strValue == "drop")			sc.policy = CFrameCapture::CAPTURE_DROP;
+					else if (strValue == "block")	sc.policy = CFrameCapture::CAPTURE_BLOCK;
+					else bOk = false;
+				}
+				else if (strKey == "buffers")
+				{
+					sc.uBuffers = (unsigned int)strtoul(strValue.c_str(), NULL, 10);
+					bOk = sc.uBuffers > 0;
+				}
+				else if (strKey == "interval")	sc.uInterval = (unsigned int)strtoul(strValue.c_str(), NULL, 10);
+				else if (strKey == "channel")
+				{
+					sc.strChannel = strValue;
+					bOk = strValue == "red" || strValue == "hue" || strValue == "saturation" ||
+						strValue == "luminosity" || strValue == "hsl" || strValue == "rgb";
+				}
+				else if (strKey == "bpp")
+				{
+					sc.iBitCount = atoi(strValue.c_str());
+					bOk = sc.iBitCount == 8 || sc.iBitCount == 24 || sc.iBitCount == 32;
+				}
+				else if (strKey == "src")		bOk = ParseSize(strValue, sc.srcWidth, sc.srcHeight);
+				else if (strKey == "dst")		bOk = ParseSize(strValue, sc.dstWidth, sc.dstHeight);
+				else if (strKey == "screen")
+				{
+					int w, h;
+					bOk = ParseSize(strValue, w, h);
+					sc.sim.screenSize = Vec2(w, h);
+				}
+				else if (strKey == "state")
+				{
+					if (strValue == "START")		sc.sim.startState = CGameWorld::START;
+					else if (strValue == "ONGOING")	sc.sim.startState = CGameWorld::ONGOING;
+					else if (strValue == "PAUSE")	sc.sim.startState = CGameWorld::PAUSE;
+					else bOk = false;
+				}
+				else if (strKey == "input")
+				{
+					if (strValue == "none")			sc.sim.input = CSimRunner::INPUT_NONE;
+					else if (strValue == "bot")		sc.sim.input = CSimRunner::INPUT_BOT;
+					else if (strValue.compare(0, 7, "script:") == 0)
+					{
+						sc.sim.input = CSimRunner::INPUT_SCRIPT;
+						bOk = CSimRunner::LoadScript((strDir + strValue.substr(7)).c_str(), sc.sim.script);
+					}
+					else bOk = false;
+				}
+				else bOk = false;
+
+				if (!bOk)
+				{
+					fprintf(stderr, "Bench: %s:%d: bad setting '%s'\n", szFileName, iLine, strPair.c_str());
+					return false;
+				}
+			}
+
+			suite.push_back(sc);
+		}
+
+		return true;
+	}
+
+	CGenericFilter* CreateFilter(const std::string &strName)
+	{
+		if (strName == "box")		return new CBoxFilter();
+		if (strName == "bilinear")	return new CBilinearFilter();
+		if (strName == "bicubic")	return new CBicubicFilter();
+		if (strName == "bspline")	return new CBSplineFilter();
+		if (strName == "lanczos3")	return new CLanczos3Filter();
+		return NULL;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : AddTimings ()
+	// Desc : Mean, median and 95th percentile of a phase in microseconds.
+	//        Only the median is held against the baseline, a single slow
+	//        repeat moves the other two too much.
+	//-------------------------------------------------------------------------
+	void AddTimings(MetricMap &metrics, const std::string &strPhase, const CSimRunner::SPhase &phase)
+	{
+		metrics[strPhase + ".mean_us"] = phase.Mean() / 1e3;
+		metrics[strPhase + ".median_us"] = phase.Median() / 1e3;
+		metrics[strPhase + ".p95_us"] = phase.Percentile(0.95) / 1e3;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunResample ()
+	// Desc : Times CResizableImage::Resample (or CStreamResizer) on a
+	//		generated image (smooth gradients plus noise, so every filter tap
+	//		matters).
+	//-------------------------------------------------------------------------
+	bool RunResample(const SScenario &sc, MetricMap &metrics)
+	{
+		std::unique_ptr<CGenericFilter> pFilter(CreateFilter(sc.strFilter));
+		if (!pFilter)
+		{
+			fprintf(stderr, "Bench: %s: unknown filter '%s'\n", sc.strName.c_str(), sc.strFilter.c_str());
+			return false;
+		}
+
+		SetSimdLevel(sc.simd);
+		CResizableImage::SetThreadCount(sc.uThreads);
+		CResizableImage::SetVerticalMode(sc.vertical);
+		CResizableImage::SetIntegerFastPaths(sc.bFastPaths);
+
+		// Start cold, the first repeat builds the weights tables and the
+		// others reuse them
+		CWeightsCache::Clear();
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Resample";
+		CSimRunner::SPhase mipPhase;
+		mipPhase.szName = "MipBuild";
+		long long llAllocations = 0;
+		size_t workingBytes = 0;
+		size_t mipBytes = 0;
+
+		auto MakeImage = [&](CResizableImage &img)
+		{
+			std::mt19937 random(sc.sim.uSeed);
+
+			img.Create(sc.srcWidth, sc.srcHeight);
+			RGBQUAD *pPixel = img.Pixels();
+			for (int y = 0; y < sc.srcHeight; y++)
+			{
+				for (int x = 0; x < sc.srcWidth; x++, pPixel++)
+				{
+					int noise = int(random() & 31);
+					pPixel->rgbRed		= BYTE((x * 255 / sc.srcWidth + noise) & 0xff);
+					pPixel->rgbGreen	= BYTE((y * 255 / sc.srcHeight + noise) & 0xff);
+					pPixel->rgbBlue		= BYTE(((x + y) * 3 + noise) & 0xff);
+					pPixel->rgbReserved	= 0;
+				}
+			}
+			img.SetFilter(pFilter.get());
+			img.SetLinearLight(sc.bLinear);
+		};
+
+		// Integer ratio fast paths must give the weights tables' pixels
+		if (sc.bFastPaths && sc.strFilter == "box" && !sc.bStream && sc.strMip.empty())
+		{
+			CResizableImage fast, general;
+			MakeImage(fast);
+			MakeImage(general);
+			fast.Resample(sc.dstWidth, sc.dstHeight);
+			CResizableImage::SetIntegerFastPaths(false);
+			general.Resample(sc.dstWidth, sc.dstHeight);
+			CResizableImage::SetIntegerFastPaths(true);
+
+			if (memcmp(fast.Pixels(), general.Pixels(), sizeof(RGBQUAD) * sc.dstWidth * sc.dstHeight))
+			{
+				fprintf(stderr, "Bench: %s: fast path and weights tables give different pixels\n", sc.strName.c_str());
+				SetSimdLevel(SIMD_AVX2);
+				CResizableImage::SetThreadCount(0);
+				CResizableImage::SetVerticalMode(VERTICAL_STRIPS);
+				return false;
+			}
+		}
+
+		for (int r = 0; r < sc.iRepeat; r++)
+		{
+			CResizableImage img;
+			MakeImage(img);
+
+			if (sc.bStream)
+			{
+				CImageFile out;
+				out.Create(sc.dstWidth, sc.dstHeight);
+				CImageRowProvider source(img);
+				CImageRowSink sink(out);
+				CStreamResizer resizer(pFilter.get());
+
+				long long llHeap = CCounters::GetHeapAllocations();
+				long long t0 = CProfiler::Now();
+				resizer.Resample(source, sc.dstWidth, sc.dstHeight, sink);
+				phase.samples.push_back(CProfiler::Now() - t0);
+				llAllocations += CCounters::GetHeapAllocations() - llHeap;
+				workingBytes = resizer.GetWorkingBytes();
+				continue;
+			}
+
+			if (!sc.strMip.empty())
+			{
+				img.SetMipFilter(sc.strMip == "lanczos" ? MIP_LANCZOS : MIP_BOX);
+
+				long long t0 = CProfiler::Now();
+				const CImageFile *pLevel = img.GetNearestMipLevel(sc.dstWidth, sc.dstHeight);
+				mipPhase.samples.push_back(CProfiler::Now() - t0);
+				mipBytes = img.GetMipBytes();
+
+				CResizableImage sprite;
+				long long llHeap = CCounters::GetHeapAllocations();
+				t0 = CProfiler::Now();
+				sprite.SetFilter(pFilter.get());
+				sprite.SetLinearLight(sc.bLinear);
+				sprite.ResampleFrom(*pLevel, sc.dstWidth, sc.dstHeight);
+				phase.samples.push_back(CProfiler::Now() - t0);
+				llAllocations += CCounters::GetHeapAllocations() - llHeap;
+				continue;
+			}
+
+			long long llHeap = CCounters::GetHeapAllocations();
+			long long t0 = CProfiler::Now();
+			img.Resample(sc.dstWidth, sc.dstHeight);
+			phase.samples.push_back(CProfiler::Now() - t0);
+			llAllocations += CCounters::GetHeapAllocations() - llHeap;
+		}
+
+		AddTimings(metrics, "Resample", phase);
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+		if (sc.bStream)
+			metrics["working_bytes"] = double(workingBytes);
+		if (!sc.strMip.empty())
+		{
+			metrics["MipBuild.mean_us"] = mipPhase.Mean() / 1e3;
+			metrics["mip_bytes"] = double(mipBytes);
+		}
+
+		SetSimdLevel(SIMD_AVX2);
+		CResizableImage::SetThreadCount(0);
+		CResizableImage::SetVerticalMode(VERTICAL_STRIPS);
+		CResizableImage::SetIntegerFastPaths(true);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : MakeBmp ()
+	// Desc : Uncompressed BMP file image of seeded noise, 8 bit files get a
+	//		gray ramp palette.
+	//-------------------------------------------------------------------------
+	std::vector<BYTE> MakeBmp(const SScenario &sc)
+	{
+		DWORD dwStride = ((DWORD)sc.srcWidth * sc.iBitCount + 31) / 32 * 4;
+		DWORD dwPalette = sc.iBitCount == 8 ? 256 * sizeof(RGBQUAD) : 0;
+		DWORD dwOffset = 14 + 40 + dwPalette;
+		std::vector<BYTE> file(dwOffset + dwStride * sc.srcHeight);
+		BYTE *p = &file[0];
+
+		auto put = [](BYTE *pAt, DWORD dwValue, int iBytes)
+		{
+			for (int i = 0; i < iBytes; i++, dwValue >>= 8)
+				pAt[i] = BYTE(dwValue & 0xff);
+		};
+
+		p[0] = 'B';
+		p[1] = 'M';
+		put(p + 2, (DWORD)file.size(), 4);
+		put(p + 10, dwOffset, 4);
+		put(p + 14, 40, 4);
+		put(p + 18, (DWORD)sc.srcWidth, 4);
+		put(p + 22, (DWORD)(sc.bTopDown ? -sc.srcHeight : sc.srcHeight), 4);
+		put(p + 26, 1, 2);
+		put(p + 28, (DWORD)sc.iBitCount, 2);
+
+		for (DWORD i = 0; i < dwPalette / 4; i++)
+			put(p + 54 + 4 * i, i * 0x010101, 4);
+
+		std::mt19937 random(sc.sim.uSeed);
+		for (size_t i = dwOffset; i < file.size(); i++)
+			file[i] = BYTE(random() & 0xff);
+
+		return file;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunDecode ()
+	// Desc : Times CBmpDecoder headers and pixels, the destination buffer is
+	//		allocated once outside the timing.
+	//-------------------------------------------------------------------------
+	bool RunDecode(const SScenario &sc, MetricMap &metrics)
+	{
+		SetSimdLevel(sc.simd);
+
+		std::vector<BYTE> file = MakeBmp(sc);
+		std::vector<RGBQUAD> pixels((size_t)sc.srcWidth * sc.srcHeight);
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Decode";
+		long long llAllocations = 0;
+
+		for (int r = 0; r < sc.iRepeat; r++)
+		{
+			CBmpDecoder decoder;
+			long long llHeap = CCounters::GetHeapAllocations();
+			long long t0 = CProfiler::Now();
+			bool bOk = decoder.Open(&file[0], file.size()) && decoder.Decode(&pixels[0], true);
+			phase.samples.push_back(CProfiler::Now() - t0);
+			llAllocations += CCounters::GetHeapAllocations() - llHeap;
+
+			if (!bOk)
+			{
+				fprintf(stderr, "Bench: %s: decoding failed\n", sc.strName.c_str());
+				SetSimdLevel(SIMD_AVX2);
+				return false;
+			}
+		}
+
+		AddTimings(metrics, "Decode", phase);
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+
+		SetSimdLevel(SIMD_AVX2);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunChannels ()
+	// Desc : Times one channel copied out of an image, or the HSL planes.
+	//-------------------------------------------------------------------------
+	bool RunChannels(const SScenario &sc, MetricMap &metrics)
+	{
+		SetSimdLevel(sc.simd);
+
+		CImageFile image;
+		image.Create(sc.srcWidth, sc.srcHeight);
+
+		std::mt19937 random(sc.sim.uSeed);
+		DWORD *pPixels = (DWORD*)image.Pixels();
+		for (size_t i = 0; i < (size_t)sc.srcWidth * sc.srcHeight; i++)
+			pPixels[i] = DWORD(random()) & 0x00ffffff;
+
+		EColorChannel chn = ECC_HUE;
+		if (sc.strChannel == "red")				chn = ECC_RED;
+		else if (sc.strChannel == "saturation")	chn = ECC_SATURATION;
+		else if (sc.strChannel == "luminosity")	chn = ECC_LUMINOSITY;
+
+		std::vector<BYTE> plane((size_t)sc.srcWidth * sc.srcHeight);
+		CPlanarImage planar;
+		bool bPlanar = sc.strChannel == "hsl";
+		if (bPlanar)
+			planar.Split(image, PLANES_HSL);
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Channels";
+		long long llAllocations = 0;
+
+		for (int r = 0; r < sc.iRepeat; r++)
+		{
+			long long llHeap = CCounters::GetHeapAllocations();
+			long long t0 = CProfiler::Now();
+			if (bPlanar)
+				planar.Split(image, PLANES_HSL);
+			else
+				image.CopyMonoImage(chn, &plane[0], sc.srcWidth);
+			phase.samples.push_back(CProfiler::Now() - t0);
+			llAllocations += CCounters::GetHeapAllocations() - llHeap;
+		}
+
+		AddTimings(metrics, "Channels", phase);
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+
+		SetSimdLevel(SIMD_AVX2);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunConvolve ()
+	// Desc : Times one filter pass over an image, or over its luminosity.
+	//-------------------------------------------------------------------------
+	bool RunConvolve(const SScenario &sc, MetricMap &metrics)
+	{
+		SetSimdLevel(sc.simd);
+		CResizableImage::SetThreadCount(sc.uThreads);
+
+		CImageFile image, filtered;
+		image.Create(sc.srcWidth, sc.srcHeight);
+
+		std::mt19937 random(sc.sim.uSeed);
+		DWORD *pPixels = (DWORD*)image.Pixels();
+		for (size_t i = 0; i < (size_t)sc.srcWidth * sc.srcHeight; i++)
+			pPixels[i] = DWORD(random()) & 0x00ffffff;
+
+		CConvolutionKernel kernel;
+		if (sc.strKernel == "box")
+			kernel.SetBox((int)sc.dSigma);
+		else if (sc.strKernel == "sharpen")
+			kernel.SetSharpen(sc.dSigma);
+		else
+			kernel.SetGaussian(sc.dSigma);
+
+		CPlanarImage planes;
+		if (sc.bPlane)
+		{
+			planes.Split(image, PLANE_LUMINOSITY);
+			planes.Plane(ECC_SATURATION);
+		}
+
+		// The first pass sizes the output and the tile buffers
+		CConvolver convolver;
+		convolver.Apply(kernel, image, filtered);
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Convolve";
+		long long llAllocations = 0;
+
+		for (int r = 0; r < sc.iRepeat; r++)
+		{
+			long long llHeap = CCounters::GetHeapAllocations();
+			long long t0 = CProfiler::Now();
+			if (sc.bPlane)
+			{
+				convolver.ApplyPlane(kernel, planes.Plane(ECC_LUMINOSITY), planes.Stride(),
+					planes.Plane(ECC_SATURATION), planes.Stride(), planes.Width(), planes.Height());
+			}
+			else
+				convolver.Apply(kernel, image, filtered);
+			phase.samples.push_back(CProfiler::Now() - t0);
+			llAllocations += CCounters::GetHeapAllocations() - llHeap;
+		}
+
+		AddTimings(metrics, "Convolve", phase);
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+
+		SetSimdLevel(SIMD_AVX2);
+		CResizableImage::SetThreadCount(0);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunPipeline ()
+	// Desc : Times a channel -> convolution -> LUT -> paste -> resample
+	//        effect, fused or one step at a time.
+	//-------------------------------------------------------------------------
+	bool RunPipeline(const SScenario &sc, MetricMap &metrics)
+	{
+		std::unique_ptr<CGenericFilter> pFilter(CreateFilter(sc.strFilter));
+		if (!pFilter)
+		{
+			fprintf(stderr, "Bench: %s: unknown filter '%s'\n", sc.strName.c_str(), sc.strFilter.c_str());
+			return false;
+		}
+
+		SetSimdLevel(sc.simd);
+		CResizableImage::SetThreadCount(sc.uThreads);
+
+		CImageFile image;
+		image.Create(sc.srcWidth, sc.srcHeight);
+
+		std::mt19937 random(sc.sim.uSeed);
+		DWORD *pPixels = (DWORD*)image.Pixels();
+		for (size_t i = 0; i < (size_t)sc.srcWidth * sc.srcHeight; i++)
+			pPixels[i] = DWORD(random()) & 0x00ffffff;
+
+		EColorChannel chn = ECC_HUE;
+		if (sc.strChannel == "red")				chn = ECC_RED;
+		else if (sc.strChannel == "saturation")	chn = ECC_SATURATION;
+		else if (sc.strChannel == "luminosity")	chn = ECC_LUMINOSITY;
+
+		CConvolutionKernel kernel;
+		if (sc.strKernel == "box")
+			kernel.SetBox((int)sc.dSigma);
+		else if (sc.strKernel == "sharpen")
+			kernel.SetSharpen(sc.dSigma);
+		else
+			kernel.SetGaussian(sc.dSigma);
+
+		BYTE contrast[256];
+		for (int i = 0; i < 256; i++)
+			contrast[i] = (BYTE)(std::min)(255, (std::max)(0, (i - 128) * 3 / 2 + 128));
+
+		CImagePipeline pipeline;
+		pipeline.Channel(chn);
+		pipeline.Convolve(kernel);
+		pipeline.Lut(contrast);
+		pipeline.Paste(ECC_RED);
+		if (sc.bResample)
+			pipeline.Resample(pFilter.get(), sc.dstWidth, sc.dstHeight);
+
+		size_t size = (size_t)sc.srcWidth * sc.srcHeight;
+		std::vector<BYTE> gray(size), filtered(size);
+		CConvolver convolver;
+		CImageFile work, fused;
+		CResizableImage stepped;
+		stepped.SetFilter(pFilter.get());
+
+		auto RunSteps = [&]()
+		{
+			image.CopyMonoImage(chn, &gray[0], sc.srcWidth);
+			convolver.ApplyPlane(kernel, &gray[0], sc.srcWidth, &filtered[0], sc.srcWidth,
+				sc.srcWidth, sc.srcHeight);
+			for (size_t i = 0; i < size; i++)
+				filtered[i] = contrast[filtered[i]];
+			work.CopyFrom(image);
+			work.PasteMonoImage(&filtered[0], sc.srcWidth, ECC_RED);
+			if (sc.bResample)
+				stepped.ResampleFrom(work, sc.dstWidth, sc.dstHeight);
+		};
+
+		// The first passes size the outputs and buffers, and must agree
+		RunSteps();
+		pipeline.Run(image, fused);
+		const CImageFile &result = sc.bResample ? (const CImageFile&)stepped : work;
+		bool bSame = fused.Width() == result.Width() && fused.Height() == result.Height() &&
+			!memcmp(fused.Pixels(), result.Pixels(), sizeof(RGBQUAD) * fused.Width() * fused.Height());
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Pipeline";
+		long long llAllocations = 0;
+
+		for (int r = 0; r < sc.iRepeat && bSame; r++)
+		{
+			long long llHeap = CCounters::GetHeapAllocations();
+			long long t0 = CProfiler::Now();
+			if (sc.bFused)
+				pipeline.Run(image, fused);
+			else
+				RunSteps();
+			phase.samples.push_back(CProfiler::Now() - t0);
+			llAllocations += CCounters::GetHeapAllocations() - llHeap;
+		}
+
+		SetSimdLevel(SIMD_AVX2);
+		CResizableImage::SetThreadCount(0);
+
+		if (!bSame)
+		{
+			fprintf(stderr, "Bench: %s: pipeline and steps give different pixels\n", sc.strName.c_str());
+			return false;
+		}
+
+		AddTimings(metrics, "Pipeline", phase);
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunTone ()
+	// Desc : Times a histogram or a tone curve over a noise image.
+	//-------------------------------------------------------------------------
+	bool RunTone(const SScenario &sc, MetricMap &metrics)
+	{
+		bool bRgb = sc.strChannel == "rgb";
+		if (bRgb && sc.strOp == "equalize")
+		{
+			fprintf(stderr, "Bench: %s: equalize takes a single channel\n", sc.strName.c_str());
+			return false;
+		}
+
+		SetSimdLevel(sc.simd);
+
+		CImageFile image, work;
+		image.Create(sc.srcWidth, sc.srcHeight);
+
+		std::mt19937 random(sc.sim.uSeed);
+		DWORD *pPixels = (DWORD*)image.Pixels();
+		for (size_t i = 0; i < (size_t)sc.srcWidth * sc.srcHeight; i++)
+			pPixels[i] = DWORD(random()) & 0x00ffffff;
+		work.CopyFrom(image);
+
+		EColorChannel chn = ECC_HUE;
+		if (sc.strChannel == "red")				chn = ECC_RED;
+		else if (sc.strChannel == "saturation")	chn = ECC_SATURATION;
+		else if (sc.strChannel == "luminosity")	chn = ECC_LUMINOSITY;
+
+		DWORD bins[3][256];
+		BYTE curve[256];
+		for (int i = 0; i < 256; i++)
+			curve[i] = (BYTE)(255 - i);
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Tone";
+		long long llAllocations = 0;
+
+		for (int r = 0; r < sc.iRepeat; r++)
+		{
+			// Every pass starts from the noise, not from the last result
+			if (sc.strOp != "histogram")
+				work.CopyFrom(image);
+
+			long long llHeap = CCounters::GetHeapAllocations();
+			long long t0 = CProfiler::Now();
+			if (sc.strOp == "histogram")
+			{
+				if (bRgb)
+					CImageTone::Histogram(image, bins[0], bins[1], bins[2]);
+				else
+					CImageTone::Histogram(image, chn, bins[0]);
+			}
+			else if (sc.strOp == "lut")
+			{
+				if (bRgb)
+					CImageTone::ApplyLut(work, curve, curve, curve);
+				else
+					CImageTone::ApplyLut(work, chn, curve);
+			}
+			else if (sc.strOp == "equalize")
+				CImageTone::Equalize(work, chn);
+			else if (bRgb)
+				CImageTone::AutoLevels(work);
+			else
+				CImageTone::AutoLevels(work, chn);
+			phase.samples.push_back(CProfiler::Now() - t0);
+			llAllocations += CCounters::GetHeapAllocations() - llHeap;
+		}
+
+		AddTimings(metrics, "Tone", phase);
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+
+		SetSimdLevel(SIMD_AVX2);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunCompact ()
+	// Desc : Times widening a compact image band by band, as Paint does
+	//        before each blit.
+	//-------------------------------------------------------------------------
+	bool RunCompact(const SScenario &sc, MetricMap &metrics)
+	{
+		SetSimdLevel(sc.simd);
+
+		CImageFile image, expanded;
+		image.Create(sc.srcWidth, sc.srcHeight);
+
+		std::mt19937 random(sc.sim.uSeed);
+		DWORD palette[200];
+		for (int i = 0; i < 200; i++)
+			palette[i] = DWORD(random()) & 0x00ffffff;
+
+		// RGB565 noise repeats the top bits of each channel like the widening
+		DWORD *pPixels = (DWORD*)image.Pixels();
+		for (size_t i = 0; i < (size_t)sc.srcWidth * sc.srcHeight; i++)
+		{
+			DWORD p = DWORD(random());
+			if (sc.format == COMPACT_INDEXED8)
+				p = palette[p % 200];
+			else if (sc.format == COMPACT_RGB565)
+				p = (p & 0xf8fcf8) | ((p >> 5) & 0x070007) | ((p >> 6) & 0x000300);
+			pPixels[i] = p & 0x00ffffff;
+		}
+
+		CCompactImage compact;
+		bool bSame = compact.Compress(image) && compact.Format() == sc.format && compact.ExpandTo(expanded) &&
+			!memcmp(expanded.Pixels(), image.Pixels(), sizeof(RGBQUAD) * sc.srcWidth * sc.srcHeight);
+		if (!bSame)
+		{
+			SetSimdLevel(SIMD_AVX2);
+			fprintf(stderr, "Bench: %s: the compact image does not give the pixels back\n", sc.strName.c_str());
+			return false;
+		}
+
+		std::vector<RGBQUAD> band((size_t)sc.srcWidth * COMPACT_PAINT_ROWS);
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Compact";
+		long long llAllocations = 0;
+
+		for (int r = 0; r < sc.iRepeat; r++)
+		{
+			long long llHeap = CCounters::GetHeapAllocations();
+			long long t0 = CProfiler::Now();
+			for (LONG lRow = 0; lRow < sc.srcHeight; lRow += COMPACT_PAINT_ROWS)
+			{
+				RECT rc = { 0, lRow, sc.srcWidth - 1, (std::min)(lRow + COMPACT_PAINT_ROWS, (LONG)sc.srcHeight) - 1 };
+				compact.Expand(&band[0], sc.srcWidth, &rc);
+			}
+			phase.samples.push_back(CProfiler::Now() - t0);
+			llAllocations += CCounters::GetHeapAllocations() - llHeap;
+		}
+
+		AddTimings(metrics, "Compact", phase);
+		metrics["resident_bytes"] = double(compact.GetBytes());
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+
+		SetSimdLevel(SIMD_AVX2);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunCapture ()
+	// Desc : Times the game thread's side of frame capture, the writer runs
+	//        on its own thread meanwhile.
+	//-------------------------------------------------------------------------
+	bool RunCapture(const SScenario &sc, MetricMap &metrics)
+	{
+		CImageFile image;
+		image.Create(sc.srcWidth, sc.srcHeight);
+
+		std::mt19937 random(sc.sim.uSeed);
+		DWORD *pPixels = (DWORD*)image.Pixels();
+		for (size_t i = 0; i < (size_t)sc.srcWidth * sc.srcHeight; i++)
+			pPixels[i] = DWORD(random()) & 0x00ffffff;
+
+		// Counters are created on first use, which would be counted as an
+		// allocation of whichever frame first drops or stalls
+		CCounters::Register("capture frames", CCounter::PER_FRAME);
+		CCounters::Register("capture drops", CCounter::PER_FRAME);
+		CCounters::Register("capture stalls", CCounter::PER_FRAME);
+		CCounters::Register("capture stall us", CCounter::PER_FRAME);
+
+		CFrameCapture::SOptions options;
+		options.format = CFrameCapture::CAPTURE_Y4M;
+		options.policy = sc.policy;
+		options.uBuffers = sc.uBuffers;
+#ifdef _WIN32
+		options.strPath = "NUL";
+#else
+		options.strPath = "/dev/null";
+#endif
+
+		CFrameCapture capture;
+		if (!capture.Start(options, sc.srcWidth, sc.srcHeight))
+		{
+			fprintf(stderr, "Bench: %s: cannot open %s\n", sc.strName.c_str(), options.strPath.c_str());
+			return false;
+		}
+
+		// One frame through before timing, so the writer thread has set up
+		// (and allocated) what it keeps for its lifetime
+		CFrameCapture::SStats stats;
+		capture.Submit(image.Pixels(), sc.srcWidth);
+		do
+		{
+			std::this_thread::yield();
+			capture.GetStats(stats);
+		} while (stats.ullWritten == 0 && !stats.bWriteFailed);
+
+		CSimRunner::SPhase phase;
+		phase.szName = "Capture";
+		phase.samples.reserve(sc.iRepeat > 0 ? sc.iRepeat : 0);
+
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		long long llHeap = CCounters::GetHeapAllocations();
+		for (int r = 0; r < sc.iRepeat; r++)
+		{
+			if (sc.uInterval)
+			{
+				next += std::chrono::microseconds(sc.uInterval);
+				std::this_thread::sleep_until(next);
+			}
+
+			long long t0 = CProfiler::Now();
+			capture.Submit(image.Pixels(), sc.srcWidth);
+			phase.samples.push_back(CProfiler::Now() - t0);
+		}
+		long long llAllocations = CCounters::GetHeapAllocations() - llHeap;
+
+		bool bOk = capture.Stop();
+		capture.GetStats(stats);
+		if (!bOk || stats.ullWritten != stats.ullCaptured ||
+			(sc.policy == CFrameCapture::CAPTURE_BLOCK && stats.ullCaptured != (unsigned long long)sc.iRepeat + 1))
+		{
+			fprintf(stderr, "Bench: %s: %llu of %llu frames written\n", sc.strName.c_str(), stats.ullWritten,
+				stats.ullCaptured);
+			return false;
+		}
+
+		printf("  %llu frames written, %llu dropped, %llu stalls (%.1f ms)\n", stats.ullWritten, stats.ullDropped,
+			stats.ullStalls, stats.llStallTime / 1e6);
+
+		AddTimings(metrics, "Capture", phase);
+		metrics["Writer.mean_us"] = stats.ullWritten ? stats.llWriteTime / 1e3 / stats.ullWritten : 0.0;
+		metrics["allocations"] = double(llAllocations) / (sc.iRepeat > 0 ? sc.iRepeat : 1);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunSimulation ()
+	// Desc : Runs a scenario through the game rules.
+	//-------------------------------------------------------------------------
+	void RunSimulation(const SScenario &sc, MetricMap &metrics)
+	{
+		CSimRunner::SResult result;
+		CSimRunner::Run(sc.sim, result);
+
+		for (size_t p = 0; p < result.phases.size(); p++)
+		{
+			const CSimRunner::SPhase &phase = result.phases[p];
+			AddTimings(metrics, phase.szName, phase);
+		}
+
+		metrics["frames"] = double(result.ulFrames);
+		metrics["setup_allocations"] = double(result.llSetupAllocations);
+		metrics["allocations"] = double(result.llRunAllocations);
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : RunScenario ()
+	// Desc : Runs a scenario of any kind, false when it could not be run.
+	//-------------------------------------------------------------------------
+	bool RunScenario(const SScenario &sc, MetricMap &metrics)
+	{
+		if (sc.kind == KIND_RESAMPLE)
+		{
+			if (!RunResample(sc, metrics))
+				return false;
+		}
+		else if (sc.kind == KIND_DECODE)
+		{
+			if (!RunDecode(sc, metrics))
+				return false;
+		}
+		else if (sc.kind == KIND_CHANNELS)
+			RunChannels(sc, metrics);
+		else if (sc.kind == KIND_CONVOLVE)
+			RunConvolve(sc, metrics);
+		else if (sc.kind == KIND_PIPELINE)
+		{
+			if (!RunPipeline(sc, metrics))
+				return false;
+		}
+		else if (sc.kind == KIND_TONE)
+		{
+			if (!RunTone(sc, metrics))
+				return false;
+		}
+		else if (sc.kind == KIND_COMPACT)
+		{
+			if (!RunCompact(sc, metrics))
+				return false;
+		}
+		else if (sc.kind == KIND_CAPTURE)
+		{
+			if (!RunCapture(sc, metrics))
+				return false;
+		}
+		else
+			RunSimulation(sc, metrics);
+
+		return true;
+	}
+
+	bool EndsWith(const std::string &str, const char *szSuffix)
+	{
+		size_t n = strlen(szSuffix);
+		return str.size() > n && str.compare(str.size() - n, n, szSuffix) == 0;
+	}
+
+	bool IsTiming(const std::string &strMetric)
+	{
+		return EndsWith(strMetric, "_us");
+	}
+
+	bool IsAllocation(const std::string &strMetric)
+	{
+		return strMetric.find("allocations") != std::string::npos;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : Compare ()
+	// Desc : Prints every metric next to its baseline, returns the number of
+	//		regressions. Frame counts must match exactly, they show that the
+	//		scenario still plays the same game. Of the timings only medians
+	//		can regress, means and percentiles are shown for reference.
+	//-------------------------------------------------------------------------
+	int Compare(const MetricMap &current, const MetricMap *pBaseline, const SThresholds &thr, bool bPrint = true)
+	{
+		int iRegressions = 0;
+
+		for (auto it = current.begin(); it != current.end(); ++it)
+		{
+			const char *szVerdict = "";
+			double dBase = 0;
+			bool bHasBase = pBaseline && pBaseline->count(it->first);
+
+			if (bHasBase)
+			{
+				dBase = pBaseline->at(it->first);
+				bool bRegressed = false;
+
+				// As it would be written, an average of allocations rarely is
+				// a round number
+				double dValue = floor(it->second / BENCH_RESOLUTION + 0.5) * BENCH_RESOLUTION;
+
+				if (IsTiming(it->first))
+					bRegressed = EndsWith(it->first, ".median_us") && it->second > dBase * (1 + thr.dTime) &&
+						it->second - dBase > thr.dTimeFloorUs;
+				else if (IsAllocation(it->first))
+					bRegressed = dValue > dBase * (1 + thr.dAlloc) + BENCH_RESOLUTION / 2;
+				else
+					bRegressed = fabs(dValue - dBase) > BENCH_RESOLUTION / 2;
+
+				if (bRegressed)
+				{
+					szVerdict = "  REGRESSION";
+					iRegressions++;
+				}
+			}
+
+			if (!bPrint)
+				continue;
+			if (bHasBase)
+				printf("  %-28s %14.3f  baseline %14.3f  %+7.1f%%%s\n", it->first.c_str(), it->second, dBase,
+					dBase != 0 ? (it->second / dBase - 1) * 100 : 0.0, szVerdict);
+			else
+				printf("  %-28s %14.3f  (no baseline)\n", it->first.c_str(), it->second);
+		}
+
+		return iRegressions;
+	}
+
+	bool WriteResults(const char *szFileName, const ScenarioMap &results, const SThresholds &thr)
+	{
+		FILE *f = fopen(szFileName, "w");
+		if (!f)
+			return false;
+
+		fprintf(f, "{\n\"thresholds\":{\"time\":%g,\"allocations\":%g,\"time_floor_us\":%g},\n\"scenarios\":{",
+			thr.dTime, thr.dAlloc, thr.dTimeFloorUs);
+
+		bool bFirst = true;
+		for (auto sc = results.begin(); sc != results.end(); ++sc)
+		{
+			fprintf(f, "%s\n\t\"%s\":{", bFirst ? "" : ",", sc->first.c_str());
+			bFirst = false;
+
+			bool bFirstMetric = true;
+			for (auto m = sc->second.begin(); m != sc->second.end(); ++m)
+			{
+				fprintf(f, "%s\n\t\t\"%s\":%.3f", bFirstMetric ? "" : ",", m->first.c_str(), m->second);
+				bFirstMetric = false;
+			}
+			fprintf(f, "\n\t}");
+		}
+
+		fprintf(f, "\n}\n}\n");
+		fclose(f);
+		return true;
+	}
+
+	void Usage()
+	{
+		fprintf(stderr,
+			"usage: Bench --suite file [--baseline file.json] [--only name] [--out file.json]\n"
+			"             [--update-baseline [--replace]] [--time-threshold f] [--alloc-threshold f]\n");
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : main ()
+// Desc : Entry point of the benchmark suite.
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	const char *szSuite = NULL;
+	const char *szBaseline = NULL;
+	const char *szOut = NULL;
+	const char *szOnly = NULL;
+	bool bUpdate = false;
+	bool bReplace = false;
+	double dTimeThreshold = -1, dAllocThreshold = -1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *szArg = argv[i];
+		const char *szValue = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(szArg, "--update-baseline") == 0) { bUpdate = true; continue; }
+		if (strcmp(szArg, "--replace") == 0) { bReplace = true; continue; }
+		if (!szValue) { Usage(); return 2; }
+		i++;
+
+		if (strcmp(szArg, "--suite") == 0)					szSuite = szValue;
+		else if (strcmp(szArg, "--baseline") == 0)			szBaseline = szValue;
+		else if (strcmp(szArg, "--out") == 0)				szOut = szValue;
+		else if (strcmp(szArg, "--only") == 0)				szOnly = szValue;
+		else if (strcmp(szArg, "--time-threshold") == 0)	dTimeThreshold = atof(szValue);
+		else if (strcmp(szArg, "--alloc-threshold") == 0)	dAllocThreshold = atof(szValue);
+		else { Usage(); return 2; }
+	}
+
+	if (!szSuite || (bUpdate && !szBaseline))
+	{
+		Usage();
+		return 2;
+	}
+
+	std::vector<SScenario> suite;
+	if (!LoadSuite(szSuite, suite))
+		return 1;
+
+	ScenarioMap baseline;
+	SThresholds thr;
+	if (szBaseline)
+	{
+		// A baseline being created from scratch does not exist yet
+		std::string strText;
+		bool bRead = ReadFile(szBaseline, strText);
+		if ((bRead || !bUpdate) && !(bRead && CJsonReader(strText).ReadBaseline(baseline, thr)))
+		{
+			fprintf(stderr, "Bench: cannot read baseline %s\n", szBaseline);
+			return 1;
+		}
+	}
+	if (dTimeThreshold >= 0)	thr.dTime = dTimeThreshold;
+	if (dAllocThreshold >= 0)	thr.dAlloc = dAllocThreshold;
+
+	CProfiler::SetThreadName("Bench");
+
+	ScenarioMap results;
+	int iRegressions = 0;
+
+	for (size_t s = 0; s < suite.size(); s++)
+	{
+		const SScenario &sc = suite[s];
+		if (szOnly && sc.strName != szOnly)
+			continue;
+
+		printf("%s\n", sc.strName.c_str());
+
+		auto base = baseline.find(sc.strName);
+		const MetricMap *pBase = base != baseline.end() ? &base->second : NULL;
+
+		MetricMap &metrics = results[sc.strName];
+		if (!RunScenario(sc, metrics))
+			return 1;
+
+		// Something else busy on the machine slows every phase for a while.
+		// A recorded timing is the middle of several runs, and a timing only
+		// regresses when no run of the scenario was fast enough.
+		if (bUpdate)
+		{
+			std::vector<MetricMap> runs(1, metrics);
+			for (int r = 0; r < BENCH_RETRIES; r++)
+			{
+				runs.push_back(MetricMap());
+				if (!RunScenario(sc, runs.back()))
+					return 1;
+			}
+			for (auto it = metrics.begin(); it != metrics.end(); ++it)
+			{
+				if (!IsTiming(it->first))
+					continue;
+
+				std::vector<double> values;
+				for (size_t r = 0; r < runs.size(); r++)
+					if (runs[r].count(it->first))
+						values.push_back(runs[r][it->first]);
+				std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+				it->second = values[values.size() / 2];
+			}
+		}
+		for (int r = 0; r < BENCH_RETRIES && !bUpdate && pBase && Compare(metrics, pBase, thr, false); r++)
+		{
+			printf("  regressed, running again\n");
+			std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_RETRY_PAUSE_MS));
+
+			MetricMap retry;
+			if (!RunScenario(sc, retry))
+				return 1;
+			for (auto it = retry.begin(); it != retry.end(); ++it)
+				metrics[it->first] = IsTiming(it->first) && metrics.count(it->first) ?
+					(std::min)(metrics[it->first], it->second) : it->second;
+		}
+		iRegressions += Compare(metrics, pBase, thr);
+
+		const char *szTiming = sc.kind == KIND_DECODE ? "Decode.median_us" :
+			sc.kind == KIND_CHANNELS ? "Channels.median_us" :
+			sc.kind == KIND_CONVOLVE ? "Convolve.median_us" :
+			sc.kind == KIND_PIPELINE ? "Pipeline.median_us" :
+			sc.kind == KIND_TONE ? "Tone.median_us" :
+			sc.kind == KIND_COMPACT ? "Compact.median_us" :
+			sc.kind == KIND_CAPTURE ? "Capture.median_us" : "Resample.median_us";
+		auto ref = results.find(sc.strRef);
+		if (!sc.strRef.empty() && ref != results.end() && metrics.count(szTiming) && ref->second.count(szTiming))
+		{
+			printf("  speedup over %-18s %10.2fx\n", sc.strRef.c_str(),
+				ref->second[szTiming] / metrics[szTiming]);
+		}
+	}
+
+	if (szOut && !WriteResults(szOut, results, thr))
+	{
+		fprintf(stderr, "Bench: cannot write %s\n", szOut);
+		return 1;
+	}
+
+	if (bUpdate)
+	{
+		// Entries already recorded are only replaced when asked for, so a
+		// change adds its own scenarios without re-recording everyone else's
+		ScenarioMap merged(baseline);
+		for (auto sc = results.begin(); sc != results.end(); ++sc)
+		{
+			if (!merged.count(sc->first) || bReplace || szOnly)
+				merged[sc->first] = sc->second;
+			else
+				printf("%s kept as recorded, --only %s or --replace records it again\n", sc->first.c_str(),
+					sc->first.c_str());
+		}
+
+		if (!WriteResults(szBaseline, merged, thr))
+		{
+			fprintf(stderr, "Bench: cannot write %s\n", szBaseline);
+			return 1;
+		}
+		printf("baseline written to %s\n", szBaseline);
+		return 0;
+	}
+
+	if (iRegressions)
+		printf("%d regression(s) (time threshold %.0f%%, allocation threshold %.0f%%)\n",
+			iRegressions, thr.dTime * 100, thr.dAlloc * 100);
+
+	return iRegressions ? 1 : 0;
+}
@@ -0,0 +1,285 @@
+//-----------------------------------------------------------------------------
+// File: BmpDecoder.cpp
+//
+// Desc: Memory mapped BMP decoding, headers parsed by hand.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// BmpDecoder Specific Includes
+//-----------------------------------------------------------------------------
+#include "BmpDecoder.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+	const DWORD BMP_FILE_HEADER_SIZE = 14;
+	const DWORD BMP_INFO_HEADER_SIZE = 40;		// BITMAPINFOHEADER, later versions are longer
+	const DWORD BMP_V2_HEADER_SIZE = 52;		// First one with the masks inside
+	const LONG	BMP_MAX_DIMENSION = 1 << 15;
+	const LONG	BMP_MAX_PIXELS = 1 << 28;			// 1 GB decoded
+
+	// BMP headers are little endian and packed, read them byte by byte
+	DWORD ReadLE( const BYTE *p, int iBytes )
+	{
+		DWORD dwValue = 0;
+		for (int i = iBytes - 1; i >= 0; i--)
+			dwValue = (dwValue << 8) | p[i];
+		return dwValue;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// CBmpDecoder Member Functions
+//-----------------------------------------------------------------------------
+CBmpDecoder::CBmpDecoder() :
+	m_pData(NULL), m_Size(0), m_lWidth(0), m_lHeight(0), m_bTopDown(false), m_wBitCount(0),
+	m_dwCompression(BI_RGB), m_dwPixelsOffset(0), m_dwStride(0)
+{
+	memset(m_Palette, 0, sizeof(m_Palette));
+}
+
+bool CBmpDecoder::Open( const char *szFileName )
+{
+	Close();
+
+	if (!m_File.Open(szFileName))
+		return false;
+
+	m_pData = m_File.Data();
+	m_Size = m_File.Size();
+	if (!ParseHeaders())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool CBmpDecoder::Open( const BYTE *pData, size_t size )
+{
+	Close();
+
+	m_pData = pData;
+	m_Size = size;
+	if (!ParseHeaders())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CBmpDecoder::Close()
+{
+	m_File.Close();
+	m_pData = NULL;
+	m_Size = 0;
+	m_lWidth = m_lHeight = 0;
+	m_wBitCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ParseHeaders () (Private)
+// Desc : Checks everything Decode relies on, so it never reads past the
+//		end of the data.
+//-----------------------------------------------------------------------------
+bool CBmpDecoder::ParseHeaders()
+{
+	if (!m_pData || m_Size < BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE || m_pData[0] != 'B' || m_pData[1] != 'M')
+		return false;
+
+	const BYTE *pInfo = m_pData + BMP_FILE_HEADER_SIZE;
+	DWORD dwInfoSize = ReadLE(pInfo, 4);
+	LONG lHeight = (LONG)ReadLE(pInfo + 8, 4);
+
+	m_dwPixelsOffset = ReadLE(m_pData + 10, 4);
+	m_lWidth = (LONG)ReadLE(pInfo + 4, 4);
+	m_lHeight = lHeight < 0 ? -lHeight : lHeight;
+	m_bTopDown = lHeight < 0;
+	m_wBitCount = (WORD)ReadLE(pInfo + 14, 2);
+	m_dwCompression = ReadLE(pInfo + 16, 4);
+
+	// Core (OS/2) headers are not supported
+	if (dwInfoSize < BMP_INFO_HEADER_SIZE || dwInfoSize > m_Size - BMP_FILE_HEADER_SIZE)
+		return false;
+
+	if (m_lWidth <= 0 || m_lHeight <= 0 || m_lWidth > BMP_MAX_DIMENSION || m_lHeight > BMP_MAX_DIMENSION ||
+		(long long)m_lWidth * m_lHeight > BMP_MAX_PIXELS || ReadLE(pInfo + 12, 2) != 1)
+		return false;
+
+	DWORD dwTableOffset = BMP_FILE_HEADER_SIZE + dwInfoSize;
+
+	switch (m_wBitCount)
+	{
+	case 8:
+		// Compressed bitmaps are always stored bottom-up
+		if (m_dwCompression != BI_RGB && (m_dwCompression != BI_RLE8 || m_bTopDown))
+			return false;
+		break;
+
+	case 24:
+		if (m_dwCompression != BI_RGB)
+			return false;
+		break;
+
+	case 32:
+		if (m_dwCompression == BI_BITFIELDS)
+		{
+			// Masks follow a plain info header, later headers hold them
+			const BYTE *pMasks = pInfo + BMP_INFO_HEADER_SIZE;
+			if (dwInfoSize < BMP_V2_HEADER_SIZE)
+			{
+				if (dwTableOffset + 12 > m_Size)
+					return false;
+				dwTableOffset += 12;
+			}
+
+			// Only the layout of a plain 32 bit bitmap
+			if (ReadLE(pMasks, 4) != 0x00ff0000 || ReadLE(pMasks + 4, 4) != 0x0000ff00 || ReadLE(pMasks + 8, 4) != 0x000000ff)
+				return false;
+		}
+		else if (m_dwCompression != BI_RGB)
+			return false;
+		break;
+
+	default:
+		return false;
+	}
+
+	if (m_wBitCount == 8)
+	{
+		DWORD dwColors = ReadLE(pInfo + 32, 4);
+		if (dwColors == 0 || dwColors > 256)
+			dwColors = 256;
+		if (dwTableOffset + 4 * dwColors > m_Size)
+			return false;
+
+		memset(m_Palette, 0, sizeof(m_Palette));
+		memcpy(m_Palette, m_pData + dwTableOffset, 4 * dwColors);
+		for (DWORD i = 0; i < dwColors; i++)
+			m_Palette[i].rgbReserved = 0;
+	}
+
+	m_dwStride = ((DWORD)m_lWidth * m_wBitCount + 31) / 32 * 4;
+	if (m_dwPixelsOffset >= m_Size)
+		return false;
+
+	// The RLE decoder checks every read itself
+	if (m_dwCompression != BI_RLE8 && (m_Size - m_dwPixelsOffset) / m_dwStride < (DWORD)m_lHeight)
+		return false;
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Decode ()
+// Desc : Every file row goes straight to its place in pDst, so the row
+//		order costs nothing.
+//-----------------------------------------------------------------------------
+bool CBmpDecoder::Decode( RGBQUAD *pDst, bool bBottomUp ) const
+{
+	PROFILE_SCOPE("CBmpDecoder::Decode");
+
+	if (!m_pData || m_lWidth <= 0 || !pDst)
+		return false;
+
+	if (m_dwCompression == BI_RLE8)
+		return DecodeRle8(pDst, bBottomUp);
+
+	EXPAND24_KERNEL pfnExpand24 = GetPixelKernels().pfnExpand24;
+
+	// File rows run bottom to top unless the file is top-down, flipping
+	// is a matter of where each one is written
+	bool bSameOrder = bBottomUp != m_bTopDown;
+
+	for (LONG y = 0; y < m_lHeight; y++)
+	{
+		const BYTE *pSrc = m_pData + m_dwPixelsOffset + (size_t)y * m_dwStride;
+		RGBQUAD *pRow = pDst + (size_t)(bSameOrder ? y : m_lHeight - 1 - y) * m_lWidth;
+
+		switch (m_wBitCount)
+		{
+		case 32:
+			memcpy(pRow, pSrc, sizeof(RGBQUAD) * m_lWidth);
+			break;
+
+		case 24:
+			pfnExpand24(pSrc, pRow, (unsigned)m_lWidth);
+			break;
+
+		case 8:
+			for (LONG x = 0; x < m_lWidth; x++)
+				pRow[x] = m_Palette[pSrc[x]];
+			break;
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : DecodeRle8 () (Private)
+// Desc : Runs and absolute blocks of palette indices. Pixels skipped by
+//		deltas or line ends stay black, truncated data ends the image early.
+//-----------------------------------------------------------------------------
+bool CBmpDecoder::DecodeRle8( RGBQUAD *pDst, bool bBottomUp ) const
+{
+	memset(pDst, 0, sizeof(RGBQUAD) * (size_t)m_lWidth * m_lHeight);
+
+	const BYTE *p = m_pData + m_dwPixelsOffset;
+	const BYTE *pEnd = m_pData + m_Size;
+	LONG x = 0, y = 0;		// y counts from the bottom, as the file does
+
+	while (pEnd - p >= 2 && y < m_lHeight)
+	{
+		BYTE count = p[0];
+		BYTE value = p[1];
+		p += 2;
+
+		RGBQUAD *pRow = pDst + (size_t)(bBottomUp ? y : m_lHeight - 1 - y) * m_lWidth;
+
+		if (count > 0)
+		{
+			// Run of one index, clipped at the right edge
+			for (LONG end = (std::min)(x + (LONG)count, m_lWidth); x < end; x++)
+				pRow[x] = m_Palette[value];
+			continue;
+		}
+
+		switch (value)
+		{
+		case 0:			// End of line
+			x = 0;
+			y++;
+			break;
+
+		case 1:			// End of bitmap
+			return true;
+
+		case 2:			// Delta
+			if (pEnd - p < 2)
+				return true;
+			x += p[0];
+			y += p[1];
+			p += 2;
+			break;
+
+		default:		// Absolute block, padded to a word
+			if (pEnd - p < value)
+				return true;
+			for (int i = 0; i < value; i++, x++)
+			{
+				if (x < m_lWidth)
+					pRow[x] = m_Palette[p[i]];
+			}
+			p += (std::min)((value + 1) & ~1, int(pEnd - p));
+			break;
+		}
+	}
+
+	return true;
+}
@@ -10,13 +10,54 @@
 // CGameApp Specific Includes
 //-----------------------------------------------------------------------------
 #include "CGameApp.h"
+#include "EmbeddedAssets.h"
+#include "Profiler.h"
+#include "Counters.h"
 
 #include <ctime>
 #include <cstdlib>
-#include <fstream>
 
 extern	HINSTANCE g_hInst;
 
+namespace
+{
+	// Bitmaps of the objects BuildObjects creates, the menu frame waits for them
+	constexpr const char *g_szStartupFiles[] = {
+		"data/menu_options/startgamesel.bmp", "data/menu_options/loadgamedes.bmp",
+		"data/menu_options/savegamedes.bmp", "data/menu_options/startgamedes.bmp",
+		"data/star.bmp", "data/ship1.bmp", "data/ship1cw30.bmp", "data/ship1ccw30.bmp",
+		"data/ship2.bmp", "data/ship2cw30.bmp", "data/ship2ccw30.bmp", "data/enemyship.bmp",
+		"data/projectile.bmp", "data/score_text.bmp", "data/numbers/0.bmp",
+		"data/lives_text.bmp", "data/heart_blue.bmp", "data/heart_red.bmp"
+	};
+
+	// Sprites built after the first frame: menu and score changes, and the
+	// ones buildDeferredSprites makes
+	constexpr const char *g_szDeferredFiles[] = {
+		"data/explosion.bmp", "data/winscreen.bmp", "data/losescreen.bmp",
+		"data/menu_options/loadgamesel.bmp", "data/menu_options/savegamesel.bmp", "data/numbers/1.bmp", "data/numbers/2.bmp",
+		"data/numbers/3.bmp", "data/numbers/4.bmp", "data/numbers/5.bmp", "data/numbers/6.bmp",
+		"data/numbers/7.bmp", "data/numbers/8.bmp", "data/numbers/9.bmp"
+	};
+
+#ifdef EMBED_ASSETS
+	template <size_t N>
+	constexpr bool AllEmbedded(const char *const (&szFiles)[N])
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			if (FindEmbeddedAsset(szFiles[i]) < 0)
+				return false;
+		}
+		return true;
+	}
+
+	// A kiosk build must never fall back to the file system
+	static_assert(AllEmbedded(g_szStartupFiles) && AllEmbedded(g_szDeferredFiles),
+		"a sprite bitmap is missing from Data/assets.txt");
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // CGameApp Member Functions
 //-----------------------------------------------------------------------------
@@ -31,14 +72,30 @@ CGameApp::CGameApp()
 	m_hIcon			= NULL;
 	m_hMenu			= NULL;
 	_Buffer			= NULL;
-	_Player1		= NULL;
-	_Player2		= NULL;
+	_enemySprite	= NULL;
+	_bulletSprite	= NULL;
+	_explosionSprite = NULL;
 	_scoreP1		= NULL;
 	_scoreP2		= NULL;
 	_wonSprite		= NULL;
 	_lostSprite		= NULL;
 	gameMenu		= NULL;
 	m_LastFrameRate = 0;
+
+	m_bActive			= false;
+	m_bDirty			= true;
+	m_bShowCounters		= false;
+	m_bScreenshot		= false;
+	m_dwLastIdleTick	= 0;
+	m_dwMinimizedTime	= 0;
+	m_nFramesRendered	= 0;
+	m_nFramesSkipped	= 0;
+	m_llStartupBegin	= 0;
+	m_llStartupBuilt	= 0;
+
+	for (int team = 0; team < 2; team++)
+		for (int tilt = 0; tilt < 3; tilt++)
+			_shipSprites[team][tilt] = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -57,8 +114,17 @@ CGameApp::~CGameApp()
 //-----------------------------------------------------------------------------
 bool CGameApp::InitInstance( LPCTSTR lpCmdLine, int iCmdShow )
 {
+	// "-profile N" writes a trace of the first N frames
+	const char *szProfile = lpCmdLine ? strstr(lpCmdLine, "-profile") : NULL;
+	unsigned long ulProfileFrames = 0;
+	if (szProfile && sscanf(szProfile, "-profile %lu", &ulProfileFrames) == 1)
+		CProfiler::SetAutoDump(ulProfileFrames, "profile.json");
+
+	m_llStartupBegin = CProfiler::Now();
+
 	// Create the primary display device
 	if (!CreateDisplay()) { ShutDown(); return false; }
+	CProfiler::Record("Startup: CreateDisplay", m_llStartupBegin, CProfiler::Now(), 1);
 
 	// Build Objects
 	if (!BuildObjects()) 
@@ -68,8 +134,21 @@ bool CGameApp::InitInstance( LPCTSTR lpCmdLine, int iCmdShow )
 		return false; 
 	}
 
+	// "-capture" records the presented frames to capture.y4m, dropping the
+	// ones the writer cannot keep up with, "-capture-block" keeps them all
+	const char *szCapture = lpCmdLine ? strstr(lpCmdLine, "-capture") : NULL;
+	if (szCapture)
+	{
+		CFrameCapture::SOptions options;
+		options.format = CFrameCapture::CAPTURE_Y4M;
+		options.policy = strncmp(szCapture, "-capture-block", 14) == 0 ? CFrameCapture::CAPTURE_BLOCK : CFrameCapture::CAPTURE_DROP;
+		options.strPath = "capture.y4m";
+		m_Recorder.Start(options, _Buffer->width(), _Buffer->height());
+	}
+
 	// Set up all required game states
 	SetupGameState();
+	m_llStartupBuilt = CProfiler::Now();
 
 	// Success!
 	return true;
@@ -151,6 +230,18 @@ int CGameApp::BeginGame()
 			TranslateMessage( &msg );
 			DispatchMessage ( &msg );
 		} 
+		else if ( !m_bActive )
+		{
+			// Minimized, nothing to draw, sleep until the window is touched.
+			// The frames skipped meanwhile are counted once it is restored.
+			WaitMessage();
+		}
+		else if ( IsIdleState() )
+		{
+			// Menus and pause screens only need a low frame rate, the ticks
+			// with nothing to draw are counted as skipped frames.
+			WaitForIdleTick();
+		}
 		else 
 		{
 			// Advance Game Frame.
@@ -163,6 +254,38 @@ int CGameApp::BeginGame()
 	return 0;
 }
 
+//-----------------------------------------------------------------------------
+// Name : IsIdleState () (Private)
+// Desc : Returns true when the game is on a screen with no simulation running
+//		(start menu, pause menu, won / lost screen).
+//-----------------------------------------------------------------------------
+bool CGameApp::IsIdleState() const
+{
+	return m_World.GetState() != GameState::ONGOING;
+}
+
+//-----------------------------------------------------------------------------
+// Name : WaitForIdleTick () (Private)
+// Desc : Advances an idle frame at most IDLE_FRAME_RATE times per second and
+//		blocks on the message queue in between, so static screens do not keep
+//		a core busy.
+//-----------------------------------------------------------------------------
+void CGameApp::WaitForIdleTick()
+{
+	DWORD dwFrameTime	= 1000 / IDLE_FRAME_RATE;
+	DWORD dwElapsed		= timeGetTime() - m_dwLastIdleTick;
+
+	if ( dwElapsed < dwFrameTime )
+	{
+		// Returns early if a message arrives, the loop will handle it.
+		MsgWaitForMultipleObjects( 0, NULL, FALSE, dwFrameTime - dwElapsed, QS_ALLINPUT );
+		return;
+	}
+
+	m_dwLastIdleTick = timeGetTime();
+	FrameAdvance();
+}
+
 //-----------------------------------------------------------------------------
 // Name : ShutDown ()
 // Desc : Shuts down the game engine, and frees up all resources.
@@ -232,17 +355,27 @@ LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM
 			PostQuitMessage(0);
 			break;
 		
+		case WM_PAINT:
+			// Window contents were invalidated, make sure idle screens redraw.
+			m_bDirty = true;
+			return DefWindowProc(hWnd, Message, wParam, lParam);
+
 		case WM_SIZE:
 			if ( wParam == SIZE_MINIMIZED )
 			{
 				// App is inactive
+				if ( m_bActive ) m_dwMinimizedTime = timeGetTime();
 				m_bActive = false;
 			
 			} // App has been minimized
 			else
 			{
-				// App is active
+				// App is active, the idle ticks spent minimized were skipped
+				if ( !m_bActive && m_dwMinimizedTime )
+					m_nFramesSkipped += (timeGetTime() - m_dwMinimizedTime) * IDLE_FRAME_RATE / 1000;
+				m_dwMinimizedTime = 0;
 				m_bActive = true;
+				m_bDirty = true;
 
 				// Store new viewport sizes
 				m_nViewWidth  = LOWORD( lParam );
@@ -268,9 +401,26 @@ LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM
 			switch(wParam)
 			{
 			case VK_ESCAPE:
-				if (_gameState == GameState::ONGOING) _gameState = GameState::PAUSE;
+				if (m_World.GetState() == GameState::ONGOING) m_World.SetState(GameState::PAUSE);
 				else PostQuitMessage(0);
 				break;
+
+			case VK_F3:
+				// Toggle the runtime counters overlay
+				m_bShowCounters = !m_bShowCounters;
+				m_bDirty = true;
+				break;
+
+			case VK_F11:
+				// Write what the profiler recorded so far
+				CProfiler::Dump("profile.json");
+				break;
+
+			case VK_F12:
+				// Save the next frame as screenshot_NNNNNN.bmp
+				m_bScreenshot = true;
+				m_bDirty = true;
+				break;
 			}
 			break;
 
@@ -278,9 +428,9 @@ LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM
 			switch(wParam)
 			{
 			case 1:
-				if (!_Player1->AdvanceExplosion())
+				if (!m_World.Player1()->AdvanceExplosion())
 					KillTimer(m_hWnd, 1);
-				if (!_Player2->AdvanceExplosion())
+				if (!m_World.Player2()->AdvanceExplosion())
 					KillTimer(m_hWnd, 1);
 			}
 			break;
@@ -302,52 +452,162 @@ LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM
 //-----------------------------------------------------------------------------
 bool CGameApp::BuildObjects()
 {
+	PROFILE_FUNCTION();
+
+	static const char *szShipFiles[2][3] = {
+		{ "data/ship1.bmp", "data/ship1cw30.bmp", "data/ship1ccw30.bmp" },
+		{ "data/ship2.bmp", "data/ship2cw30.bmp", "data/ship2ccw30.bmp" }
+	};
+
+	long long llStart = CProfiler::Now();
+
+	// One mapping instead of a file per sprite, the loose bitmaps are still
+	// used when the pack has not been built. Kiosk builds have it compiled in.
+#ifdef EMBED_ASSETS
+	if (OpenEmbeddedAssets(m_AssetPack))
+#else
+	if (m_AssetPack.Open("data/assets.pak"))
+#endif
+		Sprite::setAssetPack(&m_AssetPack);
+
+	// Every load starts now, the sprites below only wait for their own
+	CAssetRequest *pBackground = m_AssetLoader.Load("data/background.bmp", CAssetLoader::LOAD_FOREGROUND, &m_imgBackground);
+	requestAssets();
+
 	_Buffer = new BackBuffer(m_hWnd, m_nViewWidth, m_nViewHeight);
-	_Player1 = new CPlayer(_Buffer, "data/ship1.bmp");
-	_Player2 = new CPlayer(_Buffer, "data/ship2.bmp");
-	_wonSprite = new Sprite("data/winscreen.bmp", RGB(0xff, 0x00, 0xff));
-	_lostSprite = new Sprite("data/losescreen.bmp", RGB(0xff, 0x00, 0xff));
 
-	_Player1->setTeam(CPlayer::TEAM::PLAYER1);
-	_Player2->setTeam(CPlayer::TEAM::PLAYER2);
+	// Units only hold their state, these sprites are shared by all of them
+	for (int team = 0; team < 2; team++) {
+		for (int tilt = 0; tilt < 3; tilt++) {
+			_shipSprites[team][tilt] = new Sprite(szShipFiles[team][tilt], RGB(0xff, 0x00, 0xff));
+			_shipSprites[team][tilt]->setBackBuffer(_Buffer);
+		}
+	}
+
+	_enemySprite = new Sprite("data/enemyship.bmp", RGB(0xff, 0x00, 0xff));
+	_enemySprite->setBackBuffer(_Buffer);
+
+	_bulletSprite = new Sprite("data/projectile.bmp", RGB(0xff, 0x00, 0xff));
+	_bulletSprite->setBackBuffer(_Buffer);
+
+	m_World.Init(_screenSize,
+		Vec2(_shipSprites[0][0]->width(), _shipSprites[0][0]->height()),
+		Vec2(_enemySprite->width(), _enemySprite->height()),
+		(unsigned int)time(NULL));
 
 	_scoreP1 = new ScoreSprite(Vec2(100, 200), _Buffer);
 	_scoreP2 = new ScoreSprite(Vec2(_screenSize.x - 140, 200.0), _Buffer);
 
 	gameMenu = new MenuSprite(Vec2(_screenSize.x / 2, _screenSize.y / 2 - 200), _Buffer);
 
-	_wonSprite->setBackBuffer(_Buffer);
-	_lostSprite->setBackBuffer(_Buffer);
-
 	addStars(20);
-	addEnemies(33);
+	m_World.AddEnemies(33);
 	setPLives(3, 3);
 
-	frameCounter = 0;
-
-	if(!m_imgBackground.LoadBitmapFromFile("data/background.bmp", GetDC(m_hWnd)))
+	if(pBackground->Get() == NULL)
 		return false;
 
+	// Kept in the smallest exact format, widened a band at a time per frame
+	m_cmpBackground.Compress(m_imgBackground);
+	m_imgBackground.Release();
+
+	CProfiler::Record("Startup: BuildObjects", llStart, CProfiler::Now(), 1);
+
 	// Success!
 	return true;
 }
 
 //-----------------------------------------------------------------------------
-// Name : SetupGameState ()
-// Desc : Sets up all the initial states required by the game.
+// Name : requestAssets () (Private)
+// Desc : Queues every bitmap the pack does not hold on the asset loader,
+//		the ones BuildObjects needs ahead of the rest.
 //-----------------------------------------------------------------------------
-void CGameApp::SetupGameState()
+void CGameApp::requestAssets()
 {
-	_Player1->Position() = Vec2(int(_screenSize.x / 3 * 1), int(_screenSize.y / 3 * 2));
-	_Player2->Position() = Vec2(int(_screenSize.x / 3 * 2), int(_screenSize.y / 3 * 2));
+	Sprite::setAssetLoader(&m_AssetLoader);
 
-	_Player1->frameCounter() = 200;
-	_Player2->frameCounter() = 200;
+	for (size_t i = 0; i < sizeof(g_szStartupFiles) / sizeof(g_szStartupFiles[0]); i++)
+	{
+		if (!m_AssetPack.Find(g_szStartupFiles[i]))
+			m_AssetLoader.Load(g_szStartupFiles[i], CAssetLoader::LOAD_FOREGROUND);
+	}
 
-	_wonSprite->mPosition = Vec2(int(_screenSize.x / 2), int(_screenSize.y / 2));
-	_lostSprite->mPosition = Vec2(int(_screenSize.x / 2), int(_screenSize.y / 2));
+	for (size_t i = 0; i < sizeof(g_szDeferredFiles) / sizeof(g_szDeferredFiles[0]); i++)
+	{
+		if (!m_AssetPack.Find(g_szDeferredFiles[i]))
+			m_AssetLoader.Load(g_szDeferredFiles[i], CAssetLoader::LOAD_BACKGROUND);
+	}
 
-	_gameState = GameState::START;
+	// The pack keeps the explosion's mask in its entry
+	if (!m_AssetPack.Find("data/explosion.bmp"))
+		m_AssetLoader.Load("data/explosionmask.bmp", CAssetLoader::LOAD_BACKGROUND);
+}
+
+//-----------------------------------------------------------------------------
+// Name : buildDeferredSprites () (Private)
+// Desc : Creates the win / lose screens and the explosion once their bitmaps
+//		finished loading in the background. Without bWait the ones still
+//		loading are left for a later frame.
+//-----------------------------------------------------------------------------
+void CGameApp::buildDeferredSprites(bool bWait)
+{
+	// Requests that do not exist mean the pack (or a direct load) has them
+	auto isLoaded = [this](const char *szFile) {
+		CAssetRequest *pRequest = m_AssetLoader.Find(szFile);
+		return pRequest == NULL || pRequest->IsReady();
+	};
+
+	if (_wonSprite == NULL && (bWait || isLoaded("data/winscreen.bmp"))) {
+		_wonSprite = new Sprite("data/winscreen.bmp", RGB(0xff, 0x00, 0xff));
+		_wonSprite->mPosition = Vec2(int(_screenSize.x / 2), int(_screenSize.y / 2));
+		_wonSprite->setBackBuffer(_Buffer);
+	}
+
+	if (_lostSprite == NULL && (bWait || isLoaded("data/losescreen.bmp"))) {
+		_lostSprite = new Sprite("data/losescreen.bmp", RGB(0xff, 0x00, 0xff));
+		_lostSprite->mPosition = Vec2(int(_screenSize.x / 2), int(_screenSize.y / 2));
+		_lostSprite->setBackBuffer(_Buffer);
+	}
+
+	if (_explosionSprite == NULL && (bWait || (isLoaded("data/explosion.bmp") && isLoaded("data/explosionmask.bmp")))) {
+		// Animation frame crop rectangle
+		RECT r;
+		r.left		= 0;
+		r.top		= 0;
+		r.right		= 128;
+		r.bottom	= 128;
+
+		_explosionSprite = new AnimatedSprite("data/explosion.bmp", "data/explosionmask.bmp", r, EXPLOSION_FRAME_COUNT);
+		_explosionSprite->setBackBuffer(_Buffer);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : recordStartup () (Private)
+// Desc : Adds the startup breakdown to the profile once the first frame was
+//		presented: window creation, BuildObjects and the first frame itself,
+//		under one "Startup" event.
+//-----------------------------------------------------------------------------
+void CGameApp::recordStartup()
+{
+	if (m_llStartupBegin == 0)
+		return;
+
+	long long llNow = CProfiler::Now();
+	CProfiler::Record("Startup: first frame", m_llStartupBuilt, llNow, 1);
+	CProfiler::Record("Startup", m_llStartupBegin, llNow, 0);
+	GAUGE_SET("startup us", (llNow - m_llStartupBegin) / 1000);
+
+	m_llStartupBegin = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetupGameState ()
+// Desc : Sets up all the initial states required by the game.
+//-----------------------------------------------------------------------------
+void CGameApp::SetupGameState()
+{
+	_drawnState = m_World.GetState();
 }
 
 //-----------------------------------------------------------------------------
@@ -357,15 +617,32 @@ void CGameApp::SetupGameState()
 //-----------------------------------------------------------------------------
 void CGameApp::ReleaseObjects( )
 {
-	if(_Player1 != NULL)
-	{
-		delete _Player1;
-		_Player1 = NULL;
+	// Frames still queued are written before the back buffer goes
+	m_Recorder.Stop();
+	m_Screenshots.Stop();
+
+	m_World.Release();
+
+	for (int team = 0; team < 2; team++) {
+		for (int tilt = 0; tilt < 3; tilt++) {
+			delete _shipSprites[team][tilt];
+			_shipSprites[team][tilt] = NULL;
+		}
 	}
 
-	if (_Player2 != NULL) {
-		delete _Player2;
-		_Player2 = NULL;
+	if (_enemySprite != NULL) {
+		delete _enemySprite;
+		_enemySprite = NULL;
+	}
+
+	if (_bulletSprite != NULL) {
+		delete _bulletSprite;
+		_bulletSprite = NULL;
+	}
+
+	if (_explosionSprite != NULL) {
+		delete _explosionSprite;
+		_explosionSprite = NULL;
 	}
 
 	if (_wonSprite != NULL) {
@@ -403,8 +680,6 @@ void CGameApp::ReleaseObjects( )
 		gameMenu = NULL;
 	}
 
-	while (!_enemies.empty()) delete _enemies.front(), _enemies.pop_front();
-	while (!_bullets.empty()) delete _bullets.front(), _bullets.pop_front();
 	while (!_stars.empty()) delete _stars.front(), _stars.pop_front();
 	while (!_livesBlue.empty()) delete _livesBlue.front(), _livesBlue.pop_front();
 	while (!_livesRed.empty()) delete _livesRed.front(), _livesRed.pop_front();
@@ -414,6 +689,10 @@ void CGameApp::ReleaseObjects( )
 		delete _Buffer;
 		_Buffer = NULL;
 	}
+
+	Sprite::setAssetPack(NULL);
+	Sprite::setAssetLoader(NULL);
+	m_AssetPack.Close();
 }
 
 //-----------------------------------------------------------------------------
@@ -429,7 +708,9 @@ void CGameApp::FrameAdvance()
 	m_Timer.Tick( );
 
 	// Skip if app is inactive
-	if ( !m_bActive ) return;
+	if ( !m_bActive ) { skipFrame(); return; }
+
+	PROFILE_SCOPE("FrameAdvance");
 	
 	// Get / Display the framerate
 	if ( m_LastFrameRate != m_Timer.GetFrameRate() )
@@ -441,16 +722,108 @@ void CGameApp::FrameAdvance()
 	} // End if Frame Rate Altered
 
 	// Poll & Process input devices
-	ProcessInput();
+	{ PROFILE_SCOPE("ProcessInput"); ProcessInput(); }
+
+	// Simulation is suspended on idle screens, only redraw when something changed
+	if ( IsIdleState() )
+	{
+		if ( !m_bDirty && _drawnState == m_World.GetState() ) { skipFrame(); return; }
+
+		{ PROFILE_SCOPE("DrawObjects"); DrawObjects(); }
+		updateCounters();
+		PROFILE_FRAME_MARK();
+		return;
+	}
 
 	// Animate the game objects
-	AnimateObjects();
+	{ PROFILE_SCOPE("AnimateObjects"); AnimateObjects(); }
 
 	// Remove all dead units
-	removeDead();
+	{ PROFILE_SCOPE("RemoveDead"); m_World.RemoveDead(); }
 
 	// Drawing the game objects
-	DrawObjects();
+	{ PROFILE_SCOPE("DrawObjects"); DrawObjects(); }
+
+	updateCounters();
+	PROFILE_FRAME_MARK();
+}
+
+//-----------------------------------------------------------------------------
+// Name : skipFrame () (Private)
+// Desc : An idle tick with nothing to draw. The counters frame still ends,
+//		so the gauges keep moving on an unchanged screen.
+//-----------------------------------------------------------------------------
+void CGameApp::skipFrame()
+{
+	m_nFramesSkipped++;
+	updateCounters();
+}
+
+//-----------------------------------------------------------------------------
+// Name : updateCounters () (Private)
+// Desc : Publishes the entity gauges and closes the counters frame.
+//-----------------------------------------------------------------------------
+void CGameApp::updateCounters()
+{
+	m_World.PublishCounters();
+
+	GAUGE_SET("stars", _stars.size());
+	GAUGE_SET("lives blue", m_World.Player1()->getLives());
+	GAUGE_SET("lives red", m_World.Player2()->getLives());
+	GAUGE_SET("frames rendered", m_nFramesRendered);
+	GAUGE_SET("frames skipped", m_nFramesSkipped);
+
+	CCounters::EndFrame(CGameWorld::StateName(m_World.GetState()));
+}
+
+//-----------------------------------------------------------------------------
+// Name : captureFrame () (Private)
+// Desc : Copies the finished back buffer to the capture writers, which
+//		encode and write it on their own threads.
+//-----------------------------------------------------------------------------
+void CGameApp::captureFrame()
+{
+	if (m_bScreenshot)
+	{
+		m_bScreenshot = false;
+		if (!m_Screenshots.IsRunning())
+		{
+			CFrameCapture::SOptions options;
+			options.uBuffers = 2;
+			options.strPath = "screenshot";
+			m_Screenshots.Start(options, _Buffer->width(), _Buffer->height());
+		}
+
+		RGBQUAD *pFrame = m_Screenshots.BeginFrame();
+		if (pFrame && _Buffer->copyPixels(pFrame))
+			m_Screenshots.EndFrame();
+	}
+
+	RGBQUAD *pFrame = m_Recorder.BeginFrame();
+	if (pFrame && _Buffer->copyPixels(pFrame))
+		m_Recorder.EndFrame();
+}
+
+//-----------------------------------------------------------------------------
+// Name : drawCounterOverlay () (Private)
+// Desc : Prints the values of the last counters frame over the back buffer.
+//-----------------------------------------------------------------------------
+void CGameApp::drawCounterOverlay()
+{
+	HDC hDC = _Buffer->getDC();
+	TCHAR szLine[128];
+
+	int iOldMode = SetBkMode(hDC, TRANSPARENT);
+	COLORREF crOldText = SetTextColor(hDC, RGB(0xff, 0xff, 0x00));
+
+	for (unsigned i = 0; i < CCounters::GetCount(); i++)
+	{
+		int iLength = sprintf_s(szLine, _T("%s: %lld"), CCounters::GetName(i), CCounters::GetLastValue(i));
+		TextOut(hDC, 10, _Buffer->height() - 20 * (CCounters::GetCount() - i) - 10, szLine, iLength);
+	}
+
+	SetTextColor(hDC, crOldText);
+	SetBkMode(hDC, iOldMode);
 }
 
 //-----------------------------------------------------------------------------
@@ -460,27 +833,31 @@ void CGameApp::FrameAdvance()
 void CGameApp::ProcessInput()
 {
 	static UCHAR	pKeyBuffer[256];
-	ULONG			Direction = 0;
 	POINT			CursorPos;
-	float			X = 0.0f, Y = 0.0f;
-	ULONG			p2Direction = 0;
+	CGameWorld::SInput input;
 
 	// Retrieve keyboard state
 	if (!GetKeyboardState(pKeyBuffer)) return;
 
-	if (_gameState == GameState::START || _gameState == GameState::PAUSE) {
-		if (pKeyBuffer[VK_UP] & 0xF0 && gameMenu->frameCounter >= 20) {
-			gameMenu->opUp(_gameState);
+	GameState state = m_World.GetState();
+
+	if (state == GameState::START || state == GameState::PAUSE) {
+		gameMenu->frameCounter++;
+
+		if (pKeyBuffer[VK_UP] & 0xF0 && gameMenu->frameCounter >= MENU_REPEAT_TICKS) {
+			gameMenu->opUp(state);
 			gameMenu->frameCounter = 0;
+			m_bDirty = true;
 		}
-		if (pKeyBuffer[VK_DOWN] & 0xF0 && gameMenu->frameCounter >= 20) {
-			gameMenu->opDown(_gameState);
+		if (pKeyBuffer[VK_DOWN] & 0xF0 && gameMenu->frameCounter >= MENU_REPEAT_TICKS) {
+			gameMenu->opDown(state);
 			gameMenu->frameCounter = 0;
+			m_bDirty = true;
 		}
 		
 		if (pKeyBuffer[VK_RETURN] & 0xF0) {
 			if (gameMenu->getChoice() == 0)
-				_gameState = GameState::ONGOING;
+				m_World.SetState(GameState::ONGOING);
 
 			if (gameMenu->getChoice() == 1)
 				loadGame();
@@ -490,45 +867,29 @@ void CGameApp::ProcessInput()
 		}
 	}
 
-	if (_gameState == GameState::ONGOING) {
+	if (m_World.GetState() == GameState::ONGOING) {
 		if (pKeyBuffer[VK_PAUSE] & 0xF0) {
-			_gameState = GameState::PAUSE;
+			m_World.SetState(GameState::PAUSE);
 		}
 	}
 
 	// Check the relevant keys
 	// keybinds for player
-	// only do something if player is alive
-	if (!_Player1->isDead()) {
-		if (pKeyBuffer[0x57] & 0xF0) Direction |= CPlayer::DIR_FORWARD;
-		if (pKeyBuffer[0x53] & 0xF0) Direction |= CPlayer::DIR_BACKWARD;
-		if (pKeyBuffer[0x41] & 0xF0) Direction |= CPlayer::DIR_LEFT;
-		if (pKeyBuffer[0x44] & 0xF0) Direction |= CPlayer::DIR_RIGHT;
-		if (pKeyBuffer[VK_SPACE] & 0xF0 && _Player1->frameCounter() >= 50) {
-			SpawnBullet(_Player1->Position(), Vec2(0, -400), CPlayer::TEAM::PLAYER1);
-			_Player1->frameCounter() = 0;
-		}
-	}
-
-	// keybinds for enemy
-	// only do something if enemy is alive
-	if (!_Player2->isDead()) {
-		if (pKeyBuffer[VK_NUMPAD8] & 0xF0) p2Direction |= CPlayer::DIR_FORWARD;
-		if (pKeyBuffer[VK_NUMPAD5] & 0xF0) p2Direction |= CPlayer::DIR_BACKWARD;
-		if (pKeyBuffer[VK_NUMPAD4] & 0xF0) p2Direction |= CPlayer::DIR_LEFT;
-		if (pKeyBuffer[VK_NUMPAD6] & 0xF0) p2Direction |= CPlayer::DIR_RIGHT;
-		if (pKeyBuffer[VK_NUMPAD0] & 0xF0 && _Player2->frameCounter() >= 50) {
-			SpawnBullet(_Player2->Position(), Vec2(0, -400), CPlayer::TEAM::PLAYER2);
-			_Player2->frameCounter() = 0;
-		}
-	}
-	
-	// Move the player
-	_Player1->Move(Direction);
-
-	// move the enemy
-	_Player2->Move(p2Direction);
-
+	if (pKeyBuffer[0x57] & 0xF0) input.ulP1Direction |= CPlayer::DIR_FORWARD;
+	if (pKeyBuffer[0x53] & 0xF0) input.ulP1Direction |= CPlayer::DIR_BACKWARD;
+	if (pKeyBuffer[0x41] & 0xF0) input.ulP1Direction |= CPlayer::DIR_LEFT;
+	if (pKeyBuffer[0x44] & 0xF0) input.ulP1Direction |= CPlayer::DIR_RIGHT;
+	input.bP1Fire = (pKeyBuffer[VK_SPACE] & 0xF0) != 0;
+
+	// keybinds for the second player
+	if (pKeyBuffer[VK_NUMPAD8] & 0xF0) input.ulP2Direction |= CPlayer::DIR_FORWARD;
+	if (pKeyBuffer[VK_NUMPAD5] & 0xF0) input.ulP2Direction |= CPlayer::DIR_BACKWARD;
+	if (pKeyBuffer[VK_NUMPAD4] & 0xF0) input.ulP2Direction |= CPlayer::DIR_LEFT;
+	if (pKeyBuffer[VK_NUMPAD6] & 0xF0) input.ulP2Direction |= CPlayer::DIR_RIGHT;
+	input.bP2Fire = (pKeyBuffer[VK_NUMPAD0] & 0xF0) != 0;
+
+	// Move the players and fire, ignored unless the game is running
+	m_World.ApplyInput(input);
 
 	// Now process the mouse (if the button is pressed)
 	if ( GetCapture() == m_hWnd )
@@ -552,43 +913,11 @@ void CGameApp::ProcessInput()
 void CGameApp::AnimateObjects()
 {
 	scrollBackground(m_Timer.GetTimeElapsed());
-	updateGameState();
-
-	switch (_gameState) {
-	case GameState::ONGOING:
-		if (!_Player1->isDead()) {
-			_Player1->Update(m_Timer.GetTimeElapsed());
-			_Player1->frameCounter()++;
-		}
-		if (!_Player2->isDead()) {
-			_Player2->Update(m_Timer.GetTimeElapsed());
-			_Player2->frameCounter()++;
-		}
 
-		holdInside(*_Player1);
-		holdInside(*_Player2);
-
-		for (auto bul : _bullets) {
-			bul->update(m_Timer.GetTimeElapsed());
-
-			if (bul->team == CPlayer::TEAM::ENEMY) {
-				trackPlayer(*bul);
-			}
-			if (detectCollision(bul) || bul->mPosition.y >= _screenSize.y || bul->mPosition.y <= 0) {
-				_bullets.remove(bul);
-				break;
-			}
-		}
-
-		moveEnemies();
-
-		for (auto enem : _enemies) {
-			enem->Update(m_Timer.GetTimeElapsed());
-		}
-
-		enemyFire();
-		break;
+	m_World.Animate(m_Timer.GetTimeElapsed());
+	syncScores();
 
+	switch (m_World.GetState()) {
 	case GameState::WON:
 		_scoreP1->move(Vec2(_screenSize.x / 2 - 150, _screenSize.y / 2 + 200));
 		_scoreP2->move(Vec2(_screenSize.x / 2 + 150, _screenSize.y / 2 + 200));
@@ -609,45 +938,57 @@ void CGameApp::DrawObjects()
 {
 	_Buffer->reset();
 
-	m_imgBackground.Paint(_Buffer->getDC(), 0, 0);
+	m_cmpBackground.Paint(_Buffer->getDC(), 0, 0);
 
 	for (auto star : _stars) {
 		star->draw();
 	}
 
-	gameMenu->draw(_gameState);
+	GameState state = m_World.GetState();
+	gameMenu->draw(state);
+
+	// The menu is drawn while the rest loads, every other screen may need it
+	buildDeferredSprites(state != GameState::START);
 
-	switch (_gameState) {
+	switch (state) {
 	case GameState::START:
 		break;
 
 	case GameState::ONGOING:
+	{
+		CPlayer *pPlayer1 = m_World.Player1();
+		CPlayer *pPlayer2 = m_World.Player2();
+		int iLives;
+
 		_scoreP1->draw();
 		_scoreP2->draw();
 
-		if (!_Player1->isDead())
-			_Player1->Draw();
+		if (!pPlayer1->isDead())
+			drawUnit(*pPlayer1, _shipSprites[0][pPlayer1->getTilt()]);
 
-		if (!_Player2->isDead())
-			_Player2->Draw();
+		if (!pPlayer2->isDead())
+			drawUnit(*pPlayer2, _shipSprites[1][pPlayer2->getTilt()]);
 
+		iLives = pPlayer1->getLives();
 		for (auto lb : _livesBlue)
-			lb->draw();
+			if (iLives-- > 0) lb->draw();
 
+		iLives = pPlayer2->getLives();
 		for (auto lr : _livesRed)
-			lr->draw();
+			if (iLives-- > 0) lr->draw();
 
-		for (auto bul : _bullets)
-			bul->draw();
+		for (auto bul : m_World.Bullets()) {
+			_bulletSprite->mPosition = bul->mPosition;
+			_bulletSprite->draw();
+		}
 
 		_livesText.first->draw();
 		_livesText.second->draw();
 
-		for (auto enem : _enemies) {
-			enem->Draw();
-			enem->frameCounter()++;
-		}
+		for (auto enem : m_World.Enemies())
+			drawUnit(*enem, _enemySprite);
 		break;
+	}
 	case GameState::LOST:
 		_scoreP1->draw();
 		_scoreP2->draw();
@@ -670,100 +1011,36 @@ void CGameApp::DrawObjects()
 		break;
 	}
 
-	_Buffer->present();
-}
-
-//-----------------------------------------------------------------------------
-// Name : SpawnBullet () (Private)
-// Desc : Spawns a bullet with position, velocity and team given as arguments
-//-----------------------------------------------------------------------------
-void CGameApp::SpawnBullet(const Vec2 position, const Vec2 velocity, const CPlayer::TEAM team)
-{
-	_bullets.push_back(new Bullet("data/projectile.bmp", RGB(0xff, 0x00, 0xff)));
-
-	auto& lastAdd = _bullets.back();
+	if (m_bShowCounters)
+		drawCounterOverlay();
 
-	lastAdd->setBackBuffer(_Buffer);
-	lastAdd->mPosition = position;
-	lastAdd->mVelocity = velocity;
-	lastAdd->team = team;
+	captureFrame();
+	_Buffer->present();
+	recordStartup();
 
-	if (velocity.y < 0) {
-		_bullets.back()->mPosition.y -= 75;
-	}
-	else {
-		_bullets.back()->mPosition.y += 75;
-	}
+	m_bDirty = false;
+	_drawnState = state;
+	m_nFramesRendered++;
 }
 
 //-----------------------------------------------------------------------------
-// Name : detectCollision () (Private)
-// Desc : This function is called for each bullet spawned at one time to detect
-// if it has hit something.
+// Name : drawUnit () (Private)
+// Desc : Draws a unit with the given sprite, or the explosion if it has
+//		been hit.
 //-----------------------------------------------------------------------------
-bool CGameApp::detectCollision(const Bullet* bullet)
+void CGameApp::drawUnit(CPlayer& unit, Sprite* sprite)
 {
-	if (bulletUnitCollision(*bullet, *_Player1) && bullet->team == CPlayer::TEAM::ENEMY && !_Player1->hasExploded()) {
-		_Player1->takeDamage();
-
-		delete _livesBlue.back();
-		_livesBlue.pop_back();
-		
-		return true;
+	if (unit.hasExploded()) {
+		_explosionSprite->SetFrame(unit.getExplosionFrame());
+		_explosionSprite->mPosition = unit.getExplosionPosition();
+		_explosionSprite->draw();
 	}
-	
-	if (bulletUnitCollision(*bullet, *_Player2) && bullet->team == CPlayer::TEAM::ENEMY && !_Player2->hasExploded()) {
-		_Player2->takeDamage();
-
-		delete _livesRed.back();
-		_livesRed.pop_back();
-		
-		return true;
-	}
-
-	for (auto enem : _enemies) {
-		if (bulletUnitCollision(*bullet, *enem)) {
-			if (enem->hasExploded()) {
-				return false;
-			}
-			if (bullet->team == CPlayer::TEAM::PLAYER1) {
-				_scoreP1->updateScore(100);
-			}
-			else if (bullet->team == CPlayer::TEAM::PLAYER2) {
-				_scoreP2->updateScore(100);
-			}
-			else {
-				return false;
-			}
-			
-			enem->Explode();
-			return true;
-		}
+	else {
+		sprite->mPosition = unit.Position();
+		sprite->draw();
 	}
-
-	return false;
- }
-
-//-----------------------------------------------------------------------------
-// Name : bulletUnitCollision () (Private)
-// Desc : Function that checks when a bullet has colided with a given 
-// player unit
-//-----------------------------------------------------------------------------
-bool CGameApp::bulletUnitCollision(const Bullet& bullet, CPlayer& unit)
-{
-	if (unit.isDead())
-		return false;
-
-	if (bullet.mPosition.x >= unit.Position().x - (unit.getSize().x / 2))
-		if (bullet.mPosition.x <= unit.Position().x + (unit.getSize().x / 2))
-			if (bullet.mPosition.y >= unit.Position().y - (unit.getSize().y / 2))
-				if (bullet.mPosition.y <= unit.Position().y + (unit.getSize().y / 2))
-					return true;
-
-	return false;
 }
 
-
 //-----------------------------------------------------------------------------
 // Name : addStars () (Private)
 // Desc : Adds specified number of stars in the background.
@@ -791,8 +1068,6 @@ void CGameApp::addStars(int noStars)
 //-----------------------------------------------------------------------------
 void CGameApp::scrollBackground(float dt)
 {
-	srand(time(NULL));
-
 	for (auto star : _stars) {
 		if (star->mPosition.y >= _screenSize.y) {
 			star->mPosition.y = 0;
@@ -802,185 +1077,34 @@ void CGameApp::scrollBackground(float dt)
 	}
 }
 
-//-----------------------------------------------------------------------------
-// Name : addEnemies () (Private)
-// Desc : Adds specified number of enemies.
-//-----------------------------------------------------------------------------
-void CGameApp::addEnemies(int noEnemies)
-{
-	srand(time(NULL));
-	Vec2 position = Vec2(_screenSize.x / 2 - 500, 50.0);
-	
-	for (int it = 0; it != noEnemies; ++it) {
-		_enemies.push_back(new CPlayer(_Buffer, "data/enemyship.bmp"));
-
-		auto& lastAdd = _enemies.back();
-
-		lastAdd->Position() = position;
-		lastAdd->Velocity() = Vec2(0, 0);
-		lastAdd->frameCounter() = rand() % 2000;
-		lastAdd->setTeam(CPlayer::TEAM::ENEMY);
-
-		position.x += 100;
-		if (position.x > _screenSize.x / 2 + 500) {
-			position.x = _screenSize.x / 2 - 500;
-			position.y += 90;
-		}
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Name : enemyFire () (Private)
-// Desc : Iterates trough all the enemies and makes them fire using a
-// random pattern.
-//-----------------------------------------------------------------------------
-void CGameApp::enemyFire()
-{
-	srand(time(NULL));
-
-	for (auto enem : _enemies) {
-		if (enem->frameCounter() == 2000) {
-			enem->frameCounter() = rand() % 1500;
-			SpawnBullet(enem->Position(), Vec2(0, 200), CPlayer::TEAM::ENEMY);
-		}
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Name : holdInside () (Private)
-// Desc : Holds a player unit inside of the playable window.
-//-----------------------------------------------------------------------------
-void CGameApp::holdInside(CPlayer& unit) 
-{
-	// bind player inside right margin
-	if (unit.Position().x + (unit.getSize().x / 2) >= _screenSize.x) {
-		unit.Position().x = _screenSize.x - (unit.getSize().x / 2);
-	}
-
-	// bind player inside left margin
-	if (unit.Position().x - (unit.getSize().x / 2) <= 0) {
-		unit.Position().x = unit.getSize().x / 2;
-	}
-
-	// bind player inside bottom marin
-	if (unit.Position().y + (unit.getSize().y / 2) >= _screenSize.y) {
-		unit.Position().y = _screenSize.y - (unit.getSize().y / 2);
-	}
-
-	// bind player inside top margin
-	if (unit.Position().y - (unit.getSize().y / 2) <= 0) {
-		unit.Position().y = unit.getSize().y / 2;
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Name : removeDead () (Private)
-// Desc : Removes all dead enemies from the game.
-//-----------------------------------------------------------------------------
-void CGameApp::removeDead()
-{
-	if (!_Player1->getLives() && !_Player1->hasExploded()) {
-		_Player1->Explode();
-	}
-		
-
-	if (!_Player2->getLives() && !_Player2->hasExploded())
-		_Player2->Explode();
-
-	for (auto enem : _enemies) {
-		if (enem->isDead()) {
-			delete enem;
-			_enemies.remove(enem);
-			break;
-		}
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Name : btpDistance () (Private)
-// Desc : Calculates bullet to player unit distance.
-//-----------------------------------------------------------------------------
-double btpDistance(Sprite& bullet, CPlayer& player)
-{
-	return bullet.mPosition.Distance(player.Position());
-}
-
-//-----------------------------------------------------------------------------
-// Name : moveTowards () (Private)
-// Desc : Moves a bullet towards a specified destination.
-//-----------------------------------------------------------------------------
-void moveTowards(Sprite& bullet, const Vec2 destination)
-{
-	if (bullet.mPosition.x > destination.x) {
-		bullet.mVelocity.x -= 2;
-	}
-	else {
-		bullet.mVelocity.x += 2;
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Name : trackPlayer () (Private)
-// Desc : Moves a bullet towards the closest alive player.
-//-----------------------------------------------------------------------------
-void CGameApp::trackPlayer(Sprite& bullet) 
-{
-	if (_Player1->isDead() && !_Player2->isDead()) {
-		moveTowards(bullet, _Player2->Position());
-	}
-	else if (_Player2->isDead() && !_Player1->isDead()) {
-		moveTowards(bullet, _Player1->Position());
-	}
-	else if (!_Player1->isDead() && !_Player2->isDead()) {
-		if (btpDistance(bullet, *_Player1) < btpDistance(bullet, *_Player2)) {
-			moveTowards(bullet, _Player1->Position());
-		}
-		else {
-			moveTowards(bullet, _Player2->Position());
-		}
-	}
-}
-
-//-----------------------------------------------------------------------------
-// Name : updateGameState () (Private)
-// Desc : Updates the game state when all players or all enemies have died.
-//-----------------------------------------------------------------------------
-void CGameApp::updateGameState()
-{
-	if (_Player1->isDead() && _Player2->isDead() && _gameState == ONGOING) {
-		_gameState = LOST;
-	}
-	else if (!_enemies.size() && _gameState == ONGOING) {
-		_gameState = WON;
-	}
-	else if (_gameState == ONGOING) {
-		_gameState = ONGOING;
-	}
-}
-
 //-----------------------------------------------------------------------------
 // Name : setPLives () (Private)
 // Desc : Sets number of lives for all players and also adds the heart sprite.
 //-----------------------------------------------------------------------------
 void CGameApp::setPLives(int livesP1, int livesP2)
 {
-	_Player1->setLives(livesP1);
-	_Player2->setLives(livesP2);
+	m_World.SetLives(livesP1, livesP2);
+
+	while (_livesBlue.size()) delete _livesBlue.back(), _livesBlue.pop_back();
+	while (_livesRed.size()) delete _livesRed.back(), _livesRed.pop_back();
 
 	Vec2 bluePos(30, 125);
 	Vec2 redPos(_screenSize.x - 50, 125.0);
 	Vec2 increment(55, 0);
 
-	_livesText.first = new Sprite("data/lives_text.bmp", RGB(0xff, 0x00, 0xff));
-	_livesText.second = new Sprite("data/lives_text.bmp", RGB(0xff, 0x00, 0xff));
-
-	_livesText.first->mPosition = Vec2(100, 50);
-	_livesText.first->mVelocity = Vec2(0, 0);
-	_livesText.first->setBackBuffer(_Buffer);
+	if (_livesText.first == NULL) {
+		_livesText.first = new Sprite("data/lives_text.bmp", RGB(0xff, 0x00, 0xff));
+		_livesText.first->mPosition = Vec2(100, 50);
+		_livesText.first->mVelocity = Vec2(0, 0);
+		_livesText.first->setBackBuffer(_Buffer);
+	}
 
-	_livesText.second->mPosition = Vec2(_screenSize.x - 140, 50.0);
-	_livesText.second->mVelocity = Vec2(0, 0);
-	_livesText.second->setBackBuffer(_Buffer);
+	if (_livesText.second == NULL) {
+		_livesText.second = new Sprite("data/lives_text.bmp", RGB(0xff, 0x00, 0xff));
+		_livesText.second->mPosition = Vec2(_screenSize.x - 140, 50.0);
+		_livesText.second->mVelocity = Vec2(0, 0);
+		_livesText.second->setBackBuffer(_Buffer);
+	}
 
 	for (int it = 0; it != livesP1; ++it) {
 		_livesBlue.push_back(new Sprite("data/heart_blue.bmp", RGB(0xff, 0x00, 0xff)));
@@ -1006,31 +1130,21 @@ void CGameApp::setPLives(int livesP1, int livesP2)
 	}
 }
 
-void CGameApp::moveEnemies()
+//-----------------------------------------------------------------------------
+// Name : syncScores () (Private)
+// Desc : Updates the score counters when the world score changed, the digit
+//		sprites are only reloaded then.
+//-----------------------------------------------------------------------------
+void CGameApp::syncScores()
 {
-	frameCounter++;
+	int scoreP1 = m_World.GetScore(CPlayer::TEAM::PLAYER1);
+	int scoreP2 = m_World.GetScore(CPlayer::TEAM::PLAYER2);
 
-	if (frameCounter > 1400) {
-		frameCounter = 0;
-	}
+	if (_scoreP1->getScore() != scoreP1)
+		_scoreP1->setScore(scoreP1);
 
-	for (auto enem : _enemies) {
-		if (frameCounter <= 300) {
-			enem->Velocity() = Vec2(-20, 0);
-		}
-		else if (frameCounter <= 400) {
-			enem->Velocity() = Vec2(0, 20);
-		}
-		else if (frameCounter <= 1000) {
-			enem->Velocity() = Vec2(20, 0);
-		}
-		else if (frameCounter <= 1100) {
-			enem->Velocity() = Vec2(0, -20);
-		}
-		else if (frameCounter <= 1400) {
-			enem->Velocity() = Vec2(-20, 0);
-		}
-	}
+	if (_scoreP2->getScore() != scoreP2)
+		_scoreP2->setScore(scoreP2);
 }
 
 //-----------------------------------------------------------------------------
@@ -1039,16 +1153,7 @@ void CGameApp::moveEnemies()
 //-----------------------------------------------------------------------------
 void CGameApp::saveGame()
 {
-	std::ofstream save("savegame/savegame.save");
-	
-	save << _Player1->Position().x << " " << _Player1->Position().y << " " << _Player1->getLives() << " ";
-	save << _scoreP1->getScore() << "\n";
-	save << _Player2->Position().x << " " << _Player2->Position().y << " " << _Player2->getLives() << " ";
-	save << _scoreP2->getScore() << "\n";
-
-	save << _enemies.size() << "\n";
-
-	save.close();
+	m_World.Save("savegame/savegame.save");
 }
 
 //-----------------------------------------------------------------------------
@@ -1057,28 +1162,9 @@ void CGameApp::saveGame()
 //-----------------------------------------------------------------------------
 void CGameApp::loadGame()
 {
-	std::ifstream save("savegame/savegame.save");
-	while (_enemies.size()) delete _enemies.back(), _enemies.pop_back();
-	while (_bullets.size()) delete _bullets.back(), _bullets.pop_back();
-	while (_livesBlue.size()) delete _livesBlue.back(), _livesBlue.pop_back();
-	while (_livesRed.size()) delete _livesRed.back(), _livesRed.pop_back();
-
-	double cdx, cdy;
-	int livesP1, livesP2, score, noEnem;
-
-	save >> cdx >> cdy >> livesP1 >> score;
-	_Player1->Position() = Vec2(cdx, cdy);
-	_scoreP1->setScore(score);
-
-	save >> cdx >> cdy >> livesP2 >> score;
-	_Player2->Position() = Vec2(cdx, cdy);
-	_scoreP2->setScore(score);
-
-	setPLives(livesP1, livesP2);
-	
-	save >> noEnem;
-	addEnemies(noEnem);
+	if (!m_World.Load("savegame/savegame.save"))
+		return;
 
-	save.close();
-	_gameState = GameState::ONGOING;
+	setPLives(m_World.Player1()->getLives(), m_World.Player2()->getLives());
+	syncScores();
 }
@@ -2,7 +2,7 @@
 // File: CPlayer.cpp
 //
 // Desc: This file stores the player object class. This class performs tasks
-//       such as player movement, some minor physics as well as rendering.
+//       such as player movement, some minor physics and the explosion state.
 //
 // Original design by Adam Hoult & Gary Simmons. Modified by Mihai Popescu.
 //-----------------------------------------------------------------------------
@@ -16,31 +16,20 @@
 // Name : CPlayer () (Constructor)
 // Desc : CPlayer Class Constructor
 //-----------------------------------------------------------------------------
-CPlayer::CPlayer(const BackBuffer *pBackBuffer, const char* texturePath)
+CPlayer::CPlayer(TEAM team, const Vec2& size)
 {
-	_sprite		= new Sprite(texturePath, RGB(0xff, 0x00, 0xff));
-	_speedState	= SPEED_STOP;
-	_timer		= 0;
-	_isDead		= false;
-	_lives		= 1;
+	_size			= size;
+	_team			= team;
+	_frameCounter	= 0;
+	_tilt			= TILT_NONE;
+	_speedState		= SPEED_STOP;
+	_timer			= 0;
+	_isDead			= false;
+	_lives			= 1;
 
-	_sprite->setBackBuffer(pBackBuffer);
-
-	_BF = pBackBuffer;
-
-	// Animation frame crop rectangle
-	RECT r;
-	r.left		= 0;
-	r.top		= 0;
-	r.right		= 128;
-	r.bottom	= 128;
-
-	// Set animation texture
-	_explosionSprite	= new AnimatedSprite("data/explosion.bmp", "data/explosionmask.bmp", r, 16);
 	_explosion			= false;
 	_explosionFrame		= 0;
-
-	_explosionSprite->setBackBuffer(pBackBuffer);
+	_explosionShown		= 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -49,106 +38,39 @@ CPlayer::CPlayer(const BackBuffer *pBackBuffer, const char* texturePath)
 //-----------------------------------------------------------------------------
 CPlayer::~CPlayer()
 {
-	delete _sprite;
-	delete _explosionSprite;
 }
 
 void CPlayer::Update(float dt)
 {
-	// passive slowdown
-	if (_sprite->mVelocity.x > 0) {
-		_sprite->mVelocity.x--;
-
-		if (_team != TEAM::ENEMY) {
-			Vec2 tempPos = _sprite->mPosition;
-			Vec2 tempVel = _sprite->mVelocity;
-			int tempFC = _sprite->frameCounter;
-
-			delete _sprite;
-
-			if (_team == TEAM::PLAYER1) {
-				_sprite = new Sprite("data/ship1cw30.bmp", RGB(0xff, 0x00, 0xff));
-				_sprite->mPosition = tempPos;
-				_sprite->mVelocity = tempVel;
-				_sprite->frameCounter = tempFC;
-				_sprite->setBackBuffer(_BF);
-			}
-			else if (_team == TEAM::PLAYER2) {
-				_sprite = new Sprite("data/ship2cw30.bmp", RGB(0xff, 0x00, 0xff));
-				_sprite->mPosition = tempPos;
-				_sprite->mVelocity = tempVel;
-				_sprite->frameCounter = tempFC;
-				_sprite->setBackBuffer(_BF);
-			}
-		}
+	// passive slowdown, the ship banks while it drifts sideways
+	if (_velocity.x > 0) {
+		_velocity.x--;
+		_tilt = TILT_CW;
 	}
-	else if (_sprite->mVelocity.x < 0) {
-		_sprite->mVelocity.x++;
-
-		if (_team != TEAM::ENEMY) {
-			Vec2 tempPos = _sprite->mPosition;
-			Vec2 tempVel = _sprite->mVelocity;
-			int tempFC = _sprite->frameCounter;
-
-			delete _sprite;
-
-			if (_team == TEAM::PLAYER1) {
-				_sprite = new Sprite("data/ship1ccw30.bmp", RGB(0xff, 0x00, 0xff));
-				_sprite->mPosition = tempPos;
-				_sprite->mVelocity = tempVel;
-				_sprite->frameCounter = tempFC;
-				_sprite->setBackBuffer(_BF);
-			}
-			else if (_team == TEAM::PLAYER2) {
-				_sprite = new Sprite("data/ship2ccw30.bmp", RGB(0xff, 0x00, 0xff));
-				_sprite->mPosition = tempPos;
-				_sprite->mVelocity = tempVel;
-				_sprite->frameCounter = tempFC;
-				_sprite->setBackBuffer(_BF);
-			}
-		}
+	else if (_velocity.x < 0) {
+		_velocity.x++;
+		_tilt = TILT_CCW;
 	}
 	else {
-		if (_team != TEAM::ENEMY) {
-			Vec2 tempPos = _sprite->mPosition;
-			Vec2 tempVel = _sprite->mVelocity;
-			int tempFC = _sprite->frameCounter;
-
-			delete _sprite;
-
-			if (_team == TEAM::PLAYER1) {
-				_sprite = new Sprite("data/ship1.bmp", RGB(0xff, 0x00, 0xff));
-				_sprite->mPosition = tempPos;
-				_sprite->mVelocity = tempVel;
-				_sprite->frameCounter = tempFC;
-				_sprite->setBackBuffer(_BF);
-			}
-			else if (_team == TEAM::PLAYER2) {
-				_sprite = new Sprite("data/ship2.bmp", RGB(0xff, 0x00, 0xff));
-				_sprite->mPosition = tempPos;
-				_sprite->mVelocity = tempVel;
-				_sprite->frameCounter = tempFC;
-				_sprite->setBackBuffer(_BF);
-			}
-		}
+		_tilt = TILT_NONE;
 	}
 
-	if (_sprite->mVelocity.y > 0) {
-		_sprite->mVelocity.y--;
+	if (_velocity.y > 0) {
+		_velocity.y--;
 	}
-	else if (_sprite->mVelocity.y < 0) {
-		_sprite->mVelocity.y++;
+	else if (_velocity.y < 0) {
+		_velocity.y++;
 	}
 
-	// Update sprite
-	_sprite->update(dt);
+	// Update position
+	_position += _velocity * dt;
 
 	if (_explosion) {
 		AdvanceExplosion();
 	}
 
 	// Get velocity
-	double v = _sprite->mVelocity.Magnitude();
+	double v = _velocity.Magnitude();
 
 	// NOTE: for each async sound played Windows creates a thread for you
 	// but only one, so you cannot play multiple sounds at once.
@@ -188,15 +110,7 @@ void CPlayer::Update(float dt)
 	// http://www.codeproject.com/KB/audio-video/midiwrapper.aspx (with code also)
 }
 
-void CPlayer::Draw()
-{
-	if (!_explosion)
-		_sprite->draw();
-	else
-		_explosionSprite->draw();
-}
-
-void CPlayer::Move(ULONG ulDirection)
+void CPlayer::Move(unsigned long ulDirection)
 {
 	double acc			= 5;		// acceleration
 	double brk			= 5 * acc;	// break force
@@ -204,55 +118,55 @@ void CPlayer::Move(ULONG ulDirection)
 
 	// code to move forward
 	if (ulDirection & CPlayer::DIR_FORWARD) {
-		if (_sprite->mVelocity.y > 0)
-			_sprite->mVelocity.y -= brk;
-		else if (_sprite->mVelocity.y >= -topSpeed)
-			_sprite->mVelocity.y -= acc / 2;
+		if (_velocity.y > 0)
+			_velocity.y -= brk;
+		else if (_velocity.y >= -topSpeed)
+			_velocity.y -= acc / 2;
 	}
 
 	// code to move backward
 	if (ulDirection & CPlayer::DIR_BACKWARD) {
-		if (_sprite->mVelocity.y < 0)
-			_sprite->mVelocity.y += brk;
-		else if (_sprite->mVelocity.y <= topSpeed)
-			_sprite->mVelocity.y += acc / 2;
+		if (_velocity.y < 0)
+			_velocity.y += brk;
+		else if (_velocity.y <= topSpeed)
+			_velocity.y += acc / 2;
 	}
 
 	// code to move left
 	if (ulDirection & CPlayer::DIR_LEFT) {
-		if (_sprite->mVelocity.x > 0)
-			_sprite->mVelocity.x -= brk;
-		else if (_sprite->mVelocity.x >= -topSpeed)
-			_sprite->mVelocity.x -= acc;
+		if (_velocity.x > 0)
+			_velocity.x -= brk;
+		else if (_velocity.x >= -topSpeed)
+			_velocity.x -= acc;
 	}
 
 	// code to move right
 	if (ulDirection & CPlayer::DIR_RIGHT) {
-		if (_sprite->mVelocity.x < 0)
-			_sprite->mVelocity.x += brk;
-		else if (_sprite->mVelocity.x <= topSpeed)
-			_sprite->mVelocity.x += acc;
+		if (_velocity.x < 0)
+			_velocity.x += brk;
+		else if (_velocity.x <= topSpeed)
+			_velocity.x += acc;
 	}
 }
 
 Vec2& CPlayer::Position()
 {
-	return _sprite->mPosition;
+	return _position;
 }
 
 Vec2& CPlayer::Velocity()
 {
-	return _sprite->mVelocity;
+	return _velocity;
 }
 
 void CPlayer::Explode()
 {
-	_explosionSprite->SetFrame(0);
+	_explosionShown = 0;
 	
 	/// TODO: add explosion sound
 
-	_explosionSprite->mPosition = _sprite->mPosition;
-	_sprite->mVelocity			= Vec2(0, 0);
+	_explosionPosition	= _position;
+	_velocity			= Vec2(0, 0);
 	_explosion = true;
 }
 
@@ -260,9 +174,9 @@ bool CPlayer::AdvanceExplosion()
 {
 	if(_explosion)
 	{
-		_explosionSprite->SetFrame(_explosionFrame++);
+		_explosionShown = _explosionFrame++;
 
-		if(_explosionFrame == _explosionSprite->GetFrameCount())
+		if(_explosionFrame == EXPLOSION_FRAME_COUNT)
 		{
 			_isDead = true;
 			_explosion = false;
@@ -280,12 +194,12 @@ bool CPlayer::isDead()
 
 Vec2 CPlayer::getSize() 
 {
-	return Vec2(_sprite->width(), _sprite->height());
+	return _size;
 }
 
 int& CPlayer::frameCounter()
 {
-	return _sprite->frameCounter;
+	return _frameCounter;
 }
 
 void CPlayer::takeDamage()
@@ -312,3 +226,23 @@ void CPlayer::setTeam(TEAM team)
 {
 	_team = team;
 }
+
+CPlayer::TEAM CPlayer::getTeam()
+{
+	return _team;
+}
+
+CPlayer::TILT CPlayer::getTilt()
+{
+	return _tilt;
+}
+
+int CPlayer::getExplosionFrame()
+{
+	return _explosionShown;
+}
+
+const Vec2& CPlayer::getExplosionPosition()
+{
+	return _explosionPosition;
+}
\ No newline at end of file
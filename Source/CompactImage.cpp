@@ -0,0 +1,270 @@
+// CompactImage.cpp
+// Format choice, conversion and drawing of CCompactImage. Widening goes
+// through the EXPAND565 and EXPAND_INDEXED kernels of PixelKernels.h.
+#include "CompactImage.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+	const DWORD RGB_MASK = 0x00ffffff;
+	const DWORD NO_COLOR = 0xffffffff;		// Reserved bytes are masked off, no pixel matches it
+	const unsigned int INDEX_BITS = 10;		// Four slots per palette entry
+
+	DWORD ColorOf(const RGBQUAD &q)
+	{
+		DWORD p;
+		memcpy(&p, &q, sizeof(p));
+		return p & RGB_MASK;
+	}
+
+	WORD Pack565(DWORD p)
+	{
+		return WORD(((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x001f));
+	}
+
+	// True when widening Pack565(p) gives p back: every channel's low bits
+	// repeat its top ones
+	bool Exact565(DWORD p)
+	{
+		return ((p & 0xf8fcf8) | ((p >> 5) & 0x070007) | ((p >> 6) & 0x000300)) == p;
+	}
+
+	// Palette entries of the colors seen so far, open addressing on the color
+	struct SColorIndex
+	{
+		DWORD keys[1 << INDEX_BITS];
+		BYTE entries[1 << INDEX_BITS];
+		unsigned int uColors;
+
+		SColorIndex() : uColors(0) { memset(keys, 0xff, sizeof(keys)); }
+
+		// Entry of color, added to pPalette when new; -1 once the palette
+		// is full
+		int Find(DWORD color, RGBQUAD *pPalette)
+		{
+			const unsigned int uMask = (1 << INDEX_BITS) - 1;
+			unsigned int slot = (unsigned int)(color * 2654435761u) >> (32 - INDEX_BITS);
+
+			for (; keys[slot] != color; slot = (slot + 1) & uMask)
+			{
+				if (keys[slot] != NO_COLOR)
+					continue;
+				if (uColors == COMPACT_PALETTE_SIZE)
+					return -1;
+
+				keys[slot] = color;
+				entries[slot] = (BYTE)uColors;
+				if (pPalette)
+					memcpy(pPalette + uColors, &color, sizeof(color));
+				uColors++;
+				break;
+			}
+			return entries[slot];
+		}
+	};
+
+	size_t BytesPerPixel(ECompactFormat format)
+	{
+		return format == COMPACT_INDEXED8 ? 1 : (format == COMPACT_RGB565 ? 2 : 4);
+	}
+}
+
+CCompactImage::CCompactImage() : m_Format(COMPACT_RGB32), m_lWidth(0), m_lHeight(0)
+{
+}
+
+ECompactFormat CCompactImage::ChooseFormat(const RGBQUAD *pPixels, size_t count)
+{
+	SColorIndex index;
+	bool bIndexed = true, b565 = true;
+
+	// Runs of one color are common in sprites, they are looked up once
+	DWORD last = NO_COLOR;
+	for (size_t i = 0; i < count && (bIndexed || b565); i++)
+	{
+		DWORD color = ColorOf(pPixels[i]);
+		if (color == last)
+			continue;
+		last = color;
+
+		b565 = b565 && Exact565(color);
+		bIndexed = bIndexed && index.Find(color, NULL) >= 0;
+	}
+
+	// Tiny images do not pay for a palette
+	size_t indexedBytes = count + COMPACT_PALETTE_SIZE * sizeof(RGBQUAD);
+	if (bIndexed && indexedBytes < count * (b565 ? sizeof(WORD) : sizeof(RGBQUAD)))
+		return COMPACT_INDEXED8;
+	return b565 ? COMPACT_RGB565 : COMPACT_RGB32;
+}
+
+size_t CCompactImage::GetPixelBytes(ECompactFormat format, LONG lWidth, LONG lHeight)
+{
+	return (size_t)lWidth * lHeight * BytesPerPixel(format);
+}
+
+bool CCompactImage::Compress(const CImageFile &image)
+{
+	if (!image.Pixels())
+		return false;
+
+	return Compress(image.Pixels(), image.Width(), image.Height(),
+		ChooseFormat(image.Pixels(), (size_t)image.Width() * image.Height()));
+}
+
+bool CCompactImage::Compress(const CImageFile &image, ECompactFormat format)
+{
+	return Compress(image.Pixels(), image.Width(), image.Height(), format);
+}
+
+bool CCompactImage::Compress(const RGBQUAD *pPixels, LONG lWidth, LONG lHeight, ECompactFormat format)
+{
+	PROFILE_SCOPE("CCompactImage::Compress");
+
+	if (!pPixels || lWidth <= 0 || lHeight <= 0)
+		return false;
+
+	size_t count = (size_t)lWidth * lHeight;
+	std::vector<BYTE> pixels(GetPixelBytes(format, lWidth, lHeight));
+	std::vector<RGBQUAD> palette;
+
+	if (format == COMPACT_RGB565)
+	{
+		WORD *pDst = (WORD*)&pixels[0];
+		for (size_t i = 0; i < count; i++)
+		{
+			DWORD color = ColorOf(pPixels[i]);
+			if (!Exact565(color))
+				return false;
+			pDst[i] = Pack565(color);
+		}
+	}
+	else if (format == COMPACT_INDEXED8)
+	{
+		RGBQUAD black = { 0, 0, 0, 0 };
+		palette.assign(COMPACT_PALETTE_SIZE, black);
+
+		SColorIndex index;
+		DWORD last = NO_COLOR;
+		int iEntry = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			DWORD color = ColorOf(pPixels[i]);
+			if (color != last)
+			{
+				last = color;
+				iEntry = index.Find(color, &palette[0]);
+				if (iEntry < 0)
+					return false;
+			}
+			pixels[i] = (BYTE)iEntry;
+		}
+	}
+	else
+	{
+		DWORD *pDst = (DWORD*)&pixels[0];
+		for (size_t i = 0; i < count; i++)
+			pDst[i] = ColorOf(pPixels[i]);
+	}
+
+	m_Format = format;
+	m_lWidth = lWidth;
+	m_lHeight = lHeight;
+	m_Pixels.swap(pixels);
+	m_Palette.swap(palette);
+	return true;
+}
+
+void CCompactImage::Clear()
+{
+	m_Format = COMPACT_RGB32;
+	m_lWidth = m_lHeight = 0;
+	std::vector<BYTE>().swap(m_Pixels);
+	std::vector<RGBQUAD>().swap(m_Palette);
+	std::vector<RGBQUAD>().swap(m_Band);
+}
+
+void CCompactImage::Expand(RGBQUAD *pDst, size_t dstStride, const RECT *rc) const
+{
+	if (m_Pixels.empty())
+		return;
+
+	RECT rcAll = { 0, 0, m_lWidth - 1, m_lHeight - 1 };
+	Expand(m_Format, &m_Pixels[0], m_lWidth, Palette(), rc ? *rc : rcAll, pDst, dstStride);
+}
+
+void CCompactImage::Expand(ECompactFormat format, const BYTE *pPixels, LONG lWidth, const RGBQUAD *pPalette,
+	const RECT &rc, RGBQUAD *pDst, size_t dstStride)
+{
+	const SPixelKernels &kernels = GetPixelKernels();
+	size_t bpp = BytesPerPixel(format);
+	unsigned count = (unsigned)(rc.right - rc.left + 1);
+
+	for (LONG y = rc.top; y <= rc.bottom; y++, pDst += dstStride)
+	{
+		const BYTE *pRow = pPixels + ((size_t)y * lWidth + rc.left) * bpp;
+
+		switch (format)
+		{
+		case COMPACT_RGB565:	kernels.pfnExpand565((const WORD*)pRow, pDst, count); break;
+		case COMPACT_INDEXED8:	kernels.pfnExpandIndexed(pRow, pDst, count, pPalette); break;
+		default:				memcpy(pDst, pRow, count * sizeof(RGBQUAD)); break;
+		}
+	}
+}
+
+bool CCompactImage::ExpandTo(CImageFile &image) const
+{
+	if (m_Pixels.empty() || !image.Create(m_lWidth, m_lHeight))
+		return false;
+
+	Expand(image.Pixels(), m_lWidth);
+	return true;
+}
+
+#ifdef _WIN32
+
+void CCompactImage::Paint(HDC hdc, int x, int y)
+{
+	PROFILE_SCOPE("CCompactImage::Paint");
+
+	if (m_Pixels.empty())
+		return;
+
+	BITMAPINFO info;
+	ZeroMemory(&info, sizeof(info));
+	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	info.bmiHeader.biWidth = m_lWidth;
+	info.bmiHeader.biPlanes = 1;
+	info.bmiHeader.biBitCount = 32;
+	info.bmiHeader.biCompression = BI_RGB;
+
+	if (m_Format == COMPACT_RGB32)
+	{
+		info.bmiHeader.biHeight = m_lHeight;
+		StretchDIBits(hdc, x, y, m_lWidth, m_lHeight, 0, 0, m_lWidth, m_lHeight, &m_Pixels[0], &info,
+			DIB_RGB_COLORS, SRCCOPY);
+		return;
+	}
+
+	// Bands stay in the cache between being widened and blitted. They are
+	// bottom-up too, the first one is the bottom of the image.
+	m_Band.resize((size_t)m_lWidth * (std::min)(m_lHeight, COMPACT_PAINT_ROWS));
+
+	for (LONG lRow = 0; lRow < m_lHeight; lRow += COMPACT_PAINT_ROWS)
+	{
+		LONG lRows = (std::min)(COMPACT_PAINT_ROWS, m_lHeight - lRow);
+		RECT rc = { 0, lRow, m_lWidth - 1, lRow + lRows - 1 };
+		Expand(&m_Band[0], m_lWidth, &rc);
+
+		info.bmiHeader.biHeight = lRows;
+		StretchDIBits(hdc, x, y + m_lHeight - lRow - lRows, m_lWidth, lRows, 0, 0, m_lWidth, lRows, &m_Band[0],
+			&info, DIB_RGB_COLORS, SRCCOPY);
+	}
+}
+
+#endif // _WIN32
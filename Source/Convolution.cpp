@@ -0,0 +1,542 @@
+// Convolution.cpp
+// Tiled convolution of CConvolver. A tile filters its rows (separable
+// kernels) or whole window (the others) straight from the source when the
+// window lies inside the image, and from a copy with the border rule
+// applied when it does not.
+#include "Convolution.h"
+#include "ResizeEngine.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	const int MAX_TAPS = (std::max)(2 * CONVOLVE_MAX_RADIUS + 1, CONVOLVE_MAX_MATRIX * CONVOLVE_MAX_MATRIX);
+
+	// Index read for position i of a line of n, -1 for a black pixel
+	int MapBorder(int i, int n, EBorderMode mode)
+	{
+		if (i >= 0 && i < n)
+			return i;
+
+		switch (mode)
+		{
+		case BORDER_MIRROR:
+			{
+				if (n == 1)
+					return 0;
+				int period = 2 * (n - 1);
+				i %= period;
+				if (i < 0)
+					i += period;
+				return i < n ? i : period - i;
+			}
+		case BORDER_WRAP:
+			i %= n;
+			return i < 0 ? i + n : i;
+		case BORDER_ZERO:
+			return -1;
+		default:
+			return i < 0 ? 0 : n - 1;
+		}
+	}
+
+	// The taps kernel of a pixel type
+	template <class T> struct STapsKernel;
+
+	template <> struct STapsKernel<RGBQUAD>
+	{
+		typedef TAPS_KERNEL Type;
+		static Type Get() { return GetPixelKernels().pfnTaps; }
+	};
+
+	template <> struct STapsKernel<BYTE>
+	{
+		typedef PLANE_TAPS_KERNEL Type;
+		static Type Get() { return GetPixelKernels().pfnPlaneTaps; }
+	};
+
+	// Weights of one pass
+	struct SPassTaps
+	{
+		const short *pWeights;
+		int iTaps;
+		int iBits;
+	};
+
+	// One Run or block, shared by the tile bands. Strides are in pixels, the
+	// buffers may hold a part of the image starting at (srcX, srcY) and
+	// (dstX, dstY).
+	template <class T>
+	struct SConvolve
+	{
+		const T *pSrc;
+		size_t srcStride;
+		int srcX, srcY;
+		T *pDst;
+		size_t dstStride;
+		int dstX, dstY;
+		int iWidth, iHeight;
+		EBorderMode border;
+		bool bSeparable;
+		SPassTaps horizontal, vertical;		// Separable kernels
+		SPassTaps matrix;					// The others
+		int iMatrixWidth, iMatrixHeight;
+		int rx, ry;
+		unsigned tilesX;
+		BYTE *pScratch;
+		size_t scratchPerThread;
+		typename STapsKernel<T>::Type pfnTaps;
+	};
+
+	// count pixels of row y from column x on, both may lie outside the image
+	template <class T>
+	void ReadSpan(const SConvolve<T> &c, int y, int x, int count, T *pOut)
+	{
+		int sy = MapBorder(y, c.iHeight, c.border);
+		if (sy < 0)
+		{
+			memset(pOut, 0, count * sizeof(T));
+			return;
+		}
+
+		const T *pRow = c.pSrc + (size_t)(sy - c.srcY) * c.srcStride;
+		int iBegin = (std::min)((std::max)(-x, 0), count);
+		int iEnd = (std::max)((std::min)(c.iWidth - x, count), iBegin);
+
+		for (int i = 0; i < iBegin; i++)
+		{
+			int sx = MapBorder(x + i, c.iWidth, c.border);
+			if (sx < 0)
+				memset(&pOut[i], 0, sizeof(T));
+			else
+				pOut[i] = pRow[sx - c.srcX];
+		}
+
+		memcpy(pOut + iBegin, pRow + (x + iBegin - c.srcX), (iEnd - iBegin) * sizeof(T));
+
+		for (int i = iEnd; i < count; i++)
+		{
+			int sx = MapBorder(x + i, c.iWidth, c.border);
+			if (sx < 0)
+				memset(&pOut[i], 0, sizeof(T));
+			else
+				pOut[i] = pRow[sx - c.srcX];
+		}
+	}
+
+	// The tw x th tile at (x0, y0), at most CONVOLVE_TILE_WIDTH wide and
+	// th + 2 * ry at most CONVOLVE_TILE_HEIGHT + 2 * CONVOLVE_MAX_RADIUS
+	template <class T>
+	void ConvolveTile(const SConvolve<T> &c, int x0, int y0, int tw, int th, T *pScratch)
+	{
+		T *pOut = c.pDst + (size_t)(y0 - c.dstY) * c.dstStride + (x0 - c.dstX);
+		int spanWidth = tw + 2 * c.rx;
+		bool bInsideX = x0 >= c.rx && x0 + tw + c.rx <= c.iWidth;
+		bool bInsideY = y0 >= c.ry && y0 + th + c.ry <= c.iHeight;
+		int offsets[MAX_TAPS];
+
+		// Kernel rows are top down, image rows bottom-up: the top tap reads
+		// the highest row of the window
+		if (c.bSeparable)
+		{
+			T *pSpan = pScratch;
+			T *pRows = pScratch + CONVOLVE_TILE_WIDTH + 2 * CONVOLVE_MAX_RADIUS;
+
+			for (int i = 0; i < c.horizontal.iTaps; i++)
+				offsets[i] = i;
+
+			for (int j = 0; j < th + 2 * c.ry; j++)
+			{
+				int y = y0 - c.ry + j;
+				const T *pIn;
+				if (bInsideX && y >= 0 && y < c.iHeight)
+					pIn = c.pSrc + (size_t)(y - c.srcY) * c.srcStride + (x0 - c.rx - c.srcX);
+				else
+				{
+					ReadSpan(c, y, x0 - c.rx, spanWidth, pSpan);
+					pIn = pSpan;
+				}
+				c.pfnTaps(pIn, offsets, pRows + j * tw, tw, c.horizontal.pWeights, c.horizontal.iTaps, c.horizontal.iBits);
+			}
+
+			for (int i = 0; i < c.vertical.iTaps; i++)
+				offsets[i] = (c.vertical.iTaps - 1 - i) * tw;
+
+			for (int j = 0; j < th; j++)
+			{
+				c.pfnTaps(pRows + j * tw, offsets, pOut + j * c.dstStride, tw,
+					c.vertical.pWeights, c.vertical.iTaps, c.vertical.iBits);
+			}
+		}
+		else
+		{
+			const T *pWindow;
+			size_t stride;
+			if (bInsideX && bInsideY)
+			{
+				pWindow = c.pSrc + (size_t)(y0 - c.ry - c.srcY) * c.srcStride + (x0 - c.rx - c.srcX);
+				stride = c.srcStride;
+			}
+			else
+			{
+				stride = spanWidth;
+				for (int j = 0; j < th + 2 * c.ry; j++)
+					ReadSpan(c, y0 - c.ry + j, x0 - c.rx, spanWidth, pScratch + j * stride);
+				pWindow = pScratch;
+			}
+
+			for (int ky = 0; ky < c.iMatrixHeight; ky++)
+			{
+				for (int kx = 0; kx < c.iMatrixWidth; kx++)
+					offsets[ky * c.iMatrixWidth + kx] = (int)((c.iMatrixHeight - 1 - ky) * stride) + kx;
+			}
+
+			for (int j = 0; j < th; j++)
+			{
+				c.pfnTaps(pWindow + j * stride, offsets, pOut + j * c.dstStride, tw,
+					c.matrix.pWeights, c.matrix.iTaps, c.matrix.iBits);
+			}
+		}
+	}
+
+	template <class T>
+	void TileBand(void *pContext, unsigned uBegin, unsigned uEnd)
+	{
+		const SConvolve<T> &c = *(const SConvolve<T>*)pContext;
+		T *pScratch = (T*)(c.pScratch + CThreadPool::GetThreadIndex() * c.scratchPerThread);
+
+		for (unsigned u = uBegin; u < uEnd; u++)
+		{
+			int x0 = (int)(u % c.tilesX * CONVOLVE_TILE_WIDTH);
+			int y0 = (int)(u / c.tilesX * CONVOLVE_TILE_HEIGHT);
+			ConvolveTile(c, x0, y0, (std::min)((int)CONVOLVE_TILE_WIDTH, c.iWidth - x0),
+				(std::min)((int)CONVOLVE_TILE_HEIGHT, c.iHeight - y0), pScratch);
+		}
+	}
+
+	// First and last pixel of a line of n read for positions iBegin .. iEnd
+	void SourceRange(int iBegin, int iEnd, int n, EBorderMode mode, LONG &lFirst, LONG &lLast)
+	{
+		if (iBegin >= 0 && iEnd < n)
+		{
+			lFirst = iBegin;
+			lLast = iEnd;
+			return;
+		}
+
+		lFirst = n;
+		lLast = -1;
+		for (int i = iBegin; i <= iEnd; i++)
+		{
+			int iRead = MapBorder(i, n, mode);
+			if (iRead >= 0)
+			{
+				lFirst = (std::min)(lFirst, (LONG)iRead);
+				lLast = (std::max)(lLast, (LONG)iRead);
+			}
+		}
+	}
+
+	// Pixels of tile buffers one thread needs, the largest tile and radius
+	size_t TileScratch(bool bSeparable)
+	{
+		size_t spanWidth = CONVOLVE_TILE_WIDTH + 2 * CONVOLVE_MAX_RADIUS;
+		size_t rows = CONVOLVE_TILE_HEIGHT + 2 * CONVOLVE_MAX_RADIUS;
+
+		if (bSeparable)
+			return spanWidth + rows * CONVOLVE_TILE_WIDTH;
+		return rows * spanWidth;
+	}
+
+	SPassTaps PassTaps(const std::vector<short> &weights, int iBits)
+	{
+		SPassTaps taps = { weights.empty() ? NULL : &weights[0], (int)weights.size(), iBits };
+		return taps;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// CConvolutionKernel
+//-----------------------------------------------------------------------------
+CConvolutionKernel::CConvolutionKernel()
+{
+	const double dOne = 1.0;
+	SetSeparable(&dOne, 1, &dOne, 1);
+}
+
+bool CConvolutionKernel::Quantize(const double *pWeights, int iCount, STaps &taps)
+{
+	double dMax = 0, dSum = 0;
+	for (int i = 0; i < iCount; i++)
+	{
+		dMax = (std::max)(dMax, fabs(pWeights[i]));
+		dSum += pWeights[i];
+	}
+
+	int iBits = WEIGHT_BITS;
+	while (iBits > 1 && dMax * (1 << iBits) > 32767)
+		iBits--;
+	if (dMax * (1 << iBits) > 32767)
+		return false;
+
+	// The rounding error goes to the largest tap so the fixed point weights
+	// sum to the rounded sum of the real ones: flat areas keep their value
+	std::vector<short> weights(iCount);
+	int iSum = 0, iLargest = 0;
+	for (int i = 0; i < iCount; i++)
+	{
+		weights[i] = (short)floor(pWeights[i] * (1 << iBits) + 0.5);
+		iSum += weights[i];
+		if (fabs(pWeights[i]) > fabs(pWeights[iLargest]))
+			iLargest = i;
+	}
+
+	int iFixed = weights[iLargest] + (int)floor(dSum * (1 << iBits) + 0.5) - iSum;
+	if (iFixed >= -32768 && iFixed <= 32767)
+		weights[iLargest] = (short)iFixed;
+
+	taps.weights.swap(weights);
+	taps.iBits = iBits;
+	return true;
+}
+
+bool CConvolutionKernel::SetSeparable(const double *pHorizontal, int iHTaps, const double *pVertical, int iVTaps)
+{
+	if (iHTaps < 1 || iVTaps < 1 || !(iHTaps & 1) || !(iVTaps & 1) ||
+		iHTaps > 2 * CONVOLVE_MAX_RADIUS + 1 || iVTaps > 2 * CONVOLVE_MAX_RADIUS + 1)
+		return false;
+
+	STaps horizontal, vertical;
+	if (!Quantize(pHorizontal, iHTaps, horizontal) || !Quantize(pVertical, iVTaps, vertical))
+		return false;
+
+	m_bSeparable = true;
+	m_iWidth = iHTaps;
+	m_iHeight = iVTaps;
+	m_Horizontal.weights.swap(horizontal.weights);
+	m_Horizontal.iBits = horizontal.iBits;
+	m_Vertical.weights.swap(vertical.weights);
+	m_Vertical.iBits = vertical.iBits;
+	m_Matrix.weights.clear();
+	return true;
+}
+
+bool CConvolutionKernel::SetMatrix(const double *pWeights, int iWidth, int iHeight)
+{
+	if (iWidth < 1 || iHeight < 1 || !(iWidth & 1) || !(iHeight & 1) ||
+		iWidth > CONVOLVE_MAX_MATRIX || iHeight > CONVOLVE_MAX_MATRIX)
+		return false;
+
+	STaps matrix;
+	if (!Quantize(pWeights, iWidth * iHeight, matrix))
+		return false;
+
+	m_bSeparable = false;
+	m_iWidth = iWidth;
+	m_iHeight = iHeight;
+	m_Matrix.weights.swap(matrix.weights);
+	m_Matrix.iBits = matrix.iBits;
+	m_Horizontal.weights.clear();
+	m_Vertical.weights.clear();
+	return true;
+}
+
+void CConvolutionKernel::SetGaussian(double dSigma)
+{
+	int iRadius = dSigma > 0 ? (std::min)((int)ceil(3 * dSigma), CONVOLVE_MAX_RADIUS) : 0;
+	double dTaps[2 * CONVOLVE_MAX_RADIUS + 1];
+	double dSum = 0;
+
+	for (int i = -iRadius; i <= iRadius; i++)
+	{
+		dTaps[i + iRadius] = iRadius ? exp(-(i * i) / (2 * dSigma * dSigma)) : 1.0;
+		dSum += dTaps[i + iRadius];
+	}
+	for (int i = 0; i <= 2 * iRadius; i++)
+		dTaps[i] /= dSum;
+
+	SetSeparable(dTaps, 2 * iRadius + 1, dTaps, 2 * iRadius + 1);
+}
+
+void CConvolutionKernel::SetBox(int iRadius)
+{
+	iRadius = (std::max)((std::min)(iRadius, CONVOLVE_MAX_RADIUS), 0);
+
+	double dTaps[2 * CONVOLVE_MAX_RADIUS + 1];
+	for (int i = 0; i <= 2 * iRadius; i++)
+		dTaps[i] = 1.0 / (2 * iRadius + 1);
+
+	SetSeparable(dTaps, 2 * iRadius + 1, dTaps, 2 * iRadius + 1);
+}
+
+void CConvolutionKernel::SetSharpen(double dAmount)
+{
+	const double a = dAmount;
+	const double dWeights[9] =
+	{
+		0,	-a,			0,
+		-a,	1 + 4 * a,	-a,
+		0,	-a,			0
+	};
+	SetMatrix(dWeights, 3, 3);
+}
+
+//-----------------------------------------------------------------------------
+// CConvolver
+//-----------------------------------------------------------------------------
+template <class TConvolve>
+void CConvolver::SetKernel(const CConvolutionKernel &kernel, TConvolve &c)
+{
+	c.bSeparable = kernel.m_bSeparable;
+	c.horizontal = PassTaps(kernel.m_Horizontal.weights, kernel.m_Horizontal.iBits);
+	c.vertical = PassTaps(kernel.m_Vertical.weights, kernel.m_Vertical.iBits);
+	c.matrix = PassTaps(kernel.m_Matrix.weights, kernel.m_Matrix.iBits);
+	c.iMatrixWidth = kernel.m_iWidth;
+	c.iMatrixHeight = kernel.m_iHeight;
+	c.rx = kernel.m_iWidth / 2;
+	c.ry = kernel.m_iHeight / 2;
+}
+
+template <class T>
+void CConvolver::Run(const CConvolutionKernel &kernel, const T *pSrc, size_t srcStride, T *pDst, size_t dstStride,
+	int iWidth, int iHeight)
+{
+	CThreadPool &pool = CResizableImage::GetThreadPool();
+
+	SConvolve<T> c;
+	c.pSrc = pSrc;
+	c.srcStride = srcStride;
+	c.srcX = c.srcY = 0;
+	c.pDst = pDst;
+	c.dstStride = dstStride;
+	c.dstX = c.dstY = 0;
+	c.iWidth = iWidth;
+	c.iHeight = iHeight;
+	c.border = m_Border;
+	SetKernel(kernel, c);
+	c.tilesX = (iWidth + CONVOLVE_TILE_WIDTH - 1) / CONVOLVE_TILE_WIDTH;
+	c.pfnTaps = STapsKernel<T>::Get();
+
+	// Tile buffers of every thread, grown once and kept
+	c.scratchPerThread = TileScratch(c.bSeparable) * sizeof(T);
+	if (m_Scratch.size() < c.scratchPerThread * pool.GetThreadCount())
+		m_Scratch.resize(c.scratchPerThread * pool.GetThreadCount());
+	c.pScratch = &m_Scratch[0];
+
+	unsigned tilesY = (iHeight + CONVOLVE_TILE_HEIGHT - 1) / CONVOLVE_TILE_HEIGHT;
+	pool.Run(c.tilesX * tilesY, 1, TileBand<T>, &c);
+}
+
+bool CConvolver::Apply(const CConvolutionKernel &kernel, const CImageFile &src, CImageFile &dst)
+{
+	if (&src == &dst)
+		return Apply(kernel, dst);
+	if (!src.Pixels())
+		return false;
+
+	PROFILE_SCOPE("CConvolver::Apply");
+
+	if ((dst.Width() != src.Width() || dst.Height() != src.Height() || !dst.Pixels()) &&
+		!dst.Create(src.Width(), src.Height()))
+		return false;
+	dst.ReleaseMips();
+
+	Run(kernel, src.Pixels(), src.Width(), dst.Pixels(), dst.Width(), src.Width(), src.Height());
+	return true;
+}
+
+bool CConvolver::Apply(const CConvolutionKernel &kernel, CImageFile &image)
+{
+	if (!image.Pixels())
+		return false;
+
+	if ((m_Copy.Width() != image.Width() || m_Copy.Height() != image.Height() || !m_Copy.Pixels()) &&
+		!m_Copy.Create(image.Width(), image.Height()))
+		return false;
+
+	memcpy(m_Copy.Pixels(), image.Pixels(), sizeof(RGBQUAD) * image.Width() * image.Height());
+	return Apply(kernel, m_Copy, image);
+}
+
+bool CConvolver::ApplyPlane(const CConvolutionKernel &kernel, const BYTE *pSrc, size_t srcStride,
+	BYTE *pDst, size_t dstStride, LONG lWidth, LONG lHeight)
+{
+	if (!pSrc || !pDst || lWidth <= 0 || lHeight <= 0)
+		return false;
+
+	PROFILE_SCOPE("CConvolver::ApplyPlane");
+
+	Run(kernel, pSrc, srcStride, pDst, dstStride, lWidth, lHeight);
+	return true;
+}
+
+RECT CConvolver::GetBlockSource(const CConvolutionKernel &kernel, EBorderMode border, const RECT &block,
+	LONG lWidth, LONG lHeight)
+{
+	int rx = kernel.m_iWidth / 2;
+	int ry = kernel.m_iHeight / 2;
+
+	RECT source;
+	SourceRange(block.left - rx, block.right + rx, lWidth, border, source.left, source.right);
+	SourceRange(block.top - ry, block.bottom + ry, lHeight, border, source.top, source.bottom);
+	return source;
+}
+
+size_t CConvolver::GetBlockScratch(const CConvolutionKernel &kernel)
+{
+	return TileScratch(kernel.m_bSeparable);
+}
+
+template <class T>
+void CConvolver::Block(const CConvolutionKernel &kernel, EBorderMode border, const T *pSrc, size_t srcStride,
+	const RECT &source, T *pDst, size_t dstStride, const RECT &block, LONG lWidth, LONG lHeight, T *pScratch)
+{
+	SConvolve<T> c;
+	c.pSrc = pSrc;
+	c.srcStride = srcStride;
+	c.srcX = source.left;
+	c.srcY = source.top;
+	c.pDst = pDst;
+	c.dstStride = dstStride;
+	c.dstX = block.left;
+	c.dstY = block.top;
+	c.iWidth = lWidth;
+	c.iHeight = lHeight;
+	c.border = border;
+	SetKernel(kernel, c);
+	c.pfnTaps = STapsKernel<T>::Get();
+
+	// Rows as even as the block allows, and as many a tile as the scratch
+	// holds for this radius: every tile filters its kernel borders again
+	int iBlockHeight = block.bottom - block.top + 1;
+	int iMaxHeight = CONVOLVE_TILE_HEIGHT + 2 * (CONVOLVE_MAX_RADIUS - c.ry);
+	int tilesY = (iBlockHeight + iMaxHeight - 1) / iMaxHeight;
+	int th = (iBlockHeight + tilesY - 1) / tilesY;
+
+	for (int y0 = block.top; y0 <= block.bottom; y0 += th)
+	{
+		for (int x0 = block.left; x0 <= block.right; x0 += CONVOLVE_TILE_WIDTH)
+		{
+			ConvolveTile(c, x0, y0, (std::min)((int)CONVOLVE_TILE_WIDTH, (int)block.right + 1 - x0),
+				(std::min)(th, (int)block.bottom + 1 - y0), pScratch);
+		}
+	}
+}
+
+void CConvolver::ApplyBlock(const CConvolutionKernel &kernel, EBorderMode border, const RGBQUAD *pSrc,
+	size_t srcStride, const RECT &source, RGBQUAD *pDst, size_t dstStride, const RECT &block,
+	LONG lWidth, LONG lHeight, RGBQUAD *pScratch)
+{
+	Block(kernel, border, pSrc, srcStride, source, pDst, dstStride, block, lWidth, lHeight, pScratch);
+}
+
+void CConvolver::ApplyBlock(const CConvolutionKernel &kernel, EBorderMode border, const BYTE *pSrc,
+	size_t srcStride, const RECT &source, BYTE *pDst, size_t dstStride, const RECT &block,
+	LONG lWidth, LONG lHeight, BYTE *pScratch)
+{
+	Block(kernel, border, pSrc, srcStride, source, pDst, dstStride, block, lWidth, lHeight, pScratch);
+}
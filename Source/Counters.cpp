@@ -0,0 +1,299 @@
+//-----------------------------------------------------------------------------
+// File: Counters.cpp
+//
+// Desc: Registry of named runtime counters and gauges with per-frame
+//	snapshots and CSV / JSON export.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Counters Specific Includes
+//-----------------------------------------------------------------------------
+#include "Counters.h"
+
+#include <mutex>
+#include <new>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	// Incremented by the global operator new below, read once per frame.
+	std::atomic<long long> g_HeapAllocations(0);
+
+	//-------------------------------------------------------------------------
+	// Name : SFrame (Struct)
+	// Desc : Values of every counter at the end of one frame.
+	//-------------------------------------------------------------------------
+	struct SFrame
+	{
+		unsigned long			ulFrame;
+		const char				*szLabel;
+		std::vector<long long>	values;
+	};
+
+	struct CRegistry
+	{
+		std::mutex				lock;
+		std::vector<CCounter*>	counters;
+		std::vector<long long>	lastValues;
+		std::vector<SFrame>		history;
+		bool					bHistory;
+		unsigned long			ulFrame;
+
+		CCounter				*pHeap;
+		long long				llHeapTotal;
+
+		CRegistry() : bHistory(false), ulFrame(0), llHeapTotal(0)
+		{
+			pHeap = new CCounter("heap allocations", CCounter::PER_FRAME);
+			counters.push_back(pHeap);
+		}
+
+		~CRegistry()
+		{
+			for (size_t i = 0; i < counters.size(); i++)
+				delete counters[i];
+		}
+	};
+
+	CRegistry& Registry()
+	{
+		static CRegistry registry;
+		return registry;
+	}
+
+	const char* Label(const SFrame &f)
+	{
+		return f.szLabel ? f.szLabel : "";
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Register () (Static)
+// Desc : Returns the counter with the given name, creating it if needed.
+//-----------------------------------------------------------------------------
+CCounter* CCounters::Register( const char *szName, CCounter::KIND kind )
+{
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	for (size_t i = 0; i < reg.counters.size(); i++)
+		if (strcmp(reg.counters[i]->Name(), szName) == 0)
+			return reg.counters[i];
+
+	CCounter *pCounter = new CCounter(szName, kind);
+	reg.counters.push_back(pCounter);
+	reg.lastValues.resize(reg.counters.size(), 0);
+
+	return pCounter;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Find () (Static)
+// Desc : Returns the counter with the given name, or NULL.
+//-----------------------------------------------------------------------------
+CCounter* CCounters::Find( const char *szName )
+{
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	for (size_t i = 0; i < reg.counters.size(); i++)
+		if (strcmp(reg.counters[i]->Name(), szName) == 0)
+			return reg.counters[i];
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Name : EnableHistory () (Static)
+// Desc : When enabled every frame snapshot is kept for export, otherwise
+//		only the last one is (enough for the on-screen overlay).
+//-----------------------------------------------------------------------------
+void CCounters::EnableHistory( bool bEnable )
+{
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	reg.bHistory = bEnable;
+	if (!bEnable)
+		reg.history.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name : EndFrame () (Static)
+// Desc : Snapshots every counter, tagging the frame with szLabel (usually the
+//		game state), then resets the per-frame counters.
+//-----------------------------------------------------------------------------
+void CCounters::EndFrame( const char *szLabel )
+{
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	long long llHeapTotal = g_HeapAllocations.load(std::memory_order_relaxed);
+	reg.pHeap->Set(llHeapTotal - reg.llHeapTotal);
+	reg.llHeapTotal = llHeapTotal;
+
+	reg.lastValues.resize(reg.counters.size());
+	for (size_t i = 0; i < reg.counters.size(); i++)
+	{
+		CCounter *pCounter = reg.counters[i];
+		// One exchange, an Add from another thread in between is not lost
+		if (pCounter->Kind() == CCounter::PER_FRAME)
+			reg.lastValues[i] = pCounter->Reset();
+		else
+			reg.lastValues[i] = pCounter->Get();
+	}
+
+	if (reg.bHistory)
+	{
+		SFrame frame;
+		frame.ulFrame = reg.ulFrame;
+		frame.szLabel = szLabel;
+		reg.history.push_back(frame);
+		reg.history.back().values = reg.lastValues;
+
+		// Do not bill the snapshot itself to the next frame
+		reg.llHeapTotal = g_HeapAllocations.load(std::memory_order_relaxed);
+	}
+
+	reg.ulFrame++;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetCount () (Static)
+// Desc : Number of registered counters.
+//-----------------------------------------------------------------------------
+unsigned CCounters::GetCount()
+{
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	return (unsigned)reg.counters.size();
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetName () (Static)
+// Desc : Name of the i-th registered counter.
+//-----------------------------------------------------------------------------
+const char* CCounters::GetName( unsigned i )
+{
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	return i < reg.counters.size() ? reg.counters[i]->Name() : "";
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetLastValue () (Static)
+// Desc : Value the i-th counter had at the end of the last frame.
+//-----------------------------------------------------------------------------
+long long CCounters::GetLastValue( unsigned i )
+{
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	return i < reg.lastValues.size() ? reg.lastValues[i] : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetHeapAllocations () (Static)
+// Desc : Total number of operator new calls since start up.
+//-----------------------------------------------------------------------------
+long long CCounters::GetHeapAllocations()
+{
+	return g_HeapAllocations.load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+// Name : ExportCSV () (Static)
+// Desc : Writes the recorded history, one row per frame.
+//-----------------------------------------------------------------------------
+bool CCounters::ExportCSV( const char *szFileName )
+{
+	FILE *f = fopen(szFileName, "w");
+	if (!f)
+		return false;
+
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	fprintf(f, "frame,label");
+	for (size_t i = 0; i < reg.counters.size(); i++)
+		fprintf(f, ",%s", reg.counters[i]->Name());
+	fprintf(f, "\n");
+
+	for (size_t r = 0; r < reg.history.size(); r++)
+	{
+		const SFrame &frame = reg.history[r];
+
+		fprintf(f, "%lu,%s", frame.ulFrame, Label(frame));
+		for (size_t i = 0; i < reg.counters.size(); i++)
+			fprintf(f, ",%lld", i < frame.values.size() ? frame.values[i] : 0LL);
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ExportJSON () (Static)
+// Desc : Writes the recorded history as {"counters":[...],"frames":[...]}.
+//-----------------------------------------------------------------------------
+bool CCounters::ExportJSON( const char *szFileName )
+{
+	FILE *f = fopen(szFileName, "w");
+	if (!f)
+		return false;
+
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	fprintf(f, "{\"counters\":[");
+	for (size_t i = 0; i < reg.counters.size(); i++)
+		fprintf(f, "%s\"%s\"", i ? "," : "", reg.counters[i]->Name());
+	fprintf(f, "],\n\"frames\":[\n");
+
+	for (size_t r = 0; r < reg.history.size(); r++)
+	{
+		const SFrame &frame = reg.history[r];
+
+		fprintf(f, "%s{\"frame\":%lu,\"label\":\"%s\",\"values\":[", r ? ",\n" : "", frame.ulFrame, Label(frame));
+		for (size_t i = 0; i < reg.counters.size(); i++)
+			fprintf(f, "%s%lld", i ? "," : "", i < frame.values.size() ? frame.values[i] : 0LL);
+		fprintf(f, "]}");
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Global allocation hooks, every operator new is counted. Define
+// DISABLE_HEAP_COUNTER to keep the runtime's default operators.
+//-----------------------------------------------------------------------------
+#ifndef DISABLE_HEAP_COUNTER
+void* operator new(size_t size)
+{
+	g_HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+#endif
@@ -0,0 +1,352 @@
+//-----------------------------------------------------------------------------
+// File: FrameCapture.cpp
+//
+// Desc: Frame buffers, queues and writer thread of CFrameCapture.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// FrameCapture Specific Includes
+//-----------------------------------------------------------------------------
+#include "FrameCapture.h"
+#include "StreamResizer.h"
+#include "Counters.h"
+#include "Profiler.h"
+
+#include <string.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+namespace
+{
+	const int CAPTURE_WRITER_NICE = 10;		// Linux niceness of the writer thread
+
+	const char Y4M_FRAME[] = "FRAME\n";
+	const size_t Y4M_FRAME_LENGTH = sizeof(Y4M_FRAME) - 1;
+
+	BYTE ClampByte( int iValue )
+	{
+		return iValue > 255 ? 255 : (BYTE)iValue;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// CFrameCapture Member Functions
+//-----------------------------------------------------------------------------
+CFrameCapture::CFrameCapture() : m_lWidth(0), m_lHeight(0), m_pStream(NULL), m_iCurrent(-1),
+	m_bWriterAsleep(false), m_bProducerAsleep(false), m_bQuit(false), m_ullCaptured(0), m_ullWritten(0),
+	m_ullDropped(0), m_ullStalls(0), m_llStallTime(0), m_llWriteTime(0), m_bWriteFailed(false)
+{
+}
+
+CFrameCapture::~CFrameCapture()
+{
+	Stop();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Start ()
+// Desc : Everything the frames need is allocated here, capturing a frame
+//		later only copies it.
+//-----------------------------------------------------------------------------
+bool CFrameCapture::Start( const SOptions &options, LONG lWidth, LONG lHeight )
+{
+	Stop();
+
+	if (lWidth <= 0 || lHeight <= 0 || options.uBuffers == 0 || options.strPath.empty())
+		return false;
+
+	if (options.format == CAPTURE_Y4M)
+	{
+		m_pStream = fopen(options.strPath.c_str(), "wb");
+		if (!m_pStream)
+			return false;
+
+		// C444 keeps the pixels exact in position, the colors are what a
+		// player gets back from full range BT.601
+		if (fprintf(m_pStream, "YUV4MPEG2 W%ld H%ld F%u:1 Ip A1:1 C444 XCOLORRANGE=FULL\n",
+			(long)lWidth, (long)lHeight, options.uFrameRate ? options.uFrameRate : CAPTURE_DEFAULT_RATE) < 0)
+		{
+			fclose(m_pStream);
+			m_pStream = NULL;
+			return false;
+		}
+
+		size_t pixels = (size_t)lWidth * lHeight;
+		m_Encoded.resize(Y4M_FRAME_LENGTH + 3 * pixels);
+		memcpy(&m_Encoded[0], Y4M_FRAME, Y4M_FRAME_LENGTH);
+	}
+
+	m_Options = options;
+	m_lWidth = lWidth;
+	m_lHeight = lHeight;
+	m_Buffers.assign(options.uBuffers, std::vector<RGBQUAD>((size_t)lWidth * lHeight));
+	m_FrameNumbers.assign(options.uBuffers, 0);
+
+	// Both rings hold every buffer, a push never finds them full
+	m_Free.Reset(options.uBuffers);
+	m_Queued.Reset(options.uBuffers);
+	for (unsigned i = 0; i < options.uBuffers; i++)
+		m_Free.Push(i);
+
+	m_iCurrent = -1;
+	m_bWriterAsleep = false;
+	m_bProducerAsleep = false;
+	m_bQuit = false;
+	m_ullCaptured = 0;
+	m_ullWritten = 0;
+	m_ullDropped = 0;
+	m_ullStalls = 0;
+	m_llStallTime = 0;
+	m_llWriteTime = 0;
+	m_bWriteFailed = false;
+
+	m_Writer = std::thread(&CFrameCapture::WriterMain, this);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Stop ()
+// Desc : A frame between BeginFrame and EndFrame is not written.
+//-----------------------------------------------------------------------------
+bool CFrameCapture::Stop()
+{
+	if (!IsRunning())
+		return !m_bWriteFailed;
+
+	m_iCurrent = -1;
+	m_bQuit.store(true, std::memory_order_release);
+	Wake(m_bWriterAsleep, m_WakeWriter);
+	m_Writer.join();
+
+	if (m_pStream && fclose(m_pStream) != 0)
+		m_bWriteFailed = true;
+	m_pStream = NULL;
+
+	std::vector<std::vector<RGBQUAD> >().swap(m_Buffers);
+	std::vector<BYTE>().swap(m_Encoded);
+	return !m_bWriteFailed;
+}
+
+//-----------------------------------------------------------------------------
+// Name : BeginFrame ()
+// Desc : Takes a free buffer. With none left CAPTURE_DROP gives up on the
+//		frame and CAPTURE_BLOCK sleeps until the writer hands one back.
+//-----------------------------------------------------------------------------
+RGBQUAD* CFrameCapture::BeginFrame()
+{
+	if (!IsRunning())
+		return NULL;
+
+	if (m_iCurrent >= 0)
+		return &m_Buffers[m_iCurrent][0];
+
+	unsigned uBuffer;
+	if (!m_Free.Pop(uBuffer))
+	{
+		if (m_Options.policy == CAPTURE_DROP)
+		{
+			m_ullDropped.fetch_add(1, std::memory_order_relaxed);
+			COUNTER_INC("capture drops");
+			return NULL;
+		}
+
+		PROFILE_SCOPE("CFrameCapture::Stall");
+		long long llStart = CProfiler::Now();
+
+		// The flag is up before the last look at the queue, and the writer
+		// looks at the flag after its push, so one of the two sees the other
+		m_bProducerAsleep.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (!m_Free.Pop(uBuffer))
+		{
+			std::unique_lock<std::mutex> lock(m_WakeLock);
+			m_WakeProducer.wait(lock, [this] { return !m_bProducerAsleep.load(); });
+			m_bProducerAsleep.store(true);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+		m_bProducerAsleep.store(false);
+
+		long long llStall = CProfiler::Now() - llStart;
+		m_ullStalls.fetch_add(1, std::memory_order_relaxed);
+		m_llStallTime.fetch_add(llStall, std::memory_order_relaxed);
+		COUNTER_INC("capture stalls");
+		COUNTER_ADD("capture stall us", llStall / 1000);
+	}
+
+	m_iCurrent = (int)uBuffer;
+	return &m_Buffers[uBuffer][0];
+}
+
+void CFrameCapture::EndFrame()
+{
+	if (m_iCurrent < 0)
+		return;
+
+	m_FrameNumbers[m_iCurrent] = m_ullCaptured.fetch_add(1, std::memory_order_relaxed) + 1;
+	m_Queued.Push((unsigned)m_iCurrent);
+	m_iCurrent = -1;
+	COUNTER_INC("capture frames");
+
+	Wake(m_bWriterAsleep, m_WakeWriter);
+}
+
+bool CFrameCapture::Submit( const RGBQUAD *pPixels, LONG lStride )
+{
+	RGBQUAD *pFrame = BeginFrame();
+	if (!pFrame)
+		return false;
+
+	if (lStride == m_lWidth)
+		memcpy(pFrame, pPixels, (size_t)m_lWidth * m_lHeight * sizeof(RGBQUAD));
+	else
+	{
+		for (LONG y = 0; y < m_lHeight; y++)
+			memcpy(pFrame + (size_t)y * m_lWidth, pPixels + (size_t)y * lStride, m_lWidth * sizeof(RGBQUAD));
+	}
+
+	EndFrame();
+	return true;
+}
+
+void CFrameCapture::GetStats( SStats &stats ) const
+{
+	stats.ullCaptured = m_ullCaptured.load();
+	stats.ullWritten = m_ullWritten.load();
+	stats.ullDropped = m_ullDropped.load();
+	stats.ullStalls = m_ullStalls.load();
+	stats.llStallTime = m_llStallTime.load();
+	stats.llWriteTime = m_llWriteTime.load();
+	stats.bWriteFailed = m_bWriteFailed.load();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Wake () (Private)
+// Desc : Called after a push, wakes the other side if it went to sleep on
+//		the queue. The lock is only taken when it did.
+//-----------------------------------------------------------------------------
+void CFrameCapture::Wake( std::atomic<bool> &bAsleep, std::condition_variable &wake )
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!bAsleep.load())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(m_WakeLock);
+		bAsleep.store(false);
+	}
+	wake.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Name : WriterMain () (Private)
+// Desc : Writes queued frames in order and hands their buffers back, until
+//		Stop has been called and the queue is empty.
+//-----------------------------------------------------------------------------
+void CFrameCapture::WriterMain()
+{
+	CProfiler::SetThreadName("Frame capture");
+
+	// Below the game thread, so waking the writer does not hand it the rest
+	// of the game's time slice when they share a core
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), CAPTURE_WRITER_NICE);
+#endif
+
+	for (;;)
+	{
+		// Stop raises the flag after its last push, so a set flag and an
+		// empty queue mean there is nothing left
+		bool bQuit = m_bQuit.load(std::memory_order_acquire);
+
+		unsigned uBuffer;
+		if (m_Queued.Pop(uBuffer))
+		{
+			WriteFrame(uBuffer);
+			m_Free.Push(uBuffer);
+			Wake(m_bProducerAsleep, m_WakeProducer);
+			continue;
+		}
+		if (bQuit)
+			break;
+
+		m_bWriterAsleep.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!m_Queued.IsEmpty() || m_bQuit.load())
+		{
+			m_bWriterAsleep.store(false);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_WakeLock);
+		m_WakeWriter.wait(lock, [this] { return !m_bWriterAsleep.load(); });
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : WriteFrame () (Private)
+//-----------------------------------------------------------------------------
+bool CFrameCapture::WriteFrame( unsigned uBuffer )
+{
+	PROFILE_SCOPE("CFrameCapture::WriteFrame");
+
+	long long llStart = CProfiler::Now();
+	const RGBQUAD *pPixels = &m_Buffers[uBuffer][0];
+
+	bool bOk = m_Options.format == CAPTURE_Y4M ? WriteY4m(pPixels) : WriteBmp(pPixels, m_FrameNumbers[uBuffer]);
+	if (bOk)
+		m_ullWritten.fetch_add(1, std::memory_order_relaxed);
+	else
+		m_bWriteFailed = true;
+
+	m_llWriteTime.fetch_add(CProfiler::Now() - llStart, std::memory_order_relaxed);
+	return bOk;
+}
+
+//-----------------------------------------------------------------------------
+// Name : WriteBmp () (Private)
+// Desc : "<path>_<frame>.bmp", rows in the order they are kept.
+//-----------------------------------------------------------------------------
+bool CFrameCapture::WriteBmp( const RGBQUAD *pPixels, unsigned long long ullFrame )
+{
+	char szSuffix[32];
+	snprintf(szSuffix, sizeof(szSuffix), "_%06llu.bmp", ullFrame);
+
+	CBmpRowSink sink;
+	if (!sink.Create((m_Options.strPath + szSuffix).c_str(), m_lWidth, m_lHeight))
+		return false;
+
+	for (LONG y = 0; y < m_lHeight; y++)
+		sink.WriteRow(y, pPixels + (size_t)y * m_lWidth);
+	return sink.Close();
+}
+
+//-----------------------------------------------------------------------------
+// Name : WriteY4m () (Private)
+// Desc : One frame of Y, U and V planes at full resolution, integer BT.601
+//		full range weights summing to 256 so grays stay exact.
+//-----------------------------------------------------------------------------
+bool CFrameCapture::WriteY4m( const RGBQUAD *pPixels )
+{
+	size_t pixels = (size_t)m_lWidth * m_lHeight;
+	BYTE *pY = &m_Encoded[Y4M_FRAME_LENGTH];
+	BYTE *pU = pY + pixels;
+	BYTE *pV = pU + pixels;
+
+	for (size_t i = 0; i < pixels; i++)
+	{
+		int r = pPixels[i].rgbRed, g = pPixels[i].rgbGreen, b = pPixels[i].rgbBlue;
+		pY[i] = (BYTE)((77 * r + 150 * g + 29 * b + 128) >> 8);
+		pU[i] = ClampByte((-43 * r - 85 * g + 128 * b + 32896) >> 8);
+		pV[i] = ClampByte((128 * r - 107 * g - 21 * b + 32896) >> 8);
+	}
+
+	return fwrite(&m_Encoded[0], 1, m_Encoded.size(), m_pStream) == m_Encoded.size();
+}
@@ -0,0 +1,557 @@
+//-----------------------------------------------------------------------------
+// File: GameWorld.cpp
+//
+// Desc: Game simulation, holds every unit and bullet and applies the game
+//	rules. Extracted from CGameApp so it can run without a window.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// GameWorld Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameWorld.h"
+#include "Profiler.h"
+#include "Counters.h"
+
+#include <fstream>
+
+//-----------------------------------------------------------------------------
+// CGameWorld Member Functions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CGameWorld () (Constructor)
+// Desc : CGameWorld Class Constructor
+//-----------------------------------------------------------------------------
+CGameWorld::CGameWorld()
+{
+	_Player1		= NULL;
+	_Player2		= NULL;
+	_gameState		= START;
+	_scoreP1		= 0;
+	_scoreP2		= 0;
+	frameCounter	= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CGameWorld () (Destructor)
+// Desc : CGameWorld Class Destructor
+//-----------------------------------------------------------------------------
+CGameWorld::~CGameWorld()
+{
+	Release();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Init ()
+// Desc : Creates both players and sets up the initial game state. The seed
+//		drives every random decision, equal seeds replay identical games.
+//-----------------------------------------------------------------------------
+void CGameWorld::Init(const Vec2& screenSize, const Vec2& shipSize, const Vec2& enemySize, unsigned int seed)
+{
+	Release();
+
+	_screenSize = screenSize;
+	_enemySize = enemySize;
+	_random.seed(seed);
+
+	_Player1 = new CPlayer(CPlayer::TEAM::PLAYER1, shipSize);
+	_Player2 = new CPlayer(CPlayer::TEAM::PLAYER2, shipSize);
+
+	_Player1->Position() = Vec2(int(_screenSize.x / 3 * 1), int(_screenSize.y / 3 * 2));
+	_Player2->Position() = Vec2(int(_screenSize.x / 3 * 2), int(_screenSize.y / 3 * 2));
+
+	_Player1->frameCounter() = 200;
+	_Player2->frameCounter() = 200;
+
+	_scoreP1 = 0;
+	_scoreP2 = 0;
+	frameCounter = 0;
+
+	_gameState = START;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Release ()
+// Desc : Frees every unit and bullet.
+//-----------------------------------------------------------------------------
+void CGameWorld::Release()
+{
+	if (_Player1 != NULL) {
+		delete _Player1;
+		_Player1 = NULL;
+	}
+
+	if (_Player2 != NULL) {
+		delete _Player2;
+		_Player2 = NULL;
+	}
+
+	while (!_enemies.empty()) delete _enemies.front(), _enemies.pop_front();
+	while (!_bullets.empty()) delete _bullets.front(), _bullets.pop_front();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Step ()
+// Desc : Advances the world by one frame.
+//-----------------------------------------------------------------------------
+void CGameWorld::Step(float dt, const SInput& input)
+{
+	ApplyInput(input);
+	Animate(dt);
+	RemoveDead();
+}
+
+//-----------------------------------------------------------------------------
+// Name : ApplyInput ()
+// Desc : Moves the players and fires their weapons. Input is ignored unless
+//		the game is running.
+//-----------------------------------------------------------------------------
+void CGameWorld::ApplyInput(const SInput& input)
+{
+	if (_gameState != ONGOING)
+		return;
+
+	// only do something if player is alive
+	if (!_Player1->isDead()) {
+		if (input.bP1Fire && _Player1->frameCounter() >= FIRE_COOLDOWN_FRAMES) {
+			SpawnBullet(_Player1->Position(), Vec2(0, -400), CPlayer::TEAM::PLAYER1);
+			_Player1->frameCounter() = 0;
+		}
+
+		_Player1->Move(input.ulP1Direction);
+	}
+
+	if (!_Player2->isDead()) {
+		if (input.bP2Fire && _Player2->frameCounter() >= FIRE_COOLDOWN_FRAMES) {
+			SpawnBullet(_Player2->Position(), Vec2(0, -400), CPlayer::TEAM::PLAYER2);
+			_Player2->frameCounter() = 0;
+		}
+
+		_Player2->Move(input.ulP2Direction);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Animate ()
+// Desc : Moves every unit and bullet and resolves hits.
+//-----------------------------------------------------------------------------
+void CGameWorld::Animate(float dt)
+{
+	updateGameState();
+
+	if (_gameState != ONGOING)
+		return;
+
+	if (!_Player1->isDead()) {
+		_Player1->Update(dt);
+		_Player1->frameCounter()++;
+	}
+	if (!_Player2->isDead()) {
+		_Player2->Update(dt);
+		_Player2->frameCounter()++;
+	}
+
+	holdInside(*_Player1);
+	holdInside(*_Player2);
+
+	for (auto it = _bullets.begin(); it != _bullets.end(); ) {
+		Bullet *bul = *it;
+		bul->update(dt);
+
+		if (bul->team == CPlayer::TEAM::ENEMY) {
+			trackPlayer(*bul);
+		}
+		if (detectCollision(bul) || bul->mPosition.y >= _screenSize.y || bul->mPosition.y <= 0) {
+			it = _bullets.erase(it);
+			delete bul;
+			COUNTER_INC("bullets retired");
+		}
+		else {
+			++it;
+		}
+	}
+
+	moveEnemies();
+
+	for (auto enem : _enemies) {
+		enem->Update(dt);
+	}
+
+	enemyFire();
+
+	for (auto enem : _enemies) {
+		enem->frameCounter()++;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : RemoveDead ()
+// Desc : Blows up players that ran out of lives and removes dead enemies.
+//-----------------------------------------------------------------------------
+void CGameWorld::RemoveDead()
+{
+	if (!_Player1->getLives() && !_Player1->hasExploded() && !_Player1->isDead())
+		_Player1->Explode();
+
+	if (!_Player2->getLives() && !_Player2->hasExploded() && !_Player2->isDead())
+		_Player2->Explode();
+
+	for (auto it = _enemies.begin(); it != _enemies.end(); ) {
+		if ((*it)->isDead()) {
+			delete *it;
+			it = _enemies.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : SpawnBullet ()
+// Desc : Spawns a bullet with position, velocity and team given as arguments
+//-----------------------------------------------------------------------------
+void CGameWorld::SpawnBullet(const Vec2 position, const Vec2 velocity, const CPlayer::TEAM team)
+{
+	COUNTER_INC("bullets spawned");
+
+	Bullet *bullet = new Bullet;
+
+	bullet->mPosition = position;
+	bullet->mVelocity = velocity;
+	bullet->team = team;
+
+	if (velocity.y < 0) {
+		bullet->mPosition.y -= 75;
+	}
+	else {
+		bullet->mPosition.y += 75;
+	}
+
+	_bullets.push_back(bullet);
+}
+
+//-----------------------------------------------------------------------------
+// Name : detectCollision () (Private)
+// Desc : This function is called for each bullet spawned at one time to detect
+// if it has hit something.
+//-----------------------------------------------------------------------------
+bool CGameWorld::detectCollision(const Bullet* bullet)
+{
+	PROFILE_FUNCTION();
+
+	if (bulletUnitCollision(*bullet, *_Player1) && bullet->team == CPlayer::TEAM::ENEMY && !_Player1->hasExploded()) {
+		_Player1->takeDamage();
+		return true;
+	}
+
+	if (bulletUnitCollision(*bullet, *_Player2) && bullet->team == CPlayer::TEAM::ENEMY && !_Player2->hasExploded()) {
+		_Player2->takeDamage();
+		return true;
+	}
+
+	for (auto enem : _enemies) {
+		if (bulletUnitCollision(*bullet, *enem)) {
+			if (enem->hasExploded()) {
+				return false;
+			}
+			if (bullet->team == CPlayer::TEAM::PLAYER1) {
+				_scoreP1 += 100;
+			}
+			else if (bullet->team == CPlayer::TEAM::PLAYER2) {
+				_scoreP2 += 100;
+			}
+			else {
+				return false;
+			}
+
+			enem->Explode();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Name : bulletUnitCollision () (Private)
+// Desc : Function that checks when a bullet has colided with a given
+// player unit
+//-----------------------------------------------------------------------------
+bool CGameWorld::bulletUnitCollision(const Bullet& bullet, CPlayer& unit)
+{
+	COUNTER_INC("collision tests");
+
+	if (unit.isDead())
+		return false;
+
+	Vec2 size = unit.getSize();
+
+	if (bullet.mPosition.x >= unit.Position().x - (size.x / 2))
+		if (bullet.mPosition.x <= unit.Position().x + (size.x / 2))
+			if (bullet.mPosition.y >= unit.Position().y - (size.y / 2))
+				if (bullet.mPosition.y <= unit.Position().y + (size.y / 2))
+					return true;
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Name : AddEnemies ()
+// Desc : Adds specified number of enemies.
+//-----------------------------------------------------------------------------
+void CGameWorld::AddEnemies(int noEnemies)
+{
+	Vec2 position = Vec2(_screenSize.x / 2 - 500, 50.0);
+
+	for (int it = 0; it != noEnemies; ++it) {
+		CPlayer *enemy = new CPlayer(CPlayer::TEAM::ENEMY, _enemySize);
+
+		enemy->Position() = position;
+		enemy->Velocity() = Vec2(0, 0);
+		enemy->frameCounter() = Random() % ENEMY_FIRE_FRAME;
+
+		_enemies.push_back(enemy);
+
+		position.x += 100;
+		if (position.x > _screenSize.x / 2 + 500) {
+			position.x = _screenSize.x / 2 - 500;
+			position.y += 90;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetLives ()
+// Desc : Sets number of lives for all players.
+//-----------------------------------------------------------------------------
+void CGameWorld::SetLives(int livesP1, int livesP2)
+{
+	_Player1->setLives(livesP1);
+	_Player2->setLives(livesP2);
+}
+
+//-----------------------------------------------------------------------------
+// Name : enemyFire () (Private)
+// Desc : Iterates trough all the enemies and makes them fire using a
+// random pattern.
+//-----------------------------------------------------------------------------
+void CGameWorld::enemyFire()
+{
+	for (auto enem : _enemies) {
+		if (enem->frameCounter() == ENEMY_FIRE_FRAME) {
+			enem->frameCounter() = Random() % 1500;
+			SpawnBullet(enem->Position(), Vec2(0, 200), CPlayer::TEAM::ENEMY);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : holdInside () (Private)
+// Desc : Holds a player unit inside of the playable window.
+//-----------------------------------------------------------------------------
+void CGameWorld::holdInside(CPlayer& unit)
+{
+	Vec2 size = unit.getSize();
+
+	// bind player inside right margin
+	if (unit.Position().x + (size.x / 2) >= _screenSize.x) {
+		unit.Position().x = _screenSize.x - (size.x / 2);
+	}
+
+	// bind player inside left margin
+	if (unit.Position().x - (size.x / 2) <= 0) {
+		unit.Position().x = size.x / 2;
+	}
+
+	// bind player inside bottom marin
+	if (unit.Position().y + (size.y / 2) >= _screenSize.y) {
+		unit.Position().y = _screenSize.y - (size.y / 2);
+	}
+
+	// bind player inside top margin
+	if (unit.Position().y - (size.y / 2) <= 0) {
+		unit.Position().y = size.y / 2;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : btpDistance ()
+// Desc : Calculates bullet to player unit distance.
+//-----------------------------------------------------------------------------
+static double btpDistance(Bullet& bullet, CPlayer& player)
+{
+	return bullet.mPosition.Distance(player.Position());
+}
+
+//-----------------------------------------------------------------------------
+// Name : moveTowards ()
+// Desc : Moves a bullet towards a specified destination.
+//-----------------------------------------------------------------------------
+static void moveTowards(Bullet& bullet, const Vec2 destination)
+{
+	if (bullet.mPosition.x > destination.x) {
+		bullet.mVelocity.x -= 2;
+	}
+	else {
+		bullet.mVelocity.x += 2;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : trackPlayer () (Private)
+// Desc : Moves a bullet towards the closest alive player.
+//-----------------------------------------------------------------------------
+void CGameWorld::trackPlayer(Bullet& bullet)
+{
+	if (_Player1->isDead() && !_Player2->isDead()) {
+		moveTowards(bullet, _Player2->Position());
+	}
+	else if (_Player2->isDead() && !_Player1->isDead()) {
+		moveTowards(bullet, _Player1->Position());
+	}
+	else if (!_Player1->isDead() && !_Player2->isDead()) {
+		if (btpDistance(bullet, *_Player1) < btpDistance(bullet, *_Player2)) {
+			moveTowards(bullet, _Player1->Position());
+		}
+		else {
+			moveTowards(bullet, _Player2->Position());
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : updateGameState () (Private)
+// Desc : Updates the game state when all players or all enemies have died.
+//-----------------------------------------------------------------------------
+void CGameWorld::updateGameState()
+{
+	if (_Player1->isDead() && _Player2->isDead() && _gameState == ONGOING) {
+		_gameState = LOST;
+	}
+	else if (!_enemies.size() && _gameState == ONGOING) {
+		_gameState = WON;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : moveEnemies () (Private)
+// Desc : Moves the enemy formation left, down, right and up in a loop.
+//-----------------------------------------------------------------------------
+void CGameWorld::moveEnemies()
+{
+	frameCounter++;
+
+	if (frameCounter > 1400) {
+		frameCounter = 0;
+	}
+
+	for (auto enem : _enemies) {
+		if (frameCounter <= 300) {
+			enem->Velocity() = Vec2(-20, 0);
+		}
+		else if (frameCounter <= 400) {
+			enem->Velocity() = Vec2(0, 20);
+		}
+		else if (frameCounter <= 1000) {
+			enem->Velocity() = Vec2(20, 0);
+		}
+		else if (frameCounter <= 1100) {
+			enem->Velocity() = Vec2(0, -20);
+		}
+		else if (frameCounter <= 1400) {
+			enem->Velocity() = Vec2(-20, 0);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetScore ()
+// Desc : Returns the score of the given player team.
+//-----------------------------------------------------------------------------
+int CGameWorld::GetScore(CPlayer::TEAM team) const
+{
+	return team == CPlayer::TEAM::PLAYER1 ? _scoreP1 : _scoreP2;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetScore ()
+// Desc : Sets the score of the given player team.
+//-----------------------------------------------------------------------------
+void CGameWorld::SetScore(CPlayer::TEAM team, int score)
+{
+	if (team == CPlayer::TEAM::PLAYER1)
+		_scoreP1 = score;
+	else
+		_scoreP2 = score;
+}
+
+//-----------------------------------------------------------------------------
+// Name : PublishCounters ()
+// Desc : Updates the entity gauges of the runtime counters.
+//-----------------------------------------------------------------------------
+void CGameWorld::PublishCounters() const
+{
+	GAUGE_SET("enemies alive", _enemies.size());
+	GAUGE_SET("bullets alive", _bullets.size());
+}
+
+//-----------------------------------------------------------------------------
+// Name : StateName () (Static)
+// Desc : Printable name of a game state, used to tag counters and stats.
+//-----------------------------------------------------------------------------
+const char* CGameWorld::StateName(GameState state)
+{
+	static const char *szStateNames[] = { "START", "ONGOING", "LOST", "WON", "PAUSE" };
+	return szStateNames[state];
+}
+
+//-----------------------------------------------------------------------------
+// Name : Save ()
+// Desc : Save current state of the game in a file.
+//-----------------------------------------------------------------------------
+bool CGameWorld::Save(const char *szFileName) const
+{
+	std::ofstream save(szFileName);
+	if (!save)
+		return false;
+
+	save << _Player1->Position().x << " " << _Player1->Position().y << " " << _Player1->getLives() << " ";
+	save << _scoreP1 << "\n";
+	save << _Player2->Position().x << " " << _Player2->Position().y << " " << _Player2->getLives() << " ";
+	save << _scoreP2 << "\n";
+
+	save << _enemies.size() << "\n";
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Load ()
+// Desc : Loads previous state of the game from a file and resumes playing.
+//-----------------------------------------------------------------------------
+bool CGameWorld::Load(const char *szFileName)
+{
+	std::ifstream save(szFileName);
+	if (!save)
+		return false;
+
+	while (_enemies.size()) delete _enemies.back(), _enemies.pop_back();
+	while (_bullets.size()) delete _bullets.back(), _bullets.pop_back();
+
+	double cdx, cdy;
+	int livesP1, livesP2, noEnem;
+
+	save >> cdx >> cdy >> livesP1 >> _scoreP1;
+	_Player1->Position() = Vec2(cdx, cdy);
+
+	save >> cdx >> cdy >> livesP2 >> _scoreP2;
+	_Player2->Position() = Vec2(cdx, cdy);
+
+	SetLives(livesP1, livesP2);
+
+	save >> noEnem;
+	AddEnemies(noEnem);
+
+	_gameState = ONGOING;
+	return true;
+}
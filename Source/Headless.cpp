@@ -0,0 +1,146 @@
+//-----------------------------------------------------------------------------
+// File: Headless.cpp
+//
+// Desc: Window-less runner. Drives the game simulation for a fixed number of
+//	frames with bot or scripted input and writes timing and counter
+//	statistics, used for performance regression checks on machines without
+//	a display.
+//
+//	Usage: Headless --headless --frames N --seed S --stats out.json
+//		[--enemies N] [--bullets N] [--screen WxH] [--bot | --script file]
+//		[--counters file.csv|file.json] [--trace file.json]
+//
+//	See CSimRunner::LoadScript for the script format.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Headless Specific Includes
+//-----------------------------------------------------------------------------
+#include "SimRunner.h"
+#include "Profiler.h"
+#include "Counters.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	struct SArgs
+	{
+		bool				bHeadless;
+		const char			*szStats;
+		const char			*szCounters;
+		const char			*szTrace;
+		const char			*szScript;
+		CSimRunner::SOptions sim;
+
+		SArgs() : bHeadless(false), szStats(NULL), szCounters(NULL), szTrace(NULL), szScript(NULL) {}
+	};
+
+	void Usage()
+	{
+		fprintf(stderr,
+			"usage: Headless --headless --frames N --seed S --stats out.json\n"
+			"                [--enemies N] [--bullets N] [--screen WxH] [--bot | --script file]\n"
+			"                [--counters file.csv|file.json] [--trace file.json]\n");
+	}
+
+	bool ParseArgs(int argc, char **argv, SArgs &args)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const char *szArg = argv[i];
+			const char *szValue = i + 1 < argc ? argv[i + 1] : NULL;
+
+			if (strcmp(szArg, "--headless") == 0) { args.bHeadless = true; continue; }
+			if (strcmp(szArg, "--bot") == 0) { args.sim.input = CSimRunner::INPUT_BOT; continue; }
+
+			if (!szValue) return false;
+			i++;
+
+			if (strcmp(szArg, "--frames") == 0)			args.sim.ulFrames = strtoul(szValue, NULL, 10);
+			else if (strcmp(szArg, "--seed") == 0)		args.sim.uSeed = (unsigned int)strtoul(szValue, NULL, 10);
+			else if (strcmp(szArg, "--enemies") == 0)	args.sim.iEnemies = atoi(szValue);
+			else if (strcmp(szArg, "--bullets") == 0)	args.sim.iBullets = atoi(szValue);
+			else if (strcmp(szArg, "--stats") == 0)		args.szStats = szValue;
+			else if (strcmp(szArg, "--counters") == 0)	args.szCounters = szValue;
+			else if (strcmp(szArg, "--trace") == 0)		args.szTrace = szValue;
+			else if (strcmp(szArg, "--script") == 0)	args.szScript = szValue;
+			else if (strcmp(szArg, "--screen") == 0)
+			{
+				int w, h;
+				if (sscanf(szValue, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) return false;
+				args.sim.screenSize = Vec2(w, h);
+			}
+			else return false;
+		}
+
+		return args.bHeadless;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : main ()
+// Desc : Entry point of the headless runner.
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	SArgs args;
+	if (!ParseArgs(argc, argv, args))
+	{
+		Usage();
+		return 2;
+	}
+
+	if (args.szScript)
+	{
+		if (!CSimRunner::LoadScript(args.szScript, args.sim.script))
+		{
+			fprintf(stderr, "Headless: cannot read script %s\n", args.szScript);
+			return 1;
+		}
+
+		// The script decides when the game starts
+		args.sim.input = CSimRunner::INPUT_SCRIPT;
+		args.sim.startState = CGameWorld::START;
+	}
+
+	CProfiler::SetThreadName("Simulation");
+	if (args.szCounters)
+		CCounters::EnableHistory(true);
+
+	CSimRunner::SResult result;
+	CSimRunner::Run(args.sim, result);
+
+	int iResult = 0;
+
+	if (args.szStats && !CSimRunner::WriteStats(args.szStats, args.sim, result))
+	{
+		fprintf(stderr, "Headless: cannot write %s\n", args.szStats);
+		iResult = 1;
+	}
+
+	if (args.szCounters)
+	{
+		size_t nLength = strlen(args.szCounters);
+		bool bCSV = nLength > 4 && strcmp(args.szCounters + nLength - 4, ".csv") == 0;
+
+		if (!(bCSV ? CCounters::ExportCSV(args.szCounters) : CCounters::ExportJSON(args.szCounters)))
+		{
+			fprintf(stderr, "Headless: cannot write %s\n", args.szCounters);
+			iResult = 1;
+		}
+	}
+
+	if (args.szTrace && !CProfiler::Dump(args.szTrace))
+	{
+		fprintf(stderr, "Headless: cannot write %s\n", args.szTrace);
+		iResult = 1;
+	}
+
+	printf("%lu frames, state %s, score %d / %d\n", result.ulFrames,
+		CGameWorld::StateName(result.finalState), result.iScoreP1, result.iScoreP2);
+
+	return iResult;
+}
@@ -0,0 +1,178 @@
+//-----------------------------------------------------------------------------
+// File: ImageCompare.cpp
+//
+// Desc: Image quality tool. Compares two BMP files, or resamples one in
+//	both the sRGB and the linear light mode and reports how well each mode
+//	survives a round trip (to the target size and back).
+//
+//	Usage: ImageCompare a.bmp b.bmp
+//	       ImageCompare --resample in.bmp WxH [--filter name] [--out prefix]
+//
+//	Filters are box, bilinear, bicubic (default), bspline and lanczos3.
+//	With --out the resampled images are written to <prefix>_srgb.bmp and
+//	<prefix>_linear.bmp.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// ImageCompare Specific Includes
+//-----------------------------------------------------------------------------
+#include "ImageMetrics.h"
+#include "StreamResizer.h"
+
+#include <memory>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	void Usage()
+	{
+		fprintf(stderr,
+			"usage: ImageCompare a.bmp b.bmp\n"
+			"       ImageCompare --resample in.bmp WxH [--filter name] [--out prefix]\n");
+	}
+
+	CGenericFilter* CreateFilter(const char *szName)
+	{
+		if (strcmp(szName, "box") == 0)			return new CBoxFilter();
+		if (strcmp(szName, "bilinear") == 0)	return new CBilinearFilter();
+		if (strcmp(szName, "bicubic") == 0)		return new CBicubicFilter();
+		if (strcmp(szName, "bspline") == 0)		return new CBSplineFilter();
+		if (strcmp(szName, "lanczos3") == 0)	return new CLanczos3Filter();
+		return NULL;
+	}
+
+	bool LoadBmp(const char *szFileName, CImageFile &image)
+	{
+		CBmpRowProvider source;
+		if (!source.Open(szFileName) || !image.Create(source.Width(), source.Height()))
+			return false;
+
+		for (LONG y = 0; y < source.Height(); y++)
+		{
+			if (!source.ReadRow(y, image.Pixels() + y * image.Width()))
+				return false;
+		}
+		return true;
+	}
+
+	bool SaveBmp(const char *szFileName, const CImageFile &image)
+	{
+		CBmpRowSink sink;
+		if (!sink.Create(szFileName, image.Width(), image.Height()))
+			return false;
+
+		for (LONG y = 0; y < image.Height(); y++)
+			sink.WriteRow(y, image.Pixels() + y * image.Width());
+		return sink.Close();
+	}
+
+	void PrintMetrics(const char *szLabel, const CImageFile &a, const CImageFile &b)
+	{
+		printf("%-16s PSNR %8.3f dB  SSIM %.5f\n", szLabel, CImageMetrics::PSNR(a, b), CImageMetrics::SSIM(a, b));
+	}
+
+	int Compare(const char *szA, const char *szB)
+	{
+		CImageFile a, b;
+		if (!LoadBmp(szA, a) || !LoadBmp(szB, b))
+		{
+			fprintf(stderr, "ImageCompare: cannot read %s or %s\n", szA, szB);
+			return 1;
+		}
+
+		if (a.Width() != b.Width() || a.Height() != b.Height())
+		{
+			fprintf(stderr, "ImageCompare: sizes differ (%dx%d, %dx%d)\n", (int)a.Width(), (int)a.Height(),
+				(int)b.Width(), (int)b.Height());
+			return 1;
+		}
+
+		PrintMetrics("a / b", a, b);
+		return 0;
+	}
+
+	int RoundTrip(const char *szIn, int iWidth, int iHeight, const char *szFilter, const char *szOut)
+	{
+		std::unique_ptr<CGenericFilter> pFilter(CreateFilter(szFilter));
+		if (!pFilter)
+		{
+			fprintf(stderr, "ImageCompare: unknown filter '%s'\n", szFilter);
+			return 1;
+		}
+
+		CImageFile source;
+		if (!LoadBmp(szIn, source))
+		{
+			fprintf(stderr, "ImageCompare: cannot read %s\n", szIn);
+			return 1;
+		}
+
+		CResizableImage resized[2], back[2];
+		const char *szModes[2] = { "srgb", "linear" };
+
+		for (int m = 0; m < 2; m++)
+		{
+			resized[m].CopyFrom(source);
+			resized[m].SetFilter(pFilter.get());
+			resized[m].SetLinearLight(m == 1);
+			resized[m].Resample(iWidth, iHeight);
+
+			back[m].CopyFrom(resized[m]);
+			back[m].SetFilter(pFilter.get());
+			back[m].SetLinearLight(m == 1);
+			back[m].Resample(source.Width(), source.Height());
+
+			std::string strLabel = std::string(szModes[m]) + " round trip";
+			PrintMetrics(strLabel.c_str(), source, back[m]);
+
+			if (szOut)
+			{
+				std::string strFile = std::string(szOut) + "_" + szModes[m] + ".bmp";
+				if (!SaveBmp(strFile.c_str(), resized[m]))
+					fprintf(stderr, "ImageCompare: cannot write %s\n", strFile.c_str());
+			}
+		}
+
+		PrintMetrics("srgb / linear", resized[0], resized[1]);
+		return 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : main ()
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	if (argc == 3 && argv[1][0] != '-')
+		return Compare(argv[1], argv[2]);
+
+	if (argc < 4 || strcmp(argv[1], "--resample") != 0)
+	{
+		Usage();
+		return 2;
+	}
+
+	int iWidth, iHeight;
+	if (sscanf(argv[3], "%dx%d", &iWidth, &iHeight) != 2 || iWidth <= 0 || iHeight <= 0)
+	{
+		Usage();
+		return 2;
+	}
+
+	const char *szFilter = "bicubic";
+	const char *szOut = NULL;
+
+	for (int i = 4; i < argc; i++)
+	{
+		if (i + 1 >= argc) { Usage(); return 2; }
+
+		if (strcmp(argv[i], "--filter") == 0)		szFilter = argv[++i];
+		else if (strcmp(argv[i], "--out") == 0)		szOut = argv[++i];
+		else { Usage(); return 2; }
+	}
+
+	return RoundTrip(argv[2], iWidth, iHeight, szFilter, szOut);
+}
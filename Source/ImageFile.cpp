@@ -2,86 +2,91 @@
 // by Mihai Popescu
 // March 2009
 #include "ImageFile.h"
+#include "BmpDecoder.h"
+#include "ResizeEngine.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+#include "Counters.h"
 
+#include <algorithm>
+
+#ifdef _WIN32
 extern HINSTANCE g_hInst;
+#endif
 
 
 CImageFile::CImageFile() : height(m_biInfo.biHeight), width(m_biInfo.biWidth)
 {
+#ifdef _WIN32
 	m_hBMP = 0;
+#endif
 	m_pRGB = NULL;
+	m_pMip = NULL;
+	m_MipFilter = MIP_BOX;
+	m_szFileName[0] = 0;
 	ZeroMemory(&m_biInfo, sizeof(BITMAPINFOHEADER));
 }
 
-bool CImageFile::LoadBitmapFromFile(const char *szFileName, HDC hdc)
+bool CImageFile::Create(LONG w, LONG h)
 {
-	BYTE *pData;
-	HDC mdc = CreateCompatibleDC(hdc);
-
-	strcpy_s(m_szFileName, MAX_PATH, szFileName);
+	if(w <= 0 || h <= 0)
+		return false;
 
-	// release previously loaded file data
+	ReleaseMips();
 	if(m_pRGB)
-	{
 		delete[] m_pRGB;
-		m_pRGB = NULL;
-	}
-
-	if(m_hBMP)
-	{
-		DeleteObject(m_hBMP);
-		m_hBMP = 0;
-	}
-
-	// Loads the image.
-	m_hBMP = (HBITMAP)LoadImage(g_hInst, szFileName, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);	
-
-	if(!m_hBMP)
-		return false;
-
-	ZeroMemory(&m_biInfo, sizeof(BITMAPINFO));
-	m_biInfo.biSize=sizeof(BITMAPINFOHEADER);
-
-	// send NULL to bits to get the bitmap info
-	GetDIBits(mdc, m_hBMP, 0, 0, NULL, (BITMAPINFO*)&m_biInfo, DIB_RGB_COLORS);
 
-	pData = new BYTE[m_biInfo.biSizeImage];
+	SetHeader(w, h);
+	m_pRGB = new RGBQUAD[w * h];
+	Clear();
 
-	// read the bitmap data
-	// NOTE: We use this method to access the bitmap bits in order to modify them
-	// applying different filters or other image processing algorithms in real time 
-	// such as blur effect (denoising) or other convolutions.
-	GetDIBits(mdc, m_hBMP, 0, height, pData, (BITMAPINFO*)&m_biInfo, DIB_RGB_COLORS);
+	return true;
+}
 
-	m_pRGB = new RGBQUAD[width * height];
+void CImageFile::SetHeader(LONG w, LONG h)
+{
+	ZeroMemory(&m_biInfo, sizeof(BITMAPINFOHEADER));
+	m_biInfo.biSize = sizeof(BITMAPINFOHEADER);
+	m_biInfo.biWidth = w;
+	m_biInfo.biHeight = h;
+	m_biInfo.biPlanes = 1;
+	m_biInfo.biBitCount = 32;
+	m_biInfo.biCompression = BI_RGB;
+}
 
-	// Fill RGB image on 32 bit in order to display it
-	if(m_biInfo.biBitCount == 24)
-	{
-		int size = width * height;
-		unsigned char *data = pData;
-		RGBQUAD *c = m_pRGB;
+bool CImageFile::CopyFrom(const CImageFile &source)
+{
+	if(&source == this || !source.m_pRGB || !Create(source.width, source.height))
+		return false;
 
-		for(int i=0;i<size;i++)
-		{
-			c->rgbBlue = *data++;
-			c->rgbGreen = *data++;
-			c->rgbRed = *data++;
-			c->rgbReserved = 0;
-			c++;
-		}
-	}
+	memcpy(m_pRGB, source.m_pRGB, sizeof(RGBQUAD) * width * height);
+	return true;
+}
 
-	m_biInfo.biBitCount = 32;
+void CImageFile::Release()
+{
+	ReleaseMips();
+	delete[] m_pRGB;
+	m_pRGB = NULL;
+	ZeroMemory(&m_biInfo, sizeof(BITMAPINFOHEADER));
 
+#ifdef _WIN32
 	DeleteObject(m_hBMP);
 	m_hBMP = 0;
+#endif
+}
 
-	DeleteDC(mdc);
+#ifdef _WIN32
 
-	delete[] pData;
+bool CImageFile::LoadBitmapFromFile(const char *szFileName, HDC /*hdc*/)
+{
+	if(m_hBMP)
+	{
+		DeleteObject(m_hBMP);
+		m_hBMP = 0;
+	}
 
-	return true;
+	return LoadFromFile(szFileName);
 }
 
 void CImageFile::Reload(HDC hdc)
@@ -91,6 +96,8 @@ void CImageFile::Reload(HDC hdc)
 
 void CImageFile::Paint(HDC hdc, int x, int y)
 {
+	PROFILE_SCOPE("CImageFile::Paint");
+
 	if(!m_pRGB)
 		return;
 
@@ -107,160 +114,111 @@ void CImageFile::Paint(HDC hdc, int x, int y)
 
 	DeleteDC(mdc);
 }
+#endif // _WIN32
+
+
+// Decodes straight from the mapped file into m_pRGB, bottom row first as
+// in a GDI DIB
+bool CImageFile::LoadFromFile(const char *szFileName)
+{
+	PROFILE_SCOPE("CImageFile::LoadFromFile");
 
+	CBmpDecoder decoder;
+	COUNTER_INC("bitmap loads");
+
+	if(!decoder.Open(szFileName))
+		return false;
+
+	// release previously loaded file data
+	ReleaseMips();
+	if(m_pRGB)
+		delete[] m_pRGB;
+
+	SetHeader(decoder.Width(), decoder.Height());
+	m_pRGB = new RGBQUAD[decoder.Width() * decoder.Height()];
+
+	if(!decoder.Decode(m_pRGB, true))
+	{
+		delete[] m_pRGB;
+		m_pRGB = NULL;
+		ZeroMemory(&m_biInfo, sizeof(BITMAPINFOHEADER));
+		return false;
+	}
+
+	if(szFileName != m_szFileName)
+	{
+		size_t length = (std::min)(strlen(szFileName), (size_t)MAX_PATH - 1);
+		memcpy(m_szFileName, szFileName, length);
+		m_szFileName[length] = 0;
+	}
+	return true;
+}
 
 CImageFile::~CImageFile(void)
 {
+	ReleaseMips();
 	if(m_pRGB)
 		delete[] m_pRGB;
 
+#ifdef _WIN32
 	DeleteObject(m_hBMP);
+#endif
 }
 
-BYTE* CImageFile::CopyMonoImage(EColorChannel chn, const RECT* rc)
+BYTE* CImageFile::CopyMonoImage(EColorChannel chn, const RECT* rc) const
 {
+	int imgHeight = rc? rc->bottom - rc->top + 1 : height;
+	int imgWidth = rc? rc->right - rc->left + 1 : width;
+
+	BYTE *img = new BYTE[imgHeight * imgWidth];
+	CopyMonoImage(chn, img, imgWidth, rc);
+	return img;
+}
+
+void CImageFile::CopyMonoImage(EColorChannel chn, BYTE *pDst, size_t dstStride, const RECT* rc) const
+{
+	PROFILE_SCOPE("CImageFile::CopyMonoImage");
+
 	int imgHeight = rc? rc->bottom - rc->top + 1 : height;
 	int imgWidth = rc? rc->right - rc->left + 1 : width;
 	int x = rc? rc->left : 0;
 	int y = rc? rc->top : 0;
 
-	BYTE *img = new BYTE[imgHeight * imgWidth];
+	if(chn >= ECC_EXCLUSIVERED)
+		chn = (EColorChannel)(chn - ECC_EXCLUSIVERED + ECC_RED);
 
-	switch(chn)
+	const SPixelKernels &kernels = GetPixelKernels();
+
+	for(int i=0;i<imgHeight;i++, pDst += dstStride)
 	{
+		const RGBQUAD *pRow = m_pRGB + (i+y)*width + x;
 
-	case ECC_RED:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-				img[i*imgWidth + j] = m_pRGB[(i+y)*width + j + x].rgbRed;
-		break;
-
-	case ECC_GREEN:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-				img[i*imgWidth + j] = m_pRGB[(i+y)*width + j + x].rgbGreen;
-		break;
-
-	case ECC_BLUE:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-				img[i*imgWidth + j] = m_pRGB[(i+y)*width + j + x].rgbBlue;
-		break;
-
-	case ECC_HUE:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-			{
-				RGBQUAD &q = m_pRGB[(i+y)*width + j + x];
-				float r = q.rgbRed/255.0f;
-				float g = q.rgbGreen/255.0f;
-				float b = q.rgbBlue/255.0f;
-
-				float u = max(r, g);
-				u = max(b, u);
-				float d = min(r, g);
-				d = min(b, d);
-
-				BYTE v;
-
-				if(fabsf(u-d)<EPS)
-					v=0;
-				else
-				{
-					float f = 1/(u-d);
-
-					if(fabsf(u-r)<EPS)
-					{
-						f *= (g-b)*60.f;
-					}
-					else
-					if(fabsf(u-g)<EPS)
-					{
-						f *= (b-r)*60.f;
-						f += 120;
-					}
-					else
-					if(fabsf(u-b)<EPS)
-					{
-						f *= (r-g)*60.f;
-						f += 240;
-					}
-
-					v = (BYTE)(f*255.f/360.f);
-				}
-
-				img[i*imgWidth + j] = v;
-			}
-
-	case ECC_SATURATION:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-			{
-				RGBQUAD &q = m_pRGB[(i+y)*width + j + x];
-				float r = q.rgbRed/255.0f;
-				float g = q.rgbGreen/255.0f;
-				float b = q.rgbBlue/255.0f;
-
-				float u = max(r, g);
-				u = max(b, u);
-				float d = min(r, g);
-				d = min(b, d);
-
-				BYTE v;
-
-				if(fabsf(u-d)<EPS)
-					v=0;
-				else
-				{
-					float l = (u+d)/2;
-					float f = (u-d);
-
-					if(l<=0.5f)
-						f /= u+d;
-					else
-						f /= 2-u-d;
-
-					v = (BYTE)(f*255.f);
-				}
-
-				img[i*imgWidth + j] = v;
-			}
-		break;
-
-	case ECC_LUMINOSITY:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-			{
-				RGBQUAD &q = m_pRGB[(i+y)*width + j + x];
-				float r = q.rgbRed/255.0f;
-				float g = q.rgbGreen/255.0f;
-				float b = q.rgbBlue/255.0f;
-
-				float u = max(r, g);
-				u = max(b, u);
-				float d = min(r, g);
-				d = min(b, d);
-
-				BYTE v;
-
-				if(fabsf(u-d)<EPS)
-					v=0;
-				else
-				{
-					float f = (u+d)/2;
-					v = (BYTE)(f*255.f);
-				}
-
-				img[i*imgWidth + j] = v;
-			}
-		break;
+		switch(chn)
+		{
+		case ECC_RED:			kernels.pfnSplitRgb(pRow, pDst, NULL, NULL, imgWidth); break;
+		case ECC_GREEN:			kernels.pfnSplitRgb(pRow, NULL, pDst, NULL, imgWidth); break;
+		case ECC_BLUE:			kernels.pfnSplitRgb(pRow, NULL, NULL, pDst, imgWidth); break;
+		case ECC_HUE:			kernels.pfnRgbToHsl(pRow, pDst, NULL, NULL, imgWidth); break;
+		case ECC_SATURATION:	kernels.pfnRgbToHsl(pRow, NULL, pDst, NULL, imgWidth); break;
+		case ECC_LUMINOSITY:	kernels.pfnRgbToHsl(pRow, NULL, NULL, pDst, imgWidth); break;
+		default:				break;
+		}
 	}
-
-	return img;
 }
 
 void CImageFile::PasteMonoImage(const BYTE *img, EColorChannel chn, const RECT* rc)
 {
+	int imgWidth = rc? rc->right - rc->left + 1 : width;
+
+	PasteMonoImage(img, imgWidth, chn, rc);
+}
+
+void CImageFile::PasteMonoImage(const BYTE *img, size_t srcStride, EColorChannel chn, const RECT* rc)
+{
+	PROFILE_SCOPE("CImageFile::PasteMonoImage");
+
+	ReleaseMips();
+
 	int imgHeight = rc? rc->bottom - rc->top + 1 : height;
 	int imgWidth = rc? rc->right - rc->left + 1 : width;
 	int x = rc? rc->left : 0;
@@ -269,30 +227,117 @@ void CImageFile::PasteMonoImage(const BYTE *img, EColorChannel chn, const RECT*
 	if(chn >= ECC_EXCLUSIVERED)
 		Clear();
 
+	// byte of the channel within an RGBQUAD
+	unsigned uChannel;
 	switch(chn)
 	{
-
 	case ECC_EXCLUSIVERED:
-	case ECC_RED:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-				m_pRGB[(i+y)*width + j + x].rgbRed = img[i*imgWidth + j];
-		break;
-
+	case ECC_RED:		uChannel = 2; break;
 	case ECC_EXCLUSIVEGREEN:
-	case ECC_GREEN:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-				m_pRGB[(i+y)*width + j + x].rgbGreen = img[i*imgWidth + j];
-		break;
-
+	case ECC_GREEN:		uChannel = 1; break;
 	case ECC_EXCLUSIVEBLUE:
-	case ECC_BLUE:
-		for(int i=0;i<imgHeight;i++)
-			for(int j=0;j<imgWidth;j++)
-				m_pRGB[(i+y)*width + j + x].rgbBlue = img[i*imgWidth + j];
-		break;
+	case ECC_BLUE:		uChannel = 0; break;
+	default:			return;
+	}
+
+	MERGE_CHANNEL_KERNEL pfnMerge = GetPixelKernels().pfnMergeChannel;
+
+	for(int i=0;i<imgHeight;i++, img += srcStride)
+		pfnMerge(img, m_pRGB + (i+y)*width + x, uChannel, imgWidth);
+}
+
+void CImageFile::SetMipFilter(EMipFilter filter)
+{
+	if(filter != m_MipFilter)
+		ReleaseMips();
+	m_MipFilter = filter;
+}
+
+int CImageFile::GetMipLevelCount() const
+{
+	if(!m_pRGB)
+		return 0;
+
+	int iLevels = 1;
+	for(LONG w = width, h = height; w > 1 || h > 1; iLevels++)
+	{
+		w = (std::max)(w / 2, (LONG)1);
+		h = (std::max)(h / 2, (LONG)1);
 	}
+	return iLevels;
+}
+
+const CImageFile* CImageFile::GetMipLevel(int iLevel)
+{
+	CImageFile *pLevel = this;
+
+	for(int i = 0; i < iLevel; i++)
+	{
+		if(!pLevel->m_pMip)
+		{
+			if(!pLevel->m_pRGB || (pLevel->width == 1 && pLevel->height == 1))
+				return NULL;
+
+			PROFILE_SCOPE("CImageFile::BuildMipLevel");
+			COUNTER_INC("mip levels built");
+
+			// 2x box reductions of even sizes take the integer ratio path
+			// of Resample, odd sizes and Lanczos the general one
+			CBoxFilter box;
+			CLanczos3Filter lanczos;
+			CResizableImage reduced;
+
+			reduced.SetFilter(m_MipFilter == MIP_LANCZOS ? (CGenericFilter*)&lanczos : &box);
+			reduced.ResampleFrom(*pLevel, (std::max)(pLevel->width / 2, (LONG)1), (std::max)(pLevel->height / 2, (LONG)1));
 
+			// take the pixels over instead of copying them once more
+			CImageFile *pMip = new CImageFile;
+			pMip->m_biInfo = reduced.m_biInfo;
+			pMip->m_pRGB = reduced.m_pRGB;
+			pMip->m_MipFilter = m_MipFilter;
+			reduced.m_pRGB = NULL;
+
+			pLevel->m_pMip = pMip;
+		}
+		pLevel = pLevel->m_pMip;
+	}
+
+	return pLevel;
+}
+
+const CImageFile* CImageFile::GetNearestMipLevel(LONG lWidth, LONG lHeight, int *pLevel)
+{
+	int iLevel = 0;
+	LONG w = width, h = height;
+
+	while(w > 1 || h > 1)
+	{
+		LONG nextWidth = (std::max)(w / 2, (LONG)1);
+		LONG nextHeight = (std::max)(h / 2, (LONG)1);
+		if(nextWidth < lWidth || nextHeight < lHeight)
+			break;
+
+		w = nextWidth;
+		h = nextHeight;
+		iLevel++;
+	}
+
+	if(pLevel)
+		*pLevel = iLevel;
+	return GetMipLevel(iLevel);
+}
+
+size_t CImageFile::GetMipBytes() const
+{
+	size_t bytes = 0;
+	for(const CImageFile *pMip = m_pMip; pMip; pMip = pMip->m_pMip)
+		bytes += sizeof(RGBQUAD) * pMip->width * pMip->height;
+	return bytes;
 }
 
+void CImageFile::ReleaseMips()
+{
+	// levels own each other, the whole chain goes with the first one
+	delete m_pMip;
+	m_pMip = NULL;
+}
@@ -0,0 +1,122 @@
+//-----------------------------------------------------------------------------
+// File: ImageMetrics.cpp
+//
+// Desc: PSNR and SSIM of two images of the same size.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// ImageMetrics Specific Includes
+//-----------------------------------------------------------------------------
+#include "ImageMetrics.h"
+
+#include <limits>
+#include <vector>
+#include <math.h>
+
+namespace
+{
+	// Wang et al. stabilizing constants for 8 bit data
+	const double SSIM_C1 = (0.01 * 255) * (0.01 * 255);
+	const double SSIM_C2 = (0.03 * 255) * (0.03 * 255);
+
+	bool SameSize( const CImageFile &a, const CImageFile &b )
+	{
+		return a.Width() == b.Width() && a.Height() == b.Height() && a.Width() > 0 && a.Height() > 0;
+	}
+
+	// Rec. 601 luma
+	void ToLuma( const CImageFile &image, std::vector<double> &luma )
+	{
+		const RGBQUAD *p = image.Pixels();
+		luma.resize(image.Width() * image.Height());
+
+		for (size_t i = 0; i < luma.size(); i++)
+			luma[i] = 0.299 * p[i].rgbRed + 0.587 * p[i].rgbGreen + 0.114 * p[i].rgbBlue;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// CImageMetrics Member Functions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : PSNR () (Static)
+//-----------------------------------------------------------------------------
+double CImageMetrics::PSNR( const CImageFile &a, const CImageFile &b )
+{
+	if (!SameSize(a, b))
+		return -1;
+
+	const RGBQUAD *pA = a.Pixels();
+	const RGBQUAD *pB = b.Pixels();
+	size_t count = (size_t)a.Width() * a.Height();
+	double dSum = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		double dr = double(pA[i].rgbRed) - pB[i].rgbRed;
+		double dg = double(pA[i].rgbGreen) - pB[i].rgbGreen;
+		double db = double(pA[i].rgbBlue) - pB[i].rgbBlue;
+		dSum += dr * dr + dg * dg + db * db;
+	}
+
+	if (dSum == 0)
+		return std::numeric_limits<double>::infinity();
+
+	double dMSE = dSum / (3.0 * count);
+	return 10 * log10(255.0 * 255.0 / dMSE);
+}
+
+//-----------------------------------------------------------------------------
+// Name : SSIM () (Static)
+// Desc : Averages the SSIM of SSIM_WINDOW square windows every SSIM_STEP
+//		pixels. Images smaller than a window are compared as one window.
+//-----------------------------------------------------------------------------
+double CImageMetrics::SSIM( const CImageFile &a, const CImageFile &b )
+{
+	if (!SameSize(a, b))
+		return -1;
+
+	std::vector<double> lumaA, lumaB;
+	ToLuma(a, lumaA);
+	ToLuma(b, lumaB);
+
+	int iWidth = a.Width();
+	int iHeight = a.Height();
+	int iWinX = iWidth < SSIM_WINDOW ? iWidth : SSIM_WINDOW;
+	int iWinY = iHeight < SSIM_WINDOW ? iHeight : SSIM_WINDOW;
+	double dTotal = 0;
+	int iWindows = 0;
+
+	for (int y = 0; y + iWinY <= iHeight; y += SSIM_STEP)
+	{
+		for (int x = 0; x + iWinX <= iWidth; x += SSIM_STEP)
+		{
+			double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+			for (int j = y; j < y + iWinY; j++)
+			{
+				for (int i = x; i < x + iWinX; i++)
+				{
+					double va = lumaA[j * iWidth + i];
+					double vb = lumaB[j * iWidth + i];
+					sa += va;
+					sb += vb;
+					saa += va * va;
+					sbb += vb * vb;
+					sab += va * vb;
+				}
+			}
+
+			double n = double(iWinX * iWinY);
+			double ma = sa / n, mb = sb / n;
+			double va = saa / n - ma * ma;
+			double vb = sbb / n - mb * mb;
+			double cov = sab / n - ma * mb;
+
+			dTotal += ((2 * ma * mb + SSIM_C1) * (2 * cov + SSIM_C2)) /
+				((ma * ma + mb * mb + SSIM_C1) * (va + vb + SSIM_C2));
+			iWindows++;
+		}
+	}
+
+	return dTotal / iWindows;
+}
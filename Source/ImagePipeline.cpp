@@ -0,0 +1,737 @@
+// ImagePipeline.cpp
+// Tiled evaluation of CImagePipeline. Stages are grouped into steps, a
+// convolution or resample followed by the point operations after it (only
+// the first step may have none). A tile asks the last step for its pixels,
+// every step asks the one before for the pixels under its window, and the
+// first step reads the source image in place. Point operations run on the
+// rows their step just produced, while they are in cache. Tiles are bands
+// of whole rows and a thread walks its bands downwards, every step keeps
+// the rows the band below reads again (kernel borders, overlapping
+// resample windows) and only produces the new ones, like CStreamResizer's
+// ring of rows.
+#include "ImagePipeline.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+	enum EPointOp
+	{
+		POINT_LOOKUP,		// Every byte looked up in a table
+		POINT_HSL,			// Gray of a hue, saturation or luminosity
+		POINT_PASTE			// One byte into the source pixel
+	};
+
+	// Point operations of a step after fusion: runs of channel selections
+	// and LUTs become a single lookup per byte
+	struct SPointOp
+	{
+		EPointOp type;
+		EColorChannel chn;				// POINT_HSL
+		unsigned uChannel;				// POINT_PASTE, byte pasted
+		bool bExclusive;
+		BYTE uSource[3];				// POINT_LOOKUP, input byte of each output byte
+		BYTE tables[3][256];
+	};
+
+	LONG RectWidth(const RECT &rc) { return rc.right - rc.left + 1; }
+	LONG RectHeight(const RECT &rc) { return rc.bottom - rc.top + 1; }
+
+	// Byte of a red, green or blue channel within an RGBQUAD
+	unsigned ChannelByte(EColorChannel chn)
+	{
+		if (chn >= ECC_EXCLUSIVERED)
+			chn = (EColorChannel)(chn - ECC_EXCLUSIVERED + ECC_RED);
+		return chn == ECC_RED ? 2 : (chn == ECC_GREEN ? 1 : 0);
+	}
+
+	void SetIdentity(SPointOp &op)
+	{
+		op.type = POINT_LOOKUP;
+		op.chn = ECC_RED;
+		op.uChannel = 0;
+		op.bExclusive = false;
+		for (int k = 0; k < 3; k++)
+		{
+			op.uSource[k] = (BYTE)k;
+			for (int i = 0; i < 256; i++)
+				op.tables[k][i] = (BYTE)i;
+		}
+	}
+
+	// Appends op to a step, folded into the lookup before it when both are
+	// lookups: out[k] = next[k][prev[src'][in[src[src']]]]
+	void AddPointOp(std::vector<SPointOp> &ops, const SPointOp &op)
+	{
+		if (op.type != POINT_LOOKUP || ops.empty() || ops.back().type != POINT_LOOKUP)
+		{
+			ops.push_back(op);
+			return;
+		}
+
+		SPointOp prev = ops.back();
+		SPointOp &fused = ops.back();
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned uFrom = op.uSource[k];
+			fused.uSource[k] = prev.uSource[uFrom];
+			for (int i = 0; i < 256; i++)
+				fused.tables[k][i] = op.tables[k][prev.tables[uFrom][i]];
+		}
+	}
+
+	// Whether gray pixels stay gray through op, a lookup then gives
+	// tables[0][gray] for every channel
+	bool KeepsGray(const SPointOp &op)
+	{
+		if (op.type == POINT_HSL)
+			return true;
+		if (op.type == POINT_PASTE)
+			return false;
+		return !memcmp(op.tables[0], op.tables[1], 256) && !memcmp(op.tables[1], op.tables[2], 256);
+	}
+
+	// Whether any pixel comes out of op gray
+	bool MakesGray(const SPointOp &op)
+	{
+		if (op.type != POINT_LOOKUP)
+			return op.type == POINT_HSL;
+		return KeepsGray(op) && op.uSource[0] == op.uSource[1] && op.uSource[1] == op.uSource[2];
+	}
+
+	// count pixels of a row through the point operations [first, last),
+	// pIn may be pOut. pSource is the source row under them, for
+	// POINT_PASTE.
+	void RunPointOps(const std::vector<SPointOp> &ops, size_t first, size_t last, const RGBQUAD *pIn,
+		RGBQUAD *pOut, unsigned count, const RGBQUAD *pSource, std::vector<BYTE> &plane)
+	{
+		for (size_t o = first; o < last; o++)
+		{
+			const SPointOp &op = ops[o];
+			const RGBQUAD *pFrom = o > first ? pOut : pIn;
+
+			if (op.type == POINT_HSL)
+			{
+				if (plane.size() < count)
+					plane.resize(count);
+
+				BYTE *pPlane = &plane[0];
+				GetPixelKernels().pfnRgbToHsl(pFrom,
+					op.chn == ECC_HUE ? pPlane : NULL,
+					op.chn == ECC_SATURATION ? pPlane : NULL,
+					op.chn == ECC_LUMINOSITY ? pPlane : NULL, count);
+
+				for (unsigned i = 0; i < count; i++)
+				{
+					pOut[i].rgbBlue = pOut[i].rgbGreen = pOut[i].rgbRed = pPlane[i];
+					pOut[i].rgbReserved = 0;
+				}
+			}
+			else if (op.type == POINT_PASTE)
+			{
+				for (unsigned i = 0; i < count; i++)
+				{
+					BYTE v = ((const BYTE*)&pFrom[i])[op.uChannel];
+					if (op.bExclusive)
+						memset(&pOut[i], 0, sizeof(RGBQUAD));
+					else
+						pOut[i] = pSource[i];
+					((BYTE*)&pOut[i])[op.uChannel] = v;
+				}
+			}
+			else
+			{
+				const BYTE *pBlue = op.tables[0], *pGreen = op.tables[1], *pRed = op.tables[2];
+				unsigned uBlue = op.uSource[0], uGreen = op.uSource[1], uRed = op.uSource[2];
+
+				for (unsigned i = 0; i < count; i++)
+				{
+					const BYTE *p = (const BYTE*)&pFrom[i];
+					BYTE in[4] = { p[0], p[1], p[2], p[3] };
+
+					pOut[i].rgbBlue = pBlue[in[uBlue]];
+					pOut[i].rgbGreen = pGreen[in[uGreen]];
+					pOut[i].rgbRed = pRed[in[uRed]];
+					pOut[i].rgbReserved = in[3];
+				}
+			}
+		}
+	}
+}
+
+// One Run, shared by the tile bands
+struct SPipelineRun
+{
+	// One step: a convolution or resample (pRegion) and the point
+	// operations after it, inWidth x inHeight pixels in and outWidth x
+	// outHeight out
+	struct SStep
+	{
+		const CImagePipeline::SStage *pRegion;
+		std::vector<SPointOp> ops;
+		LONG inWidth, inHeight;
+		LONG outWidth, outHeight;
+		bool bGray;						// Input pixels are gray
+		CWeightsCache::TablePtr pColumns, pRows;
+		bool bColumnsFirst;				// Resample order, the one Resample picks
+
+		SStep(const CImagePipeline::SStage *pStage, LONG w, LONG h) : pRegion(pStage), inWidth(w), inHeight(h),
+			outWidth(w), outHeight(h), bGray(false), bColumnsFirst(false) {}
+	};
+
+	const RGBQUAD *pSrc;
+	LONG srcWidth;
+	std::vector<SStep> steps;
+	RGBQUAD *pDst;
+	LONG dstWidth;
+	LONG tileHeight;
+	CImagePipeline::SThreadBuffers *pThreads;
+
+	// Pixels rc of step s, rows outStride pixels apart
+	void Produce(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, RGBQUAD *pOut, size_t outStride) const;
+
+	// Pixels rc of the input of step s, the source in place or a buffer
+	const RGBQUAD* Input(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, size_t &stride) const;
+
+	// Same for a step with gray input, as a plane of RectWidth(rc) bytes a
+	// row. The channel or lookup making the pixels gray writes it directly.
+	void InputPlane(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, BYTE *pPlane) const;
+
+	// Returns how many of the step's point operations it ran, on gray
+	// pixels they can run on the plane
+	size_t Convolve(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, RGBQUAD *pOut, size_t outStride,
+		const RGBQUAD *pSource) const;
+	void Resample(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, RGBQUAD *pOut, size_t outStride) const;
+
+	// Makes rows hold rc, rows of RectWidth(rc) pixels, moving up the ones
+	// they already held. Returns the first row still to produce.
+	template <class T>
+	static LONG KeepRows(CImagePipeline::SRows<T> &rows, const RECT &rc);
+
+	static void TileBand(void *pContext, unsigned uBegin, unsigned uEnd);
+};
+
+template <class T>
+LONG SPipelineRun::KeepRows(CImagePipeline::SRows<T> &rows, const RECT &rc)
+{
+	size_t width = RectWidth(rc);
+	if (rows.pixels.size() < width * RectHeight(rc))
+		rows.pixels.resize(width * RectHeight(rc));
+
+	LONG top = rc.top;
+	const RECT &kept = rows.rc;
+	if (kept.left == rc.left && kept.right == rc.right && kept.top <= rc.top && kept.bottom >= rc.top)
+	{
+		LONG bottom = (std::min)(kept.bottom, rc.bottom);
+		if (rc.top > kept.top)
+		{
+			memmove(&rows.pixels[0], &rows.pixels[(size_t)(rc.top - kept.top) * width],
+				sizeof(T) * (bottom - rc.top + 1) * width);
+		}
+		top = bottom + 1;
+	}
+
+	rows.rc = rc;
+	return top;
+}
+
+const RGBQUAD* SPipelineRun::Input(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, size_t &stride) const
+{
+	if (s == 0)
+	{
+		stride = srcWidth;
+		return pSrc + (size_t)rc.top * srcWidth + rc.left;
+	}
+
+	CImagePipeline::SRows<RGBQUAD> &rows = buf.steps[s - 1];
+	LONG top = KeepRows(rows, rc);
+	stride = RectWidth(rc);
+
+	if (top <= rc.bottom)
+	{
+		RECT rest = rc;
+		rest.top = top;
+		Produce(buf, s - 1, rest, &rows.pixels[(size_t)(top - rc.top) * stride], stride);
+	}
+	return &rows.pixels[0];
+}
+
+void SPipelineRun::InputPlane(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, BYTE *pPlane) const
+{
+	const SPixelKernels &kernels = GetPixelKernels();
+	unsigned w = RectWidth(rc);
+	unsigned h = RectHeight(rc);
+	size_t stride;
+
+	const SStep *pPrev = s ? &steps[s - 1] : NULL;
+	const SPointOp *pLast = pPrev && !pPrev->pRegion && !pPrev->ops.empty() ? &pPrev->ops.back() : NULL;
+	if (!pLast || !MakesGray(*pLast))
+	{
+		const RGBQUAD *pIn = Input(buf, s, rc, stride);
+		for (unsigned j = 0; j < h; j++)
+			kernels.pfnSplitRgb(pIn + j * stride, NULL, NULL, pPlane + j * w, w);
+		return;
+	}
+
+	// The previous step up to its last operation, which then writes the plane
+	const RGBQUAD *pIn = Input(buf, s - 1, rc, stride);
+	const RGBQUAD *pSource = pSrc + (size_t)rc.top * srcWidth + rc.left;
+	size_t last = pPrev->ops.size() - 1;
+	if (last && buf.row.size() < w)
+		buf.row.resize(w);
+
+	for (unsigned j = 0; j < h; j++)
+	{
+		const RGBQUAD *pRow = pIn + j * stride;
+		BYTE *pOut = pPlane + j * w;
+
+		if (last)
+		{
+			RunPointOps(pPrev->ops, 0, last, pRow, &buf.row[0], w, pSource + j * srcWidth, buf.plane);
+			pRow = &buf.row[0];
+		}
+
+		if (pLast->type == POINT_HSL)
+		{
+			kernels.pfnRgbToHsl(pRow,
+				pLast->chn == ECC_HUE ? pOut : NULL,
+				pLast->chn == ECC_SATURATION ? pOut : NULL,
+				pLast->chn == ECC_LUMINOSITY ? pOut : NULL, w);
+		}
+		else
+		{
+			unsigned u = pLast->uSource[0];
+			kernels.pfnSplitRgb(pRow, u == 2 ? pOut : NULL, u == 1 ? pOut : NULL, u == 0 ? pOut : NULL, w);
+
+			const BYTE *pTable = pLast->tables[0];
+			for (unsigned i = 0; i < w; i++)
+				pOut[i] = pTable[pOut[i]];
+		}
+	}
+}
+
+void SPipelineRun::Produce(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, RGBQUAD *pOut,
+	size_t outStride) const
+{
+	const SStep &step = steps[s];
+	unsigned w = RectWidth(rc);
+	unsigned h = RectHeight(rc);
+
+	// Paste only comes before any resample, rc is also the source's
+	const RGBQUAD *pSource = pSrc + (size_t)rc.top * srcWidth + rc.left;
+
+	if (!step.pRegion)
+	{
+		size_t stride;
+		const RGBQUAD *pIn = Input(buf, s, rc, stride);
+
+		for (unsigned j = 0; j < h; j++)
+		{
+			if (step.ops.empty())
+				memcpy(pOut + j * outStride, pIn + j * stride, sizeof(RGBQUAD) * w);
+			else
+			{
+				RunPointOps(step.ops, 0, step.ops.size(), pIn + j * stride, pOut + j * outStride, w,
+					pSource + j * srcWidth, buf.plane);
+			}
+		}
+		return;
+	}
+
+	size_t done = 0;
+	if (step.pRegion->type == CImagePipeline::STAGE_CONVOLVE)
+		done = Convolve(buf, s, rc, pOut, outStride, pSource);
+	else
+		Resample(buf, s, rc, pOut, outStride);
+
+	for (unsigned j = 0; j < h && done < step.ops.size(); j++)
+	{
+		RunPointOps(step.ops, done, step.ops.size(), pOut + j * outStride, pOut + j * outStride, w,
+			pSource + j * srcWidth, buf.plane);
+	}
+}
+
+size_t SPipelineRun::Convolve(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, RGBQUAD *pOut,
+	size_t outStride, const RGBQUAD *pSource) const
+{
+	const SStep &step = steps[s];
+	const CConvolutionKernel &kernel = step.pRegion->kernel;
+	EBorderMode border = step.pRegion->border;
+	RECT source = CConvolver::GetBlockSource(kernel, border, rc, step.inWidth, step.inHeight);
+	size_t scratch = CConvolver::GetBlockScratch(kernel);
+
+	if (!step.bGray)
+	{
+		size_t stride;
+		const RGBQUAD *pIn = Input(buf, s, source, stride);
+
+		if (buf.convolve.size() < scratch)
+			buf.convolve.resize(scratch);
+
+		CConvolver::ApplyBlock(kernel, border, pIn, stride, source, pOut, outStride, rc,
+			step.inWidth, step.inHeight, &buf.convolve[0]);
+		return 0;
+	}
+
+	// One channel holds it all, filter it as a plane
+	unsigned w = RectWidth(rc);
+	unsigned h = RectHeight(rc);
+	unsigned sourceWidth = RectWidth(source);
+	unsigned sourceHeight = RectHeight(source);
+	if (buf.grayOut.size() < (size_t)w * h)
+		buf.grayOut.resize((size_t)w * h);
+	if (buf.grayScratch.size() < scratch)
+		buf.grayScratch.resize(scratch);
+
+	CImagePipeline::SRows<BYTE> &input = buf.grayIn[s];
+	RECT rest = source;
+	rest.top = KeepRows(input, source);
+	if (rest.top <= rest.bottom)
+		InputPlane(buf, s, rest, &input.pixels[(size_t)(rest.top - source.top) * sourceWidth]);
+
+	const SPixelKernels &kernels = GetPixelKernels();
+	BYTE *pGray = &buf.grayOut[0];
+	CConvolver::ApplyBlock(kernel, border, &input.pixels[0], sourceWidth, source, pGray, w, rc,
+		step.inWidth, step.inHeight, &buf.grayScratch[0]);
+
+	// A lookup keeping gray pixels gray is one table for every channel, and
+	// a paste is a merge of the plane
+	size_t done = 0;
+	if (done < step.ops.size() && step.ops[done].type == POINT_LOOKUP && KeepsGray(step.ops[done]))
+	{
+		const BYTE *pTable = step.ops[done++].tables[0];
+		for (size_t i = 0; i < (size_t)w * h; i++)
+			pGray[i] = pTable[pGray[i]];
+	}
+
+	if (done < step.ops.size() && step.ops[done].type == POINT_PASTE)
+	{
+		const SPointOp &op = step.ops[done++];
+		for (unsigned j = 0; j < h; j++)
+		{
+			RGBQUAD *pRow = pOut + j * outStride;
+			if (op.bExclusive)
+				memset(pRow, 0, sizeof(RGBQUAD) * w);
+			else
+				memcpy(pRow, pSource + j * srcWidth, sizeof(RGBQUAD) * w);
+			kernels.pfnMergeChannel(pGray + j * w, pRow, op.uChannel, w);
+		}
+		return done;
+	}
+
+	for (unsigned j = 0; j < h; j++)
+	{
+		const BYTE *pPlane = pGray + j * w;
+		RGBQUAD *pRow = pOut + j * outStride;
+
+		for (unsigned i = 0; i < w; i++)
+		{
+			pRow[i].rgbBlue = pRow[i].rgbGreen = pRow[i].rgbRed = pPlane[i];
+			pRow[i].rgbReserved = 0;
+		}
+	}
+	return done;
+}
+
+void SPipelineRun::Resample(CImagePipeline::SThreadBuffers &buf, size_t s, const RECT &rc, RGBQUAD *pOut,
+	size_t outStride) const
+{
+	const SStep &step = steps[s];
+	const CWeightsTable &columns = *step.pColumns;
+	const CWeightsTable &rows = *step.pRows;
+	const SResizeKernels &kernels = GetResizeKernels();
+	unsigned w = RectWidth(rc);
+	unsigned h = RectHeight(rc);
+
+	// Source pixels under the windows of the tile
+	RECT source = { step.inWidth, step.inHeight, -1, -1 };
+	for (LONG x = rc.left; x <= rc.right; x++)
+	{
+		source.left = (std::min)(source.left, (LONG)columns.getLeftBoundary(x));
+		source.right = (std::max)(source.right, (LONG)columns.getRightBoundary(x));
+	}
+	for (LONG y = rc.top; y <= rc.bottom; y++)
+	{
+		source.top = (std::min)(source.top, (LONG)rows.getLeftBoundary(y));
+		source.bottom = (std::max)(source.bottom, (LONG)rows.getRightBoundary(y));
+	}
+
+	size_t stride;
+	unsigned srcWidth = RectWidth(source);
+
+	// Same passes and rounding as CResizableImage, on the tile's windows
+	if (step.bColumnsFirst)
+	{
+		// Source rows the tile above filtered already are kept
+		RECT filtered = { rc.left, source.top, rc.right, source.bottom };
+		CImagePipeline::SRows<RGBQUAD> &temp = buf.resample[s];
+		LONG top = KeepRows(temp, filtered);
+		RGBQUAD *pTemp = &temp.pixels[0];
+
+		if (top <= source.bottom)
+		{
+			RECT rest = source;
+			rest.top = top;
+			const RGBQUAD *pIn = Input(buf, s, rest, stride);
+			for (LONG y = top; y <= source.bottom; y++)
+			{
+				kernels.pfnRow(pIn + (y - top) * stride, source.left, pTemp + (size_t)(y - source.top) * w,
+					rc.left, rc.right + 1, columns);
+			}
+		}
+
+		for (LONG y = rc.top; y <= rc.bottom; y++)
+		{
+			int iLeft = rows.getLeftBoundary(y);
+			kernels.pfnCol(pTemp + (size_t)(iLeft - source.top) * w, w, pOut + (y - rc.top) * outStride, w,
+				rows.getFixedWeights(y), rows.getRightBoundary(y) - iLeft + 1);
+		}
+	}
+	else
+	{
+		const RGBQUAD *pIn = Input(buf, s, source, stride);
+		std::vector<RGBQUAD> &temp = buf.resample[s].pixels;
+		if (temp.size() < (size_t)srcWidth * h)
+			temp.resize((size_t)srcWidth * h);
+		RGBQUAD *pTemp = &temp[0];
+
+		for (LONG y = rc.top; y <= rc.bottom; y++)
+		{
+			int iLeft = rows.getLeftBoundary(y);
+			kernels.pfnCol(pIn + (iLeft - source.top) * stride, (unsigned)stride, pTemp + (y - rc.top) * srcWidth,
+				srcWidth, rows.getFixedWeights(y), rows.getRightBoundary(y) - iLeft + 1);
+		}
+
+		for (unsigned j = 0; j < h; j++)
+			kernels.pfnRow(pTemp + j * srcWidth, source.left, pOut + j * outStride, rc.left, rc.right + 1, columns);
+	}
+}
+
+void SPipelineRun::TileBand(void *pContext, unsigned uBegin, unsigned uEnd)
+{
+	const SPipelineRun &run = *(const SPipelineRun*)pContext;
+	CImagePipeline::SThreadBuffers &buf = run.pThreads[CThreadPool::GetThreadIndex()];
+	const SStep &last = run.steps.back();
+
+	for (unsigned u = uBegin; u < uEnd; u++)
+	{
+		RECT rc;
+		rc.left = 0;
+		rc.top = u * run.tileHeight;
+		rc.right = last.outWidth - 1;
+		rc.bottom = (std::min)(rc.top + run.tileHeight, last.outHeight) - 1;
+
+		run.Produce(buf, run.steps.size() - 1, rc, run.pDst + (size_t)rc.top * run.dstWidth + rc.left, run.dstWidth);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// CImagePipeline
+//-----------------------------------------------------------------------------
+void CImagePipeline::Channel(EColorChannel chn)
+{
+	SStage stage;
+	stage.type = STAGE_CHANNEL;
+	stage.chn = chn;
+	m_Stages.push_back(stage);
+}
+
+void CImagePipeline::Lut(const BYTE *pTable)
+{
+	Lut(pTable, pTable, pTable);
+}
+
+void CImagePipeline::Lut(const BYTE *pRed, const BYTE *pGreen, const BYTE *pBlue)
+{
+	SStage stage;
+	stage.type = STAGE_LUT;
+	memcpy(stage.tables[0], pBlue, 256);
+	memcpy(stage.tables[1], pGreen, 256);
+	memcpy(stage.tables[2], pRed, 256);
+	m_Stages.push_back(stage);
+}
+
+bool CImagePipeline::Paste(EColorChannel chn)
+{
+	if (chn >= ECC_HUE && chn <= ECC_LUMINOSITY)
+		return false;
+
+	for (size_t i = 0; i < m_Stages.size(); i++)
+	{
+		if (m_Stages[i].type == STAGE_RESAMPLE)
+			return false;
+	}
+
+	SStage stage;
+	stage.type = STAGE_PASTE;
+	stage.chn = chn;
+	m_Stages.push_back(stage);
+	return true;
+}
+
+void CImagePipeline::Convolve(const CConvolutionKernel &kernel, EBorderMode border)
+{
+	SStage stage;
+	stage.type = STAGE_CONVOLVE;
+	stage.kernel = kernel;
+	stage.border = border;
+	m_Stages.push_back(stage);
+}
+
+bool CImagePipeline::Resample(CGenericFilter *pFilter, unsigned int uWidth, unsigned int uHeight)
+{
+	if (!pFilter || !uWidth || !uHeight)
+		return false;
+
+	SStage stage;
+	stage.type = STAGE_RESAMPLE;
+	stage.pFilter = pFilter;
+	stage.uWidth = uWidth;
+	stage.uHeight = uHeight;
+	m_Stages.push_back(stage);
+	return true;
+}
+
+void CImagePipeline::GetOutputSize(LONG lWidth, LONG lHeight, LONG &lOutWidth, LONG &lOutHeight) const
+{
+	lOutWidth = lWidth;
+	lOutHeight = lHeight;
+	for (size_t i = 0; i < m_Stages.size(); i++)
+	{
+		if (m_Stages[i].type == STAGE_RESAMPLE)
+		{
+			lOutWidth = m_Stages[i].uWidth;
+			lOutHeight = m_Stages[i].uHeight;
+		}
+	}
+}
+
+bool CImagePipeline::Run(const CImageFile &src, CImageFile &dst)
+{
+	if (!src.Pixels())
+		return false;
+
+	PROFILE_SCOPE("CImagePipeline::Run");
+
+	LONG lWidth, lHeight;
+	GetOutputSize(src.Width(), src.Height(), lWidth, lHeight);
+
+	// Tiles reading around the pixels they write, or reading the source
+	// again after writing them, need the source apart
+	const CImageFile *pSource = &src;
+	if (&src == &dst)
+	{
+		bool bCopy = false;
+		for (size_t i = 0; i < m_Stages.size(); i++)
+			bCopy |= m_Stages[i].type != STAGE_CHANNEL && m_Stages[i].type != STAGE_LUT;
+
+		if (bCopy)
+		{
+			if ((m_Copy.Width() != src.Width() || m_Copy.Height() != src.Height() || !m_Copy.Pixels()) &&
+				!m_Copy.Create(src.Width(), src.Height()))
+				return false;
+
+			memcpy(m_Copy.Pixels(), src.Pixels(), sizeof(RGBQUAD) * src.Width() * src.Height());
+			pSource = &m_Copy;
+		}
+	}
+
+	if ((dst.Width() != lWidth || dst.Height() != lHeight || !dst.Pixels()) && !dst.Create(lWidth, lHeight))
+		return false;
+	dst.ReleaseMips();
+
+	SPipelineRun run;
+	run.pSrc = pSource->Pixels();
+	run.srcWidth = pSource->Width();
+	run.pDst = dst.Pixels();
+	run.dstWidth = dst.Width();
+
+	// Group the stages into steps, fusing the point operations of each
+	LONG w = pSource->Width(), h = pSource->Height();
+	bool bGray = false;
+	run.steps.reserve(m_Stages.size() + 1);
+	for (size_t i = 0; i < m_Stages.size(); i++)
+	{
+		const SStage &stage = m_Stages[i];
+
+		if (stage.type == STAGE_CONVOLVE || stage.type == STAGE_RESAMPLE)
+		{
+			SPipelineRun::SStep step(&stage, w, h);
+			step.bGray = bGray;
+
+			if (stage.type == STAGE_RESAMPLE)
+			{
+				step.outWidth = w = stage.uWidth;
+				step.outHeight = h = stage.uHeight;
+				step.pColumns = CWeightsCache::Get(stage.pFilter, w, step.inWidth);
+				step.pRows = CWeightsCache::Get(stage.pFilter, h, step.inHeight);
+				step.bColumnsFirst = (unsigned)w * step.inHeight <= (unsigned)h * step.inWidth;
+			}
+
+			run.steps.push_back(step);
+			continue;
+		}
+
+		// Point operations before any other stage read the source
+		if (run.steps.empty())
+			run.steps.push_back(SPipelineRun::SStep(NULL, w, h));
+
+		SPointOp op;
+		SetIdentity(op);
+		if (stage.type == STAGE_LUT)
+			memcpy(op.tables, stage.tables, sizeof(op.tables));
+		else if (stage.type == STAGE_PASTE)
+		{
+			op.type = POINT_PASTE;
+			op.uChannel = ChannelByte(stage.chn);
+			op.bExclusive = stage.chn >= ECC_EXCLUSIVERED;
+		}
+		else if (stage.chn >= ECC_HUE && stage.chn <= ECC_LUMINOSITY)
+		{
+			op.type = POINT_HSL;
+			op.chn = stage.chn;
+		}
+		else
+			op.uSource[0] = op.uSource[1] = op.uSource[2] = (BYTE)ChannelByte(stage.chn);
+
+		bGray = MakesGray(op) || (bGray && KeepsGray(op));
+		AddPointOp(run.steps.back().ops, op);
+	}
+
+	// No stage at all copies
+	if (run.steps.empty())
+		run.steps.push_back(SPipelineRun::SStep(NULL, w, h));
+
+	CThreadPool &pool = CResizableImage::GetThreadPool();
+	if (m_Threads.size() < pool.GetThreadCount())
+		m_Threads.resize(pool.GetThreadCount());
+	for (size_t i = 0; i < m_Threads.size(); i++)
+	{
+		SThreadBuffers &buf = m_Threads[i];
+		if (buf.steps.size() < run.steps.size())
+		{
+			buf.steps.resize(run.steps.size());
+			buf.resample.resize(run.steps.size());
+			buf.grayIn.resize(run.steps.size());
+		}
+
+		// Rows kept from the last run are of other pixels
+		for (size_t s = 0; s < buf.steps.size(); s++)
+		{
+			buf.steps[s].Forget();
+			buf.resample[s].Forget();
+			buf.grayIn[s].Forget();
+		}
+	}
+	run.pThreads = &m_Threads[0];
+
+	// Upscaled tiles grow with the scale, a tile of the source would
+	// otherwise be mostly kernel borders re-read by its neighbours
+	run.tileHeight = (LONG)PIPELINE_TILE_ROWS * (std::max)((LONG)1, lHeight / pSource->Height());
+	unsigned tiles = (lHeight + run.tileHeight - 1) / run.tileHeight;
+	pool.Run(tiles, 1, SPipelineRun::TileBand, &run);
+	return true;
+}
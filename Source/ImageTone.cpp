@@ -0,0 +1,274 @@
+// ImageTone.cpp
+// Histograms and lookup tables of CImageTone, row by row through the
+// histogram, LUT and HSL kernels of PixelKernels.h.
+#include "ImageTone.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	// Origin and size of rc, or of the whole image, false when it does not fit
+	bool GetArea(const CImageFile &image, const RECT *rc, LONG &x, LONG &y, LONG &w, LONG &h)
+	{
+		x = rc ? rc->left : 0;
+		y = rc ? rc->top : 0;
+		w = rc ? rc->right - rc->left + 1 : image.Width();
+		h = rc ? rc->bottom - rc->top + 1 : image.Height();
+
+		return image.Pixels() && x >= 0 && y >= 0 && w > 0 && h > 0 && x + w <= image.Width() &&
+			y + h <= image.Height();
+	}
+
+	EColorChannel PlainChannel(EColorChannel chn)
+	{
+		if (chn >= ECC_EXCLUSIVERED)
+			chn = (EColorChannel)(chn - ECC_EXCLUSIVERED + ECC_RED);
+		return chn;
+	}
+
+	// Adds up the HISTOGRAM_SETS copies of the bins
+	void SumSets(const DWORD *pSets, DWORD *pBins)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			DWORD dwCount = 0;
+			for (int s = 0; s < HISTOGRAM_SETS; s++)
+				dwCount += pSets[s * 256 + i];
+			pBins[i] = dwCount;
+		}
+	}
+
+	void SetIdentity(BYTE *pTable)
+	{
+		for (int i = 0; i < 256; i++)
+			pTable[i] = (BYTE)i;
+	}
+}
+
+bool CImageTone::Histogram(const CImageFile &image, EColorChannel chn, DWORD *pBins, const RECT *rc)
+{
+	chn = PlainChannel(chn);
+	if (chn <= ECC_BLUE)
+	{
+		DWORD *pChannels[3] = { NULL, NULL, NULL };
+		pChannels[chn] = pBins;
+		return Histogram(image, pChannels[ECC_RED], pChannels[ECC_GREEN], pChannels[ECC_BLUE], rc);
+	}
+
+	LONG x, y, w, h;
+	if (chn > ECC_LUMINOSITY || !GetArea(image, rc, x, y, w, h))
+		return false;
+
+	PROFILE_SCOPE("CImageTone::Histogram");
+
+	const SPixelKernels &kernels = GetPixelKernels();
+	std::vector<BYTE> plane(w);
+	DWORD sets[HISTOGRAM_SETS * 256];
+	memset(sets, 0, sizeof(sets));
+
+	for (LONG i = 0; i < h; i++)
+	{
+		const RGBQUAD *pRow = image.Pixels() + (size_t)(i + y) * image.Width() + x;
+		kernels.pfnRgbToHsl(pRow,
+			chn == ECC_HUE ? &plane[0] : NULL,
+			chn == ECC_SATURATION ? &plane[0] : NULL,
+			chn == ECC_LUMINOSITY ? &plane[0] : NULL, w);
+		kernels.pfnPlaneHistogram(&plane[0], w, sets);
+	}
+
+	SumSets(sets, pBins);
+	return true;
+}
+
+bool CImageTone::Histogram(const CImageFile &image, DWORD *pRed, DWORD *pGreen, DWORD *pBlue, const RECT *rc)
+{
+	LONG x, y, w, h;
+	if (!GetArea(image, rc, x, y, w, h))
+		return false;
+
+	PROFILE_SCOPE("CImageTone::Histogram");
+
+	HISTOGRAM_KERNEL pfnHistogram = GetPixelKernels().pfnHistogram;
+	DWORD sets[3][HISTOGRAM_SETS * 256];
+	memset(sets, 0, sizeof(sets));
+
+	for (LONG i = 0; i < h; i++)
+		pfnHistogram(image.Pixels() + (size_t)(i + y) * image.Width() + x, w, sets[0]);
+
+	if (pRed)
+		SumSets(sets[0], pRed);
+	if (pGreen)
+		SumSets(sets[1], pGreen);
+	if (pBlue)
+		SumSets(sets[2], pBlue);
+	return true;
+}
+
+bool CImageTone::ApplyLut(CImageFile &image, const BYTE *pRed, const BYTE *pGreen, const BYTE *pBlue,
+	const RECT *rc)
+{
+	LONG x, y, w, h;
+	if (!GetArea(image, rc, x, y, w, h))
+		return false;
+
+	PROFILE_SCOPE("CImageTone::ApplyLut");
+
+	image.ReleaseMips();
+
+	SLutTables tables;
+	tables.Set(pRed, pGreen, pBlue);
+
+	LUT_KERNEL pfnLut = GetPixelKernels().pfnLut;
+	for (LONG i = 0; i < h; i++)
+	{
+		RGBQUAD *pRow = image.Pixels() + (size_t)(i + y) * image.Width() + x;
+		pfnLut(pRow, pRow, w, tables);
+	}
+	return true;
+}
+
+bool CImageTone::ApplyLut(CImageFile &image, EColorChannel chn, const BYTE *pTable, const RECT *rc)
+{
+	chn = PlainChannel(chn);
+	if (chn <= ECC_BLUE)
+	{
+		BYTE identity[256];
+		SetIdentity(identity);
+
+		const BYTE *pTables[3] = { identity, identity, identity };
+		pTables[chn] = pTable;
+		return ApplyLut(image, pTables[ECC_RED], pTables[ECC_GREEN], pTables[ECC_BLUE], rc);
+	}
+
+	LONG x, y, w, h;
+	if (chn > ECC_LUMINOSITY || !GetArea(image, rc, x, y, w, h))
+		return false;
+
+	PROFILE_SCOPE("CImageTone::ApplyLut");
+
+	image.ReleaseMips();
+
+	const SPixelKernels &kernels = GetPixelKernels();
+	std::vector<BYTE> planes(3 * (size_t)w);
+	BYTE *pHue = &planes[0];
+	BYTE *pSat = pHue + w;
+	BYTE *pLum = pSat + w;
+	BYTE *pPlane = chn == ECC_HUE ? pHue : (chn == ECC_SATURATION ? pSat : pLum);
+
+	for (LONG i = 0; i < h; i++)
+	{
+		RGBQUAD *pRow = image.Pixels() + (size_t)(i + y) * image.Width() + x;
+
+		kernels.pfnRgbToHsl(pRow, pHue, pSat, pLum, w);
+		for (LONG j = 0; j < w; j++)
+			pPlane[j] = pTable[pPlane[j]];
+		kernels.pfnHslToRgb(pHue, pSat, pLum, pRow, w);
+	}
+	return true;
+}
+
+void CImageTone::EqualizeCurve(const DWORD *pBins, BYTE *pTable)
+{
+	unsigned long long ullTotal = 0;
+	for (int i = 0; i < 256; i++)
+		ullTotal += pBins[i];
+
+	// The darkest value present maps to 0, the brightest to 255
+	unsigned long long ullFirst = 0;
+	for (int i = 0; i < 256 && !ullFirst; i++)
+		ullFirst = pBins[i];
+
+	if (ullTotal == ullFirst)
+	{
+		SetIdentity(pTable);
+		return;
+	}
+
+	unsigned long long ullRange = ullTotal - ullFirst;
+	unsigned long long ullSum = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		ullSum += pBins[i];
+		pTable[i] = ullSum <= ullFirst ? 0 : (BYTE)(((ullSum - ullFirst) * 255 + ullRange / 2) / ullRange);
+	}
+}
+
+void CImageTone::LevelsCurve(const DWORD *pBins, double dClip, BYTE *pTable)
+{
+	unsigned long long ullTotal = 0;
+	for (int i = 0; i < 256; i++)
+		ullTotal += pBins[i];
+
+	unsigned long long ullClip = (unsigned long long)(dClip * ullTotal);
+
+	int iLow = 0, iHigh = 255;
+	unsigned long long ullSum = 0;
+	for (; iLow < 255; iLow++)
+	{
+		ullSum += pBins[iLow];
+		if (ullSum > ullClip)
+			break;
+	}
+
+	ullSum = 0;
+	for (; iHigh > 0; iHigh--)
+	{
+		ullSum += pBins[iHigh];
+		if (ullSum > ullClip)
+			break;
+	}
+
+	if (iHigh <= iLow)
+	{
+		SetIdentity(pTable);
+		return;
+	}
+
+	int iRange = iHigh - iLow;
+	for (int i = 0; i < 256; i++)
+	{
+		if (i <= iLow)
+			pTable[i] = 0;
+		else if (i >= iHigh)
+			pTable[i] = 255;
+		else
+			pTable[i] = (BYTE)(((i - iLow) * 255 + iRange / 2) / iRange);
+	}
+}
+
+bool CImageTone::Equalize(CImageFile &image, EColorChannel chn, const RECT *rc)
+{
+	DWORD bins[256];
+	if (!Histogram(image, chn, bins, rc))
+		return false;
+
+	BYTE table[256];
+	EqualizeCurve(bins, table);
+	return ApplyLut(image, chn, table, rc);
+}
+
+bool CImageTone::AutoLevels(CImageFile &image, EColorChannel chn, double dClip, const RECT *rc)
+{
+	DWORD bins[256];
+	if (!Histogram(image, chn, bins, rc))
+		return false;
+
+	BYTE table[256];
+	LevelsCurve(bins, dClip, table);
+	return ApplyLut(image, chn, table, rc);
+}
+
+bool CImageTone::AutoLevels(CImageFile &image, double dClip, const RECT *rc)
+{
+	DWORD bins[3][256];
+	if (!Histogram(image, bins[0], bins[1], bins[2], rc))
+		return false;
+
+	BYTE tables[3][256];
+	for (int c = 0; c < 3; c++)
+		LevelsCurve(bins[c], dClip, tables[c]);
+	return ApplyLut(image, tables[0], tables[1], tables[2], rc);
+}
@@ -0,0 +1,133 @@
+//-----------------------------------------------------------------------------
+// File: MappedFile.cpp
+//
+// Desc: Read only memory mapped files.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// MappedFile Specific Includes
+//-----------------------------------------------------------------------------
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// CMappedFile Member Functions
+//-----------------------------------------------------------------------------
+CMappedFile::CMappedFile() : m_pData(NULL), m_Size(0), m_bOpen(false)
+{
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool CMappedFile::Open( const char *szFileName )
+{
+	Close();
+
+	m_hFile = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart > LONGLONG(~size_t(0) >> 1))
+	{
+		Close();
+		return false;
+	}
+
+	m_Size = size_t(size.QuadPart);
+	m_bOpen = true;
+
+	// Mapping an empty file fails, there is nothing to map anyway
+	if (m_Size == 0)
+		return true;
+
+	m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping)
+		m_pData = (const BYTE*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+
+	m_pData = NULL;
+	m_Size = 0;
+	m_bOpen = false;
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+}
+
+#else
+
+bool CMappedFile::Open( const char *szFileName )
+{
+	Close();
+
+	int fd = open(szFileName, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+
+	m_Size = size_t(info.st_size);
+	if (m_Size > 0)
+	{
+		void *pView = mmap(NULL, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (pView == MAP_FAILED)
+		{
+			close(fd);
+			m_Size = 0;
+			return false;
+		}
+		m_pData = (const BYTE*)pView;
+	}
+
+	// The mapping keeps its own reference to the file
+	close(fd);
+	m_bOpen = true;
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if (m_pData)
+		munmap((void*)m_pData, m_Size);
+
+	m_pData = NULL;
+	m_Size = 0;
+	m_bOpen = false;
+}
+
+#endif // _WIN32
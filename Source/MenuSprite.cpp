@@ -56,8 +56,6 @@ MenuSprite::~MenuSprite()
 //-----------------------------------------------------------------------------
 void MenuSprite::draw(ULONG gameState)
 {
-	frameCounter++;
-
 	switch (gameState) {
 	case 0: // start menu
 		startText->draw();
@@ -0,0 +1,153 @@
+//-----------------------------------------------------------------------------
+// File: PackBuilder.cpp
+//
+// Desc: Builds the asset pack the game maps at start up (see AssetPack.h)
+//	from a manifest of the loose bitmaps.
+//
+//	Usage: PackBuilder Data/assets.txt Data/assets.pak [--prefix data/]
+//		[--embed dir]
+//
+//	Pack names are the prefix followed by the path in the manifest, which
+//	with the default prefix is the name the game asks for. Every bitmap is
+//	stored in the smallest format that keeps its pixels exactly (see
+//	CCompactImage). --embed also writes the pack as C++ into dir (see
+//	EmbeddedAssets.h).
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// PackBuilder Specific Includes
+//-----------------------------------------------------------------------------
+#include "AssetPack.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	// Names are plain paths, quotes and backslashes are escaped anyway
+	std::string CppString(const char *sz)
+	{
+		std::string str = "\"";
+		for (; *sz; sz++)
+		{
+			if (*sz == '"' || *sz == '\\')
+				str += '\\';
+			str += *sz;
+		}
+		return str + "\"";
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : WriteEmbedded ()
+	// Desc : EmbeddedAssetTable.h with a constexpr descriptor per entry and
+	//		EmbeddedAssetData.cpp with the pack bytes as a constexpr array of
+	//		DWORDs (a quarter of the tokens a BYTE array takes to compile).
+	//-------------------------------------------------------------------------
+	bool WriteEmbedded(const std::string &strDir, const CAssetPack &pack, const std::vector<BYTE> &data)
+	{
+		std::string strTable = strDir + "/EmbeddedAssetTable.h";
+		std::string strData = strDir + "/EmbeddedAssetData.cpp";
+
+		FILE *f = fopen(strTable.c_str(), "w");
+		if (!f)
+			return false;
+
+		fprintf(f, "// Generated by PackBuilder, do not edit. Included by EmbeddedAssets.h.\n\n");
+		fprintf(f, "const DWORD EMBEDDED_ASSET_COUNT = %u;\n\n", (unsigned)pack.GetEntryCount());
+		fprintf(f, "constexpr SEmbeddedAsset g_EmbeddedAssets[] = {\n");
+		for (DWORD i = 0; i < pack.GetEntryCount(); i++)
+		{
+			const SPackEntry &e = *pack.GetEntry(i);
+			fprintf(f, "\t{ %s, %d, %d, 0x%08x, %u, { %d, %d, %d, %d }, 0x%08x, 0x%08x, %u, 0x%08x },\n",
+				CppString(pack.GetName(e)).c_str(), (int)e.lWidth, (int)e.lHeight, (unsigned)e.dwColorKey,
+				(unsigned)e.dwFrameCount, (int)e.rcFrame.left, (int)e.rcFrame.top, (int)e.rcFrame.right,
+				(int)e.rcFrame.bottom, (unsigned)e.dwPixelsOffset, (unsigned)e.dwMaskOffset, (unsigned)e.dwFormat,
+				(unsigned)e.dwPaletteOffset);
+		}
+		fprintf(f, "};\n");
+		if (fclose(f) != 0)
+			return false;
+
+		f = fopen(strData.c_str(), "w");
+		if (!f)
+			return false;
+
+		// The pack ends on a 4 byte boundary, the last DWORD is padded anyway
+		size_t dwords = (data.size() + 3) / 4;
+		fprintf(f, "// Generated by PackBuilder, do not edit.\n#include \"EmbeddedAssets.h\"\n\n");
+		fprintf(f, "namespace\n{\n\talignas(%u) constexpr DWORD s_Pack[%u] = {", (unsigned)PACK_ALIGNMENT, (unsigned)dwords);
+		for (size_t i = 0; i < dwords; i++)
+		{
+			DWORD dw = 0;
+			for (size_t b = 0; b < 4 && i * 4 + b < data.size(); b++)
+				dw |= DWORD(data[i * 4 + b]) << (8 * b);
+			fprintf(f, i % 8 ? " 0x%08x," : "\n\t\t0x%08x,", (unsigned)dw);
+		}
+		fprintf(f, "\n\t};\n}\n\n");
+		fprintf(f, "const BYTE* GetEmbeddedPackData() { return (const BYTE*)s_Pack; }\n");
+		fprintf(f, "size_t GetEmbeddedPackSize() { return %u; }\n", (unsigned)data.size());
+		return fclose(f) == 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : main ()
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	const char *szPrefix = "data/";
+	const char *szEmbedDir = NULL;
+	bool bUsage = argc < 3;
+
+	for (int i = 3; i < argc && !bUsage; i += 2)
+	{
+		if (i + 1 >= argc)								bUsage = true;
+		else if (strcmp(argv[i], "--prefix") == 0)		szPrefix = argv[i + 1];
+		else if (strcmp(argv[i], "--embed") == 0)		szEmbedDir = argv[i + 1];
+		else											bUsage = true;
+	}
+
+	if (bUsage)
+	{
+		fprintf(stderr, "usage: PackBuilder manifest.txt out.pak [--prefix data/] [--embed dir]\n");
+		return 2;
+	}
+
+	CAssetPackWriter writer;
+	if (!writer.AddManifest(argv[1], szPrefix))
+		return 1;
+
+	std::vector<BYTE> data;
+	writer.Write(data);
+
+	// Read it back the way the game will before replacing anything
+	CAssetPack pack;
+	if (!pack.Open(&data[0], data.size()) || pack.GetEntryCount() != writer.GetEntryCount())
+	{
+		fprintf(stderr, "PackBuilder: the pack does not read back\n");
+		return 1;
+	}
+
+	FILE *pFile = fopen(argv[2], "wb");
+	bool bWritten = pFile && fwrite(&data[0], 1, data.size(), pFile) == data.size();
+	if (pFile && fclose(pFile) != 0)
+		bWritten = false;
+
+	if (!bWritten)
+	{
+		fprintf(stderr, "PackBuilder: cannot write %s\n", argv[2]);
+		return 1;
+	}
+
+	if (szEmbedDir && !WriteEmbedded(szEmbedDir, pack, data))
+	{
+		fprintf(stderr, "PackBuilder: cannot write the embedded sources to %s\n", szEmbedDir);
+		return 1;
+	}
+
+	printf("%s: %u bitmaps, %u bytes, pixels %u bytes (%u at 32 bits)\n", argv[2], (unsigned)pack.GetEntryCount(),
+		(unsigned)data.size(), (unsigned)writer.GetPixelBytes(), (unsigned)writer.GetRgb32Bytes());
+	return 0;
+}
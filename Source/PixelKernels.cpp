@@ -0,0 +1,920 @@
+// PixelKernels.cpp
+// Scalar, SSE4.1 and AVX2 versions of the per pixel kernels: widening,
+// channel split and merge, HSL, convolution taps, histograms and LUTs.
+//
+// Pixels are 4 bytes (b, g, r, reserved). The convolution taps pair two
+// taps per _mm_madd_epi16 as the resampling kernels do, sums are kept in
+// 32 bit ints and rounded and clamped once, so every level writes
+// identical pixels.
+#include "PixelKernels.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Scalar kernels
+//-----------------------------------------------------------------------------
+static void Expand24Scalar(const BYTE *pSrc, RGBQUAD *pDst, unsigned count)
+{
+	for (unsigned x = 0; x < count; x++, pSrc += 3)
+	{
+		pDst[x].rgbBlue = pSrc[0];
+		pDst[x].rgbGreen = pSrc[1];
+		pDst[x].rgbRed = pSrc[2];
+		pDst[x].rgbReserved = 0;
+	}
+}
+
+static void SplitRgbScalar(const RGBQUAD *pSrc, BYTE *pRed, BYTE *pGreen, BYTE *pBlue, unsigned count)
+{
+	for (unsigned x = 0; x < count; x++)
+	{
+		if (pRed)
+			pRed[x] = pSrc[x].rgbRed;
+		if (pGreen)
+			pGreen[x] = pSrc[x].rgbGreen;
+		if (pBlue)
+			pBlue[x] = pSrc[x].rgbBlue;
+	}
+}
+
+static void MergeChannelScalar(const BYTE *pPlane, RGBQUAD *pDst, unsigned uChannel, unsigned count)
+{
+	BYTE *p = (BYTE*)pDst + uChannel;
+	for (unsigned x = 0; x < count; x++, p += 4)
+		*p = pPlane[x];
+}
+
+// Integer form of the usual float HSL, the SIMD versions divide in float
+// which is exact here: every quotient below is of integers under 2^24 and
+// lands at least 1 / 6120 away from the next integer unless it is one, far
+// more than float rounding can move it.
+//	luminosity	(max + min) / 2
+//	saturation	255 * d / (max + min), or 255 * d / (510 - max - min) when
+//				max + min > 255, with d = max - min
+//	hue			17 * n / (24 * d), n being the hue in degrees times d / 60
+//				and 17 / 24 the 255 / 360 scale
+static void RgbToHslScalar(const RGBQUAD *pSrc, BYTE *pHue, BYTE *pSat, BYTE *pLum, unsigned count)
+{
+	for (unsigned x = 0; x < count; x++)
+	{
+		int r = pSrc[x].rgbRed, g = pSrc[x].rgbGreen, b = pSrc[x].rgbBlue;
+		int hi = r > g ? (r > b ? r : b) : (g > b ? g : b);
+		int lo = r < g ? (r < b ? r : b) : (g < b ? g : b);
+		int d = hi - lo, sum = hi + lo;
+
+		if (pLum)
+			pLum[x] = (BYTE)(sum >> 1);
+		if (pSat)
+			pSat[x] = d ? (BYTE)(255 * d / (sum <= 255 ? sum : 510 - sum)) : 0;
+		if (pHue)
+		{
+			int n;
+			if (hi == r)
+				n = 60 * (g - b) + (g < b ? 360 * d : 0);
+			else if (hi == g)
+				n = 60 * (b - r) + 120 * d;
+			else
+				n = 60 * (r - g) + 240 * d;
+			pHue[x] = d ? (BYTE)(17 * n / (24 * d)) : 0;
+		}
+	}
+}
+
+// HSL_TO_RGB_SCALE and the channel formula are shared with the SIMD versions
+// and evaluated in the same order, so all levels round alike:
+//	channel(k) = l - a * max(-1, min(k - 3, 9 - k, 1)), a = s * min(l, 1 - l)
+// with k = (k0 + hue in twelfths) mod 12 and k0 0 for red, 8 green, 4 blue
+static const float HUE_TO_TWELFTHS = 12.0f / 255.0f;
+static const float BYTE_TO_UNIT = 1.0f / 255.0f;
+
+static inline BYTE HslChannel(float k0, float h12, float l, float a)
+{
+	float k = k0 + h12;
+	if (k >= 12.0f)
+		k = k - 12.0f;
+
+	float t = (std::min)((std::min)(k - 3.0f, 9.0f - k), 1.0f);
+	t = (std::max)(t, -1.0f);
+
+	int v = (int)((l - a * t) * 255.0f + 0.5f);
+	return (BYTE)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static void HslToRgbScalar(const BYTE *pHue, const BYTE *pSat, const BYTE *pLum, RGBQUAD *pDst, unsigned count)
+{
+	for (unsigned x = 0; x < count; x++)
+	{
+		float h12 = (float)pHue[x] * HUE_TO_TWELFTHS;
+		float s = (float)pSat[x] * BYTE_TO_UNIT;
+		float l = (float)pLum[x] * BYTE_TO_UNIT;
+		float a = s * (std::min)(l, 1.0f - l);
+
+		pDst[x].rgbRed = HslChannel(0.0f, h12, l, a);
+		pDst[x].rgbGreen = HslChannel(8.0f, h12, l, a);
+		pDst[x].rgbBlue = HslChannel(4.0f, h12, l, a);
+		pDst[x].rgbReserved = 0;
+	}
+}
+
+static inline BYTE TapsToByte(int iSum, int iBits)
+{
+	iSum = (iSum + (1 << (iBits - 1))) >> iBits;
+	return (BYTE)(iSum < 0 ? 0 : (iSum > 255 ? 255 : iSum));
+}
+
+static void TapsScalar(const RGBQUAD *pSrc, const int *pOffsets, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits)
+{
+	for (unsigned c = 0; c < count; c++)
+	{
+		int r = 0, g = 0, b = 0;
+
+		for (int i = 0; i < taps; i++)
+		{
+			const RGBQUAD &tap = pSrc[c + pOffsets[i]];
+			int w = pWeights[i];
+			r += w * tap.rgbRed;
+			g += w * tap.rgbGreen;
+			b += w * tap.rgbBlue;
+		}
+
+		pDst[c].rgbRed = TapsToByte(r, iBits);
+		pDst[c].rgbGreen = TapsToByte(g, iBits);
+		pDst[c].rgbBlue = TapsToByte(b, iBits);
+		pDst[c].rgbReserved = 0;
+	}
+}
+
+static void PlaneTapsScalar(const BYTE *pSrc, const int *pOffsets, BYTE *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits)
+{
+	for (unsigned c = 0; c < count; c++)
+	{
+		int iSum = 0;
+		for (int i = 0; i < taps; i++)
+			iSum += pWeights[i] * pSrc[c + pOffsets[i]];
+
+		pDst[c] = TapsToByte(iSum, iBits);
+	}
+}
+
+// Counting is bound by the increments, not by reading the pixels, so the
+// SIMD levels use these too. HISTOGRAM_SETS pixels per step, one per set.
+static void HistogramScalar(const RGBQUAD *pSrc, unsigned count, DWORD *pBins)
+{
+	DWORD *pRed = pBins;
+	DWORD *pGreen = pBins + HISTOGRAM_SETS * 256;
+	DWORD *pBlue = pBins + 2 * HISTOGRAM_SETS * 256;
+	unsigned x = 0;
+
+	for (; x + HISTOGRAM_SETS <= count; x += HISTOGRAM_SETS)
+	{
+		for (int s = 0; s < HISTOGRAM_SETS; s++)
+		{
+			const RGBQUAD &px = pSrc[x + s];
+			pRed[s * 256 + px.rgbRed]++;
+			pGreen[s * 256 + px.rgbGreen]++;
+			pBlue[s * 256 + px.rgbBlue]++;
+		}
+	}
+
+	for (; x < count; x++)
+	{
+		pRed[pSrc[x].rgbRed]++;
+		pGreen[pSrc[x].rgbGreen]++;
+		pBlue[pSrc[x].rgbBlue]++;
+	}
+}
+
+static void PlaneHistogramScalar(const BYTE *pSrc, unsigned count, DWORD *pBins)
+{
+	unsigned x = 0;
+
+	for (; x + HISTOGRAM_SETS <= count; x += HISTOGRAM_SETS)
+	{
+		for (int s = 0; s < HISTOGRAM_SETS; s++)
+			pBins[s * 256 + pSrc[x + s]]++;
+	}
+
+	for (; x < count; x++)
+		pBins[pSrc[x]]++;
+}
+
+void SLutTables::Set(const BYTE *pRed, const BYTE *pGreen, const BYTE *pBlue)
+{
+	for (int i = 0; i < 256; i++)
+	{
+		blue[i] = pBlue[i];
+		green[i] = (DWORD)pGreen[i] << 8;
+		red[i] = (DWORD)pRed[i] << 16;
+	}
+}
+
+static void LutScalar(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned count, const SLutTables &tables)
+{
+	for (unsigned x = 0; x < count; x++)
+	{
+		DWORD p;
+		memcpy(&p, pSrc + x, sizeof(p));
+		p = tables.blue[p & 0xff] | tables.green[(p >> 8) & 0xff] | tables.red[(p >> 16) & 0xff] | (p & 0xff000000);
+		memcpy(pDst + x, &p, sizeof(p));
+	}
+}
+
+// Every channel in place in one DWORD, its top bits repeated below it
+static inline DWORD Expand565(DWORD v)
+{
+	return ((v << 3) & 0xf8) | ((v >> 2) & 0x07) |
+		((v << 5) & 0xfc00) | ((v >> 1) & 0x300) |
+		((v << 8) & 0xf80000) | ((v << 3) & 0x70000);
+}
+
+static void Expand565Scalar(const WORD *pSrc, RGBQUAD *pDst, unsigned count)
+{
+	for (unsigned x = 0; x < count; x++)
+	{
+		DWORD p = Expand565(pSrc[x]);
+		memcpy(pDst + x, &p, sizeof(p));
+	}
+}
+
+static void ExpandIndexedScalar(const BYTE *pSrc, RGBQUAD *pDst, unsigned count, const RGBQUAD *pPalette)
+{
+	for (unsigned x = 0; x < count; x++)
+		pDst[x] = pPalette[pSrc[x]];
+}
+
+#ifdef SIMD_X86
+
+// Two weights in the 16 bit halves of an int, for _mm_madd_epi16
+static inline int WeightPair(short w0, short w1)
+{
+	return (int)((unsigned)(unsigned short)w0 | ((unsigned)(unsigned short)w1 << 16));
+}
+
+// Every pair of a TAPS kernel's weights, an odd last one paired with 0
+static inline void WeightPairs(const short *pWeights, int taps, int *pPairs)
+{
+	for (int i = 0; i < taps; i += 2)
+		pPairs[i >> 1] = WeightPair(pWeights[i], i + 1 < taps ? pWeights[i + 1] : 0);
+}
+
+//-----------------------------------------------------------------------------
+// SSE4.1 kernels
+//-----------------------------------------------------------------------------
+// [b0 g0 r0 b1 g1 r1 b2 g2 r2 b3 g3 r3 ...] -> 4 pixels, reserved bytes zeroed
+SIMD_TARGET("sse4.1")
+static inline __m128i Expand24Mask()
+{
+	return _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+}
+
+SIMD_TARGET("sse4.1")
+static void Expand24SSE41(const BYTE *pSrc, RGBQUAD *pDst, unsigned count)
+{
+	const __m128i mask = Expand24Mask();
+	unsigned x = 0;
+
+	// 16 byte loads for 12 bytes of pixels, stop before they read past the end
+	for (; x + 6 <= count; x += 4)
+		_mm_storeu_si128((__m128i*)(pDst + x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + 3 * x)), mask));
+
+	Expand24Scalar(pSrc + 3 * x, pDst + x, count - x);
+}
+
+// [b0 g0 r0 a0 b1 ...] -> [b0 b1 b2 b3 g0 .. g3 r0 .. r3 a0 .. a3]
+SIMD_TARGET("sse4.1")
+static inline __m128i SplitMask()
+{
+	return _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+}
+
+SIMD_TARGET("sse4.1")
+static void SplitRgbSSE41(const RGBQUAD *pSrc, BYTE *pRed, BYTE *pGreen, BYTE *pBlue, unsigned count)
+{
+	const __m128i mask = SplitMask();
+	unsigned x = 0;
+
+	// 16 pixels per step, a 4 x 4 transpose of the per channel dwords
+	for (; x + 16 <= count; x += 16)
+	{
+		__m128i v0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + x)), mask);
+		__m128i v1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + x + 4)), mask);
+		__m128i v2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + x + 8)), mask);
+		__m128i v3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + x + 12)), mask);
+
+		__m128i bg01 = _mm_unpacklo_epi32(v0, v1);
+		__m128i ra01 = _mm_unpackhi_epi32(v0, v1);
+		__m128i bg23 = _mm_unpacklo_epi32(v2, v3);
+		__m128i ra23 = _mm_unpackhi_epi32(v2, v3);
+
+		if (pBlue)
+			_mm_storeu_si128((__m128i*)(pBlue + x), _mm_unpacklo_epi64(bg01, bg23));
+		if (pGreen)
+			_mm_storeu_si128((__m128i*)(pGreen + x), _mm_unpackhi_epi64(bg01, bg23));
+		if (pRed)
+			_mm_storeu_si128((__m128i*)(pRed + x), _mm_unpacklo_epi64(ra01, ra23));
+	}
+
+	SplitRgbScalar(pSrc + x, pRed ? pRed + x : NULL, pGreen ? pGreen + x : NULL, pBlue ? pBlue + x : NULL, count - x);
+}
+
+SIMD_TARGET("sse4.1")
+static void MergeChannelSSE41(const BYTE *pPlane, RGBQUAD *pDst, unsigned uChannel, unsigned count)
+{
+	const __m128i shift = _mm_cvtsi32_si128(8 * uChannel);
+	const __m128i mask = _mm_sll_epi32(_mm_set1_epi32(0xff), shift);
+	unsigned x = 0;
+
+	for (; x + 4 <= count; x += 4)
+	{
+		int iBytes;
+		memcpy(&iBytes, pPlane + x, sizeof(iBytes));
+
+		__m128i v = _mm_sll_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(iBytes)), shift);
+		__m128i px = _mm_loadu_si128((const __m128i*)(pDst + x));
+		_mm_storeu_si128((__m128i*)(pDst + x), _mm_blendv_epi8(px, v, mask));
+	}
+
+	MergeChannelScalar(pPlane + x, pDst + x, uChannel, count - x);
+}
+
+// HSL of 4 pixels as ints, see RgbToHslScalar
+SIMD_TARGET("sse4.1")
+static inline void HslSSE41(__m128i px, __m128i &hue, __m128i &sat, __m128i &lum)
+{
+	const __m128i low = _mm_set1_epi32(0xff);
+	__m128i b = _mm_and_si128(px, low);
+	__m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), low);
+	__m128i r = _mm_and_si128(_mm_srli_epi32(px, 16), low);
+
+	__m128i hi = _mm_max_epi32(r, _mm_max_epi32(g, b));
+	__m128i lo = _mm_min_epi32(r, _mm_min_epi32(g, b));
+	__m128i d = _mm_sub_epi32(hi, lo);
+	__m128i sum = _mm_add_epi32(hi, lo);
+
+	lum = _mm_srli_epi32(sum, 1);
+
+	// min(sum, 510 - sum) picks the denominator, d == 0 divides 0 by 1 or more
+	__m128i denom = _mm_min_epi32(sum, _mm_sub_epi32(_mm_set1_epi32(510), sum));
+	__m128 fd = _mm_cvtepi32_ps(d);
+	__m128 fsat = _mm_div_ps(_mm_mul_ps(fd, _mm_set1_ps(255.0f)),
+		_mm_cvtepi32_ps(_mm_max_epi32(denom, _mm_set1_epi32(1))));
+	sat = _mm_cvttps_epi32(fsat);
+
+	// max is red, else green, else blue, as in the scalar code
+	__m128i isRed = _mm_cmpeq_epi32(hi, r);
+	__m128i isGreen = _mm_cmpeq_epi32(hi, g);
+	__m128i diff = _mm_blendv_epi8(_mm_blendv_epi8(_mm_sub_epi32(r, g), _mm_sub_epi32(b, r), isGreen), _mm_sub_epi32(g, b), isRed);
+	__m128i redBase = _mm_and_si128(_mm_cmpgt_epi32(b, g), _mm_set1_epi32(360));
+	__m128i base = _mm_blendv_epi8(_mm_blendv_epi8(_mm_set1_epi32(240), _mm_set1_epi32(120), isGreen), redBase, isRed);
+
+	__m128 fn = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(diff), _mm_set1_ps(60.0f)), _mm_mul_ps(_mm_cvtepi32_ps(base), fd));
+	__m128 fhue = _mm_div_ps(_mm_mul_ps(fn, _mm_set1_ps(17.0f)),
+		_mm_mul_ps(_mm_max_ps(fd, _mm_set1_ps(1.0f)), _mm_set1_ps(24.0f)));
+	hue = _mm_cvttps_epi32(fhue);
+}
+
+SIMD_TARGET("sse4.1")
+static inline __m128i PackBytesSSE41(__m128i v0, __m128i v1, __m128i v2, __m128i v3)
+{
+	return _mm_packus_epi16(_mm_packus_epi32(v0, v1), _mm_packus_epi32(v2, v3));
+}
+
+SIMD_TARGET("sse4.1")
+static void RgbToHslSSE41(const RGBQUAD *pSrc, BYTE *pHue, BYTE *pSat, BYTE *pLum, unsigned count)
+{
+	unsigned x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		__m128i h[4], s[4], l[4];
+		for (int i = 0; i < 4; i++)
+			HslSSE41(_mm_loadu_si128((const __m128i*)(pSrc + x + 4 * i)), h[i], s[i], l[i]);
+
+		if (pHue)
+			_mm_storeu_si128((__m128i*)(pHue + x), PackBytesSSE41(h[0], h[1], h[2], h[3]));
+		if (pSat)
+			_mm_storeu_si128((__m128i*)(pSat + x), PackBytesSSE41(s[0], s[1], s[2], s[3]));
+		if (pLum)
+			_mm_storeu_si128((__m128i*)(pLum + x), PackBytesSSE41(l[0], l[1], l[2], l[3]));
+	}
+
+	RgbToHslScalar(pSrc + x, pHue ? pHue + x : NULL, pSat ? pSat + x : NULL, pLum ? pLum + x : NULL, count - x);
+}
+
+// 4 plane bytes widened to floats
+SIMD_TARGET("sse4.1")
+static inline __m128 LoadPlaneSSE41(const BYTE *p)
+{
+	int iBytes;
+	memcpy(&iBytes, p, sizeof(iBytes));
+	return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(iBytes)));
+}
+
+SIMD_TARGET("sse4.1")
+static inline __m128i HslChannelSSE41(float k0, __m128 h12, __m128 l, __m128 a)
+{
+	const __m128 twelve = _mm_set1_ps(12.0f);
+	__m128 k = _mm_add_ps(_mm_set1_ps(k0), h12);
+	k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpge_ps(k, twelve), twelve));
+
+	__m128 t = _mm_min_ps(_mm_min_ps(_mm_sub_ps(k, _mm_set1_ps(3.0f)), _mm_sub_ps(_mm_set1_ps(9.0f), k)), _mm_set1_ps(1.0f));
+	t = _mm_max_ps(t, _mm_set1_ps(-1.0f));
+
+	__m128 v = _mm_sub_ps(l, _mm_mul_ps(a, t));
+	__m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+	return _mm_min_epi32(_mm_max_epi32(i, _mm_setzero_si128()), _mm_set1_epi32(255));
+}
+
+SIMD_TARGET("sse4.1")
+static void HslToRgbSSE41(const BYTE *pHue, const BYTE *pSat, const BYTE *pLum, RGBQUAD *pDst, unsigned count)
+{
+	unsigned x = 0;
+
+	for (; x + 4 <= count; x += 4)
+	{
+		__m128 h12 = _mm_mul_ps(LoadPlaneSSE41(pHue + x), _mm_set1_ps(HUE_TO_TWELFTHS));
+		__m128 s = _mm_mul_ps(LoadPlaneSSE41(pSat + x), _mm_set1_ps(BYTE_TO_UNIT));
+		__m128 l = _mm_mul_ps(LoadPlaneSSE41(pLum + x), _mm_set1_ps(BYTE_TO_UNIT));
+		__m128 a = _mm_mul_ps(s, _mm_min_ps(l, _mm_sub_ps(_mm_set1_ps(1.0f), l)));
+
+		__m128i r = HslChannelSSE41(0.0f, h12, l, a);
+		__m128i g = HslChannelSSE41(8.0f, h12, l, a);
+		__m128i b = HslChannelSSE41(4.0f, h12, l, a);
+		__m128i px = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(g, 8)), b);
+		_mm_storeu_si128((__m128i*)(pDst + x), px);
+	}
+
+	HslToRgbScalar(pHue + x, pSat + x, pLum + x, pDst + x, count - x);
+}
+
+// ColSSE41 with a source offset per tap and a variable fraction
+SIMD_TARGET("sse4.1")
+static void TapsSSE41(const RGBQUAD *pSrc, const int *pOffsets, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32(1 << (iBits - 1));
+	const __m128i shift = _mm_cvtsi32_si128(iBits);
+	const __m128i noAlpha = _mm_set1_epi32(0x00ffffff);
+	int pPairs[TAPS_MAX / 2 + 1];
+	WeightPairs(pWeights, taps, pPairs);
+	unsigned c = 0;
+
+	for (; c + 4 <= count; c += 4)
+	{
+		__m128i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+
+		for (int i = 0; i < taps; i += 2)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(pSrc + c + pOffsets[i]));
+			__m128i b = i + 1 < taps ? _mm_loadu_si128((const __m128i*)(pSrc + c + pOffsets[i + 1])) : zero;
+			__m128i w = _mm_set1_epi32(pPairs[i >> 1]);
+
+			__m128i lo = _mm_unpacklo_epi8(a, b);
+			__m128i hi = _mm_unpackhi_epi8(a, b);
+
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+		}
+
+		__m128i p01 = _mm_packs_epi32(_mm_sra_epi32(acc0, shift), _mm_sra_epi32(acc1, shift));
+		__m128i p23 = _mm_packs_epi32(_mm_sra_epi32(acc2, shift), _mm_sra_epi32(acc3, shift));
+		_mm_storeu_si128((__m128i*)(pDst + c), _mm_and_si128(_mm_packus_epi16(p01, p23), noAlpha));
+	}
+
+	if (c < count)
+		TapsScalar(pSrc + c, pOffsets, pDst + c, count - c, pWeights, taps, iBits);
+}
+
+// 16 plane bytes per step, the two taps of a madd interleaved byte by byte
+SIMD_TARGET("sse4.1")
+static void PlaneTapsSSE41(const BYTE *pSrc, const int *pOffsets, BYTE *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32(1 << (iBits - 1));
+	const __m128i shift = _mm_cvtsi32_si128(iBits);
+	int pPairs[TAPS_MAX / 2 + 1];
+	WeightPairs(pWeights, taps, pPairs);
+	unsigned c = 0;
+
+	for (; c + 16 <= count; c += 16)
+	{
+		__m128i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+
+		for (int i = 0; i < taps; i += 2)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(pSrc + c + pOffsets[i]));
+			__m128i b = i + 1 < taps ? _mm_loadu_si128((const __m128i*)(pSrc + c + pOffsets[i + 1])) : zero;
+			__m128i w = _mm_set1_epi32(pPairs[i >> 1]);
+
+			__m128i lo = _mm_unpacklo_epi8(a, b);		// bytes 0 .. 7 of both taps
+			__m128i hi = _mm_unpackhi_epi8(a, b);		// bytes 8 .. 15
+
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+		}
+
+		__m128i p0 = _mm_packs_epi32(_mm_sra_epi32(acc0, shift), _mm_sra_epi32(acc1, shift));
+		__m128i p1 = _mm_packs_epi32(_mm_sra_epi32(acc2, shift), _mm_sra_epi32(acc3, shift));
+		_mm_storeu_si128((__m128i*)(pDst + c), _mm_packus_epi16(p0, p1));
+	}
+
+	if (c < count)
+		PlaneTapsScalar(pSrc + c, pOffsets, pDst + c, count - c, pWeights, taps, iBits);
+}
+
+// Expand565 on 4 pixels widened to 32 bit lanes
+SIMD_TARGET("sse4.1")
+static inline __m128i Expand565LanesSSE41(__m128i v)
+{
+	__m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 3), _mm_set1_epi32(0xf8)),
+		_mm_and_si128(_mm_srli_epi32(v, 2), _mm_set1_epi32(0x07)));
+	__m128i g = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 5), _mm_set1_epi32(0xfc00)),
+		_mm_and_si128(_mm_srli_epi32(v, 1), _mm_set1_epi32(0x300)));
+	__m128i r = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 8), _mm_set1_epi32(0xf80000)),
+		_mm_and_si128(_mm_slli_epi32(v, 3), _mm_set1_epi32(0x70000)));
+	return _mm_or_si128(_mm_or_si128(b, g), r);
+}
+
+SIMD_TARGET("sse4.1")
+static void Expand565SSE41(const WORD *pSrc, RGBQUAD *pDst, unsigned count)
+{
+	unsigned x = 0;
+	for (; x + 8 <= count; x += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(pSrc + x));
+		_mm_storeu_si128((__m128i*)(pDst + x), Expand565LanesSSE41(_mm_cvtepu16_epi32(v)));
+		_mm_storeu_si128((__m128i*)(pDst + x + 4), Expand565LanesSSE41(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8))));
+	}
+
+	Expand565Scalar(pSrc + x, pDst + x, count - x);
+}
+
+//-----------------------------------------------------------------------------
+// AVX2 kernels
+//-----------------------------------------------------------------------------
+SIMD_TARGET("avx2")
+static void Expand24AVX2(const BYTE *pSrc, RGBQUAD *pDst, unsigned count)
+{
+	const __m256i mask = _mm256_broadcastsi128_si256(Expand24Mask());
+	unsigned x = 0;
+
+	// 8 pixels per step, each lane loads 12 of its bytes plus 4 spare
+	for (; x + 10 <= count; x += 8)
+	{
+		const BYTE *p = pSrc + 3 * x;
+		__m256i px = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+			_mm_loadu_si128((const __m128i*)(p + 12)), 1);
+		_mm256_storeu_si256((__m256i*)(pDst + x), _mm256_shuffle_epi8(px, mask));
+	}
+
+	Expand24SSE41(pSrc + 3 * x, pDst + x, count - x);
+}
+
+SIMD_TARGET("avx2")
+static void SplitRgbAVX2(const RGBQUAD *pSrc, BYTE *pRed, BYTE *pGreen, BYTE *pBlue, unsigned count)
+{
+	const __m256i mask = _mm256_broadcastsi128_si256(SplitMask());
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	unsigned x = 0;
+
+	// 32 pixels per step. After the shuffle and permute every register of 8
+	// pixels holds 8 blue, 8 green, 8 red and 8 reserved bytes in its
+	// quarters, the unpacks and lane swaps gather the quarters.
+	for (; x + 32 <= count; x += 32)
+	{
+		__m256i v[4];
+		for (int i = 0; i < 4; i++)
+		{
+			v[i] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(pSrc + x + 8 * i)), mask);
+			v[i] = _mm256_permutevar8x32_epi32(v[i], order);
+		}
+
+		__m256i br01 = _mm256_unpacklo_epi64(v[0], v[1]);
+		__m256i ga01 = _mm256_unpackhi_epi64(v[0], v[1]);
+		__m256i br23 = _mm256_unpacklo_epi64(v[2], v[3]);
+		__m256i ga23 = _mm256_unpackhi_epi64(v[2], v[3]);
+
+		if (pBlue)
+			_mm256_storeu_si256((__m256i*)(pBlue + x), _mm256_permute2x128_si256(br01, br23, 0x20));
+		if (pGreen)
+			_mm256_storeu_si256((__m256i*)(pGreen + x), _mm256_permute2x128_si256(ga01, ga23, 0x20));
+		if (pRed)
+			_mm256_storeu_si256((__m256i*)(pRed + x), _mm256_permute2x128_si256(br01, br23, 0x31));
+	}
+
+	SplitRgbSSE41(pSrc + x, pRed ? pRed + x : NULL, pGreen ? pGreen + x : NULL, pBlue ? pBlue + x : NULL, count - x);
+}
+
+SIMD_TARGET("avx2")
+static void MergeChannelAVX2(const BYTE *pPlane, RGBQUAD *pDst, unsigned uChannel, unsigned count)
+{
+	const __m128i shift = _mm_cvtsi32_si128(8 * uChannel);
+	const __m256i mask = _mm256_sll_epi32(_mm256_set1_epi32(0xff), shift);
+	unsigned x = 0;
+
+	for (; x + 8 <= count; x += 8)
+	{
+		__m256i v = _mm256_sll_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pPlane + x))), shift);
+		__m256i px = _mm256_loadu_si256((const __m256i*)(pDst + x));
+		_mm256_storeu_si256((__m256i*)(pDst + x), _mm256_blendv_epi8(px, v, mask));
+	}
+
+	MergeChannelSSE41(pPlane + x, pDst + x, uChannel, count - x);
+}
+
+// HslSSE41 on 8 pixels
+SIMD_TARGET("avx2")
+static inline void HslAVX2(__m256i px, __m256i &hue, __m256i &sat, __m256i &lum)
+{
+	const __m256i low = _mm256_set1_epi32(0xff);
+	__m256i b = _mm256_and_si256(px, low);
+	__m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 8), low);
+	__m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 16), low);
+
+	__m256i hi = _mm256_max_epi32(r, _mm256_max_epi32(g, b));
+	__m256i lo = _mm256_min_epi32(r, _mm256_min_epi32(g, b));
+	__m256i d = _mm256_sub_epi32(hi, lo);
+	__m256i sum = _mm256_add_epi32(hi, lo);
+
+	lum = _mm256_srli_epi32(sum, 1);
+
+	__m256i denom = _mm256_min_epi32(sum, _mm256_sub_epi32(_mm256_set1_epi32(510), sum));
+	__m256 fd = _mm256_cvtepi32_ps(d);
+	__m256 fsat = _mm256_div_ps(_mm256_mul_ps(fd, _mm256_set1_ps(255.0f)),
+		_mm256_cvtepi32_ps(_mm256_max_epi32(denom, _mm256_set1_epi32(1))));
+	sat = _mm256_cvttps_epi32(fsat);
+
+	__m256i isRed = _mm256_cmpeq_epi32(hi, r);
+	__m256i isGreen = _mm256_cmpeq_epi32(hi, g);
+	__m256i diff = _mm256_blendv_epi8(_mm256_blendv_epi8(_mm256_sub_epi32(r, g), _mm256_sub_epi32(b, r), isGreen),
+		_mm256_sub_epi32(g, b), isRed);
+	__m256i redBase = _mm256_and_si256(_mm256_cmpgt_epi32(b, g), _mm256_set1_epi32(360));
+	__m256i base = _mm256_blendv_epi8(_mm256_blendv_epi8(_mm256_set1_epi32(240), _mm256_set1_epi32(120), isGreen),
+		redBase, isRed);
+
+	__m256 fn = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(diff), _mm256_set1_ps(60.0f)),
+		_mm256_mul_ps(_mm256_cvtepi32_ps(base), fd));
+	__m256 fhue = _mm256_div_ps(_mm256_mul_ps(fn, _mm256_set1_ps(17.0f)),
+		_mm256_mul_ps(_mm256_max_ps(fd, _mm256_set1_ps(1.0f)), _mm256_set1_ps(24.0f)));
+	hue = _mm256_cvttps_epi32(fhue);
+}
+
+// The in-lane packs leave the dwords of 4 pixels in the order 0 2 4 6 1 3 5 7
+SIMD_TARGET("avx2")
+static inline __m256i PackBytesAVX2(__m256i v0, __m256i v1, __m256i v2, __m256i v3)
+{
+	__m256i v = _mm256_packus_epi16(_mm256_packus_epi32(v0, v1), _mm256_packus_epi32(v2, v3));
+	return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+SIMD_TARGET("avx2")
+static void RgbToHslAVX2(const RGBQUAD *pSrc, BYTE *pHue, BYTE *pSat, BYTE *pLum, unsigned count)
+{
+	unsigned x = 0;
+
+	for (; x + 32 <= count; x += 32)
+	{
+		__m256i h[4], s[4], l[4];
+		for (int i = 0; i < 4; i++)
+			HslAVX2(_mm256_loadu_si256((const __m256i*)(pSrc + x + 8 * i)), h[i], s[i], l[i]);
+
+		if (pHue)
+			_mm256_storeu_si256((__m256i*)(pHue + x), PackBytesAVX2(h[0], h[1], h[2], h[3]));
+		if (pSat)
+			_mm256_storeu_si256((__m256i*)(pSat + x), PackBytesAVX2(s[0], s[1], s[2], s[3]));
+		if (pLum)
+			_mm256_storeu_si256((__m256i*)(pLum + x), PackBytesAVX2(l[0], l[1], l[2], l[3]));
+	}
+
+	RgbToHslSSE41(pSrc + x, pHue ? pHue + x : NULL, pSat ? pSat + x : NULL, pLum ? pLum + x : NULL, count - x);
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 LoadPlaneAVX2(const BYTE *p)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i HslChannelAVX2(float k0, __m256 h12, __m256 l, __m256 a)
+{
+	const __m256 twelve = _mm256_set1_ps(12.0f);
+	__m256 k = _mm256_add_ps(_mm256_set1_ps(k0), h12);
+	k = _mm256_sub_ps(k, _mm256_and_ps(_mm256_cmp_ps(k, twelve, _CMP_GE_OQ), twelve));
+
+	__m256 t = _mm256_min_ps(_mm256_min_ps(_mm256_sub_ps(k, _mm256_set1_ps(3.0f)), _mm256_sub_ps(_mm256_set1_ps(9.0f), k)),
+		_mm256_set1_ps(1.0f));
+	t = _mm256_max_ps(t, _mm256_set1_ps(-1.0f));
+
+	__m256 v = _mm256_sub_ps(l, _mm256_mul_ps(a, t));
+	__m256i i = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+	return _mm256_min_epi32(_mm256_max_epi32(i, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+}
+
+SIMD_TARGET("avx2")
+static void HslToRgbAVX2(const BYTE *pHue, const BYTE *pSat, const BYTE *pLum, RGBQUAD *pDst, unsigned count)
+{
+	unsigned x = 0;
+
+	for (; x + 8 <= count; x += 8)
+	{
+		__m256 h12 = _mm256_mul_ps(LoadPlaneAVX2(pHue + x), _mm256_set1_ps(HUE_TO_TWELFTHS));
+		__m256 s = _mm256_mul_ps(LoadPlaneAVX2(pSat + x), _mm256_set1_ps(BYTE_TO_UNIT));
+		__m256 l = _mm256_mul_ps(LoadPlaneAVX2(pLum + x), _mm256_set1_ps(BYTE_TO_UNIT));
+		__m256 a = _mm256_mul_ps(s, _mm256_min_ps(l, _mm256_sub_ps(_mm256_set1_ps(1.0f), l)));
+
+		__m256i r = HslChannelAVX2(0.0f, h12, l, a);
+		__m256i g = HslChannelAVX2(8.0f, h12, l, a);
+		__m256i b = HslChannelAVX2(4.0f, h12, l, a);
+		__m256i px = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_slli_epi32(g, 8)), b);
+		_mm256_storeu_si256((__m256i*)(pDst + x), px);
+	}
+
+	HslToRgbSSE41(pHue + x, pSat + x, pLum + x, pDst + x, count - x);
+}
+
+// TapsSSE41 on 8 pixels per step, lanes as in ColAVX2
+SIMD_TARGET("avx2")
+static void TapsAVX2(const RGBQUAD *pSrc, const int *pOffsets, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i half = _mm256_set1_epi32(1 << (iBits - 1));
+	const __m128i shift = _mm_cvtsi32_si128(iBits);
+	const __m256i noAlpha = _mm256_set1_epi32(0x00ffffff);
+	int pPairs[TAPS_MAX / 2 + 1];
+	WeightPairs(pWeights, taps, pPairs);
+	unsigned c = 0;
+
+	for (; c + 8 <= count; c += 8)
+	{
+		__m256i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+
+		for (int i = 0; i < taps; i += 2)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(pSrc + c + pOffsets[i]));
+			__m256i b = i + 1 < taps ? _mm256_loadu_si256((const __m256i*)(pSrc + c + pOffsets[i + 1])) : zero;
+			__m256i w = _mm256_set1_epi32(pPairs[i >> 1]);
+
+			__m256i lo = _mm256_unpacklo_epi8(a, b);
+			__m256i hi = _mm256_unpackhi_epi8(a, b);
+
+			acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+		}
+
+		__m256i p01 = _mm256_packs_epi32(_mm256_sra_epi32(acc0, shift), _mm256_sra_epi32(acc1, shift));
+		__m256i p23 = _mm256_packs_epi32(_mm256_sra_epi32(acc2, shift), _mm256_sra_epi32(acc3, shift));
+		_mm256_storeu_si256((__m256i*)(pDst + c), _mm256_and_si256(_mm256_packus_epi16(p01, p23), noAlpha));
+	}
+
+	if (c < count)
+		TapsSSE41(pSrc + c, pOffsets, pDst + c, count - c, pWeights, taps, iBits);
+}
+
+// 32 plane bytes per step. Per lane acc0 holds bytes 0 .. 3 (16 .. 19 in
+// the upper lane), acc1 4 .. 7 and so on, the packs restore the order.
+SIMD_TARGET("avx2")
+static void PlaneTapsAVX2(const BYTE *pSrc, const int *pOffsets, BYTE *pDst, unsigned count,
+	const short *pWeights, int taps, int iBits)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i half = _mm256_set1_epi32(1 << (iBits - 1));
+	const __m128i shift = _mm_cvtsi32_si128(iBits);
+	int pPairs[TAPS_MAX / 2 + 1];
+	WeightPairs(pWeights, taps, pPairs);
+	unsigned c = 0;
+
+	for (; c + 32 <= count; c += 32)
+	{
+		__m256i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+
+		for (int i = 0; i < taps; i += 2)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(pSrc + c + pOffsets[i]));
+			__m256i b = i + 1 < taps ? _mm256_loadu_si256((const __m256i*)(pSrc + c + pOffsets[i + 1])) : zero;
+			__m256i w = _mm256_set1_epi32(pPairs[i >> 1]);
+
+			__m256i lo = _mm256_unpacklo_epi8(a, b);
+			__m256i hi = _mm256_unpackhi_epi8(a, b);
+
+			acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+		}
+
+		__m256i p0 = _mm256_packs_epi32(_mm256_sra_epi32(acc0, shift), _mm256_sra_epi32(acc1, shift));
+		__m256i p1 = _mm256_packs_epi32(_mm256_sra_epi32(acc2, shift), _mm256_sra_epi32(acc3, shift));
+		_mm256_storeu_si256((__m256i*)(pDst + c), _mm256_packus_epi16(p0, p1));
+	}
+
+	if (c < count)
+		PlaneTapsSSE41(pSrc + c, pOffsets, pDst + c, count - c, pWeights, taps, iBits);
+}
+
+// 8 pixels per step, one gather per channel
+SIMD_TARGET("avx2")
+static void LutAVX2(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned count, const SLutTables &tables)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xff);
+	const __m256i reservedMask = _mm256_set1_epi32((int)0xff000000);
+	unsigned x = 0;
+
+	for (; x + 8 <= count; x += 8)
+	{
+		__m256i px = _mm256_loadu_si256((const __m256i*)(pSrc + x));
+		__m256i b = _mm256_and_si256(px, byteMask);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 8), byteMask);
+		__m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 16), byteMask);
+
+		__m256i v = _mm256_and_si256(px, reservedMask);
+		v = _mm256_or_si256(v, _mm256_i32gather_epi32((const int*)tables.blue, b, 4));
+		v = _mm256_or_si256(v, _mm256_i32gather_epi32((const int*)tables.green, g, 4));
+		v = _mm256_or_si256(v, _mm256_i32gather_epi32((const int*)tables.red, r, 4));
+		_mm256_storeu_si256((__m256i*)(pDst + x), v);
+	}
+
+	LutScalar(pSrc + x, pDst + x, count - x, tables);
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i Expand565LanesAVX2(__m256i v)
+{
+	__m256i b = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 3), _mm256_set1_epi32(0xf8)),
+		_mm256_and_si256(_mm256_srli_epi32(v, 2), _mm256_set1_epi32(0x07)));
+	__m256i g = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 5), _mm256_set1_epi32(0xfc00)),
+		_mm256_and_si256(_mm256_srli_epi32(v, 1), _mm256_set1_epi32(0x300)));
+	__m256i r = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 8), _mm256_set1_epi32(0xf80000)),
+		_mm256_and_si256(_mm256_slli_epi32(v, 3), _mm256_set1_epi32(0x70000)));
+	return _mm256_or_si256(_mm256_or_si256(b, g), r);
+}
+
+SIMD_TARGET("avx2")
+static void Expand565AVX2(const WORD *pSrc, RGBQUAD *pDst, unsigned count)
+{
+	unsigned x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(pSrc + x));
+		_mm256_storeu_si256((__m256i*)(pDst + x), Expand565LanesAVX2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v))));
+		_mm256_storeu_si256((__m256i*)(pDst + x + 8), Expand565LanesAVX2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1))));
+	}
+
+	Expand565SSE41(pSrc + x, pDst + x, count - x);
+}
+
+// 8 pixels per gather
+SIMD_TARGET("avx2")
+static void ExpandIndexedAVX2(const BYTE *pSrc, RGBQUAD *pDst, unsigned count, const RGBQUAD *pPalette)
+{
+	unsigned x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(pSrc + x));
+		__m256i lo = _mm256_i32gather_epi32((const int*)pPalette, _mm256_cvtepu8_epi32(v), 4);
+		__m256i hi = _mm256_i32gather_epi32((const int*)pPalette, _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), 4);
+		_mm256_storeu_si256((__m256i*)(pDst + x), lo);
+		_mm256_storeu_si256((__m256i*)(pDst + x + 8), hi);
+	}
+
+	ExpandIndexedScalar(pSrc + x, pDst + x, count - x, pPalette);
+}
+
+#endif // SIMD_X86
+
+static const SPixelKernels g_Kernels[] =
+{
+	{ SIMD_SCALAR,	"scalar",	Expand24Scalar,	SplitRgbScalar,	MergeChannelScalar,	RgbToHslScalar,	HslToRgbScalar,
+		TapsScalar,		PlaneTapsScalar,	HistogramScalar,	PlaneHistogramScalar,	LutScalar,
+		Expand565Scalar,	ExpandIndexedScalar },
+#ifdef SIMD_X86
+	{ SIMD_SSE41,	"sse4.1",	Expand24SSE41,	SplitRgbSSE41,	MergeChannelSSE41,	RgbToHslSSE41,	HslToRgbSSE41,
+		TapsSSE41,		PlaneTapsSSE41,		HistogramScalar,	PlaneHistogramScalar,	LutScalar,
+		Expand565SSE41,		ExpandIndexedScalar },
+	{ SIMD_AVX2,	"avx2",		Expand24AVX2,	SplitRgbAVX2,	MergeChannelAVX2,	RgbToHslAVX2,	HslToRgbAVX2,
+		TapsAVX2,		PlaneTapsAVX2,		HistogramScalar,	PlaneHistogramScalar,	LutAVX2,
+		Expand565AVX2,		ExpandIndexedAVX2 },
+#endif
+};
+
+const SPixelKernels& GetPixelKernels()
+{
+	return g_Kernels[GetSimdLevel()];
+}
@@ -0,0 +1,151 @@
+// PlanarImage.cpp
+// Split and merge of CPlanarImage, row by row through the channel kernels.
+#include "PlanarImage.h"
+#include "PixelKernels.h"
+#include "Profiler.h"
+
+
+CPlanarImage::CPlanarImage() : m_lWidth(0), m_lHeight(0), m_Stride(0)
+{
+	for(int i = 0; i < PLANE_COUNT; i++)
+	{
+		m_pBlocks[i] = NULL;
+		m_pPlanes[i] = NULL;
+	}
+}
+
+CPlanarImage::~CPlanarImage()
+{
+	Release();
+}
+
+bool CPlanarImage::Create(LONG w, LONG h)
+{
+	if(w <= 0 || h <= 0)
+		return false;
+
+	if(w != m_lWidth || h != m_lHeight)
+	{
+		Release();
+		m_lWidth = w;
+		m_lHeight = h;
+		m_Stride = ((size_t)w + PLANE_ALIGNMENT - 1) / PLANE_ALIGNMENT * PLANE_ALIGNMENT;
+	}
+	return true;
+}
+
+void CPlanarImage::Release()
+{
+	for(int i = 0; i < PLANE_COUNT; i++)
+	{
+		delete[] m_pBlocks[i];
+		m_pBlocks[i] = NULL;
+		m_pPlanes[i] = NULL;
+	}
+	m_lWidth = m_lHeight = 0;
+	m_Stride = 0;
+}
+
+BYTE* CPlanarImage::Plane(EColorChannel chn)
+{
+	if(chn < 0 || chn >= PLANE_COUNT || !m_Stride)
+		return NULL;
+
+	if(!m_pPlanes[chn])
+	{
+		m_pBlocks[chn] = new BYTE[m_Stride * m_lHeight + PLANE_ALIGNMENT - 1];
+
+		size_t misalign = (size_t)m_pBlocks[chn] % PLANE_ALIGNMENT;
+		m_pPlanes[chn] = m_pBlocks[chn] + (misalign ? PLANE_ALIGNMENT - misalign : 0);
+	}
+	return m_pPlanes[chn];
+}
+
+const BYTE* CPlanarImage::Plane(EColorChannel chn) const
+{
+	return chn >= 0 && chn < PLANE_COUNT ? m_pPlanes[chn] : NULL;
+}
+
+bool CPlanarImage::Split(const CImageFile &image, unsigned int uPlanes, const RECT *rc)
+{
+	PROFILE_SCOPE("CPlanarImage::Split");
+
+	LONG w = rc ? rc->right - rc->left + 1 : image.Width();
+	LONG h = rc ? rc->bottom - rc->top + 1 : image.Height();
+	LONG x = rc ? rc->left : 0;
+	LONG y = rc ? rc->top : 0;
+
+	if(!image.Pixels() || x < 0 || y < 0 || x + w > image.Width() || y + h > image.Height() || !Create(w, h))
+		return false;
+
+	BYTE *pPlanes[PLANE_COUNT];
+	for(int i = 0; i < PLANE_COUNT; i++)
+		pPlanes[i] = (uPlanes & (1 << i)) ? Plane((EColorChannel)i) : NULL;
+
+	const SPixelKernels &kernels = GetPixelKernels();
+	const bool bRgb = (uPlanes & PLANES_RGB) != 0;
+	const bool bHsl = (uPlanes & PLANES_HSL) != 0;
+
+	for(LONG i = 0; i < h; i++)
+	{
+		const RGBQUAD *pRow = image.Pixels() + (size_t)(i + y) * image.Width() + x;
+		size_t offset = (size_t)i * m_Stride;
+
+		if(bRgb)
+		{
+			kernels.pfnSplitRgb(pRow,
+				pPlanes[ECC_RED] ? pPlanes[ECC_RED] + offset : NULL,
+				pPlanes[ECC_GREEN] ? pPlanes[ECC_GREEN] + offset : NULL,
+				pPlanes[ECC_BLUE] ? pPlanes[ECC_BLUE] + offset : NULL, w);
+		}
+		if(bHsl)
+		{
+			kernels.pfnRgbToHsl(pRow,
+				pPlanes[ECC_HUE] ? pPlanes[ECC_HUE] + offset : NULL,
+				pPlanes[ECC_SATURATION] ? pPlanes[ECC_SATURATION] + offset : NULL,
+				pPlanes[ECC_LUMINOSITY] ? pPlanes[ECC_LUMINOSITY] + offset : NULL, w);
+		}
+	}
+	return true;
+}
+
+bool CPlanarImage::Merge(CImageFile &image, unsigned int uPlanes, LONG x, LONG y) const
+{
+	PROFILE_SCOPE("CPlanarImage::Merge");
+
+	if(!image.Pixels() || x < 0 || y < 0 || x + m_lWidth > image.Width() || y + m_lHeight > image.Height())
+		return false;
+
+	for(int i = 0; i < PLANE_COUNT; i++)
+	{
+		if((uPlanes & (1 << i)) && !m_pPlanes[i])
+			return false;
+	}
+	if((uPlanes & PLANES_HSL) && (uPlanes & PLANES_HSL) != PLANES_HSL)
+		return false;
+
+	image.ReleaseMips();
+
+	const SPixelKernels &kernels = GetPixelKernels();
+
+	// byte of each RGB plane within an RGBQUAD
+	static const unsigned s_uChannels[3] = { 2, 1, 0 };
+
+	for(LONG i = 0; i < m_lHeight; i++)
+	{
+		RGBQUAD *pRow = image.Pixels() + (size_t)(i + y) * image.Width() + x;
+		size_t offset = (size_t)i * m_Stride;
+
+		if(uPlanes & PLANES_HSL)
+		{
+			kernels.pfnHslToRgb(m_pPlanes[ECC_HUE] + offset, m_pPlanes[ECC_SATURATION] + offset,
+				m_pPlanes[ECC_LUMINOSITY] + offset, pRow, m_lWidth);
+		}
+		for(int c = ECC_RED; c <= ECC_BLUE; c++)
+		{
+			if(uPlanes & (1 << c))
+				kernels.pfnMergeChannel(m_pPlanes[c] + offset, pRow, s_uChannels[c], m_lWidth);
+		}
+	}
+	return true;
+}
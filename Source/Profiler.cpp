@@ -0,0 +1,301 @@
+//-----------------------------------------------------------------------------
+// File: Profiler.cpp
+//
+// Desc: Lightweight hierarchical scope profiler with Chrome trace export.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Profiler Specific Includes
+//-----------------------------------------------------------------------------
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+namespace
+{
+	//-------------------------------------------------------------------------
+	// Name : SEvent (Struct)
+	// Desc : One completed scope.
+	//-------------------------------------------------------------------------
+	struct SEvent
+	{
+		const char	*szName;
+		long long	llStart;
+		long long	llEnd;
+		int			iDepth;
+	};
+
+	static_assert((PROFILER_EVENTS_PER_THREAD & (PROFILER_EVENTS_PER_THREAD - 1)) == 0,
+		"PROFILER_EVENTS_PER_THREAD must be a power of two");
+
+	//-------------------------------------------------------------------------
+	// Name : CEventBuffer (Class)
+	// Desc : Ring of the newest events of a single writing thread. The total
+	//		count is published with release semantics so a dump running on
+	//		another thread only reads completed events, and can tell which
+	//		of them were overwritten while it copied them.
+	//-------------------------------------------------------------------------
+	struct CEventBuffer
+	{
+		SEvent								events[PROFILER_EVENTS_PER_THREAD];
+		std::atomic<unsigned long long>		count;		// Events recorded since start up
+		unsigned							tid;
+		const char							*szThreadName;
+	};
+
+	//-------------------------------------------------------------------------
+	// Name : CRegistry (Class)
+	// Desc : Owns every thread buffer created so far. The lock is only taken
+	//		when a thread records its first event and when dumping.
+	//-------------------------------------------------------------------------
+	struct CRegistry
+	{
+		std::mutex					lock;
+		std::vector<CEventBuffer*>	buffers;
+
+		std::atomic<unsigned long>	frameCount;
+		unsigned long				autoDumpFrames;
+		std::string					autoDumpFile;
+
+		CRegistry() : frameCount(0), autoDumpFrames(0) {}
+		~CRegistry()
+		{
+			for (size_t i = 0; i < buffers.size(); i++)
+				delete buffers[i];
+		}
+	};
+
+	CRegistry& Registry()
+	{
+		static CRegistry registry;
+		return registry;
+	}
+
+	CEventBuffer* ThreadBuffer()
+	{
+		thread_local CEventBuffer *pBuffer = NULL;
+
+		if (!pBuffer)
+		{
+			CRegistry &reg = Registry();
+			std::lock_guard<std::mutex> guard(reg.lock);
+
+			pBuffer = new CEventBuffer;
+			pBuffer->count = 0;
+			pBuffer->tid = (unsigned)reg.buffers.size() + 1;
+			pBuffer->szThreadName = NULL;
+
+			reg.buffers.push_back(pBuffer);
+		}
+
+		return pBuffer;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : Snapshot ()
+	// Desc : Copies the events still in a ring, oldest first, and returns how
+	//		many of the thread's events are no longer in it. Slots the
+	//		thread overwrote during the copy are left out, and so is the slot
+	//		it may be writing the next event into.
+	//-------------------------------------------------------------------------
+	unsigned long long Snapshot(const CEventBuffer *pBuffer, std::vector<SEvent> &events)
+	{
+		const unsigned long long ullMask = PROFILER_EVENTS_PER_THREAD - 1;
+		unsigned long long ullEnd = pBuffer->count.load(std::memory_order_acquire);
+		unsigned long long ullBegin = ullEnd > ullMask ? ullEnd - ullMask : 0;
+
+		events.clear();
+		for (unsigned long long i = ullBegin; i < ullEnd; i++)
+			events.push_back(pBuffer->events[i & ullMask]);
+
+		// Any event the thread added since the first look replaced an old one
+		std::atomic_thread_fence(std::memory_order_acquire);
+		unsigned long long ullNow = pBuffer->count.load(std::memory_order_relaxed);
+		unsigned long long ullLost = ullNow > ullMask ? ullNow - ullMask : 0;
+		if (ullLost > ullBegin)
+			events.erase(events.begin(), events.begin() + (size_t)(std::min)(ullLost - ullBegin, (unsigned long long)events.size()));
+
+		return (std::max)(ullLost, ullBegin);
+	}
+
+	void WriteEscaped(FILE *f, const char *sz)
+	{
+		for (; *sz; sz++)
+		{
+			if (*sz == '"' || *sz == '\\')
+				fputc('\\', f);
+			fputc(*sz, f);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Now () (Static)
+// Desc : Returns a monotonic timestamp in nanoseconds.
+//-----------------------------------------------------------------------------
+long long CProfiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Depth () (Static)
+// Desc : Nesting level of the calling thread's open scopes.
+//-----------------------------------------------------------------------------
+int& CProfiler::Depth()
+{
+	thread_local int iDepth = 0;
+	return iDepth;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Record () (Static)
+// Desc : Appends a completed scope to the calling thread's ring, over the
+//		oldest event once the ring is full.
+//-----------------------------------------------------------------------------
+void CProfiler::Record( const char *szName, long long llStart, long long llEnd, int iDepth )
+{
+	CEventBuffer *pBuffer = ThreadBuffer();
+	unsigned long long n = pBuffer->count.load(std::memory_order_relaxed);
+
+	SEvent &e	= pBuffer->events[n & (PROFILER_EVENTS_PER_THREAD - 1)];
+	e.szName	= szName;
+	e.llStart	= llStart;
+	e.llEnd		= llEnd;
+	e.iDepth	= iDepth;
+
+	pBuffer->count.store(n + 1, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetThreadName () (Static)
+// Desc : Names the calling thread in the exported trace. Without the
+//		profiler it does nothing, the thread gets no ring.
+//-----------------------------------------------------------------------------
+void CProfiler::SetThreadName( const char *szName )
+{
+#ifdef PROFILER_ENABLED
+	ThreadBuffer()->szThreadName = szName;
+#else
+	(void)szName;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetAutoDump () (Static)
+// Desc : Writes the trace to szFileName once ulFrames frames were marked.
+//		Passing 0 frames disables the automatic dump.
+//-----------------------------------------------------------------------------
+void CProfiler::SetAutoDump( unsigned long ulFrames, const char *szFileName )
+{
+	CRegistry &reg = Registry();
+
+	reg.autoDumpFrames = ulFrames;
+	reg.autoDumpFile = szFileName ? szFileName : "";
+}
+
+//-----------------------------------------------------------------------------
+// Name : FrameMark () (Static)
+// Desc : Signals the end of a frame.
+//-----------------------------------------------------------------------------
+void CProfiler::FrameMark()
+{
+	CRegistry &reg = Registry();
+	unsigned long ulFrame = ++reg.frameCount;
+
+	if (reg.autoDumpFrames && ulFrame == reg.autoDumpFrames && !reg.autoDumpFile.empty())
+		Dump(reg.autoDumpFile.c_str());
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetFrameCount () (Static)
+// Desc : Number of frames marked so far.
+//-----------------------------------------------------------------------------
+unsigned long CProfiler::GetFrameCount()
+{
+	return Registry().frameCount;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Dump () (Static)
+// Desc : Writes the events still held as Chrome trace JSON, the newest
+//		PROFILER_EVENTS_PER_THREAD - 1 of every thread. Safe to call while
+//		other threads keep recording, they simply will not show up past the
+//		point the dump started.
+//-----------------------------------------------------------------------------
+bool CProfiler::Dump( const char *szFileName )
+{
+	FILE *f = fopen(szFileName, "w");
+	if (!f)
+		return false;
+
+	CRegistry &reg = Registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+
+	std::vector<std::vector<SEvent> > events(reg.buffers.size());
+	std::vector<unsigned long long> lost(reg.buffers.size());
+
+	// Use the earliest event as the trace origin to keep numbers small
+	long long llOrigin = 0;
+	bool bFirst = true;
+
+	for (size_t b = 0; b < reg.buffers.size(); b++)
+	{
+		lost[b] = Snapshot(reg.buffers[b], events[b]);
+
+		for (size_t i = 0; i < events[b].size(); i++)
+			if (bFirst || events[b][i].llStart < llOrigin)
+			{
+				llOrigin = events[b][i].llStart;
+				bFirst = false;
+			}
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool bComma = false;
+	for (size_t b = 0; b < reg.buffers.size(); b++)
+	{
+		CEventBuffer *pBuffer = reg.buffers[b];
+
+		if (pBuffer->szThreadName)
+		{
+			fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+				bComma ? ",\n" : "", pBuffer->tid);
+			WriteEscaped(f, pBuffer->szThreadName);
+			fprintf(f, "\"}}");
+			bComma = true;
+		}
+
+		for (size_t i = 0; i < events[b].size(); i++)
+		{
+			const SEvent &e = events[b][i];
+
+			fprintf(f, "%s{\"name\":\"", bComma ? ",\n" : "");
+			WriteEscaped(f, e.szName);
+			fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%d}}",
+				pBuffer->tid, (e.llStart - llOrigin) / 1000.0, (e.llEnd - e.llStart) / 1000.0, e.iDepth);
+			bComma = true;
+		}
+
+		// Older events the ring no longer holds
+		if (lost[b])
+		{
+			fprintf(f, "%s{\"name\":\"overwritten events\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":0,\"args\":{\"count\":%llu}}",
+				bComma ? ",\n" : "", pBuffer->tid, lost[b]);
+			bComma = true;
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	return true;
+}
@@ -0,0 +1,184 @@
+//-----------------------------------------------------------------------------
+// File: ResizeCheck.cpp
+//
+// Desc: Resampling consistency check, run by ctest. Resamples seeded images
+//	at every SIMD level, thread count and vertical mode, with the box filter
+//	integer ratio fast paths on and off, and compares each result byte for
+//	byte with the scalar, single thread, VERTICAL_STRIPS one. CStreamResizer
+//	is held against it too wherever Resample filters horizontally first.
+//	Linear light is compared with its own scalar result.
+//
+//	Usage: ResizeCheck
+//
+//	Returns 0 when every result matches, 1 otherwise.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// ResizeCheck Specific Includes
+//-----------------------------------------------------------------------------
+#include "StreamResizer.h"
+#include "SimdLevel.h"
+
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	struct SCase
+	{
+		unsigned	srcWidth, srcHeight;
+		unsigned	dstWidth, dstHeight;
+		const char	*szFilter;
+	};
+
+	// Both filtering orders, enlarging and shrinking, odd sizes and the box
+	// filter's whole ratios
+	const SCase g_Cases[] =
+	{
+		{ 320, 180, 213, 120, "bicubic" },
+		{ 320, 180, 640, 360, "bilinear" },
+		{ 301, 203, 517, 97, "lanczos3" },
+		{ 301, 203, 97, 517, "bspline" },
+		{ 257, 131, 255, 129, "bicubic" },
+		{ 160, 90, 480, 180, "box" },
+		{ 320, 180, 160, 90, "box" },
+		{ 320, 180, 80, 45, "box" },
+		{ 320, 180, 159, 89, "box" },
+	};
+
+	const unsigned g_Threads[] = { 1, 2, 3, 8 };
+
+	const EVerticalMode g_Modes[] = { VERTICAL_STRIPS, VERTICAL_COLUMNS, VERTICAL_TRANSPOSE };
+	const char *g_szModes[] = { "strips", "columns", "transpose" };
+	const char *g_szLevels[] = { "scalar", "sse4.1", "avx2" };
+
+	CGenericFilter* CreateFilter(const char *szName)
+	{
+		if (strcmp(szName, "box") == 0)			return new CBoxFilter();
+		if (strcmp(szName, "bilinear") == 0)	return new CBilinearFilter();
+		if (strcmp(szName, "bicubic") == 0)		return new CBicubicFilter();
+		if (strcmp(szName, "bspline") == 0)		return new CBSplineFilter();
+		if (strcmp(szName, "lanczos3") == 0)	return new CLanczos3Filter();
+		return NULL;
+	}
+
+	// Smooth gradients plus noise, so every filter tap matters
+	void MakeImage(CImageFile &image, unsigned uWidth, unsigned uHeight, unsigned uSeed)
+	{
+		std::mt19937 random(uSeed);
+
+		image.Create(uWidth, uHeight);
+		RGBQUAD *pPixel = image.Pixels();
+		for (unsigned y = 0; y < uHeight; y++)
+		{
+			for (unsigned x = 0; x < uWidth; x++, pPixel++)
+			{
+				int noise = int(random() & 63);
+				pPixel->rgbRed		= BYTE((x * 255 / uWidth + noise) & 0xff);
+				pPixel->rgbGreen	= BYTE((y * 255 / uHeight + noise) & 0xff);
+				pPixel->rgbBlue		= BYTE(((x + y) * 3 + noise) & 0xff);
+				pPixel->rgbReserved	= 0;
+			}
+		}
+	}
+
+	bool Same(const CImageFile &a, const CImageFile &b)
+	{
+		return a.Width() == b.Width() && a.Height() == b.Height() &&
+			!memcmp(a.Pixels(), b.Pixels(), sizeof(RGBQUAD) * a.Width() * a.Height());
+	}
+
+	void Resample(const CImageFile &source, CGenericFilter *pFilter, const SCase &c, bool bLinear,
+		CResizableImage &out)
+	{
+		out.SetFilter(pFilter);
+		out.SetLinearLight(bLinear);
+		out.ResampleFrom(source, c.dstWidth, c.dstHeight);
+	}
+
+	// Failures of one case
+	int CheckCase(const SCase &c, unsigned uSeed)
+	{
+		std::unique_ptr<CGenericFilter> pFilter(CreateFilter(c.szFilter));
+		CImageFile source;
+		MakeImage(source, c.srcWidth, c.srcHeight, uSeed);
+
+		char szCase[64];
+		sprintf(szCase, "%s %ux%u -> %ux%u", c.szFilter, c.srcWidth, c.srcHeight, c.dstWidth, c.dstHeight);
+
+		int iFailures = 0;
+		for (int iLinear = 0; iLinear < 2; iLinear++)
+		{
+			SetSimdLevel(SIMD_SCALAR);
+			CResizableImage::SetThreadCount(1);
+			CResizableImage::SetVerticalMode(VERTICAL_STRIPS);
+			CResizableImage::SetIntegerFastPaths(false);
+
+			CResizableImage reference;
+			Resample(source, pFilter.get(), c, iLinear != 0, reference);
+
+			for (int level = SIMD_SCALAR; level <= GetSupportedSimdLevel(); level++)
+			for (size_t t = 0; t < sizeof(g_Threads) / sizeof(g_Threads[0]); t++)
+			for (size_t m = 0; m < sizeof(g_Modes) / sizeof(g_Modes[0]); m++)
+			for (int iFast = 0; iFast < 2; iFast++)
+			{
+				SetSimdLevel((ESimdLevel)level);
+				CResizableImage::SetThreadCount(g_Threads[t]);
+				CResizableImage::SetVerticalMode(g_Modes[m]);
+				CResizableImage::SetIntegerFastPaths(iFast != 0);
+
+				CResizableImage out;
+				Resample(source, pFilter.get(), c, iLinear != 0, out);
+				if (!Same(out, reference))
+				{
+					fprintf(stderr, "ResizeCheck: %s%s differs at simd=%s threads=%u vertical=%s fastpath=%d\n",
+						szCase, iLinear ? " linear" : "", g_szLevels[level], g_Threads[t], g_szModes[m], iFast);
+					iFailures++;
+				}
+			}
+
+			// The stream filters horizontally first, the other order rounds
+			// in between passes differently
+			if (iLinear || c.dstWidth * c.srcHeight > c.dstHeight * c.srcWidth)
+				continue;
+
+			for (int level = SIMD_SCALAR; level <= GetSupportedSimdLevel(); level++)
+			{
+				SetSimdLevel((ESimdLevel)level);
+
+				CImageFile out;
+				out.Create(c.dstWidth, c.dstHeight);
+				CImageRowProvider rows(source);
+				CImageRowSink sink(out);
+				CStreamResizer resizer(pFilter.get());
+
+				if (!resizer.Resample(rows, c.dstWidth, c.dstHeight, sink) || !Same(out, reference))
+				{
+					fprintf(stderr, "ResizeCheck: %s differs through CStreamResizer at simd=%s\n",
+						szCase, g_szLevels[level]);
+					iFailures++;
+				}
+			}
+		}
+
+		return iFailures;
+	}
+}
+
+int main(int, char **)
+{
+	int iFailures = 0;
+	size_t uCases = sizeof(g_Cases) / sizeof(g_Cases[0]);
+	for (size_t i = 0; i < uCases; i++)
+		iFailures += CheckCase(g_Cases[i], 7 + (unsigned)i);
+
+	SetSimdLevel(SIMD_AVX2);
+	CResizableImage::SetThreadCount(0);
+	CResizableImage::SetVerticalMode(VERTICAL_STRIPS);
+	CResizableImage::SetIntegerFastPaths(true);
+
+	printf("ResizeCheck: %u cases, %d mismatches\n", (unsigned)uCases, iFailures);
+	return iFailures ? 1 : 0;
+}
@@ -1,8 +1,226 @@
 #include "ResizeEngine.h"
+#include "Profiler.h"
+
+#include "Counters.h"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <typeinfo>
+#include <string.h>
+
+namespace
+{
+	// Pool shared by every CResizableImage, created on first use
+	std::mutex						g_PoolLock;
+	std::unique_ptr<CThreadPool>	g_pPool;
+	unsigned						g_uThreads = 0;
+
+	CThreadPool& GetPool()
+	{
+		std::lock_guard<std::mutex> guard(g_PoolLock);
+		if (!g_pPool)
+			g_pPool.reset(new CThreadPool(g_uThreads));
+		return *g_pPool;
+	}
+
+	// Identifies a weights table, see CWeightsCache::Get
+	struct SWeightsKey
+	{
+		const std::type_info	*pType;
+		double					dWidth, dParam1, dParam2;
+		DWORD					uDstSize, uSrcSize;
+
+		bool operator==(const SWeightsKey &rhs) const
+		{
+			return *pType == *rhs.pType && dWidth == rhs.dWidth && dParam1 == rhs.dParam1 &&
+				dParam2 == rhs.dParam2 && uDstSize == rhs.uDstSize && uSrcSize == rhs.uSrcSize;
+		}
+	};
+
+	typedef std::pair<SWeightsKey, CWeightsCache::TablePtr> WeightsEntry;
+
+	// Most recently used table first
+	std::mutex					g_CacheLock;
+	std::list<WeightsEntry>		g_Cache;
+	unsigned int				g_uCacheCapacity = WEIGHTS_CACHE_SIZE;
+
+	EVerticalMode				g_VerticalMode = VERTICAL_STRIPS;
+	bool						g_bIntegerFastPaths = true;
+
+	// Calls the virtual Filter() of filters without a specialized path
+	struct SVirtualCurve
+	{
+		CGenericFilter *pFilter;
+
+		explicit SVirtualCurve(CGenericFilter *pF) : pFilter(pF) {}
+		double Eval(double dVal) const { return pFilter->Filter(dVal); }
+	};
+
+	// Edge of the square tiles Transpose copies, 8 x 8 pixels are 8 cache lines
+	const unsigned int TRANSPOSE_TILE = 8;
+
+	// Fewest destination rows of a linear light band, every band fills its
+	// ring from scratch
+	const unsigned int LINEAR_BAND = 32;
+
+	// Image copy with rows and columns swapped, bands are rows of tiles
+	struct STranspose
+	{
+		const RGBQUAD *pSrc;
+		RGBQUAD *pDst;
+		unsigned int src_width, src_height;
+	};
+
+	void TransposeBand(void *pContext, unsigned uBegin, unsigned uEnd)
+	{
+		STranspose *pT = (STranspose*)pContext;
+
+		for (unsigned ty = uBegin * TRANSPOSE_TILE; ty < uEnd * TRANSPOSE_TILE && ty < pT->src_height; ty += TRANSPOSE_TILE)
+		{
+			unsigned yEnd = (std::min)(ty + TRANSPOSE_TILE, pT->src_height);
+			for (unsigned tx = 0; tx < pT->src_width; tx += TRANSPOSE_TILE)
+			{
+				unsigned xEnd = (std::min)(tx + TRANSPOSE_TILE, pT->src_width);
+				for (unsigned y = ty; y < yEnd; y++)
+					for (unsigned x = tx; x < xEnd; x++)
+						pT->pDst[x * pT->src_height + y] = pT->pSrc[y * pT->src_width + x];
+			}
+		}
+	}
+
+	void Transpose(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned int src_width, unsigned int src_height)
+	{
+		STranspose t = { pSrc, pDst, src_width, src_height };
+		GetPool().Run((src_height + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE, 1, TransposeBand, &t);
+	}
+
+	// Rows of a transposed image run through the horizontal kernel
+	struct SLines
+	{
+		const RGBQUAD *pSrc;
+		RGBQUAD *pDst;
+		unsigned int src_length, dst_length;
+		const CWeightsTable *pWeights;
+	};
+
+	void LinesBand(void *pContext, unsigned uBegin, unsigned uEnd)
+	{
+		SLines *pL = (SLines*)pContext;
+		RESIZE_ROW_KERNEL pfnRow = GetResizeKernels().pfnRow;
+
+		for (unsigned u = uBegin; u < uEnd; u++)
+			pfnRow(&pL->pSrc[u * pL->src_length], 0, &pL->pDst[u * pL->dst_length], 0, pL->dst_length, *pL->pWeights);
+	}
+
+	// Linear light resampling, bands are destination rows. Each thread keeps
+	// the rows under the vertical kernel in a ring of 2 * taps rows (slots
+	// r % taps and r % taps + taps, as CStreamResizer does) and converts
+	// from and to sRGB one row at a time, so no linear image is ever held
+	// and the intermediate rows stay in the cache. Going xy the ring holds
+	// horizontally filtered rows, going yx linear source rows and every
+	// destination row is filtered horizontally after the vertical pass.
+	struct SLinearStream
+	{
+		const RGBQUAD *pSrc;
+		RGBQUAD *pDst;
+		unsigned int src_width, dst_width;
+		unsigned int ring_width;		// dst_width going xy, src_width going yx
+		unsigned int ring_rows;			// widest vertical window
+		bool bRowsFirst;
+		const CWeightsTable *pRowWeights;
+		const CWeightsTable *pColWeights;
+		SLinearPixel *pScratch;			// scratch_size pixels per pool thread
+		unsigned int scratch_size;
+	};
+
+	void LinearStreamBand(void *pContext, unsigned uBegin, unsigned uEnd)
+	{
+		SLinearStream *pS = (SLinearStream*)pContext;
+		const SResizeKernels &kernels = GetResizeKernels();
+
+		SLinearPixel *pIn = pS->pScratch + CThreadPool::GetThreadIndex() * pS->scratch_size;
+		SLinearPixel *pRing = pIn + pS->src_width;
+		SLinearPixel *pCol = pRing + 2 * pS->ring_rows * pS->ring_width;
+		SLinearPixel *pRow = pCol + pS->ring_width;
+		int iNextRow = 0;		// First source row not in the ring yet
+
+		for (unsigned y = uBegin; y < uEnd; y++)
+		{
+			int iLeft = pS->pColWeights->getLeftBoundary(y);
+			int iRight = pS->pColWeights->getRightBoundary(y);
+
+			// Rows before the window are not needed by this or any later row
+			iNextRow = (std::max)(iNextRow, iLeft);
+
+			for (; iNextRow <= iRight; iNextRow++)
+			{
+				SLinearPixel *pSlot = &pRing[(iNextRow % pS->ring_rows) * pS->ring_width];
+				if (pS->bRowsFirst)
+				{
+					SrgbToLinear(&pS->pSrc[iNextRow * pS->src_width], pIn, pS->src_width);
+					kernels.pfnLinearRow(pIn, pSlot, pS->dst_width, *pS->pRowWeights);
+				}
+				else
+					SrgbToLinear(&pS->pSrc[iNextRow * pS->src_width], pSlot, pS->src_width);
+				memcpy(pSlot + pS->ring_rows * pS->ring_width, pSlot, sizeof(SLinearPixel) * pS->ring_width);
+			}
+
+			kernels.pfnLinearCol(&pRing[(iLeft % pS->ring_rows) * pS->ring_width], pS->ring_width, pCol, pS->ring_width,
+				pS->pColWeights->getFixedWeights(y), iRight - iLeft + 1);
+
+			if (pS->bRowsFirst)
+				LinearToSrgb(pCol, &pS->pDst[y * pS->dst_width], pS->dst_width);
+			else
+			{
+				kernels.pfnLinearRow(pCol, pRow, pS->dst_width, *pS->pRowWeights);
+				LinearToSrgb(pRow, &pS->pDst[y * pS->dst_width], pS->dst_width);
+			}
+		}
+	}
+
+	// Integer ratio passes of the box filter, bands are destination rows
+	// (reduction) or source rows (replication)
+	struct SIntegerPass
+	{
+		const RGBQUAD *pSrc;
+		RGBQUAD *pDst;
+		unsigned int src_width, dst_width;
+		unsigned int factor_x, factor_y;
+	};
+
+	void BoxReduceBand(void *pContext, unsigned uBegin, unsigned uEnd)
+	{
+		SIntegerPass *pP = (SIntegerPass*)pContext;
+		BOX_REDUCE_KERNEL pfnReduce = GetResizeKernels().pfnBoxReduce;
+
+		for (unsigned y = uBegin; y < uEnd; y++)
+			pfnReduce(&pP->pSrc[y * pP->factor_y * pP->src_width], pP->src_width, &pP->pDst[y * pP->dst_width],
+				pP->dst_width, pP->factor_x);
+	}
+
+	void ReplicateBand(void *pContext, unsigned uBegin, unsigned uEnd)
+	{
+		SIntegerPass *pP = (SIntegerPass*)pContext;
+		REPLICATE_KERNEL pfnReplicate = GetResizeKernels().pfnReplicate;
+
+		for (unsigned y = uBegin; y < uEnd; y++)
+		{
+			RGBQUAD *pRow = &pP->pDst[y * pP->factor_y * pP->dst_width];
+			pfnReplicate(&pP->pSrc[y * pP->src_width], pRow, pP->src_width, pP->factor_x);
+
+			for (unsigned i = 1; i < pP->factor_y; i++)
+				memcpy(pRow + i * pP->dst_width, pRow, sizeof(RGBQUAD) * pP->dst_width);
+		}
+	}
+}
 
 CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrcSize) 
 {
-	DWORD u;
+	PROFILE_SCOPE("CWeightsTable::CWeightsTable");
+
 	double dWidth;
 	double dFScale = 1.0;
 	double dFilterWidth = pFilter->GetWidth();
@@ -25,22 +243,71 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrc
 	// allocate a new line contributions structure
 	// window size is the number of sampled pixels
 	m_WindowSize = 2 * (int)ceil(dWidth) + 1;
+	m_WindowStride = (m_WindowSize + WEIGHTS_PAD - 1) / WEIGHTS_PAD * WEIGHTS_PAD;
 	m_LineLength = uDstSize;
-	// allocate list of contributions
-	m_WeightTable = new sContribution[m_LineLength];
-	for(u = 0 ; u < m_LineLength ; u++) 
-	{
-		// allocate contributions for every pixel
-		m_WeightTable[u].Weights = new double[m_WindowSize];
-	}
 
-	for(u = 0; u < m_LineLength; u++) 
+	// allocate every contribution in one block, zeroed so the padding
+	// after each window holds zero weights
+	size_t weightsSize = sizeof(double) * m_WindowStride * m_LineLength;
+	size_t fixedSize = sizeof(short) * m_WindowStride * m_LineLength;
+	size_t boundsSize = sizeof(sContribution) * m_LineLength;
+	m_pBlock = new BYTE[weightsSize + fixedSize + boundsSize];
+	memset(m_pBlock, 0, weightsSize + fixedSize + boundsSize);
+
+	m_pWeights = (double*)m_pBlock;
+	m_pFixedWeights = (short*)(m_pBlock + weightsSize);
+	m_pBounds = (sContribution*)(m_pBlock + weightsSize + fixedSize);
+
+	// weights are computed by code instantiated for the filter type, the
+	// virtual Filter() is only used for unknown filters or changed widths
+	const std::type_info &type = typeid(*pFilter);
+	if(type == typeid(CBoxFilter))
+		FillWeightsFor(static_cast<CBoxFilter&>(*pFilter), dScale, dFScale, dWidth, uSrcSize);
+	else if(type == typeid(CBilinearFilter))
+		FillWeightsFor(static_cast<CBilinearFilter&>(*pFilter), dScale, dFScale, dWidth, uSrcSize);
+	else if(type == typeid(CBicubicFilter))
+		FillWeightsFor(static_cast<CBicubicFilter&>(*pFilter), dScale, dFScale, dWidth, uSrcSize);
+	else if(type == typeid(CBSplineFilter))
+		FillWeightsFor(static_cast<CBSplineFilter&>(*pFilter), dScale, dFScale, dWidth, uSrcSize);
+	else if(type == typeid(CLanczos3Filter))
+		FillWeightsFor(static_cast<CLanczos3Filter&>(*pFilter), dScale, dFScale, dWidth, uSrcSize);
+	else
+		FillWeights(SVirtualCurve(pFilter), dScale, dFScale, dWidth, uSrcSize);
+}
+
+template <class TFilter>
+void CWeightsTable::FillWeightsFor(TFilter &filter, double dScale, double dFScale, double dWidth, DWORD uSrcSize)
+{
+	if(filter.GetWidth() != TFilter::DefaultWidth())
+		FillWeights(SVirtualCurve(&filter), dScale, dFScale, dWidth, uSrcSize);
+	else
+		FillWeightsFor(filter, dScale, dFScale, dWidth, uSrcSize, std::integral_constant<bool, TFilter::Tabulated()>());
+}
+
+template <class TFilter>
+void CWeightsTable::FillWeightsFor(TFilter &filter, double dScale, double dFScale, double dWidth, DWORD uSrcSize, std::true_type)
+{
+	// sample the curve once instead of evaluating it for every tap
+	CFilterCurve<TFilter> curve(filter);
+	FillWeights(curve, dScale, dFScale, dWidth, uSrcSize);
+}
+
+template <class TFilter>
+void CWeightsTable::FillWeightsFor(TFilter &filter, double dScale, double dFScale, double dWidth, DWORD uSrcSize, std::false_type)
+{
+	FillWeights(filter, dScale, dFScale, dWidth, uSrcSize);
+}
+
+template <class TCurve>
+void CWeightsTable::FillWeights(const TCurve &curve, double dScale, double dFScale, double dWidth, DWORD uSrcSize)
+{
+	for(DWORD u = 0; u < m_LineLength; u++) 
 	{
 		// scan through line of contributions
-		double dCenter = (double)u / dScale;   // reverse mapping
+		double dCenter = ((double)u + 0.5) / dScale - 0.5;   // reverse mapping, pixel centres onto pixel centres
 		// find the significant edge points that affect the pixel
-		int iLeft = max(0, (int)floor(dCenter - dWidth));
-		int iRight = min((int)ceil(dCenter + dWidth), int(uSrcSize) - 1);
+		int iLeft = (std::max)(0, (int)floor(dCenter - dWidth));
+		int iRight = (std::min)((int)ceil(dCenter + dWidth), int(uSrcSize) - 1);
 
 		// cut edge points to fit in filter window in case of spill-off
 		if((iRight - iLeft + 1) > int(m_WindowSize)) 
@@ -55,16 +322,19 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrc
 			}
 		}
 
-		m_WeightTable[u].Left = iLeft;
-		m_WeightTable[u].Right = iRight;
+		m_pBounds[u].Left = iLeft;
+		m_pBounds[u].Right = iRight;
+
+		double *pWeights = &m_pWeights[u * m_WindowStride];
+		short *pFixedWeights = &m_pFixedWeights[u * m_WindowStride];
 
 		int iSrc = 0;
 		double dTotalWeight = 0;  // zero sum of weights
 		for(iSrc = iLeft; iSrc <= iRight; iSrc++) 
 		{
 			// calculate weights
-			double weight = dFScale * pFilter->Filter(dFScale * (dCenter - (double)iSrc));
-			m_WeightTable[u].Weights[iSrc-iLeft] = weight;
+			double weight = dFScale * curve.Eval(dFScale * (dCenter - (double)iSrc));
+			pWeights[iSrc-iLeft] = weight;
 			dTotalWeight += weight;
 		}
 
@@ -74,22 +344,87 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrc
 			for(iSrc = iLeft; iSrc <= iRight; iSrc++)
 			{
 				// normalize point
-				m_WeightTable[u].Weights[iSrc-iLeft] /= dTotalWeight;
+				pWeights[iSrc-iLeft] /= dTotalWeight;
 			}
 		}
+
+		// round to fixed point, then push the rounding error into the
+		// largest weight so that flat areas keep their exact value
+		int iTotal = 0;
+		int iLargest = 0;
+		for(iSrc = 0; iSrc <= iRight - iLeft; iSrc++)
+		{
+			double dWeight = pWeights[iSrc];
+			int iWeight = (int)floor(dWeight * WEIGHT_ONE + 0.5);
+
+			pFixedWeights[iSrc] = (short)iWeight;
+			iTotal += iWeight;
+
+			if(fabs(dWeight) > fabs(pWeights[iLargest]))
+				iLargest = iSrc;
+		}
+
+		if(dTotalWeight > 0)
+			pFixedWeights[iLargest] += (short)(WEIGHT_ONE - iTotal);
 	}
 }
 
 CWeightsTable::~CWeightsTable() 
 {
-		for(DWORD u = 0; u < m_LineLength; u++) 
+		// free all contributions
+		delete []m_pBlock;
+}
+
+
+CWeightsCache::TablePtr CWeightsCache::Get(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrcSize)
+{
+	SWeightsKey key;
+	key.pType = &typeid(*pFilter);
+	key.dWidth = pFilter->GetWidth();
+	pFilter->GetParams(key.dParam1, key.dParam2);
+	key.uDstSize = uDstSize;
+	key.uSrcSize = uSrcSize;
+
+	{
+		std::lock_guard<std::mutex> guard(g_CacheLock);
+		for (std::list<WeightsEntry>::iterator it = g_Cache.begin(); it != g_Cache.end(); ++it)
 		{
-				// free contributions for every pixel
-				delete []m_WeightTable[u].Weights;
+			if (it->first == key)
+			{
+				// move to the front, it is now the most recently used
+				g_Cache.splice(g_Cache.begin(), g_Cache, it);
+				COUNTER_INC("resize weights cache hits");
+				return it->second;
+			}
 		}
+	}
+
+	// build outside the lock, other threads may keep resampling meanwhile
+	COUNTER_INC("resize weights cache misses");
+	TablePtr pTable = std::make_shared<CWeightsTable>(pFilter, uDstSize, uSrcSize);
 
-		// free list of pixels contributions
-		delete []m_WeightTable;
+	std::lock_guard<std::mutex> guard(g_CacheLock);
+	if (g_uCacheCapacity > 0)
+	{
+		g_Cache.push_front(WeightsEntry(key, pTable));
+		while (g_Cache.size() > g_uCacheCapacity)
+			g_Cache.pop_back();
+	}
+	return pTable;
+}
+
+void CWeightsCache::SetCapacity(unsigned int uTables)
+{
+	std::lock_guard<std::mutex> guard(g_CacheLock);
+	g_uCacheCapacity = uTables;
+	while (g_Cache.size() > g_uCacheCapacity)
+		g_Cache.pop_back();
+}
+
+void CWeightsCache::Clear()
+{
+	std::lock_guard<std::mutex> guard(g_CacheLock);
+	g_Cache.clear();
 }
 
 
@@ -98,32 +433,24 @@ void CResizableImage::ScaleRow(unsigned int dst_width, unsigned int /*dst_height
 	RGBQUAD *pDstRow = &(m_pResImg[row * dst_width]);
 	RGBQUAD *pSrcRow = &(m_pRGB[row * width]);
 
-	for (UINT x = 0; x < dst_width; x++) 
+	// Accumulate weighted effect of each neighboring pixel
+	GetResizeKernels().pfnRow(pSrcRow, 0, pDstRow, 0, dst_width, *m_pWeights);
+}
+
+void CResizableImage::RowBand(void *pContext, unsigned uBegin, unsigned uEnd)
+{
+	SPass *pPass = (SPass*)pContext;
+
+	for (UINT u = uBegin; u < uEnd; u++)
 	{
-		// Loop through row
-		BYTE r = 0;
-		BYTE g = 0;
-		BYTE b = 0;
-		int iLeft = m_pWeights->getLeftBoundary(x);	// Retrieve left boundries
-		int iRight = m_pWeights->getRightBoundary(x);  // Retrieve right boundries
-		for (int i = iLeft; i <= iRight; i++)
-		{
-			// Scan between boundries
-			// Accumulate weighted effect of each neighboring pixel
-			r += (BYTE)(m_pWeights->getWeight(x, i-iLeft) * (double)(pSrcRow[i].rgbRed)); 
-			g += (BYTE)(m_pWeights->getWeight(x, i-iLeft) * (double)(pSrcRow[i].rgbGreen)); 
-			b += (BYTE)(m_pWeights->getWeight(x, i-iLeft) * (double)(pSrcRow[i].rgbBlue)); 
-		} 
-		// set destination row
-		pDstRow[x].rgbRed = r;
-		pDstRow[x].rgbGreen = g;
-		pDstRow[x].rgbBlue = b;
-		pDstRow[x].rgbReserved = 0;
+		// scale each row
+		pPass->pImage->ScaleRow(pPass->dst_width, pPass->dst_height, u);
 	}
 }
 
 void CResizableImage::HorizontalFilter(unsigned int dst_width, unsigned int dst_height)
 {
+	PROFILE_SCOPE("CResizableImage::HorizontalFilter");
 
 	if (dst_width == width)
 	{
@@ -131,75 +458,178 @@ void CResizableImage::HorizontalFilter(unsigned int dst_width, unsigned int dst_
 		memcpy (m_pResImg, m_pRGB, sizeof(RGBQUAD) * width * height);
 	}
 	
-	m_pWeights = new CWeightsTable(m_pFilter, dst_width, width);
+	m_pWeights = CWeightsCache::Get(m_pFilter, dst_width, width);
+
+	// Rows are independent, the weights table is only read
+	SPass pass = { this, dst_width, dst_height };
+	GetPool().Run(dst_height, HORIZONTAL_BAND, RowBand, &pass);
 
-	for (UINT u = 0; u < dst_height; u++)
+	m_pWeights.reset();
+}
+
+void CResizableImage::ScaleStrip(unsigned int dst_width, unsigned int row_begin, unsigned int row_end)
+{
+	RESIZE_COL_KERNEL pfnCol = GetResizeKernels().pfnCol;
+
+	for (UINT x = 0; x < dst_width; x += VERTICAL_CHUNK)
 	{
-		// scale each row
-		ScaleRow (dst_width, dst_width, u);	// Scale each row 
+		// Step through the strip one chunk of every row at a time, the rows
+		// of a strip share most of their source rows
+		UINT count = (std::min)(VERTICAL_CHUNK, dst_width - x);
+
+		for (UINT y = row_begin; y < row_end; y++)
+		{
+			int iLeft = m_pWeights->getLeftBoundary(y);	// Retrieve left boundries
+			int iRight = m_pWeights->getRightBoundary(y);  // Retrieve right boundries
+
+			pfnCol(&m_pRGB[iLeft * width + x], width, &m_pResImg[y * dst_width + x], count,
+				m_pWeights->getFixedWeights(y), iRight - iLeft + 1);
+		}
 	}
+}
 
-	delete m_pWeights;
+void CResizableImage::StripBand(void *pContext, unsigned uBegin, unsigned uEnd)
+{
+	SPass *pPass = (SPass*)pContext;
+
+	for (UINT u = uBegin; u < uEnd; u += VERTICAL_STRIP)
+	{
+		// Step through strips of rows
+		pPass->pImage->ScaleStrip(pPass->dst_width, u, (std::min)(u + VERTICAL_STRIP, uEnd));
+	}
 }
 
-void CResizableImage::ScaleCol(unsigned int dst_width, unsigned int dst_height, unsigned int col)
+void CResizableImage::ScaleCols(unsigned int dst_width, unsigned int dst_height, unsigned int col, unsigned int count)
 { 
+	RESIZE_COL_KERNEL pfnCol = GetResizeKernels().pfnCol;
+
 	for (UINT y = 0; y < dst_height; y++) 
 	{
-		// Loop through column
-		BYTE r = 0;
-		BYTE g = 0;
-		BYTE b = 0;
+		// Loop through the columns of the block, every tap reads count
+		// adjacent source pixels
 		int iLeft = m_pWeights->getLeftBoundary(y);	// Retrieve left boundries
 		int iRight = m_pWeights->getRightBoundary(y);  // Retrieve right boundries
-		for (int i = iLeft; i <= iRight; i++)
-		{
-			// Scan between boundries
-			// Accumulate weighted effect of each neighboring pixel
-			RGBQUAD &src = m_pRGB[i * width + col];
-			r += (BYTE)(m_pWeights->getWeight(y, i-iLeft) * (double)(src.rgbRed));
-			g += (BYTE)(m_pWeights->getWeight(y, i-iLeft) * (double)(src.rgbGreen));
-			b += (BYTE)(m_pWeights->getWeight(y, i-iLeft) * (double)(src.rgbBlue));
-		}
 
-		RGBQUAD &dst = m_pResImg[y * dst_width + col];
-		dst.rgbRed = r;
-		dst.rgbGreen = g;
-		dst.rgbBlue = b;
-		dst.rgbReserved = 0;
+		pfnCol(&m_pRGB[iLeft * width + col], width, &m_pResImg[y * dst_width + col], count,
+			m_pWeights->getFixedWeights(y), iRight - iLeft + 1);
 	}
 }
 
 
+void CResizableImage::ColBand(void *pContext, unsigned uBegin, unsigned uEnd)
+{
+	SPass *pPass = (SPass*)pContext;
+
+	for (UINT u = uBegin * VERTICAL_BLOCK; u < uEnd * VERTICAL_BLOCK && u < pPass->dst_width; u += VERTICAL_BLOCK)
+	{
+		// Step through blocks of columns
+		pPass->pImage->ScaleCols(pPass->dst_width, pPass->dst_height, u, (std::min)(VERTICAL_BLOCK, pPass->dst_width - u));
+	}
+}
+
 void CResizableImage::VerticalFilter(unsigned int dst_width, unsigned int dst_height)
 {
+	PROFILE_SCOPE("CResizableImage::VerticalFilter");
+
 	if (height == dst_height)
 	{
 		// No scaling required, just copy
 		memcpy(m_pResImg, m_pRGB, sizeof (RGBQUAD) * width * height);
 	}
 	
-	m_pWeights = new CWeightsTable(m_pFilter, dst_height, height);
-
-	for (UINT u = 0; u < dst_width; u++)
+	if (g_VerticalMode == VERTICAL_TRANSPOSE)
 	{
-		// Step through columns
-		ScaleCol(dst_width, dst_height, u);   // Scale each column
+		TransposedVerticalFilter(dst_width, dst_height);
+		return;
 	}
 
-	delete m_pWeights;
+	m_pWeights = CWeightsCache::Get(m_pFilter, dst_height, height);
+
+	// Strips and column blocks are independent, the weights table is only read
+	SPass pass = { this, dst_width, dst_height };
+	if (g_VerticalMode == VERTICAL_COLUMNS)
+		GetPool().Run((dst_width + VERTICAL_BLOCK - 1) / VERTICAL_BLOCK, 1, ColBand, &pass);
+	else
+		GetPool().Run(dst_height, VERTICAL_STRIP, StripBand, &pass);
+
+	m_pWeights.reset();
+}
+
+void CResizableImage::TransposedVerticalFilter(unsigned int dst_width, unsigned int dst_height)
+{
+	PROFILE_SCOPE("CResizableImage::TransposedVerticalFilter");
+
+	CWeightsCache::TablePtr pWeights = CWeightsCache::Get(m_pFilter, dst_height, height);
+
+	// Columns become rows, run through the row kernel and are turned back
+	RGBQUAD *pColumns = new RGBQUAD[width * height];
+	RGBQUAD *pFiltered = new RGBQUAD[dst_width * dst_height];
+
+	Transpose(m_pRGB, pColumns, width, height);
+
+	SLines lines = { pColumns, pFiltered, (unsigned int)height, dst_height, pWeights.get() };
+	GetPool().Run(dst_width, HORIZONTAL_BAND, LinesBand, &lines);
+
+	Transpose(pFiltered, m_pResImg, dst_height, dst_width);
+
+	delete[] pColumns;
+	delete[] pFiltered;
 }
 
 void CResizableImage::Resample(unsigned dst_width, unsigned dst_height)
 {
+	PROFILE_SCOPE("CResizableImage::Resample");
+
+	ReleaseMips();
+	ResamplePixels(dst_width, dst_height, NULL);
+}
+
+//-----------------------------------------------------------------------------
+// Name : ResampleFrom ()
+// Desc : The first pass reads the source image's pixels in place, so unlike
+//		CopyFrom followed by Resample nothing is copied.
+//-----------------------------------------------------------------------------
+bool CResizableImage::ResampleFrom(const CImageFile &source, unsigned dst_width, unsigned dst_height)
+{
+	PROFILE_SCOPE("CResizableImage::ResampleFrom");
+
+	if (&source == this || !source.Pixels())
+		return false;
+
+	ReleaseMips();
+	delete[] m_pRGB;
+
+	SetHeader(source.Width(), source.Height());
+	m_pRGB = const_cast<RGBQUAD*>(source.Pixels());
+	ResamplePixels(dst_width, dst_height, source.Pixels());
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ResamplePixels () (Private)
+// Desc : Resample with m_pRGB as the source, left alone when it is pBorrowed
+//		and freed otherwise.
+//-----------------------------------------------------------------------------
+void CResizableImage::ResamplePixels(unsigned dst_width, unsigned dst_height, const RGBQUAD *pBorrowed)
+{
+	if (ResampleIntegerRatio(dst_width, dst_height))
+	{
+		// m_pResImg holds the result
+	}
+	else if (m_bLinearLight)
+	{
+		m_pResImg = new RGBQUAD[dst_width * dst_height];
+		ResampleLinear(dst_width, dst_height);
+	}
 	// decide which filtering order (xy or yx) is faster for this mapping
-	if(dst_width * height <= dst_height * width) 
+	else if(dst_width * height <= dst_height * width) 
 	{
 		m_pResImg = new RGBQUAD[dst_width * height];
 
 		HorizontalFilter(dst_width, height);
 		
-		delete m_pRGB;
+		if (m_pRGB != pBorrowed)
+			delete[] m_pRGB;
 		m_pRGB = m_pResImg;
 		width = dst_width;
 		m_pResImg = new RGBQUAD[dst_width * dst_height];
@@ -211,7 +641,8 @@ void CResizableImage::Resample(unsigned dst_width, unsigned dst_height)
 		m_pResImg = new RGBQUAD[width * dst_height];
 		VerticalFilter(width, dst_height);
 		
-		delete m_pRGB;
+		if (m_pRGB != pBorrowed)
+			delete[] m_pRGB;
 		m_pRGB = m_pResImg;
 		height = dst_height;
 		m_pResImg = new RGBQUAD[dst_width * dst_height];
@@ -219,11 +650,142 @@ void CResizableImage::Resample(unsigned dst_width, unsigned dst_height)
 		HorizontalFilter(dst_width, dst_height);
 	}
 
-	delete m_pRGB;
+	if (m_pRGB != pBorrowed)
+		delete[] m_pRGB;
 	m_pRGB = m_pResImg;
 	width = dst_width;
 	height = dst_height;
 
+#ifdef _WIN32
 	DeleteObject(m_hBMP);
 	m_hBMP = 0;
-}
\ No newline at end of file
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : ResampleIntegerRatio () (Private)
+// Desc : Box filter resamples by a whole factor, done without weights
+//		tables. Enlarging repeats every pixel factor times, shrinking by 2
+//		or 4 averages the 2x2 or 4x4 blocks, rounding after the horizontal
+//		and after the vertical sum. Both are the pixels the weights tables
+//		give for these ratios, the tables map pixel centres onto pixel
+//		centres and the general path also filters horizontally first at
+//		equal ratios. Returns false, with nothing allocated, for any other
+//		filter or ratio.
+//-----------------------------------------------------------------------------
+bool CResizableImage::ResampleIntegerRatio(unsigned dst_width, unsigned dst_height)
+{
+	unsigned src_width = width;
+	unsigned src_height = height;
+
+	if (!g_bIntegerFastPaths || !m_pFilter || src_width == 0 || src_height == 0 ||
+		typeid(*m_pFilter) != typeid(CBoxFilter) || m_pFilter->GetWidth() != CBoxFilter::DefaultWidth())
+		return false;
+
+	SIntegerPass pass = { m_pRGB, NULL, src_width, dst_width, 0, 0 };
+	CThreadPool::BAND_FUNC pfnBand;
+	unsigned uRows;
+
+	if (dst_width >= src_width && dst_height >= src_height &&
+		dst_width % src_width == 0 && dst_height % src_height == 0)
+	{
+		// one tap of weight 1 is also exact in linear light
+		pass.factor_x = dst_width / src_width;
+		pass.factor_y = dst_height / src_height;
+		pfnBand = ReplicateBand;
+		uRows = src_height;
+	}
+	else if (!m_bLinearLight && dst_width * src_height == dst_height * src_width &&
+		(src_width == 2 * dst_width || src_width == 4 * dst_width))
+	{
+		pass.factor_x = pass.factor_y = src_width / dst_width;
+		pfnBand = BoxReduceBand;
+		uRows = dst_height;
+	}
+	else
+		return false;
+
+	PROFILE_SCOPE("CResizableImage::ResampleIntegerRatio");
+	COUNTER_INC("resize integer ratio fast paths");
+
+	m_pResImg = pass.pDst = new RGBQUAD[dst_width * dst_height];
+	GetPool().Run(uRows, HORIZONTAL_BAND, pfnBand, &pass);
+
+	return true;
+}
+
+void CResizableImage::ResampleLinear(unsigned dst_width, unsigned dst_height)
+{
+	PROFILE_SCOPE("CResizableImage::ResampleLinear");
+
+	unsigned src_width = width;
+	unsigned src_height = height;
+	CWeightsCache::TablePtr pRowWeights = CWeightsCache::Get(m_pFilter, dst_width, src_width);
+	CWeightsCache::TablePtr pColWeights = CWeightsCache::Get(m_pFilter, dst_height, src_height);
+	CThreadPool &pool = GetPool();
+
+	// same filtering order as the byte path
+	SLinearStream stream;
+	stream.pSrc = m_pRGB;
+	stream.pDst = m_pResImg;
+	stream.src_width = src_width;
+	stream.dst_width = dst_width;
+	stream.bRowsFirst = dst_width * src_height <= dst_height * src_width;
+	stream.ring_width = stream.bRowsFirst ? dst_width : src_width;
+	stream.pRowWeights = pRowWeights.get();
+	stream.pColWeights = pColWeights.get();
+
+	stream.ring_rows = 1;
+	for (unsigned y = 0; y < dst_height; y++)
+		stream.ring_rows = (std::max)(stream.ring_rows,
+			unsigned(pColWeights->getRightBoundary(y) - pColWeights->getLeftBoundary(y) + 1));
+
+	stream.scratch_size = src_width + (2 * stream.ring_rows + 1) * stream.ring_width + dst_width;
+	stream.pScratch = new SLinearPixel[pool.GetThreadCount() * stream.scratch_size];
+
+	pool.Run(dst_height, LINEAR_BAND, LinearStreamBand, &stream);
+
+	delete[] stream.pScratch;
+}
+
+void CResizableImage::SetThreadCount(unsigned uThreads)
+{
+	std::lock_guard<std::mutex> guard(g_PoolLock);
+	if (g_pPool && uThreads == g_uThreads)
+		return;
+
+	// Join the old workers before starting the new ones
+	g_pPool.reset();
+	g_uThreads = uThreads;
+	g_pPool.reset(new CThreadPool(uThreads));
+}
+
+unsigned CResizableImage::GetThreadCount()
+{
+	return GetPool().GetThreadCount();
+}
+
+CThreadPool& CResizableImage::GetThreadPool()
+{
+	return GetPool();
+}
+
+void CResizableImage::SetVerticalMode(EVerticalMode mode)
+{
+	g_VerticalMode = mode;
+}
+
+EVerticalMode CResizableImage::GetVerticalMode()
+{
+	return g_VerticalMode;
+}
+
+void CResizableImage::SetIntegerFastPaths(bool bEnable)
+{
+	g_bIntegerFastPaths = bEnable;
+}
+
+bool CResizableImage::GetIntegerFastPaths()
+{
+	return g_bIntegerFastPaths;
+}
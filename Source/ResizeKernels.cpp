@@ -0,0 +1,800 @@
+// ResizeKernels.cpp
+// Scalar, SSE4.1 and AVX2 filter kernels of CResizableImage.
+//
+// Pixels are 4 bytes (b, g, r, reserved), weights are WEIGHT_BITS fixed
+// point shorts. Sums are kept in 32 bit ints, rounded and clamped once. The
+// SIMD versions pair two taps per _mm_madd_epi16 (pixel bytes widened to
+// 16 bit next to the matching weight pair) which gives the same integer
+// sums as the scalar code, so every level writes identical pixels.
+//
+// Linear light pixels hold 15 bit channels in shorts and go through the
+// same madd scheme without the byte widening step.
+#include "ResizeKernels.h"
+#include "ResizeEngine.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+static inline BYTE FixedToByte(int iSum)
+{
+	iSum = (iSum + (WEIGHT_ONE >> 1)) >> WEIGHT_BITS;
+	return (BYTE)(iSum < 0 ? 0 : (iSum > 255 ? 255 : iSum));
+}
+
+//-----------------------------------------------------------------------------
+// Scalar kernels
+//-----------------------------------------------------------------------------
+static void RowScalar(const RGBQUAD *pSrc, unsigned src_begin, RGBQUAD *pDst, unsigned dst_begin, unsigned dst_end,
+	const CWeightsTable &weights)
+{
+	for (unsigned x = dst_begin; x < dst_end; x++)
+	{
+		int r = 0, g = 0, b = 0;
+		int iLeft = weights.getLeftBoundary(x);
+		int iTaps = weights.getRightBoundary(x) - iLeft + 1;
+		const short *pWeights = weights.getFixedWeights(x);
+		const RGBQUAD *pTap = pSrc + (iLeft - (int)src_begin);
+
+		for (int i = 0; i < iTaps; i++)
+		{
+			int w = pWeights[i];
+			r += w * pTap[i].rgbRed;
+			g += w * pTap[i].rgbGreen;
+			b += w * pTap[i].rgbBlue;
+		}
+
+		RGBQUAD *pOut = pDst + (x - dst_begin);
+		pOut->rgbRed = FixedToByte(r);
+		pOut->rgbGreen = FixedToByte(g);
+		pOut->rgbBlue = FixedToByte(b);
+		pOut->rgbReserved = 0;
+	}
+}
+
+static void ColScalar(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps)
+{
+	for (unsigned c = 0; c < count; c++)
+	{
+		int r = 0, g = 0, b = 0;
+		const RGBQUAD *pTap = pSrc + c;
+
+		for (int i = 0; i < taps; i++, pTap += src_stride)
+		{
+			int w = pWeights[i];
+			r += w * pTap->rgbRed;
+			g += w * pTap->rgbGreen;
+			b += w * pTap->rgbBlue;
+		}
+
+		pDst[c].rgbRed = FixedToByte(r);
+		pDst[c].rgbGreen = FixedToByte(g);
+		pDst[c].rgbBlue = FixedToByte(b);
+		pDst[c].rgbReserved = 0;
+	}
+}
+
+static inline short FixedToLinear(int iSum)
+{
+	iSum = (iSum + (WEIGHT_ONE >> 1)) >> WEIGHT_BITS;
+	return (short)(iSum < 0 ? 0 : (iSum > LINEAR_ONE ? LINEAR_ONE : iSum));
+}
+
+static void RowLinearScalar(const SLinearPixel *pSrc, SLinearPixel *pDst, unsigned dst_width, const CWeightsTable &weights)
+{
+	for (unsigned x = 0; x < dst_width; x++)
+	{
+		int r = 0, g = 0, b = 0;
+		int iLeft = weights.getLeftBoundary(x);
+		int iTaps = weights.getRightBoundary(x) - iLeft + 1;
+		const short *pWeights = weights.getFixedWeights(x);
+		const SLinearPixel *pTap = pSrc + iLeft;
+
+		for (int i = 0; i < iTaps; i++)
+		{
+			int w = pWeights[i];
+			r += w * pTap[i].r;
+			g += w * pTap[i].g;
+			b += w * pTap[i].b;
+		}
+
+		pDst[x].r = FixedToLinear(r);
+		pDst[x].g = FixedToLinear(g);
+		pDst[x].b = FixedToLinear(b);
+		pDst[x].a = 0;
+	}
+}
+
+static void ColLinearScalar(const SLinearPixel *pSrc, unsigned src_stride, SLinearPixel *pDst, unsigned count,
+	const short *pWeights, int taps)
+{
+	for (unsigned c = 0; c < count; c++)
+	{
+		int r = 0, g = 0, b = 0;
+		const SLinearPixel *pTap = pSrc + c;
+
+		for (int i = 0; i < taps; i++, pTap += src_stride)
+		{
+			int w = pWeights[i];
+			r += w * pTap->r;
+			g += w * pTap->g;
+			b += w * pTap->b;
+		}
+
+		pDst[c].r = FixedToLinear(r);
+		pDst[c].g = FixedToLinear(g);
+		pDst[c].b = FixedToLinear(b);
+		pDst[c].a = 0;
+	}
+}
+
+// One pixel of a factor x factor block average, rows summed and rounded
+// first, then the column of row averages, as the box filter weights do
+static inline RGBQUAD BoxPixel(const RGBQUAD *pSrc, unsigned src_stride, unsigned factor)
+{
+	int iShift = factor == 4 ? 2 : 1;
+	int iHalf = (int)factor >> 1;
+	int r = 0, g = 0, b = 0;
+
+	for (unsigned y = 0; y < factor; y++, pSrc += src_stride)
+	{
+		int rowR = 0, rowG = 0, rowB = 0;
+		for (unsigned i = 0; i < factor; i++)
+		{
+			rowR += pSrc[i].rgbRed;
+			rowG += pSrc[i].rgbGreen;
+			rowB += pSrc[i].rgbBlue;
+		}
+		r += (rowR + iHalf) >> iShift;
+		g += (rowG + iHalf) >> iShift;
+		b += (rowB + iHalf) >> iShift;
+	}
+
+	RGBQUAD px;
+	px.rgbRed = BYTE((r + iHalf) >> iShift);
+	px.rgbGreen = BYTE((g + iHalf) >> iShift);
+	px.rgbBlue = BYTE((b + iHalf) >> iShift);
+	px.rgbReserved = 0;
+	return px;
+}
+
+static void BoxReduceScalar(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned dst_width, unsigned factor)
+{
+	for (unsigned x = 0; x < dst_width; x++)
+		pDst[x] = BoxPixel(pSrc + x * factor, src_stride, factor);
+}
+
+static void ReplicateScalar(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned src_width, unsigned factor)
+{
+	for (unsigned x = 0; x < src_width; x++)
+	{
+		RGBQUAD px = pSrc[x];
+		px.rgbReserved = 0;
+		for (unsigned i = 0; i < factor; i++)
+			*pDst++ = px;
+	}
+}
+
+#ifdef SIMD_X86
+
+static inline int LoadPixel(const RGBQUAD *p)
+{
+	int i;
+	memcpy(&i, p, sizeof(i));
+	return i;
+}
+
+static inline void StorePixel(RGBQUAD *p, int i)
+{
+	memcpy(p, &i, sizeof(i));
+}
+
+// Two weights in the 16 bit halves of an int, for _mm_madd_epi16
+static inline int WeightPair(short w0, short w1)
+{
+	return (int)((unsigned)(unsigned short)w0 | ((unsigned)(unsigned short)w1 << 16));
+}
+
+//-----------------------------------------------------------------------------
+// SSE4.1 kernels
+//-----------------------------------------------------------------------------
+SIMD_TARGET("sse4.1")
+static inline __m128i FinishPixelSSE41(__m128i acc)
+{
+	// round, shift and saturate (b, g, r, a) to bytes, then drop alpha
+	acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(WEIGHT_ONE >> 1)), WEIGHT_BITS);
+	acc = _mm_packs_epi32(acc, acc);
+	acc = _mm_packus_epi16(acc, acc);
+	return _mm_and_si128(acc, _mm_set1_epi32(0x00ffffff));
+}
+
+SIMD_TARGET("sse4.1")
+static void RowSSE41(const RGBQUAD *pSrc, unsigned src_begin, RGBQUAD *pDst, unsigned dst_begin, unsigned dst_end,
+	const CWeightsTable &weights)
+{
+	// [b0 g0 r0 a0 b1 g1 r1 a1] -> [b0 b1 g0 g1 r0 r1 a0 a1]
+	const __m128i pairMask = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (unsigned x = dst_begin; x < dst_end; x++)
+	{
+		int iLeft = weights.getLeftBoundary(x);
+		int iTaps = weights.getRightBoundary(x) - iLeft + 1;
+		const short *pWeights = weights.getFixedWeights(x);
+		const RGBQUAD *pTap = pSrc + (iLeft - (int)src_begin);
+		__m128i acc = _mm_setzero_si128();
+		int i = 0;
+
+		for (; i + 1 < iTaps; i += 2)
+		{
+			__m128i px = _mm_loadl_epi64((const __m128i*)(pTap + i));
+			px = _mm_cvtepu8_epi16(_mm_shuffle_epi8(px, pairMask));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1]))));
+		}
+
+		if (i < iTaps)
+		{
+			__m128i px = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(LoadPixel(pTap + i)));
+			acc = _mm_add_epi32(acc, _mm_mullo_epi32(px, _mm_set1_epi32(pWeights[i])));
+		}
+
+		StorePixel(pDst + (x - dst_begin), _mm_cvtsi128_si32(FinishPixelSSE41(acc)));
+	}
+}
+
+SIMD_TARGET("sse4.1")
+static void ColSSE41(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32(WEIGHT_ONE >> 1);
+	const __m128i noAlpha = _mm_set1_epi32(0x00ffffff);
+	unsigned c = 0;
+
+	// 4 pixels (16 channels) per step, two source rows per madd
+	for (; c + 4 <= count; c += 4)
+	{
+		__m128i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+		const RGBQUAD *pTap = pSrc + c;
+		int i = 0;
+
+		for (; i < taps; i += 2, pTap += 2 * src_stride)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)pTap);
+			__m128i b;
+			__m128i w;
+
+			if (i + 1 < taps)
+			{
+				b = _mm_loadu_si128((const __m128i*)(pTap + src_stride));
+				w = _mm_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1]));
+			}
+			else
+			{
+				b = zero;
+				w = _mm_set1_epi32(WeightPair(pWeights[i], 0));
+			}
+
+			__m128i lo = _mm_unpacklo_epi8(a, b);		// pixels 0, 1 with rows interleaved
+			__m128i hi = _mm_unpackhi_epi8(a, b);		// pixels 2, 3
+
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+		}
+
+		__m128i p01 = _mm_packs_epi32(_mm_srai_epi32(acc0, WEIGHT_BITS), _mm_srai_epi32(acc1, WEIGHT_BITS));
+		__m128i p23 = _mm_packs_epi32(_mm_srai_epi32(acc2, WEIGHT_BITS), _mm_srai_epi32(acc3, WEIGHT_BITS));
+		_mm_storeu_si128((__m128i*)(pDst + c), _mm_and_si128(_mm_packus_epi16(p01, p23), noAlpha));
+	}
+
+	if (c < count)
+		ColScalar(pSrc + c, src_stride, pDst + c, count - c, pWeights, taps);
+}
+
+// [b0 g0 r0 a0 b1 g1 r1 a1] (shorts) -> [b0 b1 g0 g1 r0 r1 a0 a1]
+SIMD_TARGET("sse4.1")
+static inline __m128i LinearPairs(__m128i px)
+{
+	return _mm_shuffle_epi8(px, _mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15));
+}
+
+// Rounds, shifts and clamps two pixels worth of sums to 0 .. LINEAR_ONE, alpha 0
+SIMD_TARGET("sse4.1")
+static inline __m128i FinishLinearSSE41(__m128i acc0, __m128i acc1)
+{
+	__m128i px = _mm_packs_epi32(_mm_srai_epi32(acc0, WEIGHT_BITS), _mm_srai_epi32(acc1, WEIGHT_BITS));
+	px = _mm_max_epi16(px, _mm_setzero_si128());
+	return _mm_and_si128(px, _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0));
+}
+
+SIMD_TARGET("sse4.1")
+static void RowLinearSSE41(const SLinearPixel *pSrc, SLinearPixel *pDst, unsigned dst_width, const CWeightsTable &weights)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32(WEIGHT_ONE >> 1);
+
+	for (unsigned x = 0; x < dst_width; x++)
+	{
+		int iLeft = weights.getLeftBoundary(x);
+		int iTaps = weights.getRightBoundary(x) - iLeft + 1;
+		const short *pWeights = weights.getFixedWeights(x);
+		const SLinearPixel *pTap = pSrc + iLeft;
+		__m128i acc = half;
+		int i = 0;
+
+		for (; i + 1 < iTaps; i += 2)
+		{
+			__m128i px = LinearPairs(_mm_loadu_si128((const __m128i*)(pTap + i)));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1]))));
+		}
+
+		if (i < iTaps)
+		{
+			__m128i px = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(pTap + i)), zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_set1_epi32(WeightPair(pWeights[i], 0))));
+		}
+
+		_mm_storel_epi64((__m128i*)(pDst + x), FinishLinearSSE41(acc, acc));
+	}
+}
+
+SIMD_TARGET("sse4.1")
+static void ColLinearSSE41(const SLinearPixel *pSrc, unsigned src_stride, SLinearPixel *pDst, unsigned count,
+	const short *pWeights, int taps)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32(WEIGHT_ONE >> 1);
+	unsigned c = 0;
+
+	// 4 pixels per step, two source rows per madd
+	for (; c + 4 <= count; c += 4)
+	{
+		__m128i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+		const SLinearPixel *pTap = pSrc + c;
+		int i = 0;
+
+		for (; i < taps; i += 2, pTap += 2 * src_stride)
+		{
+			__m128i a0 = _mm_loadu_si128((const __m128i*)pTap);
+			__m128i a1 = _mm_loadu_si128((const __m128i*)(pTap + 2));
+			__m128i b0 = zero, b1 = zero;
+			__m128i w;
+
+			if (i + 1 < taps)
+			{
+				b0 = _mm_loadu_si128((const __m128i*)(pTap + src_stride));
+				b1 = _mm_loadu_si128((const __m128i*)(pTap + src_stride + 2));
+				w = _mm_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1]));
+			}
+			else
+				w = _mm_set1_epi32(WeightPair(pWeights[i], 0));
+
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a0, b0), w));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a0, b0), w));
+			acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(a1, b1), w));
+			acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(a1, b1), w));
+		}
+
+		_mm_storeu_si128((__m128i*)(pDst + c), FinishLinearSSE41(acc0, acc1));
+		_mm_storeu_si128((__m128i*)(pDst + c + 2), FinishLinearSSE41(acc2, acc3));
+	}
+
+	if (c < count)
+		ColLinearScalar(pSrc + c, src_stride, pDst + c, count - c, pWeights, taps);
+}
+
+// 2x2: _mm_avg_epu8 rounds exactly like two equal box weights
+SIMD_TARGET("sse4.1")
+static inline __m128i BoxRow2SSE41(const RGBQUAD *pSrc)
+{
+	__m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)pSrc));
+	__m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(pSrc + 4)));
+	__m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm_avg_epu8(even, odd);
+}
+
+// 4x4: rounded averages of 4 pixels of a row for 2 destination pixels, as shorts
+SIMD_TARGET("sse4.1")
+static inline __m128i BoxRow4SSE41(const RGBQUAD *pSrc)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_loadu_si128((const __m128i*)pSrc);
+	__m128i b = _mm_loadu_si128((const __m128i*)(pSrc + 4));
+	__m128i sa = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero));
+	__m128i sb = _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero));
+	__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(sa, sb), _mm_unpackhi_epi64(sa, sb));
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+SIMD_TARGET("sse4.1")
+static __m128i BoxColumn4SSE41(const RGBQUAD *pSrc, unsigned src_stride)
+{
+	__m128i sum = _mm_set1_epi16(2);
+	for (int y = 0; y < 4; y++, pSrc += src_stride)
+		sum = _mm_add_epi16(sum, BoxRow4SSE41(pSrc));
+	return _mm_srli_epi16(sum, 2);
+}
+
+SIMD_TARGET("sse4.1")
+static void BoxReduceSSE41(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned dst_width, unsigned factor)
+{
+	const __m128i noAlpha = _mm_set1_epi32(0x00ffffff);
+	unsigned x = 0;
+
+	if (factor == 2)
+	{
+		for (; x + 4 <= dst_width; x += 4)
+		{
+			const RGBQUAD *pTap = pSrc + 2 * x;
+			__m128i avg = _mm_avg_epu8(BoxRow2SSE41(pTap), BoxRow2SSE41(pTap + src_stride));
+			_mm_storeu_si128((__m128i*)(pDst + x), _mm_and_si128(avg, noAlpha));
+		}
+	}
+	else if (factor == 4)
+	{
+		for (; x + 4 <= dst_width; x += 4)
+		{
+			const RGBQUAD *pTap = pSrc + 4 * x;
+			__m128i avg = _mm_packus_epi16(BoxColumn4SSE41(pTap, src_stride), BoxColumn4SSE41(pTap + 8, src_stride));
+			_mm_storeu_si128((__m128i*)(pDst + x), _mm_and_si128(avg, noAlpha));
+		}
+	}
+
+	for (; x < dst_width; x++)
+		pDst[x] = BoxPixel(pSrc + x * factor, src_stride, factor);
+}
+
+SIMD_TARGET("sse4.1")
+static void ReplicateSSE41(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned src_width, unsigned factor)
+{
+	const __m128i noAlpha = _mm_set1_epi32(0x00ffffff);
+	unsigned x = 0;
+
+	// 4 source pixels per step, factor whole vectors stored
+	if (factor >= 1 && factor <= 4)
+	{
+		for (; x + 4 <= src_width; x += 4, pDst += 4 * factor)
+		{
+			__m128i px = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pSrc + x)), noAlpha);
+			__m128i *pOut = (__m128i*)pDst;
+
+			switch (factor)
+			{
+			case 1:
+				_mm_storeu_si128(pOut, px);
+				break;
+			case 2:
+				_mm_storeu_si128(pOut, _mm_unpacklo_epi32(px, px));
+				_mm_storeu_si128(pOut + 1, _mm_unpackhi_epi32(px, px));
+				break;
+			case 3:
+				_mm_storeu_si128(pOut, _mm_shuffle_epi32(px, _MM_SHUFFLE(1, 0, 0, 0)));
+				_mm_storeu_si128(pOut + 1, _mm_shuffle_epi32(px, _MM_SHUFFLE(2, 2, 1, 1)));
+				_mm_storeu_si128(pOut + 2, _mm_shuffle_epi32(px, _MM_SHUFFLE(3, 3, 3, 2)));
+				break;
+			case 4:
+				_mm_storeu_si128(pOut, _mm_shuffle_epi32(px, _MM_SHUFFLE(0, 0, 0, 0)));
+				_mm_storeu_si128(pOut + 1, _mm_shuffle_epi32(px, _MM_SHUFFLE(1, 1, 1, 1)));
+				_mm_storeu_si128(pOut + 2, _mm_shuffle_epi32(px, _MM_SHUFFLE(2, 2, 2, 2)));
+				_mm_storeu_si128(pOut + 3, _mm_shuffle_epi32(px, _MM_SHUFFLE(3, 3, 3, 3)));
+				break;
+			}
+		}
+	}
+	else
+	{
+		// Larger factors, each pixel broadcast and stored 4 copies at a time
+		for (; x < src_width; x++)
+		{
+			__m128i px = _mm_and_si128(_mm_set1_epi32(LoadPixel(pSrc + x)), noAlpha);
+			unsigned i = 0;
+			for (; i + 4 <= factor; i += 4, pDst += 4)
+				_mm_storeu_si128((__m128i*)pDst, px);
+			for (; i < factor; i++)
+				StorePixel(pDst++, _mm_cvtsi128_si32(px));
+		}
+	}
+
+	if (x < src_width)
+		ReplicateScalar(pSrc + x, pDst, src_width - x, factor);
+}
+
+//-----------------------------------------------------------------------------
+// AVX2 kernels
+//-----------------------------------------------------------------------------
+SIMD_TARGET("avx2")
+static void RowAVX2(const RGBQUAD *pSrc, unsigned src_begin, RGBQUAD *pDst, unsigned dst_begin, unsigned dst_end,
+	const CWeightsTable &weights)
+{
+	// 4 pixels -> [b0 b1 g0 g1 r0 r1 a0 a1 | b2 b3 g2 g3 r2 r3 a2 a3]
+	const __m128i quadMask = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+	const __m128i pairMask = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (unsigned x = dst_begin; x < dst_end; x++)
+	{
+		int iLeft = weights.getLeftBoundary(x);
+		int iTaps = weights.getRightBoundary(x) - iLeft + 1;
+		const short *pWeights = weights.getFixedWeights(x);
+		const RGBQUAD *pTap = pSrc + (iLeft - (int)src_begin);
+		__m256i acc4 = _mm256_setzero_si256();
+		int i = 0;
+
+		// four taps per step, taps 0-1 in the low lane and 2-3 in the high one
+		for (; i + 3 < iTaps; i += 4)
+		{
+			__m128i px = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pTap + i)), quadMask);
+			__m256i w = _mm256_set_m128i(
+				_mm_set1_epi32(WeightPair(pWeights[i + 2], pWeights[i + 3])),
+				_mm_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1])));
+			acc4 = _mm256_add_epi32(acc4, _mm256_madd_epi16(_mm256_cvtepu8_epi16(px), w));
+		}
+
+		__m128i acc = _mm_add_epi32(_mm256_castsi256_si128(acc4), _mm256_extracti128_si256(acc4, 1));
+
+		for (; i + 1 < iTaps; i += 2)
+		{
+			__m128i px = _mm_loadl_epi64((const __m128i*)(pTap + i));
+			px = _mm_cvtepu8_epi16(_mm_shuffle_epi8(px, pairMask));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1]))));
+		}
+
+		if (i < iTaps)
+		{
+			__m128i px = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(LoadPixel(pTap + i)));
+			acc = _mm_add_epi32(acc, _mm_mullo_epi32(px, _mm_set1_epi32(pWeights[i])));
+		}
+
+		StorePixel(pDst + (x - dst_begin), _mm_cvtsi128_si32(FinishPixelSSE41(acc)));
+	}
+}
+
+SIMD_TARGET("avx2")
+static void ColAVX2(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned count,
+	const short *pWeights, int taps)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i half = _mm256_set1_epi32(WEIGHT_ONE >> 1);
+	const __m256i noAlpha = _mm256_set1_epi32(0x00ffffff);
+	unsigned c = 0;
+
+	// 8 pixels per step; unpacks work per 128 bit lane, so acc0 holds
+	// pixels 0 and 4, acc1 pixels 1 and 5 and so on, and the packs below
+	// put them back in order
+	for (; c + 8 <= count; c += 8)
+	{
+		__m256i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+		const RGBQUAD *pTap = pSrc + c;
+		int i = 0;
+
+		for (; i < taps; i += 2, pTap += 2 * src_stride)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)pTap);
+			__m256i b;
+			__m256i w;
+
+			if (i + 1 < taps)
+			{
+				b = _mm256_loadu_si256((const __m256i*)(pTap + src_stride));
+				w = _mm256_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1]));
+			}
+			else
+			{
+				b = zero;
+				w = _mm256_set1_epi32(WeightPair(pWeights[i], 0));
+			}
+
+			__m256i lo = _mm256_unpacklo_epi8(a, b);
+			__m256i hi = _mm256_unpackhi_epi8(a, b);
+
+			acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+			acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+			acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+			acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+		}
+
+		__m256i p01 = _mm256_packs_epi32(_mm256_srai_epi32(acc0, WEIGHT_BITS), _mm256_srai_epi32(acc1, WEIGHT_BITS));
+		__m256i p23 = _mm256_packs_epi32(_mm256_srai_epi32(acc2, WEIGHT_BITS), _mm256_srai_epi32(acc3, WEIGHT_BITS));
+		_mm256_storeu_si256((__m256i*)(pDst + c), _mm256_and_si256(_mm256_packus_epi16(p01, p23), noAlpha));
+	}
+
+	if (c < count)
+		ColSSE41(pSrc + c, src_stride, pDst + c, count - c, pWeights, taps);
+}
+
+SIMD_TARGET("avx2")
+static void ColLinearAVX2(const SLinearPixel *pSrc, unsigned src_stride, SLinearPixel *pDst, unsigned count,
+	const short *pWeights, int taps)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i half = _mm256_set1_epi32(WEIGHT_ONE >> 1);
+	const __m256i noAlpha = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+	unsigned c = 0;
+
+	// 8 pixels per step; the unpacks work per lane so acc0 holds pixels 0
+	// and 2, acc1 pixels 1 and 3, and the packs put them back in order
+	for (; c + 8 <= count; c += 8)
+	{
+		__m256i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+		const SLinearPixel *pTap = pSrc + c;
+		int i = 0;
+
+		for (; i < taps; i += 2, pTap += 2 * src_stride)
+		{
+			__m256i a0 = _mm256_loadu_si256((const __m256i*)pTap);
+			__m256i a1 = _mm256_loadu_si256((const __m256i*)(pTap + 4));
+			__m256i b0 = zero, b1 = zero;
+			__m256i w;
+
+			if (i + 1 < taps)
+			{
+				b0 = _mm256_loadu_si256((const __m256i*)(pTap + src_stride));
+				b1 = _mm256_loadu_si256((const __m256i*)(pTap + src_stride + 4));
+				w = _mm256_set1_epi32(WeightPair(pWeights[i], pWeights[i + 1]));
+			}
+			else
+				w = _mm256_set1_epi32(WeightPair(pWeights[i], 0));
+
+			acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi16(a0, b0), w));
+			acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi16(a0, b0), w));
+			acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi16(a1, b1), w));
+			acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi16(a1, b1), w));
+		}
+
+		__m256i p0 = _mm256_packs_epi32(_mm256_srai_epi32(acc0, WEIGHT_BITS), _mm256_srai_epi32(acc1, WEIGHT_BITS));
+		__m256i p1 = _mm256_packs_epi32(_mm256_srai_epi32(acc2, WEIGHT_BITS), _mm256_srai_epi32(acc3, WEIGHT_BITS));
+		_mm256_storeu_si256((__m256i*)(pDst + c), _mm256_and_si256(_mm256_max_epi16(p0, zero), noAlpha));
+		_mm256_storeu_si256((__m256i*)(pDst + c + 4), _mm256_and_si256(_mm256_max_epi16(p1, zero), noAlpha));
+	}
+
+	if (c < count)
+		ColLinearSSE41(pSrc + c, src_stride, pDst + c, count - c, pWeights, taps);
+}
+
+// 8 destination pixels of a 2x2 reduction per step, 4x4 goes through SSE4.1
+SIMD_TARGET("avx2")
+static inline __m256i BoxRow2AVX2(const RGBQUAD *pSrc)
+{
+	__m256 a = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)pSrc));
+	__m256 b = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)(pSrc + 8)));
+	__m256i even = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm256_avg_epu8(even, odd);
+}
+
+SIMD_TARGET("avx2")
+static void BoxReduceAVX2(const RGBQUAD *pSrc, unsigned src_stride, RGBQUAD *pDst, unsigned dst_width, unsigned factor)
+{
+	const __m256i noAlpha = _mm256_set1_epi32(0x00ffffff);
+	unsigned x = 0;
+
+	if (factor == 2)
+	{
+		for (; x + 8 <= dst_width; x += 8)
+		{
+			const RGBQUAD *pTap = pSrc + 2 * x;
+			__m256i avg = _mm256_avg_epu8(BoxRow2AVX2(pTap), BoxRow2AVX2(pTap + src_stride));
+
+			// lanes hold pixels [0 1 4 5 | 2 3 6 7]
+			avg = _mm256_permute4x64_epi64(avg, _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i*)(pDst + x), _mm256_and_si256(avg, noAlpha));
+		}
+	}
+
+	if (x < dst_width)
+		BoxReduceSSE41(pSrc + x * factor, src_stride, pDst + x, dst_width - x, factor);
+}
+
+SIMD_TARGET("avx2")
+static void ReplicateAVX2(const RGBQUAD *pSrc, RGBQUAD *pDst, unsigned src_width, unsigned factor)
+{
+	const __m256i noAlpha = _mm256_set1_epi32(0x00ffffff);
+	unsigned x = 0;
+
+	if (factor == 2)
+	{
+		for (; x + 8 <= src_width; x += 8, pDst += 16)
+		{
+			__m256i px = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(pSrc + x)), noAlpha);
+			__m256i lo = _mm256_unpacklo_epi32(px, px);		// [0 0 1 1 | 4 4 5 5]
+			__m256i hi = _mm256_unpackhi_epi32(px, px);		// [2 2 3 3 | 6 6 7 7]
+			_mm256_storeu_si256((__m256i*)pDst, _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i*)(pDst + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+	}
+
+	if (x < src_width)
+		ReplicateSSE41(pSrc + x, pDst, src_width - x, factor);
+}
+
+#endif // SIMD_X86
+
+static const SResizeKernels g_Kernels[] =
+{
+	{ SIMD_SCALAR,	"scalar",	RowScalar,	ColScalar,	RowLinearScalar,	ColLinearScalar,	BoxReduceScalar,	ReplicateScalar },
+#ifdef SIMD_X86
+	{ SIMD_SSE41,	"sse4.1",	RowSSE41,	ColSSE41,	RowLinearSSE41,		ColLinearSSE41,		BoxReduceSSE41,		ReplicateSSE41 },
+	{ SIMD_AVX2,	"avx2",		RowAVX2,	ColAVX2,	RowLinearSSE41,		ColLinearAVX2,		BoxReduceAVX2,		ReplicateAVX2 },
+#endif
+};
+
+const SResizeKernels& GetResizeKernels()
+{
+	return g_Kernels[GetSimdLevel()];
+}
+
+//-----------------------------------------------------------------------------
+// sRGB <-> linear light tables
+//-----------------------------------------------------------------------------
+struct SLinearTables
+{
+	short				toLinear[256];
+	unsigned long long	toPixel[3][256];		// toLinear shifted to the blue, green and red shorts of a pixel
+	BYTE				toSrgb[LINEAR_TO_SRGB_SIZE];
+
+	SLinearTables()
+	{
+		const int iShift = LINEAR_BITS - 12;	// LINEAR_TO_SRGB_SIZE is 1 << 12
+
+		for (int i = 0; i < 256; i++)
+		{
+			double c = i / 255.0;
+			double l = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+			toLinear[i] = (short)floor(l * LINEAR_ONE + 0.5);
+
+			for (int k = 0; k < 3; k++)
+				toPixel[k][i] = (unsigned long long)toLinear[i] << (16 * k);
+		}
+
+		for (int i = 0; i < LINEAR_TO_SRGB_SIZE; i++)
+		{
+			double l = (double)((i << iShift) + (1 << (iShift - 1))) / LINEAR_ONE;
+			double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1 / 2.4) - 0.055;
+			int v = (int)floor(c * 255 + 0.5);
+			toSrgb[i] = (BYTE)(v < 0 ? 0 : (v > 255 ? 255 : v));
+		}
+
+		// the bucket of every byte value converts back to exactly that byte
+		for (int i = 0; i < 256; i++)
+			toSrgb[toLinear[i] >> iShift] = (BYTE)i;
+	}
+};
+
+static const SLinearTables& GetLinearTables()
+{
+	static const SLinearTables tables;
+	return tables;
+}
+
+// Both build whole pixels in a register, one load and one store per pixel
+void SrgbToLinear(const RGBQUAD *pSrc, SLinearPixel *pDst, unsigned count)
+{
+	const SLinearTables &tables = GetLinearTables();
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		unsigned long long ullPixel = tables.toPixel[0][pSrc[i].rgbBlue] | tables.toPixel[1][pSrc[i].rgbGreen] |
+			tables.toPixel[2][pSrc[i].rgbRed];
+		memcpy(&pDst[i], &ullPixel, sizeof(ullPixel));
+	}
+}
+
+void LinearToSrgb(const SLinearPixel *pSrc, RGBQUAD *pDst, unsigned count)
+{
+	const BYTE *pTable = GetLinearTables().toSrgb;
+	const int iShift = LINEAR_BITS - 12;
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		DWORD dwPixel = pTable[pSrc[i].b >> iShift] | (DWORD)pTable[pSrc[i].g >> iShift] << 8 |
+			(DWORD)pTable[pSrc[i].r >> iShift] << 16;
+		memcpy(&pDst[i], &dwPixel, sizeof(dwPixel));
+	}
+}
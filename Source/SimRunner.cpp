@@ -0,0 +1,286 @@
+//-----------------------------------------------------------------------------
+// File: SimRunner.cpp
+//
+// Desc: Runs the game simulation for a number of frames without a window,
+//	feeding bot or scripted input and timing every phase.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// SimRunner Specific Includes
+//-----------------------------------------------------------------------------
+#include "SimRunner.h"
+#include "Profiler.h"
+#include "Counters.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <math.h>
+#include <stdio.h>
+
+//-----------------------------------------------------------------------------
+// CSimRunner::SPhase Member Functions
+//-----------------------------------------------------------------------------
+long long CSimRunner::SPhase::Total() const
+{
+	long long llTotal = 0;
+	for (size_t i = 0; i < samples.size(); i++)
+		llTotal += samples[i];
+	return llTotal;
+}
+
+long long CSimRunner::SPhase::Max() const
+{
+	return samples.empty() ? 0 : *std::max_element(samples.begin(), samples.end());
+}
+
+double CSimRunner::SPhase::Mean() const
+{
+	return samples.empty() ? 0.0 : double(Total()) / samples.size();
+}
+
+long long CSimRunner::SPhase::Median() const
+{
+	return Percentile(0.5);
+}
+
+long long CSimRunner::SPhase::Percentile(double p) const
+{
+	if (samples.empty())
+		return 0;
+
+	std::vector<long long> sorted(samples);
+	size_t n = (size_t)(p * (sorted.size() - 1) + 0.5);
+	std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+	return sorted[n];
+}
+
+//-----------------------------------------------------------------------------
+// CSimRunner Member Functions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : LoadScript () (Static)
+// Desc : Reads an input track. Lines are "<frame> <command>" where command is
+//		one of start, pause, resume, "p1 <keys>" or "p2 <keys>". Keys are any
+//		of U, D, L, R and F (fire), or '-' for none; they stay held until
+//		changed. Empty lines and lines starting with '#' are skipped.
+//-----------------------------------------------------------------------------
+bool CSimRunner::LoadScript( const char *szFileName, std::vector<SCommand> &script )
+{
+	std::ifstream in(szFileName);
+	if (!in)
+		return false;
+
+	std::string strLine;
+	while (std::getline(in, strLine))
+	{
+		if (strLine.empty() || strLine[0] == '#')
+			continue;
+
+		std::istringstream line(strLine);
+		SCommand cmd;
+		if (!(line >> cmd.ulFrame >> cmd.strVerb))
+			continue;
+		line >> cmd.strArg;
+		script.push_back(cmd);
+	}
+
+	std::stable_sort(script.begin(), script.end(),
+		[](const SCommand &a, const SCommand &b) { return a.ulFrame < b.ulFrame; });
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ParseKeys () (Private, Static)
+// Desc : Turns a script key string into player input.
+//-----------------------------------------------------------------------------
+void CSimRunner::ParseKeys( const std::string &strKeys, unsigned long &ulDirection, bool &bFire )
+{
+	ulDirection = 0;
+	bFire = false;
+
+	for (size_t i = 0; i < strKeys.size(); i++)
+	{
+		switch (strKeys[i])
+		{
+		case 'U': ulDirection |= CPlayer::DIR_FORWARD; break;
+		case 'D': ulDirection |= CPlayer::DIR_BACKWARD; break;
+		case 'L': ulDirection |= CPlayer::DIR_LEFT; break;
+		case 'R': ulDirection |= CPlayer::DIR_RIGHT; break;
+		case 'F': bFire = true; break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : BotSteer () (Private, Static)
+// Desc : Steers a player under the closest enemy and keeps firing.
+//-----------------------------------------------------------------------------
+void CSimRunner::BotSteer( CGameWorld &world, CPlayer *pPlayer, unsigned long &ulDirection, bool &bFire )
+{
+	ulDirection = 0;
+	bFire = !pPlayer->isDead();
+
+	CPlayer *pTarget = NULL;
+	double dBest = 0;
+	for (auto enem : world.Enemies())
+	{
+		double d = fabs(enem->Position().x - pPlayer->Position().x);
+		if (!pTarget || d < dBest) { pTarget = enem; dBest = d; }
+	}
+
+	if (pTarget && dBest > 10)
+		ulDirection = pTarget->Position().x < pPlayer->Position().x ? CPlayer::DIR_LEFT : CPlayer::DIR_RIGHT;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Run () (Static)
+// Desc : Builds a world from the options and steps it, recording how long
+//		each phase of every frame took and what the counters reported.
+//-----------------------------------------------------------------------------
+void CSimRunner::Run( const SOptions &opt, SResult &result )
+{
+	// Close whatever frame was open so this run starts from clean counters
+	CCounters::EndFrame();
+
+	long long llHeap = CCounters::GetHeapAllocations();
+
+	CGameWorld world;
+	world.Init(opt.screenSize, Vec2(SIM_SHIP_SIZE, SIM_SHIP_SIZE), Vec2(SIM_SHIP_SIZE, SIM_SHIP_SIZE), opt.uSeed);
+	world.AddEnemies(opt.iEnemies);
+	world.SetLives(3, 3);
+	world.SetState(opt.startState);
+
+	for (int i = 0; i < opt.iBullets; i++)
+	{
+		Vec2 position(world.Random() % int(opt.screenSize.x), world.Random() % int(opt.screenSize.y / 2));
+		world.SpawnBullet(position, Vec2(0, 200), CPlayer::TEAM::ENEMY);
+	}
+
+	result.phases.assign(3, SPhase());
+	result.phases[0].szName = "ApplyInput";
+	result.phases[1].szName = "Animate";
+	result.phases[2].szName = "RemoveDead";
+	for (size_t p = 0; p < result.phases.size(); p++)
+		result.phases[p].samples.reserve(opt.ulFrames);
+
+	std::vector<long long> totals;
+	totals.reserve(64);
+
+	result.llSetupAllocations = CCounters::GetHeapAllocations() - llHeap;
+	CCounters::EndFrame("SETUP");
+	llHeap = CCounters::GetHeapAllocations();
+
+	CGameWorld::SInput input;
+	size_t nextCommand = 0;
+	unsigned long ulFrame;
+
+	for (ulFrame = 0; ulFrame < opt.ulFrames; ulFrame++)
+	{
+		if (opt.input == INPUT_SCRIPT)
+		{
+			for (; nextCommand < opt.script.size() && opt.script[nextCommand].ulFrame <= ulFrame; nextCommand++)
+			{
+				const SCommand &cmd = opt.script[nextCommand];
+
+				if (cmd.strVerb == "start" || cmd.strVerb == "resume")
+					world.SetState(CGameWorld::ONGOING);
+				else if (cmd.strVerb == "pause")
+					world.SetState(CGameWorld::PAUSE);
+				else if (cmd.strVerb == "p1")
+					ParseKeys(cmd.strArg, input.ulP1Direction, input.bP1Fire);
+				else if (cmd.strVerb == "p2")
+					ParseKeys(cmd.strArg, input.ulP2Direction, input.bP2Fire);
+			}
+		}
+		else if (opt.input == INPUT_BOT)
+		{
+			BotSteer(world, world.Player1(), input.ulP1Direction, input.bP1Fire);
+			BotSteer(world, world.Player2(), input.ulP2Direction, input.bP2Fire);
+		}
+
+		long long t0 = CProfiler::Now();
+		{ PROFILE_SCOPE("ApplyInput"); world.ApplyInput(input); }
+		long long t1 = CProfiler::Now();
+		{ PROFILE_SCOPE("Animate"); world.Animate(SIM_DT); }
+		long long t2 = CProfiler::Now();
+		{ PROFILE_SCOPE("RemoveDead"); world.RemoveDead(); }
+		long long t3 = CProfiler::Now();
+
+		result.phases[0].samples.push_back(t1 - t0);
+		result.phases[1].samples.push_back(t2 - t1);
+		result.phases[2].samples.push_back(t3 - t2);
+
+		world.PublishCounters();
+		CCounters::EndFrame(CGameWorld::StateName(world.GetState()));
+		PROFILE_FRAME_MARK();
+
+		totals.resize(CCounters::GetCount(), 0);
+		for (unsigned i = 0; i < totals.size(); i++)
+		{
+			CCounter *pCounter = CCounters::Find(CCounters::GetName(i));
+			if (pCounter && pCounter->Kind() == CCounter::GAUGE)
+				totals[i] = CCounters::GetLastValue(i);
+			else
+				totals[i] += CCounters::GetLastValue(i);
+		}
+
+		// Nothing left to simulate
+		if (world.GetState() == CGameWorld::WON || world.GetState() == CGameWorld::LOST)
+		{
+			ulFrame++;
+			break;
+		}
+	}
+
+	result.llRunAllocations = CCounters::GetHeapAllocations() - llHeap;
+	result.ulFrames = ulFrame;
+	result.finalState = world.GetState();
+	result.iScoreP1 = world.GetScore(CPlayer::TEAM::PLAYER1);
+	result.iScoreP2 = world.GetScore(CPlayer::TEAM::PLAYER2);
+
+	result.counters.resize(totals.size());
+	for (unsigned i = 0; i < totals.size(); i++)
+	{
+		result.counters[i].strName = CCounters::GetName(i);
+		result.counters[i].llValue = totals[i];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : WriteStats () (Static)
+// Desc : Writes the result of a run as JSON. Phase times are reported in
+//		microseconds per frame, except the total which is in milliseconds.
+//-----------------------------------------------------------------------------
+bool CSimRunner::WriteStats( const char *szFileName, const SOptions &opt, const SResult &result )
+{
+	FILE *f = fopen(szFileName, "w");
+	if (!f)
+		return false;
+
+	fprintf(f, "{\n\"frames\":%lu,\n\"seed\":%u,\n\"dt\":%g,\n", result.ulFrames, opt.uSeed, SIM_DT);
+	fprintf(f, "\"final_state\":\"%s\",\n", CGameWorld::StateName(result.finalState));
+	fprintf(f, "\"score_p1\":%d,\n\"score_p2\":%d,\n", result.iScoreP1, result.iScoreP2);
+	fprintf(f, "\"setup_allocations\":%lld,\n\"run_allocations\":%lld,\n",
+		result.llSetupAllocations, result.llRunAllocations);
+
+	fprintf(f, "\"phases\":{");
+	for (size_t p = 0; p < result.phases.size(); p++)
+	{
+		const SPhase &phase = result.phases[p];
+
+		fprintf(f, "%s\n\t\"%s\":{\"total_ms\":%.3f,\"mean_us\":%.3f,\"max_us\":%.3f,\"p95_us\":%.3f}",
+			p ? "," : "", phase.szName, phase.Total() / 1e6, phase.Mean() / 1e3,
+			phase.Max() / 1e3, phase.Percentile(0.95) / 1e3);
+	}
+	fprintf(f, "\n},\n");
+
+	// Per-frame counters are summed over the run, gauges keep their last value
+	fprintf(f, "\"counters\":{");
+	for (size_t i = 0; i < result.counters.size(); i++)
+		fprintf(f, "%s\n\t\"%s\":%lld", i ? "," : "", result.counters[i].strName.c_str(), result.counters[i].llValue);
+	fprintf(f, "\n}\n}\n");
+
+	fclose(f);
+	return true;
+}
@@ -0,0 +1,78 @@
+// SimdLevel.cpp
+// CPU detection and the level every kernel table is picked with.
+#include "SimdLevel.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//-----------------------------------------------------------------------------
+// CPU detection
+//-----------------------------------------------------------------------------
+#ifdef SIMD_X86
+
+static ESimdLevel DetectSimdLevel()
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	int iMaxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool bSSE41 = (info[2] & (1 << 19)) != 0;
+	bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	bool bAVX = (info[2] & (1 << 28)) != 0;
+
+	bool bAVX2 = false;
+	if (iMaxLeaf >= 7 && bOSXSave && bAVX && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		bAVX2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool bSSE41 = __builtin_cpu_supports("sse4.1") != 0;
+	bool bAVX2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+
+	if (bAVX2 && bSSE41)
+		return SIMD_AVX2;
+	if (bSSE41)
+		return SIMD_SSE41;
+	return SIMD_SCALAR;
+}
+
+#else
+
+static ESimdLevel DetectSimdLevel()
+{
+	return SIMD_SCALAR;
+}
+
+#endif // SIMD_X86
+
+static ESimdLevel g_RequestedLevel = SIMD_AVX2;
+
+ESimdLevel GetSupportedSimdLevel()
+{
+	static const ESimdLevel level = DetectSimdLevel();
+	return level;
+}
+
+ESimdLevel GetSimdLevel()
+{
+	ESimdLevel level = GetSupportedSimdLevel();
+	if (g_RequestedLevel < level)
+		level = g_RequestedLevel;
+
+	return level;
+}
+
+void SetSimdLevel(ESimdLevel level)
+{
+	g_RequestedLevel = level;
+}
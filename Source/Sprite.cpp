@@ -1,12 +1,95 @@
 #include "Sprite.h"
+#include "Profiler.h"
+#include "Counters.h"
+
+#include <string.h>
+#include <vector>
 
 extern HINSTANCE g_hInst;
 
+static const CAssetPack *s_pAssetPack = NULL;
+static CAssetLoader *s_pAssetLoader = NULL;
+
+// Pack pixels smaller than 32 bits widened for one draw, shared by every
+// sprite since they are all drawn on the window's thread
+static std::vector<RGBQUAD> s_AssetRows;
+
+void Sprite::setAssetPack(const CAssetPack *pPack)
+{
+	s_pAssetPack = pPack;
+}
+
+void Sprite::setAssetLoader(CAssetLoader *pLoader)
+{
+	s_pAssetLoader = pLoader;
+}
+
+// A DIB section with the pixels the asset loader decoded, or the file
+// loaded here when the loader was not asked for it.
+HBITMAP Sprite::loadBitmap(const char *szFile)
+{
+	CAssetRequest *pRequest = s_pAssetLoader ? s_pAssetLoader->Find(szFile) : NULL;
+	const CImageFile *pImage = pRequest ? pRequest->Get() : NULL;
+
+	if (pImage == NULL)
+	{
+		COUNTER_INC("bitmap loads");
+		return (HBITMAP)LoadImage(g_hInst, szFile, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);
+	}
+
+	// CImageFile keeps the DIB row order, the pixels copy as they are
+	BITMAPINFO info;
+	ZeroMemory(&info, sizeof(info));
+	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	info.bmiHeader.biWidth = pImage->Width();
+	info.bmiHeader.biHeight = pImage->Height();
+	info.bmiHeader.biPlanes = 1;
+	info.bmiHeader.biBitCount = 32;
+	info.bmiHeader.biCompression = BI_RGB;
+
+	void *pBits = NULL;
+	HBITMAP hBitmap = CreateDIBSection(NULL, &info, DIB_RGB_COLORS, &pBits, NULL, 0);
+	if (hBitmap != 0)
+		memcpy(pBits, pImage->Pixels(), sizeof(RGBQUAD) * pImage->Width() * pImage->Height());
+	return hBitmap;
+}
+
+// Points the sprite at a pack entry made with the same transparency, there
+// is nothing to load or decode.
+bool Sprite::loadFromPack(const char *szImageFile, DWORD dwColorKey)
+{
+	mpAsset = s_pAssetPack ? s_pAssetPack->Find(szImageFile) : NULL;
+	if (mpAsset == NULL || mpAsset->dwColorKey != dwColorKey)
+	{
+		mpAsset = NULL;
+		return false;
+	}
+
+	mpAssetPixels = s_pAssetPack->GetPixels(*mpAsset);
+	mpAssetMask = s_pAssetPack->GetMask(*mpAsset);
+	COUNTER_INC("pack sprites");
+
+	ZeroMemory(&mImageBM, sizeof(BITMAP));
+	mImageBM.bmWidth = mpAsset->lWidth;
+	mImageBM.bmHeight = mpAsset->lHeight;
+	ECompactFormat format = (ECompactFormat)mpAsset->dwFormat;
+	mImageBM.bmWidthBytes = (LONG)CCompactImage::GetPixelBytes(format, mpAsset->lWidth, 1);
+	mImageBM.bmPlanes = 1;
+	mImageBM.bmBitsPixel = (WORD)(8 * CCompactImage::GetPixelBytes(format, 1, 1));
+	mImageBM.bmBits = (LPVOID)mpAssetPixels;
+	mMaskBM = mImageBM;
+
+	mhImage = 0;
+	mhMask = 0;
+	return true;
+}
+
 Sprite::Sprite(int imageID, int maskID)
 {
 	// Load the bitmap resources.
 	mhImage = LoadBitmap(g_hInst, MAKEINTRESOURCE(imageID));
 	mhMask = LoadBitmap(g_hInst, MAKEINTRESOURCE(maskID));
+	COUNTER_ADD("bitmap loads", 2);
 
 	// Get the BITMAP structure for each of the bitmaps.
 	GetObject(mhImage, sizeof(BITMAP), &mImageBM);
@@ -19,12 +102,21 @@ Sprite::Sprite(int imageID, int maskID)
 	mcTransparentColor = 0;
 	mhSpriteDC = 0;
 	frameCounter = 0;
+	mpAsset = NULL;
 }
 
 Sprite::Sprite(const char *szImageFile, const char *szMaskFile)
 {
-	mhImage = (HBITMAP)LoadImage(g_hInst, szImageFile, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);
-	mhMask = (HBITMAP)LoadImage(g_hInst, szMaskFile, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);
+	mcTransparentColor = 0;
+	mhSpriteDC = 0;
+	frameCounter = 0;
+
+	// The pack keeps the mask file's mask with the image
+	if (loadFromPack(szImageFile, PACK_NO_COLOR_KEY))
+		return;
+
+	mhImage = loadBitmap(szImageFile);
+	mhMask = loadBitmap(szMaskFile);
 
 	// Get the BITMAP structure for each of the bitmaps.
 	GetObject(mhImage, sizeof(BITMAP), &mImageBM);
@@ -33,24 +125,23 @@ Sprite::Sprite(const char *szImageFile, const char *szMaskFile)
 	// Image and Mask should be the same dimensions.
 	assert(mImageBM.bmWidth == mMaskBM.bmWidth);
 	assert(mImageBM.bmHeight == mMaskBM.bmHeight);
-
-	mcTransparentColor = 0;
-	mhSpriteDC = 0;
-	frameCounter = 0;
 }
 
 Sprite::Sprite(const char *szImageFile, COLORREF crTransparentColor)
 {
-	mhImage = (HBITMAP)LoadImage(g_hInst, szImageFile, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);
-
-	mhMask = 0;
 	mhSpriteDC = 0;
 	mcTransparentColor = crTransparentColor;
+	frameCounter = 0;
+
+	// The pack keeps a mask made from the same color key
+	if (loadFromPack(szImageFile, crTransparentColor))
+		return;
+
+	mhImage = loadBitmap(szImageFile);
+	mhMask = 0;
 
 	// Get the BITMAP structure for the bitmap.
 	GetObject(mhImage, sizeof(BITMAP), &mImageBM);
-
-	frameCounter = 0;
 }
 
 Sprite::~Sprite()
@@ -80,7 +171,9 @@ void Sprite::setBackBuffer(const BackBuffer *pBackBuffer)
 
 void Sprite::draw()
 {
-	if( mhMask != 0 )
+	if( mpAsset != NULL )
+		drawAsset(0, 0, width(), height());
+	else if( mhMask != 0 )
 		drawMask();
 	else
 		drawTransparent();
@@ -88,9 +181,13 @@ void Sprite::draw()
 
 void Sprite::drawMask()
 {
+	PROFILE_SCOPE("Sprite::drawMask");
+
 	if( mpBackBuffer == NULL )
 		return;
 
+	COUNTER_ADD("blits", 2);
+
 	HDC hBackBufferDC = mpBackBuffer->getDC();
 
 	// The position BitBlt wants is not the sprite's center
@@ -129,9 +226,13 @@ void Sprite::drawMask()
 
 void Sprite::drawTransparent()
 {
+	PROFILE_SCOPE("Sprite::drawTransparent");
+
 	if( mpBackBuffer == NULL )
 		return;
 
+	COUNTER_ADD("blits", 4);
+
 	HDC hBackBuffer = mpBackBuffer->getDC();
 
 	int w = width();
@@ -179,6 +280,72 @@ void Sprite::drawTransparent()
 	SetTextColor(hBackBuffer, crOldText);
 }
 
+void Sprite::drawAsset(int xSrc, int ySrc, int w, int h)
+{
+	PROFILE_SCOPE("Sprite::drawAsset");
+
+	if( mpBackBuffer == NULL )
+		return;
+
+	HDC hBackBufferDC = mpBackBuffer->getDC();
+
+	// Upper-left corner.
+	int x = (int)mPosition.x - (w / 2);
+	int y = (int)mPosition.y - (h / 2);
+
+	// Pack bitmaps are bottom-up, whose source rows count from the bottom.
+	int yDib = mImageBM.bmHeight - ySrc - h;
+
+	// 32 bit pixels and the mask are drawn straight from the pack, the header
+	// and the mask's black and white palette are all GDI needs on top.
+	struct
+	{
+		BITMAPINFOHEADER	bmiHeader;
+		RGBQUAD				bmiColors[2];
+	} info;
+	ZeroMemory(&info, sizeof(info));
+	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	info.bmiHeader.biWidth = mImageBM.bmWidth;
+	info.bmiHeader.biHeight = mImageBM.bmHeight;
+	info.bmiHeader.biPlanes = 1;
+	info.bmiHeader.biCompression = BI_RGB;
+
+	// Smaller formats are widened to 32 bits first, only the rows drawn
+	const void *pPixels = mpAssetPixels;
+	int xPixels = xSrc, yPixels = yDib;
+	BITMAPINFOHEADER pixelsHeader = info.bmiHeader;
+	pixelsHeader.biBitCount = 32;
+
+	if( mpAsset->dwFormat != COMPACT_RGB32 )
+	{
+		RECT rc = { xSrc, yDib, xSrc + w - 1, yDib + h - 1 };
+		s_AssetRows.resize((size_t)w * h);
+		s_pAssetPack->Expand(*mpAsset, rc, &s_AssetRows[0], w);
+
+		pPixels = &s_AssetRows[0];
+		xPixels = yPixels = 0;
+		pixelsHeader.biWidth = w;
+		pixelsHeader.biHeight = h;
+	}
+
+	if( mpAssetMask == NULL )
+	{
+		COUNTER_INC("blits");
+		StretchDIBits(hBackBufferDC, x, y, w, h, xPixels, yPixels, w, h, pPixels, (const BITMAPINFO*)&pixelsHeader, DIB_RGB_COLORS, SRCCOPY);
+		return;
+	}
+
+	COUNTER_ADD("blits", 2);
+
+	// Same two passes as drawMask: the mask clears the opaque pixels, the
+	// image (black where transparent) is ORed on top.
+	info.bmiHeader.biBitCount = 1;
+	info.bmiColors[1].rgbRed = info.bmiColors[1].rgbGreen = info.bmiColors[1].rgbBlue = 0xff;
+	StretchDIBits(hBackBufferDC, x, y, w, h, xSrc, yDib, w, h, mpAssetMask, (const BITMAPINFO*)&info, DIB_RGB_COLORS, SRCAND);
+
+	StretchDIBits(hBackBufferDC, x, y, w, h, xPixels, yPixels, w, h, pPixels, (const BITMAPINFO*)&pixelsHeader, DIB_RGB_COLORS, SRCPAINT);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 AnimatedSprite::AnimatedSprite(const char *szImageFile, const char *szMaskFile, const RECT& rcFirstFrame, int iFrameCount) 
@@ -202,9 +369,19 @@ void AnimatedSprite::SetFrame(int iIndex)
 
 void AnimatedSprite::draw()
 {
+	PROFILE_SCOPE("AnimatedSprite::draw");
+
 	if( mpBackBuffer == NULL )
 		return;
 
+	if( mpAsset != NULL )
+	{
+		drawAsset(mptFrameCrop.x, mptFrameCrop.y, miFrameWidth, miFrameHeight);
+		return;
+	}
+
+	COUNTER_ADD("blits", 2);
+
 	// The position BitBlt wants is not the sprite's center
 	// position; rather, it wants the upper-left position,
 	// so compute that.
@@ -0,0 +1,289 @@
+//-----------------------------------------------------------------------------
+// File: StreamResizer.cpp
+//
+// Desc: Row streaming resampler and the image / BMP file row providers and
+//	sinks it works with.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// StreamResizer Specific Includes
+//-----------------------------------------------------------------------------
+#include "StreamResizer.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+namespace
+{
+	const DWORD BMP_FILE_HEADER_SIZE = 14;
+	const DWORD BMP_INFO_HEADER_SIZE = 40;
+
+	// BMP headers are little endian and packed, read them byte by byte
+	DWORD ReadLE( const BYTE *p, int iBytes )
+	{
+		DWORD dwValue = 0;
+		for (int i = iBytes - 1; i >= 0; i--)
+			dwValue = (dwValue << 8) | p[i];
+		return dwValue;
+	}
+
+	void WriteLE( BYTE *p, DWORD dwValue, int iBytes )
+	{
+		for (int i = 0; i < iBytes; i++, dwValue >>= 8)
+			p[i] = BYTE(dwValue & 0xff);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// CImageRowProvider / CImageRowSink Member Functions
+//-----------------------------------------------------------------------------
+bool CImageRowProvider::ReadRow( LONG y, RGBQUAD *pRow )
+{
+	if (y < 0 || y >= m_Image.Height())
+		return false;
+
+	memcpy(pRow, m_Image.Pixels() + y * m_Image.Width(), sizeof(RGBQUAD) * m_Image.Width());
+	return true;
+}
+
+bool CImageRowSink::WriteRow( LONG y, const RGBQUAD *pRow )
+{
+	if (y < 0 || y >= m_Image.Height())
+		return false;
+
+	memcpy(m_Image.Pixels() + y * m_Image.Width(), pRow, sizeof(RGBQUAD) * m_Image.Width());
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// CBmpRowProvider Member Functions
+//-----------------------------------------------------------------------------
+CBmpRowProvider::CBmpRowProvider() :
+	m_pFile(NULL), m_lWidth(0), m_lHeight(0), m_bBottomUp(true), m_wBitCount(0),
+	m_dwPixelsOffset(0), m_dwStride(0), m_pLine(NULL)
+{
+}
+
+CBmpRowProvider::~CBmpRowProvider()
+{
+	Close();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Open ()
+// Desc : Reads the headers, only uncompressed 24 and 32 bit files are
+//		accepted.
+//-----------------------------------------------------------------------------
+bool CBmpRowProvider::Open( const char *szFileName )
+{
+	Close();
+
+	m_pFile = fopen(szFileName, "rb");
+	if (!m_pFile)
+		return false;
+
+	BYTE header[BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE];
+	if (fread(header, 1, sizeof(header), m_pFile) != sizeof(header) || header[0] != 'B' || header[1] != 'M')
+	{
+		Close();
+		return false;
+	}
+
+	const BYTE *pInfo = header + BMP_FILE_HEADER_SIZE;
+	LONG lHeight = (LONG)ReadLE(pInfo + 8, 4);
+
+	m_dwPixelsOffset = ReadLE(header + 10, 4);
+	m_lWidth = (LONG)ReadLE(pInfo + 4, 4);
+	m_lHeight = lHeight < 0 ? -lHeight : lHeight;
+	m_bBottomUp = lHeight > 0;
+	m_wBitCount = (WORD)ReadLE(pInfo + 14, 2);
+
+	DWORD dwCompression = ReadLE(pInfo + 16, 4);
+	if (m_lWidth <= 0 || m_lHeight <= 0 || dwCompression != BI_RGB || (m_wBitCount != 24 && m_wBitCount != 32))
+	{
+		Close();
+		return false;
+	}
+
+	m_dwStride = ((DWORD)m_lWidth * m_wBitCount + 31) / 32 * 4;
+	m_pLine = new BYTE[m_dwStride];
+	return true;
+}
+
+void CBmpRowProvider::Close()
+{
+	if (m_pFile)
+		fclose(m_pFile);
+	delete[] m_pLine;
+
+	m_pFile = NULL;
+	m_pLine = NULL;
+	m_lWidth = m_lHeight = 0;
+}
+
+bool CBmpRowProvider::ReadRow( LONG y, RGBQUAD *pRow )
+{
+	if (!m_pFile || y < 0 || y >= m_lHeight)
+		return false;
+
+	LONG lFileRow = m_bBottomUp ? m_lHeight - 1 - y : y;
+	if (fseek(m_pFile, long(m_dwPixelsOffset + (DWORD)lFileRow * m_dwStride), SEEK_SET) != 0 ||
+		fread(m_pLine, 1, m_dwStride, m_pFile) != m_dwStride)
+		return false;
+
+	if (m_wBitCount == 32)
+	{
+		memcpy(pRow, m_pLine, sizeof(RGBQUAD) * m_lWidth);
+		return true;
+	}
+
+	const BYTE *pSrc = m_pLine;
+	for (LONG x = 0; x < m_lWidth; x++, pSrc += 3)
+	{
+		pRow[x].rgbBlue = pSrc[0];
+		pRow[x].rgbGreen = pSrc[1];
+		pRow[x].rgbRed = pSrc[2];
+		pRow[x].rgbReserved = 0;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// CBmpRowSink Member Functions
+//-----------------------------------------------------------------------------
+CBmpRowSink::CBmpRowSink() : m_pFile(NULL), m_lWidth(0), m_bOk(false)
+{
+}
+
+CBmpRowSink::~CBmpRowSink()
+{
+	Close();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Create ()
+// Desc : Writes the headers. The height is stored negative (top-down) so
+//		rows can be appended in the order they are produced.
+//-----------------------------------------------------------------------------
+bool CBmpRowSink::Create( const char *szFileName, LONG lWidth, LONG lHeight )
+{
+	Close();
+
+	if (lWidth <= 0 || lHeight <= 0)
+		return false;
+
+	m_pFile = fopen(szFileName, "wb");
+	if (!m_pFile)
+		return false;
+
+	DWORD dwImageSize = (DWORD)lWidth * (DWORD)lHeight * sizeof(RGBQUAD);
+	BYTE header[BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE];
+	memset(header, 0, sizeof(header));
+
+	header[0] = 'B';
+	header[1] = 'M';
+	WriteLE(header + 2, sizeof(header) + dwImageSize, 4);
+	WriteLE(header + 10, sizeof(header), 4);
+
+	BYTE *pInfo = header + BMP_FILE_HEADER_SIZE;
+	WriteLE(pInfo, BMP_INFO_HEADER_SIZE, 4);
+	WriteLE(pInfo + 4, (DWORD)lWidth, 4);
+	WriteLE(pInfo + 8, (DWORD)-lHeight, 4);
+	WriteLE(pInfo + 12, 1, 2);
+	WriteLE(pInfo + 14, 32, 2);
+	WriteLE(pInfo + 16, BI_RGB, 4);
+	WriteLE(pInfo + 20, dwImageSize, 4);
+
+	m_lWidth = lWidth;
+	m_bOk = fwrite(header, 1, sizeof(header), m_pFile) == sizeof(header);
+	return m_bOk;
+}
+
+bool CBmpRowSink::Close()
+{
+	bool bOk = m_bOk;
+	if (m_pFile)
+		bOk = (fclose(m_pFile) == 0) && bOk;
+
+	m_pFile = NULL;
+	m_bOk = false;
+	return bOk;
+}
+
+bool CBmpRowSink::WriteRow( LONG /*y*/, const RGBQUAD *pRow )
+{
+	if (!m_pFile)
+		return false;
+
+	// 32 bit rows need no padding
+	m_bOk = m_bOk && fwrite(pRow, sizeof(RGBQUAD), m_lWidth, m_pFile) == (size_t)m_lWidth;
+	return m_bOk;
+}
+
+//-----------------------------------------------------------------------------
+// CStreamResizer Member Functions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : Resample ()
+// Desc : Every source row is filtered horizontally once, when the first
+//		destination row needing it comes up, and stored twice in a ring
+//		of 2 * taps rows (slots r % taps and r % taps + taps). The rows
+//		under any destination row are then consecutive in the ring and
+//		go straight through the vertical kernel.
+//-----------------------------------------------------------------------------
+bool CStreamResizer::Resample( IRowProvider &source, unsigned dst_width, unsigned dst_height, IRowSink &sink )
+{
+	PROFILE_SCOPE("CStreamResizer::Resample");
+
+	LONG src_width = source.Width();
+	LONG src_height = source.Height();
+	m_WorkingBytes = 0;
+
+	if (!m_pFilter || src_width <= 0 || src_height <= 0 || dst_width == 0 || dst_height == 0)
+		return false;
+
+	CWeightsCache::TablePtr pRowWeights = CWeightsCache::Get(m_pFilter, dst_width, src_width);
+	CWeightsCache::TablePtr pColWeights = CWeightsCache::Get(m_pFilter, dst_height, src_height);
+
+	// Ring length, the widest vertical window
+	unsigned uRing = 1;
+	for (unsigned y = 0; y < dst_height; y++)
+		uRing = (std::max)(uRing, unsigned(pColWeights->getRightBoundary(y) - pColWeights->getLeftBoundary(y) + 1));
+
+	std::vector<RGBQUAD> srcRow(src_width);
+	std::vector<RGBQUAD> ring(2 * uRing * dst_width);
+	std::vector<RGBQUAD> dstRow(dst_width);
+	m_WorkingBytes = sizeof(RGBQUAD) * (srcRow.size() + ring.size() + dstRow.size());
+
+	const SResizeKernels &kernels = GetResizeKernels();
+	LONG lNextRow = 0;		// First source row not read yet
+
+	for (unsigned y = 0; y < dst_height; y++)
+	{
+		int iLeft = pColWeights->getLeftBoundary(y);
+		int iRight = pColWeights->getRightBoundary(y);
+
+		// Rows before the window are not needed by this or any later row
+		lNextRow = (std::max)(lNextRow, (LONG)iLeft);
+
+		for (; lNextRow <= iRight; lNextRow++)
+		{
+			if (!source.ReadRow(lNextRow, &srcRow[0]))
+				return false;
+
+			RGBQUAD *pSlot = &ring[(lNextRow % uRing) * dst_width];
+			kernels.pfnRow(&srcRow[0], 0, pSlot, 0, dst_width, *pRowWeights);
+			memcpy(pSlot + uRing * dst_width, pSlot, sizeof(RGBQUAD) * dst_width);
+		}
+
+		kernels.pfnCol(&ring[(iLeft % uRing) * dst_width], dst_width, &dstRow[0], dst_width,
+			pColWeights->getFixedWeights(y), iRight - iLeft + 1);
+
+		if (!sink.WriteRow(y, &dstRow[0]))
+			return false;
+	}
+
+	return true;
+}
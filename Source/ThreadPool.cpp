@@ -0,0 +1,162 @@
+//-----------------------------------------------------------------------------
+// File: ThreadPool.cpp
+//
+// Desc: Fixed size pool of worker threads running banded loops.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// ThreadPool Specific Includes
+//-----------------------------------------------------------------------------
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace
+{
+	thread_local unsigned t_uThreadIndex = 0;
+}
+
+//-----------------------------------------------------------------------------
+// CThreadPool Member Functions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CThreadPool () (Constructor)
+// Desc : Starts uThreads - 1 workers, the thread calling Run is the last one.
+//		0 uses every hardware thread.
+//-----------------------------------------------------------------------------
+CThreadPool::CThreadPool( unsigned uThreads ) :
+	m_ulGeneration(0), m_uBusyWorkers(0), m_bQuit(false),
+	m_pfnBand(NULL), m_pContext(NULL), m_uCount(0), m_uBandSize(1), m_NextBand(0)
+{
+	if (uThreads == 0)
+		uThreads = GetHardwareThreads();
+
+	m_Workers.reserve(uThreads - 1);
+	for (unsigned i = 1; i < uThreads; i++)
+		m_Workers.push_back(std::thread(&CThreadPool::WorkerMain, this, i));
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CThreadPool () (Destructor)
+//-----------------------------------------------------------------------------
+CThreadPool::~CThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_Lock);
+		m_bQuit = true;
+	}
+	m_WakeWorkers.notify_all();
+
+	for (size_t i = 0; i < m_Workers.size(); i++)
+		m_Workers[i].join();
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetHardwareThreads () (Static)
+//-----------------------------------------------------------------------------
+unsigned CThreadPool::GetHardwareThreads()
+{
+	return (std::max)(1u, std::thread::hardware_concurrency());
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetThreadIndex () (Static)
+//-----------------------------------------------------------------------------
+unsigned CThreadPool::GetThreadIndex()
+{
+	return t_uThreadIndex;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Run ()
+// Desc : Hands out bands of the range until none are left. Each thread gets
+//		about four bands so uneven bands still balance out.
+//-----------------------------------------------------------------------------
+void CThreadPool::Run( unsigned uCount, unsigned uGrain, BAND_FUNC pfnBand, void *pContext )
+{
+	if (uCount == 0)
+		return;
+
+	// The caller is thread 0 of this pool, even when it is a worker of
+	// another one
+	unsigned uCallerIndex = t_uThreadIndex;
+	t_uThreadIndex = 0;
+
+	unsigned uThreads = GetThreadCount();
+	unsigned uBandSize = (std::max)((std::max)(uGrain, 1u), (uCount + uThreads * 4 - 1) / (uThreads * 4));
+
+	// Not worth waking anybody up
+	if (uThreads == 1 || uBandSize >= uCount)
+	{
+		pfnBand(pContext, 0, uCount);
+		t_uThreadIndex = uCallerIndex;
+		return;
+	}
+
+	std::lock_guard<std::mutex> running(m_RunLock);
+	{
+		std::lock_guard<std::mutex> guard(m_Lock);
+		m_pfnBand = pfnBand;
+		m_pContext = pContext;
+		m_uCount = uCount;
+		m_uBandSize = uBandSize;
+		m_NextBand.store(0, std::memory_order_relaxed);
+		m_uBusyWorkers = (unsigned)m_Workers.size();
+		m_ulGeneration++;
+	}
+	m_WakeWorkers.notify_all();
+
+	DoBands();
+
+	std::unique_lock<std::mutex> lock(m_Lock);
+	m_WakeCaller.wait(lock, [this] { return m_uBusyWorkers == 0; });
+	m_pfnBand = NULL;
+	m_pContext = NULL;
+	t_uThreadIndex = uCallerIndex;
+}
+
+//-----------------------------------------------------------------------------
+// Name : DoBands () (Private)
+// Desc : Claims and runs bands of the current job until all are taken.
+//-----------------------------------------------------------------------------
+void CThreadPool::DoBands()
+{
+	for (;;)
+	{
+		unsigned uBegin = m_NextBand.fetch_add(m_uBandSize, std::memory_order_relaxed);
+		if (uBegin >= m_uCount)
+			break;
+
+		m_pfnBand(m_pContext, uBegin, (std::min)(uBegin + m_uBandSize, m_uCount));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : WorkerMain () (Private)
+// Desc : Sleeps until a new job is posted, helps with it and reports back.
+//-----------------------------------------------------------------------------
+void CThreadPool::WorkerMain( unsigned uIndex )
+{
+	CProfiler::SetThreadName("Pool worker");
+	t_uThreadIndex = uIndex;
+
+	unsigned long ulSeen = 0;
+	std::unique_lock<std::mutex> lock(m_Lock);
+
+	for (;;)
+	{
+		m_WakeWorkers.wait(lock, [this, ulSeen] { return m_bQuit || m_ulGeneration != ulSeen; });
+		if (m_bQuit)
+			break;
+
+		ulSeen = m_ulGeneration;
+		lock.unlock();
+
+		DoBands();
+
+		lock.lock();
+		if (--m_uBusyWorkers == 0)
+			m_WakeCaller.notify_one();
+	}
+}